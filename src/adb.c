@@ -0,0 +1,276 @@
+/** @file
+ * Client of the adb server's host protocol.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every function here speaks to the server over a connection of its own, since
+ * the server only allows a single request per connection once a transport has
+ * been chosen. The server's port may be moved with ANDROID_ADB_SERVER_PORT just
+ * as it can for the adb client.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "adb.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Port the adb server listens on unless told otherwise. */
+#define ADB_PORT (5037)
+
+/** Maximum number of characters of a request. */
+#define REQUEST_NCHARS (1024)
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static int read_all(int fd, void *data, size_t len);
+static int read_length(int fd, size_t *len);
+static int write_all(int fd, const void *data, size_t len);
+
+/******************************************************************************/
+
+/**
+ * Connect to the adb server. Returns the connected socket or -1 on failure.
+ */
+int adb_connect(void)
+{
+    int port = ADB_PORT;
+    const char *env = getenv("ANDROID_ADB_SERVER_PORT");
+    if (env != NULL && atoi(env) > 0) {
+        port = atoi(env);
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/**
+ * Run the given command on the device with the given serial number. Returns a
+ * socket carrying the command's output or -1 on failure, with errno set to
+ * EPROTO when the server is running but refused to run it. Unless tty is NULL
+ * it is set to whether the output passes through a terminal on the device,
+ * which ends its lines with a carriage return as well.
+ */
+int adb_open_command(const char *serial, const char *command, bool *tty)
+{
+    char transport[REQUEST_NCHARS];
+    snprintf(transport, sizeof(transport), "host:transport:%s", serial);
+
+    // exec: skips the device's shell and any line ending translation but only
+    // exists from Android 5.0 onwards; older devices get shell:.
+    static const char *services[] = { "exec:", "shell:" };
+    for (size_t i = 0; i < sizeof(services) / sizeof(services[0]); ++i) {
+        char service[REQUEST_NCHARS];
+        snprintf(service, sizeof(service), "%s%s", services[i], command);
+
+        int fd = adb_connect();
+        if (fd < 0) {
+            return -1;
+        }
+        if (adb_request(fd, transport) == 0 && adb_request(fd, service) == 0) {
+            if (tty != NULL) {
+                *tty = i > 0;
+            }
+            return fd;
+        }
+        close(fd);
+    }
+    errno = EPROTO;
+    return -1;
+}
+
+/**
+ * Start logcat with the given arguments on the device with the given serial
+ * number. Returns a socket carrying logcat's output or -1 on failure, setting
+ * tty, just as adb_open_command() does.
+ */
+int adb_open_logcat(const char *serial, const char *args, bool *tty)
+{
+    char command[REQUEST_NCHARS];
+    snprintf(command, sizeof(command), "logcat %s", args);
+    return adb_open_command(serial, command, tty);
+}
+
+/**
+ * Send the given host service request and read its length prefixed reply into
+ * out, which is always NUL terminated. Replies longer than out are cut short.
+ * Returns the length of the reply kept or -1 on failure.
+ */
+ssize_t adb_query(const char *service, char *out, size_t n)
+{
+    int fd = adb_connect();
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t len = -1;
+    if (adb_request(fd, service) == 0) {
+        len = adb_read_reply(fd, out, n);
+    }
+    close(fd);
+    return len;
+}
+
+/**
+ * Read a length prefixed reply from the given connection into out, which is
+ * always NUL terminated. Replies longer than out are cut short. Returns the
+ * length of the reply kept or -1 on failure.
+ */
+ssize_t adb_read_reply(int fd, char *out, size_t n)
+{
+    size_t len;
+    if (read_length(fd, &len) != 0) {
+        return -1;
+    }
+    size_t kept = len < n - 1 ? len : n - 1;
+    if (read_all(fd, out, kept) != 0) {
+        return -1;
+    }
+    out[kept] = '\0';
+
+    // Skip whatever did not fit.
+    char discard[REQUEST_NCHARS];
+    for (size_t left = len - kept; left > 0;) {
+        size_t chunk = left < sizeof(discard) ? left : sizeof(discard);
+        if (read_all(fd, discard, chunk) != 0) {
+            return -1;
+        }
+        left -= chunk;
+    }
+    return kept;
+}
+
+/**
+ * Send the given service request over the given connection. Returns 0 if the
+ * server accepted the request or -1 otherwise.
+ */
+int adb_request(int fd, const char *service)
+{
+    char request[4 + REQUEST_NCHARS + 1];
+    size_t len = strlen(service);
+    if (len > REQUEST_NCHARS) {
+        errno = EINVAL;
+        return -1;
+    }
+    snprintf(request, sizeof(request), "%04zx%s", len, service);
+    if (write_all(fd, request, len + 4) != 0) {
+        return -1;
+    }
+
+    // A refusal is followed by the server's reason, which nobody reads; the
+    // connection is closed on failure anyway.
+    char status[4];
+    if (read_all(fd, status, sizeof(status)) != 0) {
+        return -1;
+    }
+    if (memcmp(status, "OKAY", sizeof(status)) != 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read exactly len bytes from the given descriptor. Returns 0 on success or
+ * -1 on failure or end of file.
+ */
+static int read_all(int fd, void *data, size_t len)
+{
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * Read the four digit hexadecimal length that prefixes a reply. Returns 0 on
+ * success or -1 on failure.
+ */
+static int read_length(int fd, size_t *len)
+{
+    char hex[5];
+    if (read_all(fd, hex, 4) != 0) {
+        return -1;
+    }
+    hex[4] = '\0';
+    char *end;
+    *len = strtoul(hex, &end, 16);
+    return *end == '\0' ? 0 : -1;
+}
+
+/**
+ * Write exactly len bytes to the given descriptor. Returns 0 on success or -1
+ * on failure.
+ */
+static int write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+/** @file
+ * Client of the adb server's host protocol.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Requests are sent to the adb server over TCP as a four digit hexadecimal
+ * length followed by the request itself. The server answers OKAY or FAIL, the
+ * latter followed by a length prefixed message. Once a transport to a device
+ * has been selected the connection carries whatever the service run on the
+ * device writes, which lets logcat output stream straight from the server into
+ * our buffers.
+ */
+#ifndef ADB_H_
+#define ADB_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int adb_connect(void);
+int adb_open_command(const char *serial, const char *command, bool *tty);
+int adb_open_logcat(const char *serial, const char *args, bool *tty);
+ssize_t adb_query(const char *service, char *out, size_t n);
+ssize_t adb_read_reply(int fd, char *out, size_t n);
+int adb_request(int fd, const char *service);
+
+#endif
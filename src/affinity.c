@@ -0,0 +1,116 @@
+/** @file
+ * Placement of threads of execution on processors.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every thread pins itself as it starts, so threads started later, such as
+ * those of devices that connect later, are placed the same way.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "affinity.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Processors each class of threads is kept to. */
+static cpu_set_t cpus[AFFINITY_CLASSES_N];
+
+/** Whether each class of threads is kept to its processors. */
+static bool pinned[AFFINITY_CLASSES_N];
+
+/******************************************************************************/
+
+/**
+ * Keep the given class of threads to the processors of the given list, of
+ * numbers and ranges of numbers separated by commas, such as 0-3,8. Returns 0
+ * on success or EINVAL when the list names no processor the process may run
+ * on.
+ */
+int affinity_parse(enum affinity_class class, const char *list)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    const char *p = list;
+    for (;;) {
+        char *end;
+        unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        if (end == p) {
+            return EINVAL;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p || last < first) {
+                return EINVAL;
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return EINVAL;
+        }
+        for (unsigned long cpu = first; cpu <= last; ++cpu) {
+            CPU_SET(cpu, &set);
+        }
+        if (*end == '\0') {
+            break;
+        }
+        if (*end != ',') {
+            return EINVAL;
+        }
+        p = end + 1;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return errno;
+    }
+    CPU_AND(&set, &set, &allowed);
+    if (CPU_COUNT(&set) == 0) {
+        return EINVAL;
+    }
+    cpus[class] = set;
+    pinned[class] = true;
+    return 0;
+}
+
+/**
+ * Keep the calling thread to the processors of the given class of threads,
+ * when it is kept to any.
+ */
+void affinity_pin(enum affinity_class class)
+{
+    if (pinned[class]) {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus[class]),
+                               &cpus[class]);
+    }
+}
@@ -0,0 +1,60 @@
+/** @file
+ * Placement of threads of execution on processors.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Threads fall in two classes that may each be kept to a set of processors of
+ * their own: those reading devices, the thread of each device, the event loops
+ * and the workers, and those writing what was read, the output writer, the
+ * compressor of archives and the writer of snapshots. Kept apart on a host of
+ * several sockets, readers and writers stop competing for the same cores and
+ * each class keeps what it shares, such as the tag map, within the caches of
+ * its own socket.
+ *
+ * Memory is placed on the node of the processor that first touches it, so the
+ * blocks a pinned reader fills come from that node; blocks are pooled by node
+ * to keep them there, see buffer.h.
+ */
+#ifndef AFFINITY_H_
+#define AFFINITY_H_
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Classes of threads of execution placed on processors together.
+ */
+enum affinity_class {
+    AFFINITY_READERS,   //!< Threads reading devices and parsing their lines.
+    AFFINITY_WRITERS,   //!< Threads writing lines out.
+    AFFINITY_CLASSES_N,
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int affinity_parse(enum affinity_class class, const char *list);
+void affinity_pin(enum affinity_class class);
+
+#endif
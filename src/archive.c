@@ -0,0 +1,880 @@
+/** @file
+ * Compressed archives of the lines of each device, indexed by time and tag.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every member of a file is a complete gzip member of its own. The index is the
+ * extra field of the last member, which holds nothing, and ends with the offset
+ * of that member so readers find it from the end of the file. An index entry is
+ * little endian: the offset and compressed size of a member, the size of its
+ * lines, the earliest and latest times of its lines as merge keys and a bloom
+ * filter over the hashes of their tags' names. Tag identifiers are only good
+ * for one run, names are good forever. Files without an index, such as those of
+ * a run that was killed, are read through member by member instead.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "archive.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "affinity.h"
+#include "logcat.h"
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bits of the bloom filter of the tags of a frame. */
+#define BLOOM_NBITS (256)
+
+/** Number of bits of the bloom filter set for each tag. */
+#define BLOOM_NHASHES (3)
+
+/** Number of bytes of an entry of the index. */
+#define ENTRY_NBYTES (8 + 4 + 4 + 8 + 8 + BLOOM_NBITS / 8)
+
+/**
+ * Most frames indexed by a single file; the index has to fit the extra field
+ * of a gzip header.
+ */
+#define FRAMES_NMAX (1000)
+
+/** Milliseconds of logging a frame spans at most. */
+#define FRAME_MS (10 * 1000)
+
+/** Window bits that have zlib write and read gzip members. */
+#define GZIP_WINDOW_BITS (15 + 16)
+
+/** Number of bytes of a gzip header before its extra field. */
+#define HEADER_NBYTES (10)
+
+/** Number of bytes of decompressed lines gone through at once. */
+#define INFLATE_NBYTES (64 * 1024)
+
+/** Maximum number of characters of the name of a stream. */
+#define NAME_NCHARS (128)
+
+/** Most frames waiting on the compressor before devices wait on it. */
+#define PENDING_NMAX (16)
+
+/**
+ * Number of bytes ending a file with an index; the subfield holding the
+ * offset of the index, the empty compressed data, its CRC and its size.
+ */
+#define TRAILER_NBYTES (4 + 8 + 2 + 4 + 4)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Lines of a device waiting to be compressed.
+ */
+struct archive_frame {
+    struct archive_frame  *next;   //!< Next frame waiting on the compressor.
+    struct archive_stream *stream; //!< Stream the frame belongs to.
+    bool                   last;   //!< Whether the stream ends with it.
+    uint64_t               first;  //!< Earliest time of the lines, as a key.
+    uint64_t               latest; //!< Latest time of the lines, as a key.
+    uint8_t                bloom[BLOOM_NBITS / 8]; //!< Tags of the lines.
+    size_t                 size;   //!< Bytes of room for lines.
+    size_t                 used;   //!< Bytes of lines held.
+    char                   data[]; //!< Lines, each ending with a newline.
+};
+
+/**
+ * Files the lines of a single device are archived to. Only the compressor
+ * touches a stream once it has been opened.
+ */
+struct archive_stream {
+    struct archive_stream *next;      //!< Next stream with a file open.
+    char                   name[NAME_NCHARS]; //!< Serial number of device.
+    int                    fd;        //!< Descriptor of the file, -1 if none.
+    bool                   failed;    //!< Whether failing was reported.
+    uint64_t               offset;    //!< Bytes written to the file.
+    size_t                 nentries;  //!< Frames within the file.
+    uint8_t                index[FRAMES_NMAX * ENTRY_NBYTES]; //!< Entries.
+};
+
+/**
+ * Lines looked for within an archive.
+ */
+struct query {
+    uint64_t             from;    //!< Earliest time of the lines.
+    uint64_t             until;   //!< Latest time of the lines.
+    const char          *tag;     //!< Tag of the lines, NULL for any.
+    size_t               tag_len; //!< Length of the tag.
+    uint32_t             hash;    //!< Hash of the tag.
+    FILE                *out;     //!< Stream lines are written to.
+    struct logcat_clock  clock;   //!< Decoder of the times of lines.
+    struct logcat_parser parser;  //!< Parser of lines.
+    const struct logcat_format *format; //!< Format of the lines, as last
+                                        //!< detected.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Directory lines are archived to, NULL to not archive them. */
+const char *archive_dir;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Room frames are compressed into, only touched by the compressor. */
+static Bytef *deflated;
+
+/** Number of bytes of room frames are compressed into. */
+static size_t deflated_size;
+
+/** Streams with a file open, only touched by the compressor. */
+static struct archive_stream *files;
+
+/** Number of frames waiting on the compressor. */
+static unsigned npending;
+
+/** Frames waiting on the compressor, oldest first. */
+static struct archive_frame *queue;
+
+/** Lock used to prevent concurrent modification of the queue. */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Latest frame waiting on the compressor. */
+static struct archive_frame *queue_tail;
+
+/** Condition signalled when a frame leaves the queue. */
+static pthread_cond_t room = PTHREAD_COND_INITIALIZER;
+
+/** Whether the compressor was started. */
+static bool started;
+
+/** Whether the compressor is to stop once the queue is empty. */
+static bool stopping;
+
+/** Thread of execution compressing frames. */
+static pthread_t thread;
+
+/** Condition signalled when a frame enters the queue. */
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void bloom_add(uint8_t *bloom, uint32_t hash);
+static bool bloom_has(const uint8_t *bloom, uint32_t hash);
+static int extract_frame(int fd, uint64_t offset, size_t len,
+                         struct query *q);
+static void extract_line(struct query *q, const char *line, size_t len);
+static void fail(struct archive_stream *s, const char *what);
+static void finish_file(struct archive_stream *s);
+static uint64_t get_le(const uint8_t *p, int nbytes);
+static struct archive_frame *new_frame(struct archive_stream *s,
+                                       size_t size);
+static void put_le(uint8_t *p, uint64_t value, int nbytes);
+static int read_index(int fd, uint64_t size, uint8_t **index,
+                      size_t *nentries);
+static void *run_compressor(void *unused);
+static int start_file(struct archive_stream *s);
+static void submit(struct archive_frame *f);
+static int write_all(struct archive_stream *s, const void *data,
+                     size_t len);
+static void write_frame(z_stream *z, struct archive_frame *f);
+
+/******************************************************************************/
+
+/**
+ * Append the line made up of the given parts, logged at the given time with a
+ * tag of the given hash, to the device's archive. A frame that is full or
+ * spans long enough is handed to the compressor first.
+ */
+void archive_add(struct archive *a, uint64_t key, uint32_t hash,
+                 const struct iovec *parts, int nparts)
+{
+    if (a->stream == NULL) {
+        return;
+    }
+    size_t len = 0;
+    for (int i = 0; i < nparts; ++i) {
+        len += parts[i].iov_len;
+    }
+
+    struct archive_frame *f = a->frame;
+    if (f != NULL
+        && (f->used + len > f->size
+            || (f->first != UINT64_MAX && key >= f->first + FRAME_MS))) {
+        submit(f);
+        f = NULL;
+    }
+    if (f == NULL) {
+        f = new_frame(a->stream, len > ARCHIVE_FRAME_NBYTES
+                                     ? len : ARCHIVE_FRAME_NBYTES);
+        a->frame = f;
+    }
+    for (int i = 0; i < nparts; ++i) {
+        memcpy(f->data + f->used, parts[i].iov_base, parts[i].iov_len);
+        f->used += parts[i].iov_len;
+    }
+    // Lines whose time is not known do not narrow the frame's time range.
+    if (key != 0) {
+        if (key < f->first) {
+            f->first = key;
+        }
+        if (key > f->latest) {
+            f->latest = key;
+        }
+    }
+    bloom_add(f->bloom, hash);
+}
+
+/**
+ * Hand whatever the device's archive holds to the compressor, which ends the
+ * device's file with its index.
+ */
+void archive_close(struct archive *a)
+{
+    if (a->stream == NULL) {
+        return;
+    }
+    struct archive_frame *f = a->frame;
+    if (f == NULL) {
+        f = new_frame(a->stream, 0);
+    }
+    f->last = true;
+    submit(f);
+    a->stream = NULL;
+    a->frame = NULL;
+}
+
+/**
+ * Write the lines of the archive file at the given path logged between the
+ * given times, and with the given tag unless NULL, to the given stream. Only
+ * the frames the index says may hold such lines are decompressed. Returns 0 on
+ * success or an error number otherwise.
+ */
+int archive_extract(const char *path, uint64_t from, uint64_t until,
+                    const char *tag, FILE *out)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+
+    struct query q = {
+        .from = from,
+        .until = until,
+        .tag = tag,
+        .tag_len = tag != NULL ? strlen(tag) : 0,
+        .out = out,
+        .format = &logcat_format_time,
+    };
+    q.hash = tag_hash(q.tag, q.tag_len);
+    int err = logcat_parser_init(&q.parser);
+    assert(!err);
+
+    uint8_t *index = NULL;
+    size_t nentries = 0;
+    err = read_index(fd, st.st_size, &index, &nentries);
+    if (err == ENOENT) {
+        err = extract_frame(fd, 0, st.st_size, &q);
+    } else if (!err) {
+        for (size_t i = 0; i < nentries && !err; ++i) {
+            const uint8_t *e = index + i * ENTRY_NBYTES;
+            uint64_t first = get_le(e + 16, 8);
+            uint64_t latest = get_le(e + 24, 8);
+            // Frames without known times may hold anything.
+            if ((first <= latest && (latest < from || first > until))
+                || (tag != NULL && !bloom_has(e + 32, q.hash))) {
+                continue;
+            }
+            err = extract_frame(fd, get_le(e, 8), get_le(e + 8, 4), &q);
+        }
+        free(index);
+    }
+    logcat_parser_free(&q.parser);
+    close(fd);
+    return err;
+}
+
+/**
+ * Start archiving the lines of the device with the given serial number when
+ * asked to. The file is only created once its first frame is compressed.
+ */
+void archive_open(struct archive *a, const char *name)
+{
+    a->frame = NULL;
+    a->stream = NULL;
+    if (archive_dir == NULL) {
+        return;
+    }
+    struct archive_stream *s = malloc(sizeof(*s));
+    if (s == NULL) {
+        fprintf(stderr, "Failure to allocate archive stream.\n");
+        abort();
+    }
+    s->next = NULL;
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->fd = -1;
+    s->failed = false;
+    s->offset = 0;
+    s->nentries = 0;
+    a->stream = s;
+}
+
+/**
+ * Start the thread of execution that compresses frames. Returns 0 on success
+ * or an error number otherwise.
+ */
+int archive_start(void)
+{
+    int err = pthread_create(&thread, NULL, run_compressor, NULL);
+    started = err == 0;
+    return err;
+}
+
+/**
+ * Compress every frame waiting and end every file still open with its index,
+ * then stop the compressor. Frames handed over later are dropped.
+ */
+void archive_stop(void)
+{
+    pthread_mutex_lock(&queue_lock);
+    stopping = true;
+    pthread_cond_broadcast(&work);
+    pthread_cond_broadcast(&room);
+    pthread_mutex_unlock(&queue_lock);
+    if (started) {
+        pthread_join(thread, NULL);
+        started = false;
+    }
+}
+
+/**
+ * Add a tag of the given hash to the given bloom filter. Each byte of the
+ * hash picks one of the bits.
+ */
+static void bloom_add(uint8_t *bloom, uint32_t hash)
+{
+    for (int i = 0; i < BLOOM_NHASHES; ++i) {
+        uint8_t bit = hash >> (8 * i);
+        bloom[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+/**
+ * Return whether the given bloom filter may hold a tag of the given hash.
+ */
+static bool bloom_has(const uint8_t *bloom, uint32_t hash)
+{
+    for (int i = 0; i < BLOOM_NHASHES; ++i) {
+        uint8_t bit = hash >> (8 * i);
+        if (!(bloom[bit / 8] & (1 << (bit % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Decompress the gzip members within the given range of the file and write the
+ * lines among them that match the query. Returns 0 on success or an error
+ * number otherwise.
+ */
+static int extract_frame(int fd, uint64_t offset, size_t len,
+                         struct query *q)
+{
+    uint8_t *in = malloc(len);
+    char *text = malloc(INFLATE_NBYTES);
+    if (in == NULL || text == NULL) {
+        fprintf(stderr, "Failure to allocate archive frame.\n");
+        abort();
+    }
+    int err = 0;
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(fd, in + got, len - got, offset + got);
+        if (n <= 0) {
+            err = n < 0 ? errno : EINVAL;
+            break;
+        }
+        got += n;
+    }
+
+    z_stream z = { 0 };
+    int zerr = inflateInit2(&z, GZIP_WINDOW_BITS);
+    assert(zerr == Z_OK);
+    z.next_in = in;
+    z.avail_in = got;
+    size_t size = INFLATE_NBYTES;
+    size_t used = 0;
+    bool more = got > 0;
+    while (more && !err) {
+        // Lines longer than what is held so far make room for themselves.
+        if (used == size) {
+            size *= 2;
+            text = realloc(text, size);
+            if (text == NULL) {
+                fprintf(stderr, "Failure to allocate archive frame.\n");
+                abort();
+            }
+        }
+        z.next_out = (Bytef *)text + used;
+        z.avail_out = size - used;
+        zerr = inflate(&z, Z_NO_FLUSH);
+        if (zerr != Z_OK && zerr != Z_STREAM_END && zerr != Z_BUF_ERROR) {
+            err = EINVAL;
+            break;
+        }
+        used = size - z.avail_out;
+        // Members follow one another until the input runs out; a member cut
+        // short simply ends the lines.
+        if (zerr == Z_STREAM_END) {
+            inflateReset(&z);
+        }
+        more = z.avail_in > 0 || (z.avail_out == 0 && zerr != Z_STREAM_END);
+
+        size_t start = 0;
+        for (;;) {
+            char *newline = memchr(text + start, '\n', used - start);
+            if (newline == NULL) {
+                break;
+            }
+            size_t line_len = newline - (text + start) + 1;
+            extract_line(q, text + start, line_len);
+            start += line_len;
+        }
+        memmove(text, text + start, used - start);
+        used -= start;
+    }
+    if (!err && used > 0) {
+        extract_line(q, text, used);
+    }
+    inflateEnd(&z);
+    free(text);
+    free(in);
+    return err;
+}
+
+/**
+ * Write the given line to the query's stream if it matches the query. Lines
+ * that cannot be parsed only match a query for everything.
+ */
+static void extract_line(struct query *q, const char *line, size_t len)
+{
+    regmatch_t matches[MESSAGE_NPARTS];
+    if (logcat_parse_any(&q->parser, &q->format, line, len, matches)) {
+        uint64_t key = q->format->decode_time(&q->clock,
+                                              &line[matches[TIME].rm_so],
+                                              matches[TIME].rm_eo
+                                              - matches[TIME].rm_so);
+        size_t tag_len = matches[TAG].rm_eo - matches[TAG].rm_so;
+        if (key < q->from || key > q->until
+            || (q->tag != NULL
+                && (tag_len != q->tag_len
+                    || memcmp(&line[matches[TAG].rm_so], q->tag, tag_len)
+                       != 0))) {
+            return;
+        }
+    } else if (q->from > 0 || q->until < UINT64_MAX || q->tag != NULL) {
+        return;
+    }
+    fwrite(line, 1, len, q->out);
+}
+
+/**
+ * Report a failure to write the files of the given stream, once per file.
+ */
+static void fail(struct archive_stream *s, const char *what)
+{
+    if (!s->failed) {
+        fprintf(stderr, "Failure to %s archive of device %s: %s\n", what,
+                s->name, strerror(errno));
+        s->failed = true;
+    }
+}
+
+/**
+ * End the file of the given stream with the index of its frames and close it.
+ */
+static void finish_file(struct archive_stream *s)
+{
+    static uint8_t footer[HEADER_NBYTES + 2 + 4 + sizeof(s->index)
+                          + TRAILER_NBYTES];
+
+    if (s->fd < 0) {
+        return;
+    }
+    size_t ilen = s->nentries * ENTRY_NBYTES;
+    static const uint8_t header[HEADER_NBYTES] = {
+        0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 3
+    };
+    uint8_t *p = footer;
+    memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+    put_le(p, 4 + ilen + 4 + 8, 2);
+    p += 2;
+    *p++ = 'A';
+    *p++ = 'I';
+    put_le(p, ilen, 2);
+    p += 2;
+    memcpy(p, s->index, ilen);
+    p += ilen;
+    *p++ = 'A';
+    *p++ = 'L';
+    put_le(p, 8, 2);
+    p += 2;
+    put_le(p, s->offset, 8);
+    p += 8;
+    // Empty compressed data followed by its CRC and size.
+    memset(p, 0, 10);
+    p[0] = 3;
+    p += 10;
+    write_all(s, footer, p - footer);
+
+    if (s->fd >= 0) {
+        close(s->fd);
+        s->fd = -1;
+    }
+    for (struct archive_stream **link = &files; *link != NULL;
+         link = &(*link)->next) {
+        if (*link == s) {
+            *link = s->next;
+            break;
+        }
+    }
+    s->next = NULL;
+    s->offset = 0;
+    s->nentries = 0;
+}
+
+/**
+ * Return the little endian number of the given number of bytes.
+ */
+static uint64_t get_le(const uint8_t *p, int nbytes)
+{
+    uint64_t value = 0;
+    for (int i = nbytes - 1; i >= 0; --i) {
+        value = value << 8 | p[i];
+    }
+    return value;
+}
+
+/**
+ * Return an empty frame of the given stream with room for the given number of
+ * bytes of lines.
+ */
+static struct archive_frame *new_frame(struct archive_stream *s,
+                                       size_t size)
+{
+    struct archive_frame *f = malloc(sizeof(*f) + size);
+    if (f == NULL) {
+        fprintf(stderr, "Failure to allocate archive frame.\n");
+        abort();
+    }
+    f->next = NULL;
+    f->stream = s;
+    f->last = false;
+    f->first = UINT64_MAX;
+    f->latest = 0;
+    memset(f->bloom, 0, sizeof(f->bloom));
+    f->size = size;
+    f->used = 0;
+    return f;
+}
+
+/**
+ * Store the given number as a little endian number of the given number of
+ * bytes.
+ */
+static void put_le(uint8_t *p, uint64_t value, int nbytes)
+{
+    for (int i = 0; i < nbytes; ++i) {
+        p[i] = value >> (8 * i);
+    }
+}
+
+/**
+ * Read the index at the end of the file of the given size into a block the
+ * caller frees. Returns 0 on success, ENOENT when the file holds no index or
+ * another error number otherwise.
+ */
+static int read_index(int fd, uint64_t size, uint8_t **index,
+                      size_t *nentries)
+{
+    uint8_t trailer[TRAILER_NBYTES];
+    if (size < HEADER_NBYTES + 2 + TRAILER_NBYTES) {
+        return ENOENT;
+    }
+    ssize_t n = pread(fd, trailer, sizeof(trailer), size - sizeof(trailer));
+    if (n < 0) {
+        return errno;
+    }
+    static const uint8_t tail[10] = { 3 };
+    uint64_t offset = get_le(trailer + 4, 8);
+    if (n != sizeof(trailer) || trailer[0] != 'A' || trailer[1] != 'L'
+        || get_le(trailer + 2, 2) != 8 || memcmp(trailer + 12, tail, 10) != 0
+        || offset > size - (HEADER_NBYTES + 2 + TRAILER_NBYTES)) {
+        return ENOENT;
+    }
+
+    // The index is the extra field of the member at that offset, its first
+    // subfield holding the entries and the last the offset.
+    size_t len = size - offset;
+    uint8_t *block = malloc(len);
+    if (block == NULL) {
+        fprintf(stderr, "Failure to allocate archive index.\n");
+        abort();
+    }
+    n = pread(fd, block, len, offset);
+    size_t xlen = len - HEADER_NBYTES - 2 - 10;
+    size_t ilen = get_le(block + HEADER_NBYTES + 4, 2);
+    if (n != (ssize_t)len || block[0] != 0x1f || block[1] != 0x8b
+        || block[2] != 8 || block[3] != 4
+        || get_le(block + HEADER_NBYTES, 2) != xlen
+        || block[HEADER_NBYTES + 2] != 'A' || block[HEADER_NBYTES + 3] != 'I'
+        || ilen % ENTRY_NBYTES != 0 || 4 + ilen + 4 + 8 != xlen) {
+        free(block);
+        return n < 0 ? errno : ENOENT;
+    }
+    memmove(block, block + HEADER_NBYTES + 6, ilen);
+    *index = block;
+    *nentries = ilen / ENTRY_NBYTES;
+    return 0;
+}
+
+/**
+ * Run thread of execution that compresses the frames handed to it in the
+ * order they came.
+ */
+static void *run_compressor(void *unused)
+{
+    affinity_pin(AFFINITY_WRITERS);
+    z_stream z = { 0 };
+    int err = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                           GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+    assert(err == Z_OK);
+
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (queue == NULL && !stopping) {
+            pthread_cond_wait(&work, &queue_lock);
+        }
+        struct archive_frame *f = queue;
+        if (f == NULL) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        queue = f->next;
+        if (queue == NULL) {
+            queue_tail = NULL;
+        }
+        --npending;
+        pthread_cond_signal(&room);
+        pthread_mutex_unlock(&queue_lock);
+
+        struct archive_stream *s = f->stream;
+        if (f->used > 0) {
+            write_frame(&z, f);
+        }
+        if (f->last) {
+            finish_file(s);
+            free(s);
+        }
+        free(f);
+    }
+
+    // The devices of the streams still open have to be done archiving.
+    while (files != NULL) {
+        finish_file(files);
+    }
+    deflateEnd(&z);
+    free(deflated);
+    deflated = NULL;
+    deflated_size = 0;
+    return NULL;
+}
+
+/**
+ * Start a new file for the given stream named after the device and the time it
+ * was started, with a count appended when several start within the same
+ * second. Returns 0 on success or -1 otherwise.
+ */
+static int start_file(struct archive_stream *s)
+{
+    // Nothing may step outside the directory.
+    char name[NAME_NCHARS];
+    snprintf(name, sizeof(name), "%s", s->name);
+    for (char *c = name; *c != '\0'; ++c) {
+        if (*c == '/') {
+            *c = '_';
+        }
+    }
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    char path[PATH_MAX];
+    for (unsigned count = 0; s->fd < 0; ++count) {
+        if (count == 0) {
+            snprintf(path, sizeof(path), "%s/%s-%s.log.gz", archive_dir, name,
+                     stamp);
+        } else {
+            snprintf(path, sizeof(path), "%s/%s-%s.%u.log.gz", archive_dir,
+                     name, stamp, count);
+        }
+        s->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (s->fd < 0 && errno != EEXIST) {
+            fail(s, "create");
+            return -1;
+        }
+    }
+    s->failed = false;
+    s->offset = 0;
+    s->nentries = 0;
+    s->next = files;
+    files = s;
+    return 0;
+}
+
+/**
+ * Hand the given frame to the compressor, waiting while too many frames are
+ * waiting on it already.
+ */
+static void submit(struct archive_frame *f)
+{
+    pthread_mutex_lock(&queue_lock);
+    while (npending >= PENDING_NMAX && !stopping) {
+        pthread_cond_wait(&room, &queue_lock);
+    }
+    if (stopping) {
+        pthread_mutex_unlock(&queue_lock);
+        free(f);
+        return;
+    }
+    f->next = NULL;
+    if (queue_tail != NULL) {
+        queue_tail->next = f;
+    } else {
+        queue = f;
+    }
+    queue_tail = f;
+    ++npending;
+    pthread_cond_signal(&work);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ * Write the given bytes to the file of the given stream, closing the file
+ * should writing fail. Returns 0 on success or -1 otherwise.
+ */
+static int write_all(struct archive_stream *s, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(s->fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fail(s, "write");
+            // What follows could not be found without the start of the file.
+            close(s->fd);
+            s->fd = -1;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * Compress the given frame into a member of its stream's file and note it
+ * within the index, starting a new file when the current one's index is full.
+ */
+static void write_frame(z_stream *z, struct archive_frame *f)
+{
+    struct archive_stream *s = f->stream;
+    if (s->fd >= 0 && s->nentries == FRAMES_NMAX) {
+        finish_file(s);
+    }
+    if (s->fd < 0 && start_file(s) != 0) {
+        return;
+    }
+
+    deflateReset(z);
+    size_t bound = deflateBound(z, f->used);
+    if (bound > deflated_size) {
+        free(deflated);
+        deflated = malloc(bound);
+        if (deflated == NULL) {
+            fprintf(stderr, "Failure to allocate archive frame.\n");
+            abort();
+        }
+        deflated_size = bound;
+    }
+    z->next_in = (Bytef *)f->data;
+    z->avail_in = f->used;
+    z->next_out = deflated;
+    z->avail_out = bound;
+    int err = deflate(z, Z_FINISH);
+    assert(err == Z_STREAM_END);
+    size_t len = bound - z->avail_out;
+    if (write_all(s, deflated, len) != 0) {
+        return;
+    }
+
+    uint8_t *e = s->index + s->nentries * ENTRY_NBYTES;
+    put_le(e, s->offset, 8);
+    put_le(e + 8, len, 4);
+    put_le(e + 12, f->used, 4);
+    put_le(e + 16, f->first, 8);
+    put_le(e + 24, f->latest, 8);
+    memcpy(e + 32, f->bloom, sizeof(f->bloom));
+    s->offset += len;
+    ++s->nentries;
+}
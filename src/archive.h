@@ -0,0 +1,89 @@
+/** @file
+ * Compressed archives of the lines of each device, indexed by time and tag.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The lines of every device may be archived within a directory to compressed
+ * files of their own. A file is a series of gzip members of about a megabyte of
+ * lines each, so any member can be decompressed on its own and the whole file
+ * still reads with zcat. A last, empty member carries an index of the others in
+ * its extra field: where each starts, the range of times of its lines and a
+ * bloom filter of their tags. A query for a stretch of time and a tag only
+ * decompresses the members that may hold matching lines.
+ *
+ * Devices fill frames of lines and hand them to a single compressor thread, so
+ * compressing and writing never stall the threads reading devices save when the
+ * compressor falls far behind.
+ */
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/uio.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes of lines compressed together into a frame. */
+#define ARCHIVE_FRAME_NBYTES (1024 * 1024)
+
+/*******************************************************************************
+ * Types
+ */
+
+struct archive_frame;
+struct archive_stream;
+
+/**
+ * Archive of the lines of a device.
+ */
+struct archive {
+    struct archive_stream *stream; //!< Stream being archived, NULL when not
+                                   //!< archiving.
+    struct archive_frame  *frame;  //!< Frame being filled, NULL when none.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *archive_dir;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void archive_add(struct archive *a, uint64_t key, uint32_t hash,
+                 const struct iovec *parts, int nparts);
+void archive_close(struct archive *a);
+int archive_extract(const char *path, uint64_t from, uint64_t until,
+                    const char *tag, FILE *out);
+void archive_open(struct archive *a, const char *name);
+int archive_start(void);
+void archive_stop(void);
+
+#endif
@@ -0,0 +1,115 @@
+/** @file
+ * Bump allocator for storage that lives until it is all freed at once.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Allocations large enough to waste much of a chunk get a chunk of their own,
+ * which is linked in behind the chunk being filled so that filling carries on.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes of storage within each chunk. */
+#define CHUNK_NBYTES (64 * 1024)
+
+/** Largest allocation carved out of a shared chunk. */
+#define SHARED_NBYTES_MAX (CHUNK_NBYTES / 8)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Block of storage allocations are carved out of.
+ */
+struct arena_chunk {
+    struct arena_chunk           *next;   //!< Next older chunk.
+    alignas(max_align_t) char     data[]; //!< Storage.
+};
+
+/******************************************************************************/
+
+/**
+ * Return storage for size bytes, suitably aligned for any object, that lives
+ * until the arena is freed. Returns NULL if out of memory.
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    if (size <= arena->avail) {
+        void *p = arena->next;
+        arena->next += size;
+        arena->avail -= size;
+        return p;
+    }
+
+    if (size > SHARED_NBYTES_MAX) {
+        struct arena_chunk *chunk = malloc(sizeof(*chunk) + size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        if (arena->chunks == NULL) {
+            chunk->next = NULL;
+            arena->chunks = chunk;
+        } else {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        return chunk->data;
+    }
+
+    struct arena_chunk *chunk = malloc(sizeof(*chunk) + CHUNK_NBYTES);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = chunk->data + size;
+    arena->avail = CHUNK_NBYTES - size;
+    return chunk->data;
+}
+
+/**
+ * Release all storage allocated from the arena, leaving it empty.
+ */
+void arena_free(struct arena *arena)
+{
+    struct arena_chunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+    arena->next = NULL;
+    arena->avail = 0;
+}
@@ -0,0 +1,58 @@
+/** @file
+ * Bump allocator for storage that lives until it is all freed at once.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Storage is carved out of large chunks one after the other, so objects
+ * allocated together sit next to each other in memory and cost nothing to free
+ * one by one since they never are; the whole arena is released in one go.
+ * Arenas are not thread safe; callers serialize their use of an arena.
+ */
+#ifndef ARENA_H_
+#define ARENA_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Arena storage is allocated from. An arena that is all zero is empty.
+ */
+struct arena {
+    struct arena_chunk *chunks; //!< Chunk being filled, then older chunks.
+    char               *next;   //!< Next free byte of the chunk being filled.
+    size_t              avail;  //!< Bytes left within the chunk being filled.
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void *arena_alloc(struct arena *arena, size_t size);
+void arena_free(struct arena *arena);
+
+#endif
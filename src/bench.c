@@ -0,0 +1,611 @@
+/** @file
+ * Synthetic load generator and end-to-end benchmark.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every simulated device is a thread writing realistic `logcat -v time` lines
+ * into a pipe whose read end stands in for the output of logcat. The devices
+ * are then read exactly as attached ones are, by a thread of their own or by
+ * the event loops, and their lines written to /dev/null. Tags are drawn from a
+ * Zipf distribution over a configurable number of names, messages have
+ * exponentially distributed lengths and priorities follow a mix typical of a
+ * busy device.
+ *
+ * Once every line has been written the throughput, the processor time spent
+ * per line outside of the generators and the percentiles of the time lines took
+ * from being read to being written are reported on stdout, along with the time
+ * spent waiting on the locks whose waits are measured, see stats.h.
+ *
+ * A sweep instead runs the devices again and again, doubling their number each
+ * time, and reports a row of throughput, processor time per line and waits on
+ * those locks for each number of devices. Every run writes the same number of
+ * lines in all, shared between its devices, so rows compare like for like and
+ * trace how reading scales with the number of devices.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <assert.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "loop.h"
+#include "output.h"
+#include "pool.h"
+#include "scan.h"
+#include "stats.h"
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes of lines a generator hands to its pipe at once. */
+#define CHUNK_NBYTES (64 * 1024)
+
+/** Longest message generated, in characters. */
+#define MESSAGE_NMAX (1024)
+
+/** Maximum number of characters of the name of a tag. */
+#define TAG_NCHARS (32)
+
+/** Most devices simulated at once. */
+#define DEVICES_NMAX (256)
+
+/** Number of times per second a rate limited generator writes its lines. */
+#define PACE_HZ (100)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * A simulated device writing lines into its pipe.
+ */
+struct generator {
+    pthread_t thread;   //!< Thread of execution writing the lines.
+    pthread_t reader;   //!< Thread reading the device, unless event loops do.
+    int       fd;       //!< Write end of the pipe.
+    uint64_t  lines;    //!< Number of lines to write.
+    uint64_t  seed;     //!< State of the random number generator.
+    uint64_t  cpu_ns;   //!< Processor time the generator used.
+};
+
+/**
+ * Measurements of a run of the simulated devices.
+ */
+struct run {
+    double   secs;                   //!< Seconds the run took.
+    uint64_t lines;                  //!< Lines written by every device.
+    uint64_t cpu_ns;                 //!< Processor time used outside of the
+                                     //!< generators.
+    uint64_t waits[STATS_LOCKS_N];   //!< Times each lock was found taken.
+    uint64_t wait_ns[STATS_LOCKS_N]; //!< Nanoseconds spent waiting on each.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Flag that indicates whether or not we are to shutdown software. */
+atomic_bool shutdown_requested = false;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Number of lines written by each device, or by all of them in a sweep. */
+static uint64_t lines_n = 200000;
+
+/** Lines per second written by each device, or zero for as fast as read. */
+static uint64_t rate;
+
+/** Number of distinct tags. */
+static unsigned tags_n = 500;
+
+/** Exponent of the Zipf distribution tags are drawn from. */
+static double skew = 1.0;
+
+/** Average number of characters of a message. */
+static unsigned message_mean = 60;
+
+/** Names of the tags. */
+static char (*tag_names)[TAG_NCHARS];
+
+/** Cumulative probability of each tag being drawn. */
+static double *tag_cdf;
+
+/** Words taken together to name tags. */
+static const char *const tag_words[][10] = {
+    { "Activity", "Window", "Package", "Wifi", "Bluetooth", "Audio", "Camera",
+      "Input", "Power", "Sensor" },
+    { "Manager", "Service", "Controller", "Policy", "Monitor", "Tracker",
+      "Handler", "Stack", "Hal", "Client" },
+};
+
+/** Priorities drawn, each as often as it appears. */
+static const char priorities[] = "VVVVDDDDDDDDIIIIIWWE";
+
+/** Text messages are cut from. */
+static const char words[] =
+    "the quick brown fox jumps over the lazy dog while the system server "
+    "reports that an activity paused in 42 ms and the wifi state changed to "
+    "connected with rssi -61 on channel 36 before the window manager "
+    "relayouted surface 0x7f3a21c0 for package com.example.app with uid "
+    "10123 and the binder transaction completed after 3 retries ";
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static uint64_t cpu_ns(clockid_t clock);
+static void init_tags(void);
+static size_t render_line(struct generator *g, char *line, const char *stamp);
+static double random_uniform(struct generator *g);
+static void run_devices(int devices_n, int loops_n, uint64_t lines,
+                        struct run *run);
+static void *run_generator(void *generator);
+static void usage(FILE *fh, const char *name);
+
+/******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        { "devices",    required_argument, NULL, 'd' },
+        { "event-loop", optional_argument, NULL, 'e' },
+        { "format",     required_argument, NULL, 'O' },
+        { "help",       no_argument,       NULL, 'h' },
+        { "lines",      required_argument, NULL, 'n' },
+        { "message",    required_argument, NULL, 'm' },
+        { "rate",       required_argument, NULL, 'r' },
+        { "skew",       required_argument, NULL, 's' },
+        { "sweep",      optional_argument, NULL, 'S' },
+        { "tags",       required_argument, NULL, 't' },
+        { "workers",    required_argument, NULL, 'w' },
+        { NULL,         0,                 NULL, 0   },
+    };
+
+    int err;
+    int opt;
+    int devices_n = 4;
+    int loops_n = 0;
+    int sweep_max = 0;
+    int workers_n = 0;
+    while ((opt = getopt_long(argc, argv, "d:e::hm:n:O:r:s:S::t:w:", options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'd':
+            devices_n = atoi(optarg);
+            if (devices_n < 1 || devices_n > DEVICES_NMAX) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'e':
+            loops_n = optarg != NULL ? atoi(optarg) : 1;
+            if (loops_n < 1) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            usage(stdout, argv[0]);
+            return EXIT_SUCCESS;
+        case 'm':
+            message_mean = strtoul(optarg, NULL, 10);
+            if (message_mean < 1 || message_mean > MESSAGE_NMAX) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            lines_n = strtoull(optarg, NULL, 10);
+            break;
+        case 'O':
+            if (strcmp(optarg, "color") == 0) {
+                output_format = OUTPUT_COLOR;
+            } else if (strcmp(optarg, "jsonl") == 0) {
+                output_format = OUTPUT_JSONL;
+            } else if (strcmp(optarg, "plain") == 0) {
+                output_format = OUTPUT_PLAIN;
+            } else {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            rate = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            skew = strtod(optarg, NULL);
+            if (skew < 0.0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'S':
+            sweep_max = optarg != NULL ? atoi(optarg) : DEVICES_NMAX;
+            if (sweep_max < 1 || sweep_max > DEVICES_NMAX) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            tags_n = strtoul(optarg, NULL, 10);
+            if (tags_n < 1) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            workers_n = atoi(optarg);
+            if (workers_n < 1) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    color_plain = output_format == OUTPUT_PLAIN;
+    init_tags();
+    scan_init();
+    tag_map_init(TAG_NDEFAULT);
+    int out = open("/dev/null", O_WRONLY);
+    if (out < 0) {
+        perror("Failure to open /dev/null");
+        return EXIT_FAILURE;
+    }
+    err = output_init(out, 0);
+    assert(!err);
+    if (workers_n > 0) {
+        err = pool_open(workers_n, device_worker_leave);
+        assert(!err);
+    }
+    if (loops_n > 0) {
+        err = loop_init(loops_n, LOOP_EPOLL);
+        assert(!err);
+    }
+
+    struct run run;
+    if (sweep_max > 0) {
+        printf("devices    lines/s cpu/line");
+        for (int i = 0; i < STATS_LOCKS_N; ++i) {
+            printf(" %11s %8s", stats_lock_names[i], "waits");
+        }
+        printf("\n");
+        for (int n = 1;; n = n * 2 < sweep_max ? n * 2 : sweep_max) {
+            run_devices(n, loops_n, lines_n / n > 0 ? lines_n / n : 1, &run);
+            printf("%7d %10.0f %6.0fns", n, run.lines / run.secs,
+                   run.lines ? (double)run.cpu_ns / run.lines : 0.0);
+            for (int i = 0; i < STATS_LOCKS_N; ++i) {
+                printf(" %9.3fms %8" PRIu64, run.wait_ns[i] / 1e6,
+                       run.waits[i]);
+            }
+            printf("\n");
+            fflush(stdout);
+            if (n == sweep_max) {
+                break;
+            }
+        }
+    } else {
+        run_devices(devices_n, loops_n, lines_n, &run);
+        printf("devices %d lines %" PRIu64 " seconds %.3f\n", devices_n,
+               run.lines, run.secs);
+        printf("lines/s %.0f cpu/line %.0fns\n", run.lines / run.secs,
+               run.lines ? (double)run.cpu_ns / run.lines : 0.0);
+        printf("latency p50 %.1fus p99 %.1fus p99.9 %.1fus\n",
+               stats_latency_percentile(50.0) / 1000.0,
+               stats_latency_percentile(99.0) / 1000.0,
+               stats_latency_percentile(99.9) / 1000.0);
+        printf("lock waits");
+        for (int i = 0; i < STATS_LOCKS_N; ++i) {
+            printf("%s %s %" PRIu64 " %.3fms", i > 0 ? "," : "",
+                   stats_lock_names[i], run.waits[i], run.wait_ns[i] / 1e6);
+        }
+        printf("\n");
+    }
+    pool_close();
+    output_close();
+
+    close(out);
+    buffer_pool_clear();
+    tag_map_clear();
+    device_map_clear();
+    free(tag_names);
+    free(tag_cdf);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Return the processor time used so far on the given clock in nanoseconds.
+ */
+static uint64_t cpu_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Name the tags drawn from and weigh them by their Zipf rank.
+ */
+static void init_tags(void)
+{
+    tag_names = malloc(tags_n * sizeof(*tag_names));
+    tag_cdf = malloc(tags_n * sizeof(*tag_cdf));
+    if (tag_names == NULL || tag_cdf == NULL) {
+        fprintf(stderr, "Failure to allocate tags.\n");
+        abort();
+    }
+
+    double sum = 0.0;
+    for (unsigned i = 0; i < tags_n; ++i) {
+        unsigned first = i % 10;
+        unsigned second = i / 10 % 10;
+        if (i < 100) {
+            snprintf(tag_names[i], TAG_NCHARS, "%s%s",
+                     tag_words[0][first], tag_words[1][second]);
+        } else {
+            snprintf(tag_names[i], TAG_NCHARS, "%s%s%u",
+                     tag_words[0][first], tag_words[1][second], i / 100);
+        }
+        sum += 1.0 / pow(i + 1, skew);
+        tag_cdf[i] = sum;
+    }
+    for (unsigned i = 0; i < tags_n; ++i) {
+        tag_cdf[i] /= sum;
+    }
+}
+
+/**
+ * Render a random line logged at the given time into the given storage,
+ * returning its length.
+ */
+static size_t render_line(struct generator *g, char *line, const char *stamp)
+{
+    // Draw the tag by its rank.
+    double u = random_uniform(g);
+    unsigned lo = 0;
+    unsigned hi = tags_n - 1;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (tag_cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    char priority = priorities[(unsigned)(random_uniform(g)
+                                          * (sizeof(priorities) - 1))];
+
+    size_t len = (size_t)(-log(1.0 - random_uniform(g)) * message_mean) + 1;
+    if (len > MESSAGE_NMAX) {
+        len = MESSAGE_NMAX;
+    }
+    size_t n = sprintf(line, "%s %c/%s(%5u): ", stamp, priority,
+                       tag_names[lo], 1000 + lo * 7 % 30000);
+    size_t offset = (size_t)(random_uniform(g) * (sizeof(words) - 1));
+    for (size_t i = 0; i < len; ++i) {
+        line[n++] = words[(offset + i) % (sizeof(words) - 1)];
+    }
+    line[n++] = '\n';
+    return n;
+}
+
+/**
+ * Return a random number within [0, 1) from the given generator's state.
+ */
+static double random_uniform(struct generator *g)
+{
+    // xorshift64*
+    g->seed ^= g->seed >> 12;
+    g->seed ^= g->seed << 25;
+    g->seed ^= g->seed >> 27;
+    return ((g->seed * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0;
+}
+
+/**
+ * Run the given number of simulated devices, read by the given number of event
+ * loops or by a thread each when none, until each has written the given number
+ * of lines and they have all been read, measuring the run.
+ */
+static void run_devices(int devices_n, int loops_n, uint64_t lines,
+                        struct run *run)
+{
+    uint64_t waits[STATS_LOCKS_N];
+    uint64_t wait_ns[STATS_LOCKS_N];
+    for (int i = 0; i < STATS_LOCKS_N; ++i) {
+        waits[i] = atomic_load(&stats_locks[i].waits);
+        wait_ns[i] = atomic_load(&stats_locks[i].wait_ns);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t cpu_start = cpu_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    // Every device reads the end of a pipe its generator writes into.
+    struct generator gens[DEVICES_NMAX];
+    for (int i = 0; i < devices_n; ++i) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("Failure to create pipe");
+            exit(EXIT_FAILURE);
+        }
+        char name[SERIAL_NCHARS];
+        snprintf(name, sizeof(name), "bench%03d", i);
+        struct device *d = device_new(name);
+        d->fd = fds[0];
+
+        gens[i].fd = fds[1];
+        gens[i].lines = lines;
+        gens[i].seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        int err = pthread_create(&gens[i].thread, NULL, run_generator,
+                                 &gens[i]);
+        assert(!err);
+        if (loops_n > 0) {
+            loop_add(d);
+        } else {
+            err = pthread_create(&gens[i].reader, NULL, device_run, d);
+            assert(!err);
+        }
+    }
+
+    uint64_t generated_ns = 0;
+    for (int i = 0; i < devices_n; ++i) {
+        pthread_join(gens[i].thread, NULL);
+        generated_ns += gens[i].cpu_ns;
+        if (loops_n == 0) {
+            pthread_join(gens[i].reader, NULL);
+        }
+    }
+    // Devices read by event loops are closed once their pipes have drained.
+    while (device_count() > 0) {
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+    // Lines of the run are all written before it is measured.
+    while (output_queued() > 0) {
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    run->secs = (end.tv_sec - start.tv_sec)
+                + (end.tv_nsec - start.tv_nsec) / 1e9;
+    uint64_t cpu = cpu_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+    run->cpu_ns = cpu > generated_ns ? cpu - generated_ns : 0;
+    run->lines = lines * devices_n;
+    for (int i = 0; i < STATS_LOCKS_N; ++i) {
+        run->waits[i] = atomic_load(&stats_locks[i].waits) - waits[i];
+        run->wait_ns[i] = atomic_load(&stats_locks[i].wait_ns) - wait_ns[i];
+    }
+}
+
+/**
+ * Write the lines of a simulated device into its pipe, closing the pipe once
+ * they have all been written.
+ */
+static void *run_generator(void *generator)
+{
+    struct generator *g = (struct generator *)generator;
+    static __thread char chunk[CHUNK_NBYTES];
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t batch = rate > 0 ? (rate + PACE_HZ - 1) / PACE_HZ : UINT64_MAX;
+    uint64_t written = 0;
+    while (written < g->lines) {
+        // Lines of a batch all carry the time the batch was made.
+        char stamp[STAMP_NCHARS];
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        struct tm tm;
+        localtime_r(&now.tv_sec, &tm);
+        size_t n = strftime(stamp, sizeof(stamp), "%m-%d %H:%M:%S", &tm);
+        snprintf(stamp + n, sizeof(stamp) - n, ".%03ld",
+                 now.tv_nsec / 1000000);
+
+        size_t used = 0;
+        uint64_t end = g->lines - written > batch ? written + batch : g->lines;
+        for (; written < end; ++written) {
+            if (used + MESSAGE_NMAX + 2 * TAG_NCHARS > sizeof(chunk)) {
+                break;
+            }
+            used += render_line(g, chunk + used, stamp);
+        }
+        for (size_t off = 0; off < used;) {
+            ssize_t nwritten = write(g->fd, chunk + off, used - off);
+            assert(nwritten > 0);
+            off += nwritten;
+        }
+
+        // Sleep until the next batch is due.
+        if (rate > 0 && written % batch == 0) {
+            uint64_t due = written * 1000000000ULL / rate;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            uint64_t elapsed = (now.tv_sec - start.tv_sec) * 1000000000ULL
+                               + now.tv_nsec - start.tv_nsec;
+            if (due > elapsed) {
+                uint64_t wait = due - elapsed;
+                nanosleep(&(struct timespec){ .tv_sec = wait / 1000000000ULL,
+                                              .tv_nsec = wait % 1000000000ULL },
+                          NULL);
+            }
+        }
+    }
+    close(g->fd);
+    g->cpu_ns = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+    return NULL;
+}
+
+/**
+ * Print the usage of the benchmark.
+ */
+static void usage(FILE *fh, const char *name)
+{
+    fprintf(fh,
+            "Usage: %s [OPTION]...\n"
+            "Measure android-log reading simulated devices that write\n"
+            "synthetic logcat lines and writing them to /dev/null.\n"
+            "\n"
+            "  -d, --devices=N       simulate N devices (default 4)\n"
+            "  -e, --event-loop[=N]  read devices from N event loops\n"
+            "                        (default 1) instead of a thread per\n"
+            "                        device\n"
+            "  -h, --help            display this help and exit\n"
+            "  -m, --message=N       average N characters per message\n"
+            "                        (default 60)\n"
+            "  -n, --lines=N         write N lines from each device, or from\n"
+            "                        them all in a sweep (default 200000)\n"
+            "  -O, --format=FORMAT   write lines as FORMAT, color, jsonl or\n"
+            "                        plain\n"
+            "  -r, --rate=N          write N lines per second from each\n"
+            "                        device, or as fast as they are read\n"
+            "                        when 0 (default)\n"
+            "  -s, --skew=S          draw tags with Zipf exponent S (default\n"
+            "                        1.0)\n"
+            "  -S, --sweep[=N]       run from 1 up to N devices (default\n"
+            "                        256), doubling them each time and\n"
+            "                        sharing the lines of -n between them\n"
+            "  -t, --tags=N          draw from N distinct tags (default 500)\n"
+            "  -w, --workers=N       parse and format lines read in bulk on\n"
+            "                        N workers\n",
+            name);
+}
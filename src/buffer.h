@@ -0,0 +1,93 @@
+/** @file
+ * Reference counted storage blocks.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Text travels from the device threads to the output writer inside large
+ * blocks. A device thread fills a block line after line and every queued line
+ * holds a reference on the block it lives in; the block returns to a shared
+ * pool once the writer has released the last of them. Blocks larger than the
+ * usual size hold lines too long for one and go back to the heap instead.
+ *
+ * Pooled blocks return to the pool of the NUMA node they were first taken on,
+ * and are taken from the pool of the node of the taker, so that a thread kept
+ * to the processors of a node fills blocks of memory placed on that node.
+ */
+#ifndef BUFFER_H_
+#define BUFFER_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes of storage within each pooled buffer. */
+#define BUFFER_NBYTES (64 * 1024)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Block of storage shared between a producer and the output writer.
+ */
+struct buffer {
+    atomic_uint    refs;   //!< Number of outstanding references.
+    unsigned       node;   //!< Pool the buffer returns to.
+    size_t         size;   //!< Bytes of storage.
+    size_t         used;   //!< Bytes filled by the producer.
+    struct buffer *next;   //!< Next buffer within the free pool.
+    char           data[]; //!< Storage.
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+struct buffer *buffer_get(void);
+struct buffer *buffer_get_large(size_t size);
+void buffer_pool_clear(void);
+
+/**
+ * Return the number of bytes left unused at the end of the given buffer.
+ */
+static inline size_t buffer_avail(const struct buffer *buf)
+{
+    return buf->size - buf->used;
+}
+
+/**
+ * Take an additional reference on the given buffer.
+ */
+static inline void buffer_ref(struct buffer *buf)
+{
+    atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+}
+
+void buffer_unref(struct buffer *buf);
+
+#endif
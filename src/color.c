@@ -0,0 +1,106 @@
+/** @file
+ * Colors and rendered columns of the console output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The palette is mapped onto ANSI SGR codes here; nothing else needs to know
+ * the escape values.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "color.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Flag that indicates whether columns are rendered without their colors. */
+bool color_plain = false;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/**
+ * Table that converts a color code to its respective ANSI. Note that the
+ * values here are ordered according to the enum color type. This means that
+ * enum color and color_ansi_table must be kept synchronized.
+ */
+static uint8_t color_ansi_table[] = {
+    31, // RED
+    32, // GREEN
+    33, // YELLOW
+    34, // BLUE
+    35, // MAGENTA
+    36, // CYAN
+    91, // BRIGHT_RED
+    92, // BRIGHT_GREEN
+    93, // BRIGHT_YELLOW
+    94, // BRIGHT_BLUE
+    95, // BRIGHT_MAGENTA
+    96  // BRIGHT_CYAN
+};
+
+/******************************************************************************/
+
+/**
+ * Copy the given column cut to the given width, should it have been rendered
+ * wider, to the given address, which has room for the whole column. Returns
+ * the number of characters copied.
+ */
+size_t color_copy_column(char *to, const struct column *col, int width)
+{
+    if (width >= col->width) {
+        memcpy(to, col->text, col->len);
+        return col->len;
+    }
+    size_t head = col->start + width;
+    size_t rest = col->len - col->start - col->width;
+    memcpy(to, col->text, head);
+    memcpy(to + head, &col->text[col->len - rest], rest);
+    return head + rest;
+}
+
+/**
+ * Render text into a column of the given width displayed in the given color,
+ * or only padded to the width when columns are plain.
+ */
+void color_render_column(struct column *col, enum color color,
+                         const char *text, int width)
+{
+    int len = color_plain
+              ? snprintf(col->text, sizeof(col->text), "%-*.*s", width, width,
+                         text)
+              : snprintf(col->text, sizeof(col->text), "\e[%dm%-*.*s\e[0m",
+                         color_ansi_table[color], width, width, text);
+    assert(len > 0 && (size_t)len < sizeof(col->text));
+    col->len = len;
+    col->start = color_plain ? 0 : strchr(col->text, 'm') + 1 - col->text;
+    col->width = width;
+}
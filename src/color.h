@@ -0,0 +1,115 @@
+/** @file
+ * Colors and rendered columns of the console output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Device names and tags are displayed in fixed width columns colored from a
+ * common palette, or left plain for output that is not read on a terminal.
+ * The color of a name follows from a hash of the name alone, so that a device
+ * or tag is shown in the same color on every run and by every client, however
+ * the names turned up. Columns are rendered as wide as they may be shown and
+ * cut to the width of the layout as they are copied, see layout.h.
+ */
+#ifndef COLOR_H_
+#define COLOR_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/**
+ * Maximum number of characters of a rendered column; the escape sequence that
+ * selects its color, the padded text and the escape sequence that resets it.
+ */
+#define COLUMN_NCHARS (48)
+
+/** Widest a column of text may be shown. */
+#define COLUMN_WIDTH_MAX (32)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Listing of colors we have available in our console. Note that the ordering
+ * of values here coincide with the ordering of values in the color_ansi_table[]
+ * variable in color.c. Also know that the ordering and contents of this enum
+ * effect which color the hash of a tag or device name / serial number picks,
+ * see color_of_hash().
+ */
+enum color {
+    COLOR_RED = 0,
+    COLOR_GREEN,
+    COLOR_YELLOW,
+    COLOR_BLUE,
+    COLOR_MAGENTA,
+    COLOR_CYAN,
+    COLOR_BRIGHT_RED,
+    COLOR_BRIGHT_GREEN,
+    COLOR_BRIGHT_YELLOW,
+    COLOR_BRIGHT_BLUE,
+    COLOR_BRIGHT_MAGENTA,
+    COLOR_BRIGHT_CYAN,
+    COLOR_NMAX
+};
+
+/**
+ * Colorized text of a fixed width column. Columns are rendered once and then
+ * copied alongside each line that displays them.
+ */
+struct column {
+    size_t  len;                 //!< Number of characters in the text.
+    char    text[COLUMN_NCHARS]; //!< Rendered text.
+    uint8_t start;               //!< Characters ahead of the padded text.
+    uint8_t width;               //!< Width the text is padded to.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern bool color_plain;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+size_t color_copy_column(char *to, const struct column *col, int width);
+void color_render_column(struct column *col, enum color color,
+                         const char *text, int width);
+
+/**
+ * Return the color of the name of the given hash, see tag_hash().
+ */
+static inline enum color color_of_hash(uint32_t hash)
+{
+    return (enum color)(hash % COLOR_NMAX);
+}
+
+#endif
@@ -0,0 +1,434 @@
+/** @file
+ * Control socket the filters are replaced through while devices are read.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Requests come from whoever runs the software, one connection at a time;
+ * further connections wait in the socket's backlog. A socket left behind by an
+ * instance that is gone is replaced, one that is still answered is not.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "control.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "filter.h"
+#include "tail.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of connections waiting to be accepted the kernel holds. */
+#define BACKLOG_NMAX (4)
+
+/** Milliseconds a client is given to take each part of its reply. */
+#define REPLY_TIMEOUT_MS (1000)
+
+/** Maximum number of characters of a request. */
+#define REQUEST_NCHARS (4096)
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Path of the control socket, NULL for none. */
+const char *control_path;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Socket of the client being served, -1 if none. */
+static int client_fd = -1;
+
+/** Socket connections are accepted on, -1 when not listening. */
+static int listen_fd = -1;
+
+/** Request being received. */
+static char request[REQUEST_NCHARS];
+
+/** Characters of the request received. */
+static size_t request_len;
+
+/** Thread of execution serving the control socket. */
+static pthread_t server;
+
+/** Flag that indicates the server should exit. */
+static atomic_bool stopping;
+
+/** Event the server is woken by when it should exit. */
+static int wake_fd = -1;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static const char *args_of(const char *req, const char *name);
+static void close_client(void);
+static void handle_request(char *req);
+static int listen_on(const char *path);
+static void read_requests(void);
+static void reply(const char *answer);
+static void reply_bytes(const char *answer, size_t len);
+static void *run_server(void *unused);
+static void search(char *args);
+
+/******************************************************************************/
+
+/**
+ * Start accepting requests on the socket at control_path. Returns 0 on success
+ * or an error number on failure.
+ */
+int control_start(void)
+{
+    int err = listen_on(control_path);
+    if (err) {
+        return err;
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        err = errno;
+    } else {
+        atomic_init(&stopping, false);
+        err = pthread_create(&server, NULL, run_server, NULL);
+    }
+    if (err) {
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(control_path);
+    }
+    return err;
+}
+
+/**
+ * Stop accepting requests, removing the control socket.
+ */
+void control_stop(void)
+{
+    if (listen_fd < 0) {
+        return;
+    }
+    atomic_store(&stopping, true);
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+    pthread_join(server, NULL);
+    if (client_fd >= 0) {
+        close_client();
+    }
+    close(listen_fd);
+    close(wake_fd);
+    listen_fd = -1;
+    wake_fd = -1;
+    unlink(control_path);
+}
+
+/**
+ * Return the arguments of the given request when it is the request of the
+ * given name, which may be empty, or NULL when it is another request.
+ */
+static const char *args_of(const char *req, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncmp(req, name, len) != 0) {
+        return NULL;
+    }
+    if (req[len] == '\0') {
+        return &req[len];
+    }
+    return req[len] == ' ' ? &req[len + 1] : NULL;
+}
+
+/**
+ * Disconnect the client being served.
+ */
+static void close_client(void)
+{
+    close(client_fd);
+    client_fd = -1;
+    request_len = 0;
+}
+
+/**
+ * Act on the given request, answering the client.
+ */
+static void handle_request(char *req)
+{
+    const char *args;
+    const char *answer = "OK\n";
+    if ((args = args_of(req, "filter")) != NULL) {
+        if (filter_replace_specs(args) != 0) {
+            answer = "ERR invalid filter spec\n";
+        }
+    } else if ((args = args_of(req, "match")) != NULL) {
+        if (filter_replace_match(args) != 0) {
+            answer = "ERR invalid regular expression\n";
+        }
+    } else if ((args = args_of(req, "search")) != NULL) {
+        search((char *)args);
+        return;
+    } else if (args_of(req, "format") != NULL) {
+        answer = "ERR format cannot change while running\n";
+    } else if (args_of(req, "sink") != NULL) {
+        answer = "ERR sink cannot change while running\n";
+    } else {
+        answer = "ERR unknown request\n";
+    }
+    reply(answer);
+}
+
+/**
+ * Open the socket connections are accepted on at the given path, which only
+ * its owner may connect to. Returns 0 on success or an error number on
+ * failure.
+ */
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path)
+        >= (int)sizeof(addr.sun_path)) {
+        return ENAMETOOLONG;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return errno;
+    }
+    mode_t mask = umask(0077);
+    int err = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? 0 : errno;
+    if (err == EADDRINUSE) {
+        // Replace the socket of an instance that is gone.
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe >= 0
+            && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) != 0
+            && errno == ECONNREFUSED && unlink(path) == 0) {
+            err = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+                  ? 0 : errno;
+        }
+        if (probe >= 0) {
+            close(probe);
+        }
+    }
+    umask(mask);
+    if (!err && listen(fd, BACKLOG_NMAX) != 0) {
+        err = errno;
+        unlink(path);
+    }
+    if (err) {
+        close(fd);
+        return err;
+    }
+    listen_fd = fd;
+    return 0;
+}
+
+/**
+ * Receive and act on whatever requests the client has sent, disconnecting it
+ * when it has gone away.
+ */
+static void read_requests(void)
+{
+    for (;;) {
+        size_t room = sizeof(request) - request_len;
+        ssize_t n = recv(client_fd, &request[request_len], room, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            close_client();
+            return;
+        }
+        request_len += n;
+
+        char *start = request;
+        char *nl;
+        while ((nl = memchr(start, '\n', &request[request_len] - start))
+               != NULL) {
+            *nl = '\0';
+            if (nl > start && nl[-1] == '\r') {
+                nl[-1] = '\0';
+            }
+            handle_request(start);
+            start = nl + 1;
+            if (client_fd < 0) {
+                return;
+            }
+        }
+        request_len -= start - request;
+        memmove(request, start, request_len);
+
+        // Requests too long to hold are refused.
+        if (request_len == sizeof(request)) {
+            request_len = 0;
+            reply("ERR request too long\n");
+            if (client_fd < 0) {
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Answer the client with the given reply. A client that does not take its
+ * reply is disconnected.
+ */
+static void reply(const char *answer)
+{
+    reply_bytes(answer, strlen(answer));
+}
+
+/**
+ * Answer the client with the given number of bytes of reply, waiting on it to
+ * take them. A client that does not take its reply is disconnected.
+ */
+static void reply_bytes(const char *answer, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(client_fd, answer, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd fd = { .fd = client_fd, .events = POLLOUT };
+            if (poll(&fd, 1, REPLY_TIMEOUT_MS) > 0) {
+                continue;
+            }
+        }
+        if (n <= 0) {
+            close_client();
+            return;
+        }
+        answer += n;
+        len -= n;
+    }
+}
+
+/**
+ * Run thread of execution that accepts clients of the control socket and acts
+ * on their requests.
+ */
+static void *run_server(void *unused)
+{
+    while (!atomic_load(&stopping)) {
+        struct pollfd fds[2] = {
+            { .fd = client_fd >= 0 ? client_fd : listen_fd, .events = POLLIN },
+            { .fd = wake_fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0 || !(fds[0].revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+        if (client_fd >= 0) {
+            read_requests();
+        } else {
+            client_fd = accept4(listen_fd, NULL, NULL,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Answer the client with the lines kept in memory matching the given
+ * arguments of a search request, followed by its OK.
+ */
+static void search(char *args)
+{
+    if (tail_nbytes == 0) {
+        reply("ERR no lines are kept\n");
+        return;
+    }
+    struct tail_query q = { 0 };
+    for (;;) {
+        char *end;
+        if (strncmp(args, "tag:", 4) == 0) {
+            q.tag = &args[4];
+            end = strchr(args, ' ');
+        } else if (strncmp(args, "last:", 5) == 0) {
+            unsigned long secs = strtoul(&args[5], &end, 10);
+            if (end == &args[5] || (*end != ' ' && *end != '\0')) {
+                reply("ERR invalid number of seconds\n");
+                return;
+            }
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t now = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+            q.since = secs * 1000 < now ? now - secs * 1000 : 0;
+        } else {
+            break;
+        }
+        if (end == NULL || *end == '\0') {
+            args = "";
+            break;
+        }
+        *end = '\0';
+        args = end + 1;
+    }
+    if (*args != '\0') {
+        q.text = args;
+    }
+
+    char *lines = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&lines, &len);
+    if (out == NULL) {
+        reply("ERR out of memory\n");
+        return;
+    }
+    int err = tail_search(out, &q);
+    if (fclose(out) != 0 && !err) {
+        err = ENOMEM;
+    }
+    if (err) {
+        reply("ERR out of memory\n");
+    } else {
+        reply_bytes(lines, len);
+        if (client_fd >= 0) {
+            reply("OK\n");
+        }
+    }
+    free(lines);
+}
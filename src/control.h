@@ -0,0 +1,58 @@
+/** @file
+ * Control socket the filters are replaced through while devices are read.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * A local client connects to a Unix domain socket and sends requests, one per
+ * line, each answered by a line of its own, "OK" or "ERR" followed by why:
+ *
+ *     filter SPECS    replace every filter spec, none when SPECS is empty
+ *     match REGEX     only show lines matching the extended regular expression
+ *     match           show lines whatever their message again
+ *     search [tag:TAG] [last:SECS] [TEXT]
+ *                     answer with the lines kept in memory, see tail.h, of
+ *                     TAG logged within the last SECS seconds whose message
+ *                     contains TEXT, ahead of the OK
+ *
+ * Requests are compiled by the control thread and take effect from the next
+ * line each device checks, see filter.h; the devices never wait on them.
+ * Formats and sinks are fixed once the first lines are written, since they
+ * shape what has already been rendered and opened for every device and tag, so
+ * requests to change them are refused.
+ */
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *control_path;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int control_start(void);
+void control_stop(void);
+
+#endif
@@ -0,0 +1,2508 @@
+/** @file
+ * Android devices connected to the host and the logs they produce.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Lines are parsed in place within the buffer they were read into and handed
+ * to the output writer as fragments pointing into that buffer. The device and
+ * tag columns are copied into a second buffer so that they stay valid after
+ * the device or tag information they came from changes or goes away.
+ *
+ * Output is read straight from a socket to the adb server when possible, or
+ * from a pipe to an adb client otherwise. Either way device_read() handles
+ * whatever a single read() returns, carrying a partial last line over into a
+ * fresh buffer when the current one fills up; threads read with blocking reads
+ * while event loops set the descriptor non-blocking. Backends that read into
+ * buffers of their own hand the chunks to device_feed(), which copies them in
+ * first.
+ *
+ * Replay devices colorize captured output handed to them in place and keep the
+ * finished lines, flattened, for whoever replays the capture to write.
+ *
+ * When a pool of workers is running, see pool.h, a device reading a lot at once
+ * hands its complete lines to the pool as a batch rather than handling them
+ * itself. A worker parses, filters and formats the lines of a batch into
+ * records; what depends on the lines before, resuming, suppressing, coalescing
+ * and archiving, is then done batch after batch in the order they were read,
+ * by whichever worker finished the batch that is next in turn. A device
+ * reading little at a time and with no batch in the pool handles its lines
+ * itself, without the hand off.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "device.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ccan/strmap/strmap.h>
+
+#include "adb.h"
+#include "affinity.h"
+#include "filter.h"
+#include "json.h"
+#include "layout.h"
+#include "output.h"
+#include "pool.h"
+#include "record.h"
+#include "scan.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Helper that fills out a column from a string literal. */
+#define BADGE(s) { sizeof(s) - 1, s }
+
+/** Arguments logcat is run with to write the binary format. */
+#define LOGCAT_BINARY_ARGS "-B"
+
+/**
+ * Least milliseconds between two reads of a device after which the device gives
+ * its buffers back to the pool, once it has handled everything it read.
+ */
+#define IDLE_MS (1000)
+
+/** Maximum number of characters of the arguments logcat is run with. */
+#define LOGCAT_ARGS_NCHARS (640)
+
+/** Room taken by the columns and fields copied for a single line. */
+#define LINE_COPIES_NCHARS (2 * COLUMN_NCHARS + STAMP_NCHARS + OWNER_NCHARS)
+
+/** Longest line handled whole; longer lines are split. */
+#define LINE_NCHARS_MAX (16 * 1024 * 1024)
+
+/** Maximum number of characters of an owner rendered from a binary entry. */
+#define OWNER_NCHARS (16)
+
+/** Least number of bytes of room the output of a device is read into. */
+#define READ_NBYTES_MIN (4 * 1024)
+
+/** Bytes of the stack of the thread reading a device. */
+#define READER_STACK_NBYTES (256 * 1024)
+
+/** Number of lines replayed within a single tag map read section. */
+#define REPLAY_SECTION_NLINES (1024)
+
+/** Maximum number of retries on starting logcat execution. */
+#define RETRIES_NMAX (10)
+
+/** Milliseconds waited before the first retry, doubled on every other. */
+#define RETRY_DELAY_MS_MIN (10)
+
+/** Most milliseconds waited between retries. */
+#define RETRY_DELAY_MS_MAX (1000)
+
+/** Shell command max number of characters. */
+#define SHELL_NCHARS (1024)
+
+/** Most batches of a device in the pool per worker. */
+#define STAGE_NBATCHES_PER_WORKER (2)
+
+/**
+ * Least number of bytes of complete lines handed to the pool when no batch of
+ * the device is in it already.
+ */
+#define STAGE_NBYTES_MIN (16 * 1024)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Complete lines read from a device at once, parsed and formatted by a worker
+ * of the pool and shown in turn with the device's other batches.
+ */
+struct batch {
+    struct pool_job  job;      //!< Job of the pool that parses the lines.
+    struct device   *device;   //!< Device the lines were read from.
+    struct buffer   *in;       //!< Buffer holding the lines, referenced.
+    const char      *data;     //!< First line of the batch.
+    size_t           len;      //!< Number of bytes of the lines.
+    uint64_t         seq;      //!< Number of the device's batches before.
+    uint64_t         read_ns;  //!< Time the lines were read.
+    unsigned         tags;     //!< Token of the read section holding the
+                               //!< tags of the lines.
+    struct buffer   *cols;     //!< Buffer columns are being copied into.
+    struct buffer   *held;     //!< Every buffer of copied columns the lines
+                               //!< point into, linked by next, referenced.
+    struct staged   *lines;    //!< Lines passing the filters, in order.
+    size_t           nlines;   //!< Number of those lines.
+    size_t           nslots;   //!< Number of lines there is room for.
+    uint64_t         nread;    //!< Number of lines read.
+    uint64_t         unparsed; //!< Number of lines that did not parse.
+    uint64_t         misses;   //!< Tag lookups of the tag map.
+    struct batch    *next;     //!< Next batch parsed ahead of its turn.
+};
+
+/**
+ * Line of a batch parsed and formatted ahead of its turn to be shown.
+ */
+struct staged {
+    const char                 *line;    //!< Line as read.
+    size_t                      len;     //!< Number of bytes of the line.
+    const struct logcat_format *format;  //!< Format the line is in.
+    const struct tag           *tag;     //!< Tag of the line.
+    regmatch_t                  matches[MESSAGE_NPARTS]; //!< Parts of the
+                                                         //!< line.
+    struct output_record        rec;     //!< Line as written, unless written
+                                         //!< as a binary record.
+};
+
+/**
+ * Decorations written around the fields of a line of text: escape sequences
+ * coloring them, or for plain text only the spacing that keeps them aligned.
+ * Lines find theirs by the output format, so that neither branches on it.
+ */
+struct style {
+    struct column        time;       //!< Ahead of the time.
+    struct column        owner;      //!< Between the time and the owner.
+    struct column        tag;        //!< Between the owner and the tag.
+    struct column        end;        //!< After the message.
+    struct column        notice;     //!< Ahead of what a notice tells.
+    struct column        notice_end; //!< After what a notice tells.
+    const struct column *badges;     //!< Badges of the tag types, which
+                                     //!< start the message.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Flag that indicates whether devices are asked for binary log entries. */
+bool device_binary = false;
+
+/**
+ * Buffers devices are asked for, one bit for each enum logcat_buffer, or zero
+ * for those logcat reads by default. Lines name their buffer unless zero.
+ */
+unsigned device_buffers;
+
+/**
+ * Milliseconds within which lines of the same tag and process are coalesced
+ * into a single record, or zero to write every line on its own.
+ */
+unsigned device_coalesce_ms;
+
+/** Format devices are asked to write their lines in. */
+const struct logcat_format *device_format = &logcat_format_time;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/**
+ * Badges displayed for each tag type indexed by the tag type's letter. The
+ * badge carries the separators on either side of it as well as the escape
+ * sequence that starts the message.
+ */
+static const struct column color_badges['Z' - 'A' + 1] = {
+    ['D' - 'A'] = BADGE(" \e[30;44m D \e[0m \e[1;30m"),
+    ['E' - 'A'] = BADGE(" \e[30;41m E \e[0m \e[1;30m"),
+    ['F' - 'A'] = BADGE(" \e[5;30;41m F \e[0m \e[1;30m"),
+    ['I' - 'A'] = BADGE(" \e[30;42m I \e[0m \e[1;30m"),
+    ['V' - 'A'] = BADGE(" \e[37m V  \e[1;30m"),
+    ['W' - 'A'] = BADGE(" \e[30;43m W \e[0m \e[1;30m"),
+    ['A' - 'A'] = BADGE("  \e[1;30m"),
+    ['B' - 'A'] = BADGE("  \e[1;30m"),
+    ['C' - 'A'] = BADGE("  \e[1;30m"),
+    ['G' - 'A'] = BADGE("  \e[1;30m"),
+    ['H' - 'A'] = BADGE("  \e[1;30m"),
+    ['J' - 'A'] = BADGE("  \e[1;30m"),
+    ['K' - 'A'] = BADGE("  \e[1;30m"),
+    ['L' - 'A'] = BADGE("  \e[1;30m"),
+    ['M' - 'A'] = BADGE("  \e[1;30m"),
+    ['N' - 'A'] = BADGE("  \e[1;30m"),
+    ['O' - 'A'] = BADGE("  \e[1;30m"),
+    ['P' - 'A'] = BADGE("  \e[1;30m"),
+    ['Q' - 'A'] = BADGE("  \e[1;30m"),
+    ['R' - 'A'] = BADGE("  \e[1;30m"),
+    ['S' - 'A'] = BADGE("  \e[1;30m"),
+    ['T' - 'A'] = BADGE("  \e[1;30m"),
+    ['U' - 'A'] = BADGE("  \e[1;30m"),
+    ['X' - 'A'] = BADGE("  \e[1;30m"),
+    ['Y' - 'A'] = BADGE("  \e[1;30m"),
+    ['Z' - 'A'] = BADGE("  \e[1;30m"),
+};
+
+/** Badges of plain text, as wide as those colorized. */
+static const struct column plain_badges['Z' - 'A' + 1] = {
+    ['D' - 'A'] = BADGE("  D  "),
+    ['E' - 'A'] = BADGE("  E  "),
+    ['F' - 'A'] = BADGE("  F  "),
+    ['I' - 'A'] = BADGE("  I  "),
+    ['V' - 'A'] = BADGE("  V  "),
+    ['W' - 'A'] = BADGE("  W  "),
+    ['A' - 'A'] = BADGE("  "),
+    ['B' - 'A'] = BADGE("  "),
+    ['C' - 'A'] = BADGE("  "),
+    ['G' - 'A'] = BADGE("  "),
+    ['H' - 'A'] = BADGE("  "),
+    ['J' - 'A'] = BADGE("  "),
+    ['K' - 'A'] = BADGE("  "),
+    ['L' - 'A'] = BADGE("  "),
+    ['M' - 'A'] = BADGE("  "),
+    ['N' - 'A'] = BADGE("  "),
+    ['O' - 'A'] = BADGE("  "),
+    ['P' - 'A'] = BADGE("  "),
+    ['Q' - 'A'] = BADGE("  "),
+    ['R' - 'A'] = BADGE("  "),
+    ['S' - 'A'] = BADGE("  "),
+    ['T' - 'A'] = BADGE("  "),
+    ['U' - 'A'] = BADGE("  "),
+    ['X' - 'A'] = BADGE("  "),
+    ['Y' - 'A'] = BADGE("  "),
+    ['Z' - 'A'] = BADGE("  "),
+};
+
+/** Decorations of colorized text. */
+static const struct style color_style = {
+    .time = BADGE(" \e[34m"),
+    .owner = BADGE("\e[0m \e[30;100m"),
+    .tag = BADGE("\e[0m "),
+    .end = BADGE("\e[0m"),
+    .notice = BADGE(" \e[1;31m--------- "),
+    .notice_end = BADGE("\e[0m\n"),
+    .badges = color_badges,
+};
+
+/** Decorations of plain text, only the spacing of those colorized. */
+static const struct style plain_style = {
+    .time = BADGE(" "),
+    .owner = BADGE(" "),
+    .tag = BADGE(" "),
+    .end = BADGE(""),
+    .notice = BADGE(" --------- "),
+    .notice_end = BADGE("\n"),
+    .badges = plain_badges,
+};
+
+/** Decorations of lines of text indexed by the output format. */
+static const struct style *const styles[] = {
+    [OUTPUT_COLOR] = &color_style,
+    [OUTPUT_PLAIN] = &plain_style,
+};
+
+/** Letters of the priorities, which JSON Lines output points into. */
+static const char priority_letters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+/** Identifier of the next device within binary records. */
+static atomic_uint next_id;
+
+/** Map of device names to device struct. */
+static struct { STRMAP_MEMBERS(struct device *); } device_map;
+
+/** Lock used to prevent concurrent read and write. */
+static pthread_mutex_t device_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Condition signalled when the last device open has been closed. */
+static pthread_cond_t devices_closed = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Number of devices created and not closed yet, whether or not they are still
+ * in the map. Protected by device_map_lock.
+ */
+static unsigned devices_open;
+
+/**
+ * Map of device names to the time of the last lines shown for devices that
+ * have gone away. Protected by device_map_lock.
+ */
+static struct { STRMAP_MEMBERS(struct stamp *); } resume_map;
+
+/** Eventfd that becomes readable once shutdown is requested. */
+static int shutdown_fd = -1;
+
+/** Control that sets up shutdown_fd exactly once. */
+static pthread_once_t shutdown_fd_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Parser shared by the threads reading devices and the workers of the pool,
+ * set up once by shared_parser_once.
+ */
+static struct logcat_parser shared_parser;
+
+/** Control of the one time set up of the shared parser. */
+static pthread_once_t shared_parser_once = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void add_column(struct output_record *rec, const struct column *col,
+                       int width);
+static void add_copy(struct output_record *rec, const char *text, size_t len);
+static void add_group(struct device *d, const struct output_record *rec);
+static void add_json(struct output_record *rec, const char *text, size_t len,
+                     const char *special);
+static void add_match(struct output_record *rec, const regmatch_t *match,
+                      const char *in);
+static size_t clip_width(const char *text, size_t len, size_t width);
+static struct buffer *decode_event(struct device *d,
+                                   const struct logcat_entry *entry,
+                                   struct logcat_entry *event);
+static void end_group(struct device *d);
+static void finish_line(struct output_record *rec, const struct tag *tag,
+                        char tagtype, const char *msg, size_t len,
+                        bool newline);
+static void finish_lines(struct device *d, struct logcat_parser *parser);
+static void format_json(const struct device *d, struct buffer *in,
+                        struct buffer **cols, const char *time,
+                        size_t time_len, char tagtype, const char *name,
+                        size_t name_len, const char *buffer, int32_t pid,
+                        int64_t tid, const char *msg, size_t len,
+                        struct output_record *rec);
+static void format_line(const struct device *d, struct buffer *in,
+                        struct buffer **cols, const char *line,
+                        const regmatch_t *matches, const struct tag *tag,
+                        struct output_record *rec);
+static void free_batch(struct batch *b);
+static struct logcat_parser *get_parser(void);
+static void give_back_buffers(struct device *d);
+static bool handle_count_member(const char *member, struct device *device,
+                                void *count);
+static bool handle_first_member(const char *member, struct device *device,
+                                void *first);
+static bool handle_free_resume(const char *member, struct stamp *stamp,
+                               void *unused);
+static bool handle_entries(struct device *d);
+static void handle_entry(struct device *d, struct buffer *in,
+                         const struct logcat_entry *entry);
+static bool handle_input(struct device *d, struct logcat_parser *parser);
+static void handle_line(struct device *d, struct logcat_parser *parser,
+                        const char *line, size_t len);
+static void handle_lines(struct device *d, struct logcat_parser *parser);
+static void hand_line(struct device *d, struct output_record *rec);
+static void join_group(struct device *d, const struct tag *tag, int32_t pid);
+static void keep_line(struct device *d, const struct output_record *rec);
+static void make_room(struct device *d, size_t len);
+static void mark_drops(struct device *d);
+static void mark_repeats(struct device *d);
+static bool note_stamp(struct device *d, const char *stamp, size_t len);
+static void open_raw(struct device *d);
+static int32_t parse_owner(const char *owner, size_t len);
+static int64_t parse_thread(const char *line, const regmatch_t *match);
+static void push_group(struct device *d);
+static void push_notice(struct device *d, const char *what, uint64_t count,
+                        const char *unit, const struct tag *tag);
+static void push_parsed(struct device *d, struct buffer *in, const char *line,
+                        const regmatch_t *matches, const struct tag *tag);
+static void push_record(struct device *d, struct buffer *in,
+                        const struct tag *tag, const char *name,
+                        size_t name_len, char tagtype, uint64_t nsec,
+                        int32_t pid, uint32_t tid, const char *msg,
+                        size_t len);
+static bool read_raw(struct device *d, struct logcat_parser *parser);
+static void release_buffers(struct device *d);
+static void render_json(struct device *d);
+static size_t render_number(char *out, int64_t value);
+static void reserve_copies(struct buffer **cols, size_t len);
+static void run_batch(struct pool_job *job);
+static void save_line(struct device *d, const char *line, size_t len,
+                      const regmatch_t *matches, const struct tag *tag);
+static void save_resume(struct device *d);
+static void set_up_parser(void);
+static void set_up_shutdown_fd(void);
+static void show_batch(struct batch *b);
+static void show_lines(struct batch *b);
+static size_t shown_width(const struct output_record *rec);
+static void stage_line(struct batch *b, struct logcat_parser *parser,
+                       const struct logcat_format **format, const char *line,
+                       size_t len);
+static bool stage_lines(struct device *d, uint64_t read_ns);
+static int start_client(struct device *d, const char *cmd);
+static void start_line(const struct device *d, struct buffer *in,
+                       struct buffer **cols, struct output_record *rec);
+static size_t strip_return(const struct device *d, char *line, size_t len,
+                           regmatch_t *matches);
+static bool suppress(struct device *d, const struct tag *tag, char tagtype,
+                     const char *msg, size_t len);
+static void wait_batches(struct device *d);
+static bool wait_input(struct device *d);
+
+/******************************************************************************/
+
+/**
+ * Remove the device from the map of known devices and release its resources.
+ */
+void device_close(struct device *d)
+{
+    wait_batches(d);
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    strmap_del(&device_map, d->name, NULL);
+    save_resume(d);
+    pthread_mutex_unlock(&device_map_lock);
+
+    end_group(d);
+    if (output_policy != OUTPUT_BLOCK) {
+        mark_drops(d);
+    }
+    mark_repeats(d);
+    limit_free(&d->limit);
+    output_source_close(d->source, d->id);
+    archive_close(&d->archive);
+    if (d->tail != NULL) {
+        tail_close(d->tail);
+    }
+    raw_close(&d->raw);
+    stats_device_unregister(&d->stats);
+    if (d->fd >= 0) {
+        close(d->fd);
+    }
+    if (d->client > 0) {
+        // A client still running, such as that of a device quiet at shutdown,
+        // would otherwise be waited on for as long as it keeps going.
+        kill(d->client, SIGTERM);
+        waitpid(d->client, NULL, 0);
+    }
+    release_buffers(d);
+    pthread_mutex_destroy(&d->stage_lock);
+    pthread_cond_destroy(&d->stage_cond);
+    free(d);
+
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    if (--devices_open == 0) {
+        pthread_cond_broadcast(&devices_closed);
+    }
+    pthread_mutex_unlock(&device_map_lock);
+}
+
+/**
+ * Close every device still in the map of known devices. None of them may be
+ * read by any thread any longer.
+ */
+void device_close_all(void)
+{
+    for (;;) {
+        struct device *d = NULL;
+        stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+        strmap_iterate(&device_map, handle_first_member, &d);
+        pthread_mutex_unlock(&device_map_lock);
+        if (d == NULL) {
+            return;
+        }
+        device_close(d);
+    }
+}
+
+/**
+ * Return the number of devices currently known.
+ */
+int device_count(void)
+{
+    int count = 0;
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    strmap_iterate(&device_map, handle_count_member, &count);
+    pthread_mutex_unlock(&device_map_lock);
+    return count;
+}
+
+/**
+ * Handle the given chunk of the device's output, which may end partway
+ * through a line. An empty chunk marks the end of the output. Returns false
+ * once the device's output has ended.
+ */
+bool device_feed(struct device *d, struct logcat_parser *parser,
+                 const char *data, size_t len)
+{
+    if (len == 0) {
+        finish_lines(d, parser);
+        return false;
+    }
+    if (d->raw.file >= 0) {
+        raw_write(&d->raw, data, len);
+    }
+    if (raw_only) {
+        return true;
+    }
+    make_room(d, len);
+    memcpy(d->in->data + d->in->used, data, len);
+    d->in->used += len;
+    return handle_input(d, parser);
+}
+
+/**
+ * Return whether a device with the given name is already known.
+ */
+bool device_known(const char *name)
+{
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    bool known = strmap_get(&device_map, name) != NULL;
+    pthread_mutex_unlock(&device_map_lock);
+    return known;
+}
+
+/**
+ * Forget where every device that went away was. No device may be running.
+ */
+void device_map_clear(void)
+{
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    strmap_iterate(&resume_map, handle_free_resume, NULL);
+    strmap_clear(&resume_map);
+    pthread_mutex_unlock(&device_map_lock);
+}
+
+/**
+ * Create the device with the given name and add it to the map of known
+ * devices.
+ */
+struct device *device_new(const char *name)
+{
+    // Lets create the device and add it to the map.
+    struct device *device = (struct device *)calloc(1, sizeof(struct device));
+    assert(device != NULL);
+    strncpy(device->name, name, sizeof(device->name) - 1);
+    device->fd = -1;
+    pthread_mutex_init(&device->stage_lock, NULL);
+    pthread_cond_init(&device->stage_cond, NULL);
+    raw_init(&device->raw);
+    limit_init(&device->limit);
+    device->binary = device_binary;
+    device->format = device_binary ? &logcat_format_time : device_format;
+    device->source = output_source_open(device->name);
+    device->id = atomic_fetch_add(&next_id, 1);
+    archive_open(&device->archive, device->name);
+    device->tail = tail_open(device->name);
+    stats_device_register(&device->stats, device->name);
+    // The device's color follows from its name, the same from run to run.
+    device->color = color_of_hash(tag_hash(device->name,
+                                           strlen(device->name)));
+    color_render_column(&device->column, device->color, device->name,
+                        COLUMN_WIDTH_MAX);
+    render_json(device);
+    // Name the device ahead of any of its lines.
+    if (output_format == OUTPUT_BINARY) {
+        reserve_copies(&device->cols, RECORD_NAME_NBYTES + SERIAL_NCHARS);
+        struct output_record rec = {
+            .bufs = { NULL, device->cols },
+            .source = device->source,
+            .device = device->id,
+        };
+        uint8_t header[RECORD_NAME_NBYTES];
+        size_t len = strlen(device->name);
+        record_encode_name(header, RECORD_DEVICE, device->id, len);
+        add_copy(&rec, (const char *)header, sizeof(header));
+        add_copy(&rec, device->name, len);
+        buffer_ref(device->cols);
+        output_push(&rec);
+    }
+    // Add device to the device map, picking up where the device was when it
+    // went away.
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    strmap_add(&device_map, device->name, device);
+    ++devices_open;
+    struct stamp *resume = strmap_get(&resume_map, device->name);
+    if (resume != NULL) {
+        device->resume = *resume;
+    }
+    pthread_mutex_unlock(&device_map_lock);
+    return device;
+}
+
+/**
+ * Start logcat for the given device, streaming its output straight from the
+ * adb server when one is running and through the adb client otherwise.
+ * Returns 0 on success or -1 if logcat could not be started.
+ */
+int device_open(struct device *d)
+{
+    // Output opened by whoever created the device is read as it is.
+    if (d->fd >= 0) {
+        return 0;
+    }
+
+    // Only fetch what is newer than the last lines shown before the device
+    // went away, and have logcat drop what the filters would.
+    char args[LOGCAT_ARGS_NCHARS];
+    const char *format = d->binary ? LOGCAT_BINARY_ARGS : device_format->args;
+    char since[STAMP_NCHARS + 8] = "";
+    if (d->resume.len > 0) {
+        snprintf(since, sizeof(since), " -T '%.*s'", (int)d->resume.len,
+                 d->resume.text);
+    }
+    char buffers[LOGCAT_BUFFER_NMAX * 16] = "";
+    size_t n = 0;
+    for (int i = 0; i < LOGCAT_BUFFER_NMAX; ++i) {
+        if ((device_buffers >> i & 1) != 0) {
+            n += snprintf(buffers + n, sizeof(buffers) - n, " -b %s",
+                          logcat_buffer_names[i]);
+        }
+    }
+    snprintf(args, sizeof(args), "%s%s%s%s", format, buffers, since,
+             filter_pushdown());
+
+    // Events are named by the dictionary of the build the device runs.
+    if ((device_buffers & LOGCAT_BINARY_BUFFERS) != 0
+        && d->event_tags == NULL) {
+        d->event_tags = events_tags_get(d->name);
+    }
+
+    // A device that just connected may be refused for a moment. Retries back
+    // off exponentially and only ever hold up the device retrying.
+    char cmd[SHELL_NCHARS];
+    snprintf(cmd, sizeof(cmd), "adb -s %s logcat %s", d->name, args);
+    unsigned delay_ms = RETRY_DELAY_MS_MIN;
+    d->tty = false;
+    for (int retries = 0;; ++retries) {
+        d->fd = adb_open_logcat(d->name, args, &d->tty);
+        if (d->fd >= 0) {
+            break;
+        }
+        // Without a server the adb client starts logcat instead.
+        if (errno != EPROTO) {
+            if (start_client(d, cmd) == 0) {
+                break;
+            }
+        }
+        if (retries == RETRIES_NMAX
+            || atomic_load(&shutdown_requested)) {
+            fprintf(stderr, "Failure to start logcat for device: %s\n",
+                    d->name);
+            return -1;
+        }
+        // Shutdown cuts the delay short.
+        struct pollfd pfd = { .fd = device_shutdown_fd(), .events = POLLIN };
+        poll(&pfd, 1, delay_ms);
+        delay_ms = delay_ms * 2 < RETRY_DELAY_MS_MAX ? delay_ms * 2
+                                                     : RETRY_DELAY_MS_MAX;
+    }
+
+    // The terminal behind shell: turns every newline byte into "\r\n", which
+    // corrupts binary entries; only exec:, from Android 5.0 on, keeps them.
+    if (d->binary && d->tty) {
+        fprintf(stderr, "Binary log format needs Android 5.0 or later on "
+                "device: %s\n", d->name);
+        close(d->fd);
+        d->fd = -1;
+        return -1;
+    }
+    open_raw(d);
+    return 0;
+}
+
+/**
+ * Read whatever output of the device is available and handle every complete
+ * line within it. Returns false once the device's output has ended.
+ */
+bool device_read(struct device *d, struct logcat_parser *parser)
+{
+    if (d->raw.file >= 0) {
+        return read_raw(d, parser);
+    }
+    make_room(d, d->binary ? LOGCAT_ENTRY_NBYTES_MAX : READ_NBYTES_MIN);
+    struct buffer *in = d->in;
+    ssize_t n = read(d->fd, in->data + in->used, buffer_avail(in));
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (n == 0) {
+        finish_lines(d, parser);
+        return false;
+    }
+    in->used += n;
+    return handle_input(d, parser);
+}
+
+/**
+ * Colorize the lines or entries within the given text, which must stay valid
+ * until this returns, as though the device had logged them. The lines are
+ * returned as a chain of buffers, oldest first, that the caller releases; a
+ * replay device never hands lines to the writer.
+ */
+struct buffer *device_replay(struct device *d, struct logcat_parser *parser,
+                             const char *data, size_t len)
+{
+    // Read sections are kept short so that evicted tags are freed promptly.
+    tag_read_begin();
+    unsigned nlines = 0;
+    while (len > 0) {
+        if (++nlines % REPLAY_SECTION_NLINES == 0) {
+            tag_read_end();
+            tag_read_begin();
+        }
+        size_t n;
+        if (d->binary) {
+            struct logcat_entry entry;
+            ssize_t got = logcat_decode_entry(data, len, &entry);
+            if (got <= 0) {
+                fprintf(stderr, "Replayed malformed log entry from: %s\n",
+                        d->name);
+                break;
+            }
+            handle_entry(d, d->in, &entry);
+            n = got;
+        } else {
+            const char *newline = scan_chr(data, len, '\n');
+            n = newline != NULL ? (size_t)(newline - data) + 1 : len;
+            handle_line(d, parser, data, n);
+        }
+        data += n;
+        len -= n;
+    }
+    // Workers replay chunks that need not follow one another.
+    mark_repeats(d);
+    tag_read_end();
+
+    struct buffer *lines = d->replayed;
+    d->replayed = NULL;
+    d->replayed_tail = NULL;
+    return lines;
+}
+
+/**
+ * Release the resources of the given replay device.
+ */
+void device_replay_free(struct device *d)
+{
+    limit_free(&d->limit);
+    release_buffers(d);
+    pthread_mutex_destroy(&d->stage_lock);
+    pthread_cond_destroy(&d->stage_cond);
+    free(d);
+}
+
+/**
+ * Create a device of the given name and color that colorizes text handed to
+ * device_replay() rather than the output of logcat. It is never known as a
+ * connected device.
+ */
+struct device *device_replay_new(const char *name, enum color color)
+{
+    struct device *device = (struct device *)calloc(1, sizeof(struct device));
+    assert(device != NULL);
+    strncpy(device->name, name, sizeof(device->name) - 1);
+    device->fd = -1;
+    pthread_mutex_init(&device->stage_lock, NULL);
+    pthread_cond_init(&device->stage_cond, NULL);
+    raw_init(&device->raw);
+    limit_init(&device->limit);
+    device->binary = device_binary;
+    device->format = device_binary ? &logcat_format_time : device_format;
+    device->in = buffer_get();
+    device->cols = buffer_get();
+    device->replay = true;
+    device->color = color;
+    color_render_column(&device->column, device->color, device->name,
+                        COLUMN_WIDTH_MAX);
+    render_json(device);
+    return device;
+}
+
+/**
+ * Run logcat for the given device.
+ */
+void *device_run(void *device)
+{
+    struct device *d = (struct device *)device;
+    affinity_pin(AFFINITY_READERS);
+    if (device_open(d) != 0) {
+        device_close(d);
+        return NULL;
+    }
+
+    struct logcat_parser *parser = get_parser();
+    while (!atomic_load(&shutdown_requested) && wait_input(d)
+           && device_read(d, parser)) {
+    }
+    stats_thread_unregister();
+    filter_thread_free();
+
+    // Device disconnected; cleanup the device resources.
+    device_close(d);
+
+    return NULL;
+}
+
+/**
+ * Ask every device to stop being read, waking whoever waits on the output of
+ * a device or on the descriptor of device_shutdown_fd().
+ */
+void device_shutdown(void)
+{
+    atomic_store(&shutdown_requested, true);
+    uint64_t one = 1;
+    ssize_t n = write(device_shutdown_fd(), &one, sizeof(one));
+    (void)n;
+}
+
+/**
+ * Return the descriptor that becomes readable once shutdown is requested and
+ * stays so, for whoever waits on anything to wait on it as well.
+ */
+int device_shutdown_fd(void)
+{
+    pthread_once(&shutdown_fd_once, set_up_shutdown_fd);
+    return shutdown_fd;
+}
+
+/**
+ * Start a thread of the given function for the given device, with a stack sized
+ * for reading a device rather than the default, so that many devices can be
+ * read at once. Returns 0 on success or an error number on failure.
+ */
+int device_spawn(struct device *d, void *(*run)(void *))
+{
+    pthread_attr_t attr;
+    int err = pthread_attr_init(&attr);
+    if (err) {
+        return err;
+    }
+    err = pthread_attr_setstacksize(&attr, READER_STACK_NBYTES);
+    if (!err) {
+        err = pthread_create(&d->thread, &attr, run, d);
+    }
+    pthread_attr_destroy(&attr);
+    return err;
+}
+
+/**
+ * Wait for every device created to have been closed, whichever thread closes
+ * it.
+ */
+void device_wait_closed(void)
+{
+    stats_lock(&device_map_lock, STATS_LOCK_DEVICE_MAP);
+    while (devices_open > 0) {
+        pthread_cond_wait(&devices_closed, &device_map_lock);
+    }
+    pthread_mutex_unlock(&device_map_lock);
+}
+
+/**
+ * Release what the calling worker of the pool set up to handle batches of
+ * lines; workers call this on their way out.
+ */
+void device_worker_leave(void)
+{
+    stats_thread_unregister();
+    filter_thread_free();
+}
+
+/**
+ * Copy the given column, cut to the given width, into the buffer of copied
+ * columns and append it to the record.
+ */
+static void add_column(struct output_record *rec, const struct column *col,
+                       int width)
+{
+    struct buffer *cols = rec->bufs[1];
+    char *copy = cols->data + cols->used;
+    size_t len = color_copy_column(copy, col, width);
+    cols->used += len;
+    output_add(rec, copy, len);
+}
+
+/**
+ * Copy the given text into the buffer of copied columns and append it to the
+ * record. The copy keeps the text valid however long the line waits for the
+ * writer.
+ */
+static void add_copy(struct output_record *rec, const char *text, size_t len)
+{
+    struct buffer *cols = rec->bufs[1];
+    char *copy = cols->data + cols->used;
+    memcpy(copy, text, len);
+    cols->used += len;
+    output_add(rec, copy, len);
+}
+
+/**
+ * Copy the given finished line onto the end of the lines coalesced, handing
+ * those held to the writer first when there is no room for it.
+ */
+static void add_group(struct device *d, const struct output_record *rec)
+{
+    size_t len = 0;
+    for (int i = 0; i < rec->niov; ++i) {
+        len += rec->iov[i].iov_len;
+    }
+    struct buffer *lines = d->group.lines;
+    if (lines != NULL && buffer_avail(lines) < len) {
+        push_group(d);
+        lines = NULL;
+    }
+    if (lines == NULL) {
+        lines = len <= BUFFER_NBYTES ? buffer_get() : buffer_get_large(len);
+        d->group.lines = lines;
+        d->group.read_ns = rec->read_ns;
+        d->group.priority = rec->priority;
+    }
+    for (int i = 0; i < rec->niov; ++i) {
+        memcpy(lines->data + lines->used, rec->iov[i].iov_base,
+               rec->iov[i].iov_len);
+        lines->used += rec->iov[i].iov_len;
+    }
+}
+
+/**
+ * Append the given text to the record as part of a JSON string, copying it
+ * escaped into the buffer of copied columns only when it holds the given
+ * first byte that needs escaping. Room for the copy must have been reserved.
+ */
+static void add_json(struct output_record *rec, const char *text, size_t len,
+                     const char *special)
+{
+    if (special == NULL) {
+        output_add(rec, text, len);
+        return;
+    }
+    struct buffer *cols = rec->bufs[1];
+    char *copy = cols->data + cols->used;
+    size_t plain = special - text;
+    memcpy(copy, text, plain);
+    size_t n = plain + json_escape(copy + plain, special, len - plain);
+    cols->used += n;
+    output_add(rec, copy, n);
+}
+
+/**
+ * Append the text for a match in the regular expression to the given record.
+ */
+static void add_match(struct output_record *rec, const regmatch_t *match,
+                      const char *in)
+{
+    output_add(rec, &in[match->rm_so], match->rm_eo - match->rm_so);
+}
+
+/**
+ * Return the number of characters of the given text, of the given length, that
+ * fit within the given width; a tab takes the terminal to its next stop.
+ */
+static size_t clip_width(const char *text, size_t len, size_t width)
+{
+    size_t shown = 0;
+    for (size_t i = 0; i < len; ++i) {
+        // Only the first byte of a character encoded in UTF-8 takes room.
+        if (((uint8_t)text[i] & 0xc0) == 0x80) {
+            continue;
+        }
+        shown = text[i] == '\t' ? (shown / 8 + 1) * 8 : shown + 1;
+        if (shown > width) {
+            return i;
+        }
+    }
+    return len;
+}
+
+/**
+ * Decode the given entry of a binary buffer of the device into the given
+ * event, whose text is written to the device's buffer of decoded events.
+ * Returns that buffer.
+ */
+static struct buffer *decode_event(struct device *d,
+                                   const struct logcat_entry *entry,
+                                   struct logcat_entry *event)
+{
+    // Lines still point into a buffer that filled up, so it is only released.
+    if (d->events == NULL || buffer_avail(d->events) < EVENTS_TEXT_NBYTES_MAX) {
+        if (d->events != NULL) {
+            buffer_unref(d->events);
+        }
+        d->events = buffer_get();
+    }
+    struct buffer *out = d->events;
+    *event = *entry;
+    out->used += events_decode(d->event_tags, event, out->data + out->used,
+                               EVENTS_TEXT_NBYTES_MAX);
+    return out;
+}
+
+/**
+ * Hand the lines coalesced to the writer and close the group.
+ */
+static void end_group(struct device *d)
+{
+    if (d->group.lines != NULL) {
+        push_group(d);
+    }
+    d->group.serial = 0;
+}
+
+/**
+ * Append the tag, badge and message to the given record started by
+ * start_line(), finishing the line. The newline ending the line is appended
+ * when the message does not carry its own.
+ */
+static void finish_line(struct output_record *rec, const struct tag *tag,
+                        char tagtype, const char *msg, size_t len,
+                        bool newline)
+{
+    // Print the tag.
+    struct layout layout = layout_get();
+    add_column(rec, &tag->column, layout.tag);
+
+    // print tagtype
+    const struct style *style = styles[output_format];
+    const struct column *badge = &style->badges[tagtype - 'A'];
+    output_add(rec, badge->text, badge->len);
+
+    // Clip the message to what is left of the line so that it never wraps.
+    if (layout.line > 0) {
+        size_t shown = shown_width(rec);
+        size_t text = len > 0 && msg[len - 1] == '\n' ? len - 1 : len;
+        size_t kept = clip_width(msg, text,
+                                 layout.line > shown ? layout.line - shown : 0);
+        if (kept < text) {
+            len = kept;
+            newline = true;
+        }
+    }
+
+    // print message
+    output_add(rec, msg, len);
+    if (newline) {
+        output_add_literal(rec, "\n");
+    }
+    output_add(rec, style->end.text, style->end.len);
+
+    rec->priority = tagtype;
+}
+
+/**
+ * Handle the partial line left at the end of the device's output; a last line
+ * without a newline is still a line.
+ */
+static void finish_lines(struct device *d, struct logcat_parser *parser)
+{
+    wait_batches(d);
+    struct buffer *in = d->in;
+    if (!d->binary && in != NULL && d->pending < in->used) {
+        tag_read_begin();
+        handle_line(d, parser, in->data + d->pending, in->used - d->pending);
+        tag_read_end();
+        d->pending = in->used;
+    }
+}
+
+/**
+ * Format a line of the device, read into the given buffer, as a JSON object
+ * within the given record, copying into the given buffer of copied columns.
+ * The buffer the line was logged to is left out when NULL, and the thread
+ * identifier when negative.
+ */
+static void format_json(const struct device *d, struct buffer *in,
+                        struct buffer **cols, const char *time,
+                        size_t time_len, char tagtype, const char *name,
+                        size_t name_len, const char *buffer, int32_t pid,
+                        int64_t tid, const char *msg, size_t len,
+                        struct output_record *rec)
+{
+    // Only text that needs escaping is copied.
+    const char *name_special = json_special(name, name_len);
+    const char *msg_special = json_special(msg, len);
+    size_t room = (name_special != NULL ? json_escaped_len(name, name_len) : 0)
+                  + (msg_special != NULL ? json_escaped_len(msg, len) : 0);
+    reserve_copies(cols, d->json_len + room);
+    *rec = (struct output_record){
+        .bufs = { in, *cols },
+        .source = d->source,
+        .device = d->id,
+        .priority = tagtype,
+    };
+    add_copy(rec, d->json, d->json_len);
+    add_copy(rec, time, time_len);
+    output_add_literal(rec, "\",\"priority\":\"");
+    output_add(rec, &priority_letters[tagtype - 'A'], 1);
+    output_add_literal(rec, "\",\"tag\":\"");
+    add_json(rec, name, name_len, name_special);
+    if (buffer != NULL) {
+        output_add_literal(rec, "\",\"buffer\":\"");
+        output_add(rec, buffer, strlen(buffer));
+    }
+
+    char ids[OWNER_NCHARS * 2 + 32];
+    static const char pid_key[] = "\",\"pid\":";
+    static const char tid_key[] = ",\"tid\":";
+    static const char msg_key[] = ",\"message\":\"";
+    size_t n = 0;
+    memcpy(ids, pid_key, sizeof(pid_key) - 1);
+    n += sizeof(pid_key) - 1;
+    n += render_number(ids + n, pid);
+    if (tid >= 0) {
+        memcpy(ids + n, tid_key, sizeof(tid_key) - 1);
+        n += sizeof(tid_key) - 1;
+        n += render_number(ids + n, tid);
+    }
+    memcpy(ids + n, msg_key, sizeof(msg_key) - 1);
+    n += sizeof(msg_key) - 1;
+    add_copy(rec, ids, n);
+
+    add_json(rec, msg, len, msg_special);
+    output_add_literal(rec, "\"}\n");
+}
+
+/**
+ * Format the given parsed line of the device, read into the given buffer, as
+ * text or as a JSON object within the given record, copying into the given
+ * buffer of copied columns. Nothing of the device that changes as lines are
+ * shown is touched, so that lines are formatted on whichever thread parsed
+ * them; the key and read time of the line are left for hand_line().
+ */
+static void format_line(const struct device *d, struct buffer *in,
+                        struct buffer **cols, const char *line,
+                        const regmatch_t *matches, const struct tag *tag,
+                        struct output_record *rec)
+{
+    if (output_format == OUTPUT_JSONL) {
+        size_t msg_len = matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so;
+        const char *msg = &line[matches[MESSAGE].rm_so];
+        while (msg_len > 0 && msg[msg_len - 1] == '\n') {
+            --msg_len;
+        }
+        format_json(d, in, cols, &line[matches[TIME].rm_so],
+                    matches[TIME].rm_eo - matches[TIME].rm_so,
+                    line[matches[TAGTYPE].rm_so], &line[matches[TAG].rm_so],
+                    matches[TAG].rm_eo - matches[TAG].rm_so, NULL,
+                    parse_owner(&line[matches[OWNER].rm_so],
+                                matches[OWNER].rm_eo - matches[OWNER].rm_so),
+                    parse_thread(line, &matches[THREAD]), msg, msg_len, rec);
+        return;
+    }
+
+    const struct style *style = styles[output_format];
+    start_line(d, in, cols, rec);
+
+    // Print the time of the logged message.
+    output_add(rec, style->time.text, style->time.len);
+    add_match(rec, &matches[TIME], line);
+
+    // Print the owner of the message, and its thread when known.
+    output_add(rec, style->owner.text, style->owner.len);
+    add_match(rec, &matches[OWNER], line);
+    if (matches[THREAD].rm_so >= 0) {
+        output_add_literal(rec, " ");
+        add_match(rec, &matches[THREAD], line);
+    }
+    output_add(rec, style->tag.text, style->tag.len);
+
+    finish_line(rec, tag, line[matches[TAGTYPE].rm_so],
+                &line[matches[MESSAGE].rm_so],
+                matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so, false);
+}
+
+/**
+ * Release the given batch shown, along with the tags and buffers it held.
+ */
+static void free_batch(struct batch *b)
+{
+    tag_read_release(b->tags);
+    buffer_unref(b->cols);
+    while (b->held != NULL) {
+        struct buffer *next = b->held->next;
+        buffer_unref(b->held);
+        b->held = next;
+    }
+    buffer_unref(b->in);
+    free(b->lines);
+    free(b);
+}
+
+/**
+ * Return the parser shared between the threads handling lines, setting it up
+ * on first use. Parsing never changes the parser, whose regular expression
+ * only serves the rare lines the tokenizers reject.
+ */
+static struct logcat_parser *get_parser(void)
+{
+    pthread_once(&shared_parser_once, set_up_parser);
+    return &shared_parser;
+}
+
+/**
+ * Give the buffers of the given device back to the pool when it has handled
+ * everything it read and no batch of its lines is on its way, so that a quiet
+ * device holds none; they are taken again on its next read.
+ */
+static void give_back_buffers(struct device *d)
+{
+    if (d->in != NULL && d->pending < d->in->used) {
+        return;
+    }
+    pthread_mutex_lock(&d->stage_lock);
+    bool idle = d->shown == d->staged && !d->showing;
+    pthread_mutex_unlock(&d->stage_lock);
+    if (idle) {
+        release_buffers(d);
+    }
+}
+
+/**
+ * Handler that counts the numer of members by iterating the count each time its
+ * called recursively.
+ */
+static bool handle_count_member(const char *member, struct device *device,
+                                void *count)
+{
+    int *c = (int *)count;
+    if (member != NULL) {
+        ++(*c);
+    }
+    return true;
+}
+
+/**
+ * Handler that keeps the first device of the map of known devices.
+ */
+static bool handle_first_member(const char *member, struct device *device,
+                                void *first)
+{
+    *(struct device **)first = device;
+    return false;
+}
+
+/**
+ * Handler that frees the key and value of an entry of the resume map.
+ */
+static bool handle_free_resume(const char *member, struct stamp *stamp,
+                               void *unused)
+{
+    free((char *)member);
+    free(stamp);
+    return true;
+}
+
+/**
+ * Handle every complete binary entry in the device's input buffer that has not
+ * been handled yet. Returns false if the input is not a valid entry.
+ */
+static bool handle_entries(struct device *d)
+{
+    struct buffer *in = d->in;
+    while (d->pending < in->used) {
+        struct logcat_entry entry;
+        ssize_t n = logcat_decode_entry(in->data + d->pending,
+                                        in->used - d->pending, &entry);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            stats_add(&d->stats.unparsed, 1);
+            fprintf(stderr, "Received malformed log entry from device: %s\n",
+                    d->name);
+            return false;
+        }
+        stats_add(&d->stats.lines, 1);
+        stats_add(&d->stats.bytes, n);
+        handle_entry(d, in, &entry);
+        d->pending += n;
+    }
+    return true;
+}
+
+/**
+ * Colorize a binary entry, which lives within the given buffer, and hand its
+ * lines to the writer. The time and owner are rendered just as the time format
+ * shows them, and a message of several lines is shown as one line of output
+ * each. Events are first decoded into text of their own.
+ */
+static void handle_entry(struct device *d, struct buffer *in,
+                         const struct logcat_entry *entry)
+{
+    struct logcat_entry event;
+    if ((LOGCAT_BINARY_BUFFERS >> entry->buffer & 1) != 0) {
+        in = decode_event(d, entry, &event);
+        entry = &event;
+    }
+
+    const struct tag *tag = tag_intern(entry->tag, entry->tag_len);
+    if (!filter_accept(tag, entry->tagtype, entry->msg, entry->msg_len)) {
+        return;
+    }
+
+    // Entries logged within the same second share all but the milliseconds.
+    struct second *second = &d->second;
+    if (second->len == 0 || entry->sec != second->sec) {
+        struct tm tm;
+        time_t sec = entry->sec;
+        localtime_r(&sec, &tm);
+        int n = snprintf(second->text, sizeof(second->text),
+                         "%02d-%02d %02d:%02d:%02d", tm.tm_mon + 1, tm.tm_mday,
+                         tm.tm_hour, tm.tm_min, tm.tm_sec);
+        second->len = n > 0 && (size_t)n < sizeof(second->text) - 4 ? n : 0;
+        second->sec = entry->sec;
+    }
+    char stamp[STAMP_NCHARS];
+    unsigned msec = entry->nsec / 1000000 % 1000;
+    memcpy(stamp, second->text, second->len);
+    stamp[second->len] = '.';
+    stamp[second->len + 1] = '0' + msec / 100;
+    stamp[second->len + 2] = '0' + msec / 10 % 10;
+    stamp[second->len + 3] = '0' + msec % 10;
+    size_t stamp_len = second->len + 4;
+    if (!note_stamp(d, stamp, stamp_len)
+        || suppress(d, tag, entry->tagtype, entry->msg, entry->msg_len)) {
+        return;
+    }
+    if (device_coalesce_ms > 0) {
+        join_group(d, tag, entry->pid);
+    }
+    char owner[OWNER_NCHARS];
+    int owner_len = snprintf(owner, sizeof(owner), "%5d", entry->pid);
+
+    const char *msg = entry->msg;
+    size_t left = entry->msg_len;
+    while (left > 0 && msg[left - 1] == '\n') {
+        --left;
+    }
+    // Records and objects keep a message of several lines whole.
+    if (output_format == OUTPUT_BINARY) {
+        push_record(d, in, tag, entry->tag, entry->tag_len, entry->tagtype,
+                    (uint64_t)entry->sec * 1000000000 + entry->nsec,
+                    entry->pid, entry->tid, msg, left);
+    } else if (output_format == OUTPUT_JSONL) {
+        struct output_record rec;
+        const char *buffer = device_buffers != 0
+                             ? logcat_buffer_names[entry->buffer] : NULL;
+        // Entries of relayed lines whose thread was not known carry none.
+        int64_t tid = entry->tid != 0 ? (int64_t)entry->tid : -1;
+        format_json(d, in, &d->cols, stamp, stamp_len, entry->tagtype,
+                    entry->tag, entry->tag_len, buffer, entry->pid, tid, msg,
+                    left, &rec);
+        hand_line(d, &rec);
+    }
+    if (d->tail != NULL) {
+        uint64_t ms = (uint64_t)entry->sec * 1000 + entry->nsec / 1000000;
+        tail_add(d->tail, ms, entry->pid, entry->tid, entry->tagtype,
+                 entry->tag, entry->tag_len, msg, left);
+        if (snapshot_dir != NULL) {
+            snapshot_check(d->name, ms, entry->tagtype, msg, left);
+        }
+    }
+    for (;;) {
+        const char *newline = scan_chr(msg, left, '\n');
+        size_t len = newline != NULL ? (size_t)(newline - msg) : left;
+
+        if (output_format == OUTPUT_COLOR || output_format == OUTPUT_PLAIN) {
+            const struct style *style = styles[output_format];
+            struct output_record rec;
+            start_line(d, in, &d->cols, &rec);
+            output_add(&rec, style->time.text, style->time.len);
+            add_copy(&rec, stamp, stamp_len);
+            output_add(&rec, style->owner.text, style->owner.len);
+            add_copy(&rec, owner, owner_len);
+            output_add(&rec, style->tag.text, style->tag.len);
+            finish_line(&rec, tag, entry->tagtype, msg, len, true);
+            hand_line(d, &rec);
+        }
+
+        // Archive the line just as the time format shows it.
+        if (d->archive.stream != NULL) {
+            struct iovec parts[] = {
+                { stamp, stamp_len },
+                { " ", 1 },
+                { (char *)&entry->tagtype, 1 },
+                { "/", 1 },
+                { (char *)entry->tag, entry->tag_len },
+                { "(", 1 },
+                { owner, owner_len },
+                { "): ", 3 },
+                { (char *)msg, len },
+                { "\n", 1 },
+            };
+            archive_add(&d->archive, d->key, tag->hash, parts,
+                        sizeof(parts) / sizeof(parts[0]));
+        }
+
+        if (newline == NULL) {
+            break;
+        }
+        msg = newline + 1;
+        left -= len + 1;
+    }
+}
+
+/**
+ * Handle whatever complete lines or entries the device's input buffer holds.
+ * Returns false if the device's output can no longer be made sense of.
+ */
+static bool handle_input(struct device *d, struct logcat_parser *parser)
+{
+    uint64_t now = stats_now_ns();
+    // A device read seldom holds on to no buffers between its reads.
+    bool seldom = now - d->input_ns >= IDLE_MS * 1000000ULL;
+    d->input_ns = now;
+    atomic_store_explicit(&d->stats.read_ns, now, memory_order_relaxed);
+    if (!d->binary && stage_lines(d, now)) {
+        if (seldom) {
+            give_back_buffers(d);
+        }
+        return true;
+    }
+    bool ok = true;
+    d->read_ns = now;
+    atomic_uint_fast64_t *misses = &stats_thread()->tag_cache_misses;
+    uint64_t missed = atomic_load_explicit(misses, memory_order_relaxed);
+    tag_read_begin();
+    if (d->binary) {
+        ok = handle_entries(d);
+    } else {
+        handle_lines(d, parser);
+    }
+    // Lines are only coalesced with those read along with them.
+    end_group(d);
+    tag_read_end();
+    stats_add(&d->stats.tag_misses,
+              atomic_load_explicit(misses, memory_order_relaxed) - missed);
+    if (seldom) {
+        give_back_buffers(d);
+    }
+    return ok;
+}
+
+/**
+ * Colorize a single line read from the device, which lives within the device's
+ * input buffer, and hand it to the writer, or hand it over as a binary record.
+ */
+static void handle_line(struct device *d, struct logcat_parser *parser,
+                        const char *line, size_t len)
+{
+    regmatch_t matches[MESSAGE_NPARTS];
+    stats_add(&d->stats.lines, 1);
+    stats_add(&d->stats.bytes, len);
+    if (!logcat_parse_any(parser, &d->format, line, len, matches)) {
+        stats_add(&d->stats.unparsed, 1);
+        fprintf(stderr, "Received line that did not match pattern: %.*s.\n",
+                (int)len, line);
+        return;
+    }
+    len = strip_return(d, (char *)line, len, matches);
+
+    const struct tag *tag = tag_intern(&line[matches[TAG].rm_so],
+                                       matches[TAG].rm_eo - matches[TAG].rm_so);
+    if (!filter_accept(tag, line[matches[TAGTYPE].rm_so],
+                       &line[matches[MESSAGE].rm_so],
+                       matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so)
+        || !note_stamp(d, &line[matches[TIME].rm_so],
+                       matches[TIME].rm_eo - matches[TIME].rm_so)
+        || suppress(d, tag, line[matches[TAGTYPE].rm_so],
+                    &line[matches[MESSAGE].rm_so],
+                    matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so)) {
+        return;
+    }
+    if (device_coalesce_ms > 0) {
+        join_group(d, tag,
+                   parse_owner(&line[matches[OWNER].rm_so],
+                               matches[OWNER].rm_eo - matches[OWNER].rm_so));
+    }
+    if (output_format == OUTPUT_BINARY) {
+        push_parsed(d, d->in, line, matches, tag);
+    } else {
+        struct output_record rec;
+        format_line(d, d->in, &d->cols, line, matches, tag, &rec);
+        hand_line(d, &rec);
+    }
+    save_line(d, line, len, matches, tag);
+}
+
+/**
+ * Handle every complete line in the device's input buffer that has not been
+ * handled yet. Only lines longer than LINE_NCHARS_MAX are split.
+ */
+static void handle_lines(struct device *d, struct logcat_parser *parser)
+{
+    struct buffer *in = d->in;
+    while (d->pending < in->used) {
+        // Only what was read since the partial line was last scanned needs
+        // scanning.
+        const char *line = in->data + d->pending;
+        size_t avail = in->used - d->pending;
+        const char *newline = scan_chr(line + d->scanned, avail - d->scanned,
+                                       '\n');
+        size_t len;
+        if (newline != NULL) {
+            len = newline - line + 1;
+        } else if (avail >= LINE_NCHARS_MAX) {
+            len = LINE_NCHARS_MAX;
+        } else {
+            d->scanned = avail;
+            break;
+        }
+        d->scanned = 0;
+        handle_line(d, parser, line, len);
+        d->pending += len;
+    }
+}
+
+/**
+ * Hand the given finished line to the writer, or keep it when replaying, as of
+ * the time of the device's last line shown.
+ */
+static void hand_line(struct device *d, struct output_record *rec)
+{
+    rec->key = d->key;
+    rec->read_ns = d->read_ns;
+    if (d->replay) {
+        keep_line(d, rec);
+        return;
+    }
+    if (d->group.serial != 0) {
+        add_group(d, rec);
+        return;
+    }
+    buffer_ref(rec->bufs[0]);
+    buffer_ref(rec->bufs[1]);
+    if (output_policy != OUTPUT_BLOCK) {
+        mark_drops(d);
+    }
+    output_push(rec);
+}
+
+/**
+ * Open a group for the line of the given tag and process about to be written
+ * unless it continues the group already open, that is unless it was logged
+ * by the same process under the same tag within device_coalesce_ms of the
+ * first line of the group.
+ */
+static void join_group(struct device *d, const struct tag *tag, int32_t pid)
+{
+    if (output_format == OUTPUT_BINARY || d->replay) {
+        return;
+    }
+    if (d->group.serial == tag->serial && d->group.pid == pid
+        && d->key >= d->group.key
+        && d->key - d->group.key <= device_coalesce_ms) {
+        return;
+    }
+    end_group(d);
+    d->group.serial = tag->serial;
+    d->group.pid = pid;
+    d->group.key = d->key;
+}
+
+/**
+ * Copy the given line onto the end of the lines kept by the replay device.
+ */
+static void keep_line(struct device *d, const struct output_record *rec)
+{
+    size_t len = 0;
+    for (int i = 0; i < rec->niov; ++i) {
+        len += rec->iov[i].iov_len;
+    }
+    struct buffer *out = d->replayed_tail;
+    if (out == NULL || buffer_avail(out) < len) {
+        struct buffer *fresh = len <= BUFFER_NBYTES ? buffer_get()
+                                                    : buffer_get_large(len);
+        if (out != NULL) {
+            out->next = fresh;
+        } else {
+            d->replayed = fresh;
+        }
+        d->replayed_tail = out = fresh;
+    }
+    for (int i = 0; i < rec->niov; ++i) {
+        memcpy(out->data + out->used, rec->iov[i].iov_base,
+               rec->iov[i].iov_len);
+        out->used += rec->iov[i].iov_len;
+    }
+    // Nothing points into the copied columns any longer.
+    d->cols->used = 0;
+}
+
+/**
+ * Make room for at least len more bytes in the device's input buffer, carrying
+ * a partial line over into a fresh buffer when the current one is too full.
+ * A partial line that has outgrown the usual buffers is carried into one twice
+ * its size, so a long line is copied a bounded number of times per byte.
+ */
+static void make_room(struct device *d, size_t len)
+{
+    struct buffer *in = d->in;
+    if (in == NULL) {
+        d->in = len <= BUFFER_NBYTES ? buffer_get() : buffer_get_large(len);
+        d->pending = 0;
+        return;
+    }
+    if (buffer_avail(in) >= len) {
+        return;
+    }
+    size_t partial = in->used - d->pending;
+    struct buffer *fresh;
+    if (partial + len <= BUFFER_NBYTES) {
+        fresh = buffer_get();
+    } else {
+        fresh = buffer_get_large(2 * partial + len);
+    }
+    fresh->used = partial;
+    memcpy(fresh->data, in->data + d->pending, partial);
+    buffer_unref(in);
+    d->in = fresh;
+    d->pending = 0;
+}
+
+/**
+ * Mark the lines of the device dropped since it was last marked with a line of
+ * their own ahead of the next line. Lines are not marked within binary records.
+ */
+static void mark_drops(struct device *d)
+{
+    uint64_t dropped = output_drops_take(d->id);
+    if (dropped == 0) {
+        return;
+    }
+    stats_add(&d->stats.dropped, dropped);
+    push_notice(d, "dropped", dropped, " lines", NULL);
+}
+
+/**
+ * Mark the repeats of the device's last line that were collapsed and not
+ * marked yet, forgetting the line.
+ */
+static void mark_repeats(struct device *d)
+{
+    uint64_t repeats = limit_repeats_take(&d->limit);
+    if (repeats > 0) {
+        push_notice(d, "repeated", repeats, " times", NULL);
+    }
+}
+
+/**
+ * Note the time of a line about to be shown. Returns false if the line was
+ * already shown before the device went away and should be skipped; logcat -T
+ * starts at the time it is given, so lines at that very time come again.
+ */
+static bool note_stamp(struct device *d, const char *stamp, size_t len)
+{
+    if (len > sizeof(d->last.text)) {
+        return true;
+    }
+    if (d->resume.len > 0) {
+        int cmp = memcmp(stamp, d->resume.text,
+                         len < d->resume.len ? len : d->resume.len);
+        if (cmp < 0 || (cmp == 0 && d->resume.count > 0)) {
+            if (cmp == 0) {
+                --d->resume.count;
+            }
+            return false;
+        }
+        d->resume.len = 0;
+    }
+
+    if (len == d->last.len && memcmp(stamp, d->last.text, len) == 0) {
+        ++d->last.count;
+    } else {
+        memcpy(d->last.text, stamp, len);
+        d->last.len = len;
+        d->last.count = 1;
+        uint64_t key = d->format->decode_time(&d->clock, stamp, len);
+        if (key != 0) {
+            d->key = key;
+        }
+    }
+    return true;
+}
+
+/**
+ * Start archiving the output of the device when asked to. Failing to archive
+ * is reported but the device is still shown.
+ */
+static void open_raw(struct device *d)
+{
+    if (raw_dir == NULL) {
+        return;
+    }
+    int err = raw_open(&d->raw, d->name);
+    if (err) {
+        fprintf(stderr, "Failure to archive device %s: %s\n", d->name,
+                strerror(err));
+    }
+}
+
+/**
+ * Return the process identifier of the given owner of a line, as logcat pads
+ * it within the time format.
+ */
+static int32_t parse_owner(const char *owner, size_t len)
+{
+    size_t i = 0;
+    while (i < len && owner[i] == ' ') {
+        ++i;
+    }
+    bool negative = i < len && owner[i] == '-';
+    if (negative) {
+        ++i;
+    }
+    int32_t pid = 0;
+    for (; i < len && owner[i] >= '0' && owner[i] <= '9'; ++i) {
+        pid = pid * 10 + (owner[i] - '0');
+    }
+    return negative ? -pid : pid;
+}
+
+/**
+ * Return the thread identifier matched within the given line, or -1 when the
+ * format of the line shows no thread.
+ */
+static int64_t parse_thread(const char *line, const regmatch_t *match)
+{
+    if (match->rm_so < 0) {
+        return -1;
+    }
+    return parse_owner(&line[match->rm_so], match->rm_eo - match->rm_so);
+}
+
+/**
+ * Hand the lines coalesced so far to the writer as a single record. The group
+ * stays open for the lines that follow.
+ */
+static void push_group(struct device *d)
+{
+    struct buffer *lines = d->group.lines;
+    d->group.lines = NULL;
+    if (output_policy != OUTPUT_BLOCK) {
+        mark_drops(d);
+    }
+    struct output_record rec = {
+        .bufs = { lines, NULL },
+        .key = d->group.key,
+        .source = d->source,
+        .read_ns = d->group.read_ns,
+        .device = d->id,
+        .priority = d->group.priority,
+    };
+    output_add(&rec, lines->data, lines->used);
+    output_push(&rec);
+}
+
+/**
+ * Hand the writer a line of its own telling of the given count of the device's
+ * lines that are not shown, e.g. "dropped 12 lines", naming the tag they were
+ * of when there is one. Such lines are never dropped and are not written
+ * within binary records.
+ */
+static void push_notice(struct device *d, const char *what, uint64_t count,
+                        const char *unit, const struct tag *tag)
+{
+    if (output_format == OUTPUT_BINARY) {
+        return;
+    }
+    // Lines coalesced so far came first.
+    if (d->group.lines != NULL) {
+        push_group(d);
+    }
+    size_t tag_len = tag != NULL ? tag->len : 0;
+    reserve_copies(&d->cols, d->json_len + 6 * tag_len);
+    struct output_record rec = {
+        .bufs = { NULL, d->cols },
+        .key = d->key,
+        .source = d->source,
+        .read_ns = d->read_ns,
+        .device = d->id,
+    };
+    char number[24];
+    size_t number_len = render_number(number, count);
+    if (output_format == OUTPUT_JSONL) {
+        // The object names the device just as those of its lines do.
+        static const char time_key[] = "\"time\":\"";
+        add_copy(&rec, d->json, d->json_len - (sizeof(time_key) - 1));
+        output_add_literal(&rec, "\"");
+        output_add(&rec, what, strlen(what));
+        output_add_literal(&rec, "\":");
+        add_copy(&rec, number, number_len);
+        if (tag != NULL) {
+            output_add_literal(&rec, ",\"tag\":\"");
+            const char *special = json_special(tag->name, tag_len);
+            if (special != NULL) {
+                add_json(&rec, tag->name, tag_len, special);
+            } else {
+                add_copy(&rec, tag->name, tag_len);
+            }
+            output_add_literal(&rec, "\"");
+        }
+        output_add_literal(&rec, "}\n");
+    } else {
+        const struct style *style = styles[output_format];
+        add_column(&rec, &d->column, layout_get().device);
+        output_add(&rec, style->notice.text, style->notice.len);
+        output_add(&rec, what, strlen(what));
+        output_add_literal(&rec, " ");
+        add_copy(&rec, number, number_len);
+        output_add(&rec, unit, strlen(unit));
+        if (tag != NULL) {
+            output_add_literal(&rec, " of ");
+            add_copy(&rec, tag->name, tag_len);
+        }
+        output_add(&rec, style->notice_end.text, style->notice_end.len);
+    }
+    if (d->replay) {
+        keep_line(d, &rec);
+        return;
+    }
+    buffer_ref(d->cols);
+    output_push(&rec);
+}
+
+/**
+ * Hand the writer a binary record of the given parsed line of the device, read
+ * into the given buffer.
+ */
+static void push_parsed(struct device *d, struct buffer *in, const char *line,
+                        const regmatch_t *matches, const struct tag *tag)
+{
+    size_t msg_len = matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so;
+    const char *msg = &line[matches[MESSAGE].rm_so];
+    while (msg_len > 0 && msg[msg_len - 1] == '\n') {
+        --msg_len;
+    }
+    int64_t tid = parse_thread(line, &matches[THREAD]);
+    push_record(d, in, tag, &line[matches[TAG].rm_so],
+                matches[TAG].rm_eo - matches[TAG].rm_so,
+                line[matches[TAGTYPE].rm_so],
+                logcat_epoch_ms(&d->clock, d->key) * 1000000,
+                parse_owner(&line[matches[OWNER].rm_so],
+                            matches[OWNER].rm_eo - matches[OWNER].rm_so),
+                tid >= 0 ? tid : 0, msg, msg_len);
+}
+
+/**
+ * Hand the writer a binary record of a line with the given tag, read into the
+ * given buffer. The name of the tag, as read, goes along for the writer to
+ * name the tag with.
+ */
+static void push_record(struct device *d, struct buffer *in,
+                        const struct tag *tag, const char *name,
+                        size_t name_len, char tagtype, uint64_t nsec,
+                        int32_t pid, uint32_t tid, const char *msg,
+                        size_t len)
+{
+    reserve_copies(&d->cols, 0);
+    struct output_record rec = {
+        .bufs = { in, d->cols },
+        .key = d->key,
+        .source = d->source,
+        .read_ns = d->read_ns,
+        .serial = tag->serial,
+        .device = d->id,
+        .priority = tagtype,
+    };
+    uint8_t header[RECORD_LINE_NBYTES];
+    record_encode_line(header, d->id, tag->id, nsec, pid, tid, tagtype, len);
+    add_copy(&rec, (const char *)header, sizeof(header));
+    output_add(&rec, name, name_len);
+    output_add(&rec, msg, len);
+    buffer_ref(in);
+    buffer_ref(d->cols);
+    output_push(&rec);
+}
+
+/**
+ * Read whatever output of the device is available by way of its archive and,
+ * unless only archiving, handle every complete line within it. Returns false
+ * once the device's output has ended.
+ */
+static bool read_raw(struct device *d, struct logcat_parser *parser)
+{
+    ssize_t n = raw_pump(&d->raw, d->fd);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (n == 0) {
+        finish_lines(d, parser);
+        return false;
+    }
+    if (raw_only) {
+        return true;
+    }
+
+    // Take everything out of the pipe so that the next pump only archives what
+    // is new.
+    while (n > 0) {
+        make_room(d, d->binary ? LOGCAT_ENTRY_NBYTES_MAX : READ_NBYTES_MIN);
+        struct buffer *in = d->in;
+        size_t avail = buffer_avail(in);
+        ssize_t got = read(d->raw.pipe[0], in->data + in->used,
+                           (size_t)n < avail ? (size_t)n : avail);
+        if (got <= 0) {
+            return false;
+        }
+        in->used += got;
+        n -= got;
+        if (!handle_input(d, parser)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Release the buffers the given device holds, if any.
+ */
+static void release_buffers(struct device *d)
+{
+    struct buffer **bufs[] = { &d->in, &d->cols, &d->events };
+    for (size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]); ++i) {
+        if (*bufs[i] != NULL) {
+            buffer_unref(*bufs[i]);
+            *bufs[i] = NULL;
+        }
+    }
+    d->pending = 0;
+    d->scanned = 0;
+}
+
+/**
+ * Render the start of the JSON objects of the device's lines, which names the
+ * device.
+ */
+static void render_json(struct device *d)
+{
+    static const char head[] = "{\"device\":\"";
+    static const char tail[] = "\",\"time\":\"";
+    size_t len = strlen(d->name);
+    char *p = d->json;
+    memcpy(p, head, sizeof(head) - 1);
+    p += sizeof(head) - 1;
+    p += json_escape(p, d->name, len);
+    memcpy(p, tail, sizeof(tail) - 1);
+    p += sizeof(tail) - 1;
+    d->json_len = p - d->json;
+}
+
+/**
+ * Write the decimal digits of the given number to out. Returns the number of
+ * characters written.
+ */
+static size_t render_number(char *out, int64_t value)
+{
+    char digits[24];
+    size_t n = 0;
+    uint64_t v = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v > 0);
+    size_t len = 0;
+    if (value < 0) {
+        out[len++] = '-';
+    }
+    while (n > 0) {
+        out[len++] = digits[--n];
+    }
+    return len;
+}
+
+/**
+ * Make sure the given buffer of copied columns has room for everything a single
+ * line copies, along with the given number of characters more, replacing it
+ * with a fresh one otherwise.
+ */
+static void reserve_copies(struct buffer **cols, size_t len)
+{
+    len += LINE_COPIES_NCHARS;
+    if (*cols == NULL || buffer_avail(*cols) < len) {
+        if (*cols != NULL) {
+            buffer_unref(*cols);
+        }
+        *cols = len <= BUFFER_NBYTES ? buffer_get() : buffer_get_large(len);
+    }
+}
+
+/**
+ * Run job of the pool that parses, filters and formats the lines of a batch,
+ * then shows them once their turn comes.
+ */
+static void run_batch(struct pool_job *job)
+{
+    struct batch *b = (struct batch *)job;
+    struct logcat_parser *parser = get_parser();
+    atomic_uint_fast64_t *misses = &stats_thread()->tag_cache_misses;
+    uint64_t missed = atomic_load_explicit(misses, memory_order_relaxed);
+    b->tags = tag_read_hold();
+    b->cols = buffer_get();
+    buffer_ref(b->cols);
+    b->held = b->cols;
+
+    // Batches only hold complete lines. Every batch detects the format for
+    // itself rather than share whatever the device last detected.
+    const struct logcat_format *format = device_format;
+    const char *line = b->data;
+    size_t left = b->len;
+    while (left > 0) {
+        const char *newline = scan_chr(line, left, '\n');
+        size_t n = (size_t)(newline - line) + 1;
+        stage_line(b, parser, &format, line, n);
+        line += n;
+        left -= n;
+    }
+    b->misses = atomic_load_explicit(misses, memory_order_relaxed) - missed;
+    show_batch(b);
+}
+
+/**
+ * Archive the given parsed line of the device as it was read and keep it
+ * within the device's tail, which it may have snapshot.
+ */
+static void save_line(struct device *d, const char *line, size_t len,
+                      const regmatch_t *matches, const struct tag *tag)
+{
+    struct iovec parts[] = { { (char *)line, len }, { "\n", 1 } };
+    archive_add(&d->archive, d->key, tag->hash, parts,
+                line[len - 1] == '\n' ? 1 : 2);
+
+    if (d->tail != NULL) {
+        size_t msg_len = matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so;
+        const char *msg = &line[matches[MESSAGE].rm_so];
+        while (msg_len > 0 && msg[msg_len - 1] == '\n') {
+            --msg_len;
+        }
+        uint64_t ms = logcat_epoch_ms(&d->clock, d->key);
+        char tagtype = line[matches[TAGTYPE].rm_so];
+        tail_add(d->tail, ms,
+                 parse_owner(&line[matches[OWNER].rm_so],
+                             matches[OWNER].rm_eo - matches[OWNER].rm_so),
+                 parse_thread(line, &matches[THREAD]), tagtype,
+                 &line[matches[TAG].rm_so],
+                 matches[TAG].rm_eo - matches[TAG].rm_so, msg, msg_len);
+        if (snapshot_dir != NULL) {
+            snapshot_check(d->name, ms, tagtype, msg, msg_len);
+        }
+    }
+}
+
+/**
+ * Remember the time of the last lines shown for a device that is going away.
+ * A device that was resumed and showed nothing is forgotten instead, in case
+ * its logcat does not know -T. Must be called with device_map_lock held.
+ */
+static void save_resume(struct device *d)
+{
+    struct stamp *stamp = strmap_get(&resume_map, d->name);
+    if (d->last.len == 0) {
+        if (stamp != NULL) {
+            free(strmap_del(&resume_map, d->name, NULL));
+            free(stamp);
+        }
+        return;
+    }
+    if (stamp == NULL) {
+        stamp = malloc(sizeof(*stamp));
+        char *key = strdup(d->name);
+        assert(stamp != NULL && key != NULL);
+        strmap_add(&resume_map, key, stamp);
+    }
+    *stamp = d->last;
+}
+
+/**
+ * Set up the parser shared between the threads handling lines.
+ */
+static void set_up_parser(void)
+{
+    int err = logcat_parser_init(&shared_parser);
+    assert(!err);
+}
+
+/**
+ * Set up the eventfd that tells of shutdown.
+ */
+static void set_up_shutdown_fd(void)
+{
+    shutdown_fd = eventfd(0, EFD_CLOEXEC);
+    if (shutdown_fd < 0) {
+        fprintf(stderr, "Failure to create shutdown eventfd: %s\n",
+                strerror(errno));
+        abort();
+    }
+}
+
+/**
+ * Queue the given parsed batch to be shown after the batches of its device
+ * read before it, and show every batch whose turn has come unless another
+ * worker is already showing the device's batches.
+ */
+static void show_batch(struct batch *b)
+{
+    struct device *d = b->device;
+    pthread_mutex_lock(&d->stage_lock);
+    b->next = d->parsed;
+    d->parsed = b;
+    if (d->showing) {
+        pthread_mutex_unlock(&d->stage_lock);
+        return;
+    }
+    d->showing = true;
+    for (;;) {
+        struct batch **next = &d->parsed;
+        while (*next != NULL && (*next)->seq != d->shown) {
+            next = &(*next)->next;
+        }
+        if (*next == NULL) {
+            break;
+        }
+        b = *next;
+        *next = b->next;
+        pthread_mutex_unlock(&d->stage_lock);
+
+        show_lines(b);
+        free_batch(b);
+
+        pthread_mutex_lock(&d->stage_lock);
+        ++d->shown;
+        pthread_cond_broadcast(&d->stage_cond);
+    }
+    d->showing = false;
+    pthread_cond_broadcast(&d->stage_cond);
+    pthread_mutex_unlock(&d->stage_lock);
+}
+
+/**
+ * Show the lines of the given batch just as handle_line() would have, now that
+ * the batches of the device read before it were shown.
+ */
+static void show_lines(struct batch *b)
+{
+    struct device *d = b->device;
+    stats_add(&d->stats.lines, b->nread);
+    stats_add(&d->stats.bytes, b->len);
+    stats_add(&d->stats.unparsed, b->unparsed);
+    stats_add(&d->stats.tag_misses, b->misses);
+    d->read_ns = b->read_ns;
+    for (size_t i = 0; i < b->nlines; ++i) {
+        struct staged *s = &b->lines[i];
+        const char *line = s->line;
+        const regmatch_t *matches = s->matches;
+        d->format = s->format;
+        if (!note_stamp(d, &line[matches[TIME].rm_so],
+                        matches[TIME].rm_eo - matches[TIME].rm_so)
+            || suppress(d, s->tag, line[matches[TAGTYPE].rm_so],
+                        &line[matches[MESSAGE].rm_so],
+                        matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so)) {
+            continue;
+        }
+        if (device_coalesce_ms > 0) {
+            join_group(d, s->tag,
+                       parse_owner(&line[matches[OWNER].rm_so],
+                                   matches[OWNER].rm_eo
+                                       - matches[OWNER].rm_so));
+        }
+        if (output_format == OUTPUT_BINARY) {
+            push_parsed(d, b->in, line, matches, s->tag);
+        } else {
+            hand_line(d, &s->rec);
+        }
+        save_line(d, line, s->len, matches, s->tag);
+    }
+    // Lines are only coalesced with those read along with them.
+    end_group(d);
+}
+
+/**
+ * Return the number of characters the given record takes on the terminal so
+ * far, leaving out escape sequences.
+ */
+static size_t shown_width(const struct output_record *rec)
+{
+    size_t shown = 0;
+    for (int i = 0; i < rec->niov; ++i) {
+        const char *text = rec->iov[i].iov_base;
+        size_t len = rec->iov[i].iov_len;
+        for (size_t j = 0; j < len; ++j) {
+            if (text[j] == '\e') {
+                while (j < len && text[j] != 'm') {
+                    ++j;
+                }
+            } else if (((uint8_t)text[j] & 0xc0) != 0x80) {
+                ++shown;
+            }
+        }
+    }
+    return shown;
+}
+
+/**
+ * Parse the given line of the batch, which lives within the batch's input
+ * buffer, filter it and, unless it will be written as a binary record, format
+ * it. Only lines passing the filters are kept for their turn.
+ */
+static void stage_line(struct batch *b, struct logcat_parser *parser,
+                       const struct logcat_format **format, const char *line,
+                       size_t len)
+{
+    ++b->nread;
+    if (b->nlines == b->nslots) {
+        b->nslots = b->nslots > 0 ? 2 * b->nslots : b->len / 128 + 16;
+        b->lines = realloc(b->lines, b->nslots * sizeof(*b->lines));
+        if (b->lines == NULL) {
+            fprintf(stderr, "Failure to allocate staged lines.\n");
+            abort();
+        }
+    }
+    struct staged *s = &b->lines[b->nlines];
+    regmatch_t *matches = s->matches;
+    if (!logcat_parse_any(parser, format, line, len, matches)) {
+        ++b->unparsed;
+        fprintf(stderr, "Received line that did not match pattern: %.*s.\n",
+                (int)len, line);
+        return;
+    }
+    len = strip_return(b->device, (char *)line, len, matches);
+
+    const struct tag *tag = tag_intern(&line[matches[TAG].rm_so],
+                                       matches[TAG].rm_eo - matches[TAG].rm_so);
+    if (!filter_accept(tag, line[matches[TAGTYPE].rm_so],
+                       &line[matches[MESSAGE].rm_so],
+                       matches[MESSAGE].rm_eo - matches[MESSAGE].rm_so)) {
+        return;
+    }
+    s->line = line;
+    s->len = len;
+    s->format = *format;
+    s->tag = tag;
+    if (output_format != OUTPUT_BINARY) {
+        // Lines formatted earlier point into the buffer of copied columns
+        // that a fresh one replaces, so the batch holds on to every one.
+        struct buffer *cols = b->cols;
+        format_line(b->device, b->in, &b->cols, line, matches, tag, &s->rec);
+        if (b->cols != cols) {
+            buffer_ref(b->cols);
+            b->cols->next = b->held;
+            b->held = b->cols;
+        }
+    }
+    ++b->nlines;
+}
+
+/**
+ * Hand the complete lines of the device's input buffer not handled yet, read
+ * at the given time, to the pool as a batch. Few lines are left for the
+ * caller to handle unless batches of the device are in the pool, which they
+ * would overtake. Waits while the device has too many batches in the pool.
+ * Returns whether the lines were handed over, or there were none to hand over
+ * ahead of the batches in the pool.
+ */
+static bool stage_lines(struct device *d, uint64_t read_ns)
+{
+    unsigned nworkers = pool_workers();
+    if (nworkers == 0 || d->replay) {
+        return false;
+    }
+    // Only what was read since the partial line was last scanned needs
+    // scanning.
+    struct buffer *in = d->in;
+    const char *start = in->data + d->pending;
+    size_t avail = in->used - d->pending;
+    const char *last = memrchr(start + d->scanned, '\n', avail - d->scanned);
+    size_t len = last != NULL ? (size_t)(last - start) + 1 : 0;
+
+    pthread_mutex_lock(&d->stage_lock);
+    bool idle = d->shown == d->staged && !d->showing;
+    if (idle && len < STAGE_NBYTES_MIN) {
+        pthread_mutex_unlock(&d->stage_lock);
+        return false;
+    }
+    if (len == 0) {
+        pthread_mutex_unlock(&d->stage_lock);
+        // A line too long to wait on is split where it stands, once the
+        // batches ahead of it were shown.
+        if (avail >= LINE_NCHARS_MAX) {
+            wait_batches(d);
+            return false;
+        }
+        d->scanned = avail;
+        return true;
+    }
+    while (d->staged - d->shown >= STAGE_NBATCHES_PER_WORKER * nworkers) {
+        pthread_cond_wait(&d->stage_cond, &d->stage_lock);
+    }
+    uint64_t seq = d->staged++;
+    pthread_mutex_unlock(&d->stage_lock);
+
+    struct batch *b = calloc(1, sizeof(*b));
+    if (b == NULL) {
+        fprintf(stderr, "Failure to allocate batch.\n");
+        abort();
+    }
+    b->job.run = run_batch;
+    b->device = d;
+    b->in = in;
+    buffer_ref(in);
+    b->data = start;
+    b->len = len;
+    b->seq = seq;
+    b->read_ns = read_ns;
+    d->pending += len;
+    d->scanned = 0;
+    pool_submit(&b->job);
+    return true;
+}
+
+/**
+ * Start the adb client running the given command for the device, reading its
+ * output. The client gets the signals the threads of execution here block.
+ * Returns 0 on success or an error number on failure.
+ */
+static int start_client(struct device *d, const char *cmd)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return errno;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawnattr_init(&attr);
+    sigset_t none;
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    char shell_cmd[SHELL_NCHARS + 8];
+    snprintf(shell_cmd, sizeof(shell_cmd), "exec %s", cmd);
+    char *argv[] = { "sh", "-c", shell_cmd, NULL };
+    pid_t pid;
+    int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (err) {
+        close(fds[0]);
+        return err;
+    }
+    d->client = pid;
+    d->fd = fds[0];
+    return 0;
+}
+
+/**
+ * Start a line of output of the device, read into the given buffer, in the
+ * given record with the device's column, making sure the given buffer of
+ * copied columns has room for everything the line copies.
+ */
+static void start_line(const struct device *d, struct buffer *in,
+                       struct buffer **cols, struct output_record *rec)
+{
+    reserve_copies(cols, 0);
+
+    // Line of output assembled from fragments of the line read and of the
+    // columns copied for it.
+    *rec = (struct output_record){
+        .bufs = { in, *cols },
+        .source = d->source,
+        .device = d->id,
+    };
+
+    // Print device name.
+    add_column(rec, &d->column, layout_get().device);
+}
+
+/**
+ * Drop the carriage return ending the given line of the given device, read
+ * through a terminal, out of the line in place and out of its message among
+ * the given parts of the line. Returns the length of the line left.
+ */
+static size_t strip_return(const struct device *d, char *line, size_t len,
+                           regmatch_t *matches)
+{
+    regmatch_t *msg = &matches[MESSAGE];
+    if (d->tty && len >= 2 && line[len - 2] == '\r' && line[len - 1] == '\n'
+        && (size_t)msg->rm_eo == len && msg->rm_eo - msg->rm_so >= 2) {
+        line[len - 2] = '\n';
+        --msg->rm_eo;
+        --len;
+    }
+    return len;
+}
+
+/**
+ * Return whether the given line of the device is suppressed, marking the lines
+ * suppressed before it once it is not.
+ */
+static bool suppress(struct device *d, const struct tag *tag, char tagtype,
+                     const char *msg, size_t len)
+{
+    // Every line passing the filters counts toward the heaviest talkers,
+    // whether or not the limits suppress it.
+    top_add(&d->stats.top, tag, len - (len > 0 && msg[len - 1] == '\n'));
+
+    uint64_t count;
+    if (limit_collapse) {
+        if (limit_repeated(&d->limit, tag, tagtype, msg, len, &count)) {
+            stats_add(&d->stats.collapsed, 1);
+            return true;
+        }
+        if (count > 0) {
+            push_notice(d, "repeated", count, " times", NULL);
+        }
+    }
+    if (limit_rate > 0) {
+        if (limit_throttled(&d->limit, tag, d->key, &count)) {
+            stats_add(&d->stats.limited, 1);
+            return true;
+        }
+        if (count > 0) {
+            push_notice(d, "limited", count, " lines", tag);
+        }
+    }
+    return false;
+}
+
+/**
+ * Wait until every batch of the device handed to the pool was shown.
+ */
+static void wait_batches(struct device *d)
+{
+    pthread_mutex_lock(&d->stage_lock);
+    while (d->shown != d->staged || d->showing) {
+        pthread_cond_wait(&d->stage_cond, &d->stage_lock);
+    }
+    pthread_mutex_unlock(&d->stage_lock);
+}
+
+/**
+ * Wait for output of the device to read. Returns false once shutdown has been
+ * requested instead.
+ */
+static bool wait_input(struct device *d)
+{
+    if (d->raw.file >= 0) {
+        return true;
+    }
+    struct pollfd fds[2] = {
+        { .fd = d->fd, .events = POLLIN },
+        { .fd = device_shutdown_fd(), .events = POLLIN },
+    };
+    while (poll(fds, 2, -1) < 0) {
+        if (errno != EINTR) {
+            return true;
+        }
+    }
+    return !(fds[1].revents & POLLIN);
+}
@@ -0,0 +1,224 @@
+/** @file
+ * Android devices connected to the host and the logs they produce.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * A device is created for every serial number discovered and is destroyed once
+ * its logcat stream ends. Its logs are either read by a thread of its own or,
+ * in event loop mode, by one of a small number of loops shared between devices.
+ *
+ * Hundreds of devices may be read at once, so a device holds little while it
+ * is quiet. The device itself takes about 10 KiB, most of it the sketch of its
+ * heaviest talking tags, see top.h; the compiled parser is shared by every
+ * thread that handles lines; and a thread reading a device runs on a stack of
+ * 256 KiB rather than the default, of which only the pages touched are ever
+ * resident. The buffers lines are read into and columns copied into are taken
+ * from the pool with the device's first read and given back once the device
+ * has handled everything it read and is read no more often than once a
+ * second, so an idle device holds no buffer. Rings of the latest lines, see
+ * tail.h, and archives, see archive.h, are only held when asked for.
+ *
+ * Shutdown is told through an eventfd that stays readable once written, which
+ * every thread that would otherwise block waits on alongside whatever it waits
+ * for: a reading thread, an event loop, a device retrying logcat and the
+ * thread finding devices all stop at once. Devices close themselves as their
+ * readers stop, handing their last lines to the writer.
+ */
+#ifndef DEVICE_H_
+#define DEVICE_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "archive.h"
+#include "buffer.h"
+#include "color.h"
+#include "events.h"
+#include "limit.h"
+#include "logcat.h"
+#include "raw.h"
+#include "stats.h"
+#include "tail.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of characters allowed in Android device serial number. */
+#define SERIAL_NCHARS (128)
+
+/**
+ * Maximum number of characters of the start of the JSON objects of a device's
+ * lines, up to the time.
+ */
+#define DEVICE_JSON_NCHARS (6 * SERIAL_NCHARS + 32)
+
+/** Maximum number of characters of the time a line is shown with. */
+#define STAMP_NCHARS (32)
+
+/*******************************************************************************
+ * Types
+ */
+
+struct batch;
+
+/**
+ * Time of the lines last shown for a device.
+ */
+struct stamp {
+    char     text[STAMP_NCHARS]; //!< Time as shown, "MM-DD HH:MM:SS.mmm".
+    size_t   len;                //!< Number of characters, 0 when unset.
+    unsigned count;              //!< Number of lines shown with that time.
+};
+
+/**
+ * Second of the times of binary entries last rendered.
+ */
+struct second {
+    uint32_t sec;                //!< Seconds since the epoch.
+    char     text[STAMP_NCHARS]; //!< Second as shown, "MM-DD HH:MM:SS".
+    size_t   len;                //!< Number of characters, 0 when unset.
+};
+
+/**
+ * Lines of a device coalesced into a single record, such as those of a stack
+ * trace.
+ */
+struct group {
+    struct buffer *lines;    //!< Lines as written, NULL when none yet.
+    uint64_t       serial;   //!< Serial number of the tag of the lines, 0
+                             //!< when no group is open.
+    int32_t        pid;      //!< Process that logged the lines.
+    uint64_t       key;      //!< Time the first line was logged as a merge
+                             //!< key.
+    uint64_t       read_ns;  //!< Time the first line held was read.
+    char           priority; //!< Priority of the first line held.
+};
+
+/**
+ * Representation of an Android device connected to the host.
+ */
+struct device {
+    pthread_t           thread;              //!< Thread of execution.
+    char                name[SERIAL_NCHARS]; //!< Serial number of device.
+    pid_t               client;              //!< Running adb client or 0.
+    int                 fd;                  //!< Descriptor of logcat output.
+    bool                tty;                 //!< Whether its lines end with a
+                                             //!< carriage return as well.
+    struct raw          raw;                 //!< Archive of logcat output.
+    struct archive      archive;             //!< Compressed archive of lines.
+    struct tail        *tail;                //!< Ring of the latest lines,
+                                             //!< NULL when none are kept.
+    bool                binary;              //!< Whether output is entries.
+    const struct logcat_format *format;      //!< Format of its lines, as
+                                             //!< last detected.
+    enum color          color;               //!< Color of the device's name.
+    struct column       column;              //!< Rendered device name column.
+    char                json[DEVICE_JSON_NCHARS]; //!< Start of JSON objects.
+    size_t              json_len;            //!< Characters of that start.
+    struct buffer      *in;                  //!< Buffer holding lines read,
+                                             //!< NULL while idle.
+    size_t              pending;             //!< Offset of the unhandled bytes.
+    size_t              scanned;             //!< Bytes of the partial line
+                                             //!< known to hold no newline.
+    struct buffer      *cols;                //!< Buffer holding copied
+                                             //!< columns, NULL while idle.
+    struct buffer      *events;              //!< Buffer holding decoded
+                                             //!< events, NULL until one is.
+    const struct events_tags *event_tags;    //!< Names of its events, NULL
+                                             //!< when unknown.
+    struct device      *next;                //!< Next device waiting on a loop.
+    struct stamp        last;                //!< Time of the last line shown.
+    struct stamp        resume;              //!< Time lines were last shown
+                                             //!< before reconnecting.
+    struct second       second;              //!< Second of the last entry.
+    struct logcat_clock clock;               //!< Decoder of the times of lines.
+    uint64_t            key;                 //!< Time of the last line shown
+                                             //!< as a merge key.
+    uint32_t            source;              //!< Source lines are pushed with.
+    uint32_t            id;                  //!< Identifier of the device
+                                             //!< within binary records.
+    struct stats_device stats;               //!< Counters of the device.
+    struct limit        limit;               //!< Suppression of its lines.
+    struct group        group;               //!< Lines being coalesced.
+    uint64_t            read_ns;             //!< Time the input being handled
+                                             //!< was read.
+    uint64_t            input_ns;            //!< Time input was last handled.
+    bool                replay;              //!< Whether lines are kept for
+                                             //!< a replay instead of pushed.
+    struct buffer      *replayed;            //!< Lines kept, oldest first.
+    struct buffer      *replayed_tail;       //!< Buffer lines are kept in.
+    struct batch       *parsed;              //!< Batches parsed ahead of
+                                             //!< their turn.
+    uint64_t            staged;              //!< Batches handed to the pool.
+    uint64_t            shown;               //!< Batches shown.
+    bool                showing;             //!< Whether a worker is showing
+                                             //!< batches.
+    pthread_mutex_t     stage_lock;          //!< Lock used to protect the
+                                             //!< above.
+    pthread_cond_t      stage_cond;          //!< Condition signalled when a
+                                             //!< batch was shown.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern bool device_binary;
+extern unsigned device_buffers;
+extern unsigned device_coalesce_ms;
+extern const struct logcat_format *device_format;
+extern atomic_bool shutdown_requested;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void device_close(struct device *d);
+void device_close_all(void);
+int device_count(void);
+bool device_known(const char *name);
+void device_map_clear(void);
+struct device *device_new(const char *name);
+bool device_feed(struct device *d, struct logcat_parser *parser,
+                 const char *data, size_t len);
+int device_open(struct device *d);
+bool device_read(struct device *d, struct logcat_parser *parser);
+struct buffer *device_replay(struct device *d, struct logcat_parser *parser,
+                             const char *data, size_t len);
+void device_replay_free(struct device *d);
+struct device *device_replay_new(const char *name, enum color color);
+void *device_run(void *device);
+void device_shutdown(void);
+int device_shutdown_fd(void);
+int device_spawn(struct device *d, void *(*run)(void *));
+void device_wait_closed(void);
+void device_worker_leave(void);
+
+#endif
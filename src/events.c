@@ -0,0 +1,529 @@
+/** @file
+ * Decoder of binary events and the dictionaries naming their tags.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * A dictionary is read from the event-log-tags file of the system, each line of
+ * which names a tag number, "NUMBER NAME (FIELDS)"; the fields are only of use
+ * to descriptive output and are ignored, as are comments. The build a device
+ * runs is told by its fingerprint, read with getprop when the device connects.
+ * Both are run over adb just as logcat is, through the adb client when there is
+ * no server.
+ *
+ * Values are written little endian, each led by a byte of its type. Lists hold
+ * a count byte followed by that many values, nested at most a few deep; they
+ * are shown within brackets, their values separated by commas. A value cut
+ * short ends the text decoded so far rather than losing the whole event.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "events.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ccan/strmap/strmap.h>
+
+#include "adb.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Command printing the fingerprint of the build a device runs. */
+#define FINGERPRINT_COMMAND "getprop ro.build.fingerprint"
+
+/** Command printing the dictionary of event tags of a device. */
+#define TAGS_COMMAND "cat /system/etc/event-log-tags"
+
+/** Maximum number of characters of a command run through the adb client. */
+#define SHELL_NCHARS (1024)
+
+/** Number of bytes output of a command is first read into. */
+#define OUTPUT_NBYTES_MIN (4096)
+
+/** Minimum number of slots of a dictionary; must be a power of two. */
+#define NSLOTS_MIN (16)
+
+/** Maximum depth lists are nested within one another. */
+#define LIST_DEPTH_MAX (8)
+
+/** Maximum number of characters of a rendered float. */
+#define FLOAT_NCHARS (64)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Types of the values of events, as liblog numbers them.
+ */
+enum event_type {
+    EVENT_INT = 0, //!< 32 bit signed integer.
+    EVENT_LONG,    //!< 64 bit signed integer.
+    EVENT_STRING,  //!< 32 bit length followed by the bytes of a string.
+    EVENT_LIST,    //!< Count byte followed by the values of a list.
+    EVENT_FLOAT,   //!< 32 bit float.
+};
+
+/**
+ * Name of a tag number within a dictionary.
+ */
+struct events_tag {
+    const char *name;   //!< Name of the tag, NULL for an empty slot.
+    uint32_t    len;    //!< Number of characters of the name.
+    uint32_t    number; //!< Number of the tag.
+};
+
+/**
+ * Dictionary of the event tags of a build.
+ */
+struct events_tags {
+    char              *build;  //!< Fingerprint of the build, the cache key.
+    char              *text;   //!< Text of the dictionary the names point in.
+    struct events_tag *slots;  //!< Table of the names.
+    uint32_t           mask;   //!< Number of slots less one.
+    unsigned           shift;  //!< Shift of a hashed number to its slot.
+};
+
+/**
+ * Text being decoded, cut short once it fills its room.
+ */
+struct text {
+    char  *data; //!< Characters decoded.
+    size_t len;  //!< Number of characters decoded.
+    size_t n;    //!< Room for characters.
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Dictionaries loaded, keyed by the fingerprint of their build. */
+static struct { STRMAP_MEMBERS(struct events_tags *); } cache;
+
+/** Lock protecting the cache, held while a dictionary is loaded. */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void append(struct text *t, const char *s, size_t len);
+static void append_number(struct text *t, int64_t value);
+static bool decode_value(const char **at, const char *end, struct text *out,
+                         unsigned depth);
+static const struct events_tag *find_tag(const struct events_tags *tags,
+                                         uint32_t number);
+static bool handle_free_tags(const char *build, struct events_tags *tags,
+                             void *unused);
+static struct events_tags *parse_tags(char *text, size_t len);
+static char *run_command(const char *serial, const char *command,
+                         size_t *len);
+static uint32_t slot_of(const struct events_tags *tags, uint32_t number);
+
+/******************************************************************************/
+
+/**
+ * Free every dictionary loaded.
+ */
+void events_clear(void)
+{
+    pthread_mutex_lock(&cache_lock);
+    strmap_iterate(&cache, handle_free_tags, NULL);
+    strmap_clear(&cache);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * Decode the event that is the message of the given entry of a binary buffer,
+ * naming its tag from the given dictionary, or by number when NULL. The tag and
+ * message of the entry are pointed at the text decoded into out, so that they
+ * live as long as the lines pointing into it. Returns the number of bytes of
+ * out used.
+ */
+size_t events_decode(const struct events_tags *tags,
+                     struct logcat_entry *entry, char *out, size_t n)
+{
+    const char *p = entry->msg;
+    const char *end = p + entry->msg_len;
+    struct text text = { out, 0, n };
+    uint32_t number = 0;
+    if (end - p >= (ptrdiff_t)sizeof(number)) {
+        memcpy(&number, p, sizeof(number));
+        p += sizeof(number);
+    } else {
+        p = end;
+    }
+
+    const struct events_tag *found = tags != NULL ? find_tag(tags, number)
+                                                  : NULL;
+    if (found != NULL) {
+        append(&text, found->name, found->len);
+    } else {
+        append_number(&text, number);
+    }
+    entry->tag = out;
+    entry->tag_len = text.len;
+
+    size_t start = text.len;
+    if (p < end) {
+        decode_value(&p, end, &text, 0);
+    }
+    entry->msg = out + start;
+    entry->msg_len = text.len - start;
+    return text.len;
+}
+
+/**
+ * Get the dictionary of event tags of the device with the given serial number,
+ * loading it unless a device of the same build already did. Returns NULL if
+ * the dictionary could not be read.
+ */
+const struct events_tags *events_tags_get(const char *serial)
+{
+    // Builds without a fingerprint are only known by their device.
+    size_t len;
+    char *build = run_command(serial, FINGERPRINT_COMMAND, &len);
+    while (build != NULL && len > 0
+           && (build[len - 1] == '\n' || build[len - 1] == '\r'
+               || build[len - 1] == ' ')) {
+        build[--len] = '\0';
+    }
+    if (build == NULL || len == 0) {
+        free(build);
+        size_t n = strlen(serial) + sizeof("device ");
+        build = (char *)malloc(n);
+        if (build == NULL) {
+            fprintf(stderr, "Failure to allocate build fingerprint.\n");
+            abort();
+        }
+        snprintf(build, n, "device %s", serial);
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    struct events_tags *tags = strmap_get(&cache, build);
+    if (tags == NULL) {
+        size_t text_len;
+        char *text = run_command(serial, TAGS_COMMAND, &text_len);
+        if (text != NULL && text_len > 0) {
+            tags = parse_tags(text, text_len);
+            tags->build = build;
+            strmap_add(&cache, tags->build, tags);
+            build = NULL;
+        } else {
+            free(text);
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    free(build);
+
+    if (tags == NULL) {
+        fprintf(stderr, "Failure to read the event tags of device: %s\n",
+                serial);
+    }
+    return tags;
+}
+
+/**
+ * Append the given characters to the given text, as many as there is room for.
+ */
+static void append(struct text *t, const char *s, size_t len)
+{
+    if (len > t->n - t->len) {
+        len = t->n - t->len;
+    }
+    memcpy(t->data + t->len, s, len);
+    t->len += len;
+}
+
+/**
+ * Append the given value in decimal to the given text.
+ */
+static void append_number(struct text *t, int64_t value)
+{
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    uint64_t left = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    do {
+        *--p = '0' + left % 10;
+        left /= 10;
+    } while (left > 0);
+    if (value < 0) {
+        *--p = '-';
+    }
+    append(t, p, digits + sizeof(digits) - p);
+}
+
+/**
+ * Decode the value at the given position, before the given end, into the given
+ * text, moving the position past it. Returns false if the value is cut short or
+ * malformed, leaving what was decoded of it.
+ */
+static bool decode_value(const char **at, const char *end, struct text *out,
+                         unsigned depth)
+{
+    const char *p = *at;
+    if (p == end) {
+        return false;
+    }
+    uint8_t type = *p++;
+    switch (type) {
+    case EVENT_INT: {
+        int32_t value;
+        if (end - p < (ptrdiff_t)sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        append_number(out, value);
+        break;
+    }
+    case EVENT_LONG: {
+        int64_t value;
+        if (end - p < (ptrdiff_t)sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        append_number(out, value);
+        break;
+    }
+    case EVENT_FLOAT: {
+        float value;
+        if (end - p < (ptrdiff_t)sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        char s[FLOAT_NCHARS];
+        int n = snprintf(s, sizeof(s), "%f", value);
+        append(out, s, n > 0 && n < FLOAT_NCHARS ? n : 0);
+        break;
+    }
+    case EVENT_STRING: {
+        int32_t len;
+        if (end - p < (ptrdiff_t)sizeof(len)) {
+            return false;
+        }
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        if (len < 0 || len > end - p) {
+            append(out, p, end - p);
+            return false;
+        }
+        append(out, p, len);
+        p += len;
+        break;
+    }
+    case EVENT_LIST: {
+        if (p == end || depth == LIST_DEPTH_MAX) {
+            return false;
+        }
+        uint8_t count = *p++;
+        append(out, "[", 1);
+        for (unsigned i = 0; i < count; ++i) {
+            if (i > 0) {
+                append(out, ",", 1);
+            }
+            if (!decode_value(&p, end, out, depth + 1)) {
+                return false;
+            }
+        }
+        append(out, "]", 1);
+        break;
+    }
+    default:
+        return false;
+    }
+    *at = p;
+    return true;
+}
+
+/**
+ * Find the name of the given tag number within the given dictionary. Returns
+ * NULL if the dictionary does not name it.
+ */
+static const struct events_tag *find_tag(const struct events_tags *tags,
+                                         uint32_t number)
+{
+    for (uint32_t i = slot_of(tags, number);; i = (i + 1) & tags->mask) {
+        const struct events_tag *slot = &tags->slots[i];
+        if (slot->name == NULL) {
+            return NULL;
+        }
+        if (slot->number == number) {
+            return slot;
+        }
+    }
+}
+
+/**
+ * Handler that frees a dictionary of the cache.
+ */
+static bool handle_free_tags(const char *build, struct events_tags *tags,
+                             void *unused)
+{
+    free(tags->build);
+    free(tags->text);
+    free(tags->slots);
+    free(tags);
+    return true;
+}
+
+/**
+ * Parse the given text of an event-log-tags file, of the given length, into a
+ * dictionary that takes ownership of the text.
+ */
+static struct events_tags *parse_tags(char *text, size_t len)
+{
+    // Every line may name a tag, and slots are kept at most half full.
+    size_t nlines = 1;
+    for (const char *p = text; (p = memchr(p, '\n', text + len - p)) != NULL;
+         ++p) {
+        ++nlines;
+    }
+    size_t nslots = NSLOTS_MIN;
+    unsigned bits = __builtin_ctz(NSLOTS_MIN);
+    while (nslots < nlines * 2) {
+        nslots *= 2;
+        ++bits;
+    }
+    struct events_tags *tags = (struct events_tags *)calloc(1, sizeof(*tags));
+    struct events_tag *slots = (struct events_tag *)calloc(nslots,
+                                                           sizeof(*slots));
+    if (tags == NULL || slots == NULL) {
+        fprintf(stderr, "Failure to allocate event tags.\n");
+        abort();
+    }
+    tags->text = text;
+    tags->slots = slots;
+    tags->mask = nslots - 1;
+    tags->shift = 32 - bits;
+
+    const char *end = text + len;
+    for (const char *p = text; p < end;) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            eol = end;
+        }
+        while (p < eol && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+        uint32_t number = 0;
+        const char *digits = p;
+        while (p < eol && *p >= '0' && *p <= '9') {
+            number = number * 10 + (*p++ - '0');
+        }
+        const char *name = p;
+        if (p > digits && p < eol && (*p == ' ' || *p == '\t')) {
+            while (name < eol && (*name == ' ' || *name == '\t')) {
+                ++name;
+            }
+            p = name;
+            while (p < eol && *p != ' ' && *p != '\t' && *p != '\r') {
+                ++p;
+            }
+        }
+        if (p > name && find_tag(tags, number) == NULL) {
+            uint32_t i = slot_of(tags, number);
+            while (slots[i].name != NULL) {
+                i = (i + 1) & tags->mask;
+            }
+            slots[i] = (struct events_tag){ name, p - name, number };
+        }
+        p = eol + 1;
+    }
+    return tags;
+}
+
+/**
+ * Run the given command on the device with the given serial number and read
+ * all of its output, setting len to its length. Returns the output, NUL
+ * terminated, which the caller frees, or NULL if the command could not be run.
+ */
+static char *run_command(const char *serial, const char *command,
+                         size_t *len)
+{
+    // Without a server the adb client runs the command instead.
+    FILE *fh = NULL;
+    int fd = adb_open_command(serial, command, NULL);
+    if (fd < 0 && errno != EPROTO) {
+        char cmd[SHELL_NCHARS];
+        snprintf(cmd, sizeof(cmd), "adb -s %s shell %s 2>/dev/null", serial,
+                 command);
+        fh = popen(cmd, "r");
+        if (fh != NULL) {
+            fd = fileno(fh);
+        }
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+
+    size_t size = OUTPUT_NBYTES_MIN;
+    size_t n = 0;
+    char *out = (char *)malloc(size);
+    for (;;) {
+        if (out == NULL) {
+            fprintf(stderr, "Failure to allocate command output.\n");
+            abort();
+        }
+        if (size - n == 1) {
+            size *= 2;
+            out = (char *)realloc(out, size);
+            continue;
+        }
+        ssize_t got = read(fd, out + n, size - n - 1);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        n += got;
+    }
+    out[n] = '\0';
+    if (fh != NULL) {
+        pclose(fh);
+    } else {
+        close(fd);
+    }
+    *len = n;
+    return out;
+}
+
+/**
+ * Find the slot the given tag number is first looked for in.
+ */
+static uint32_t slot_of(const struct events_tags *tags, uint32_t number)
+{
+    return (number * 0x9e3779b1u) >> tags->shift;
+}
@@ -0,0 +1,70 @@
+/** @file
+ * Decoder of binary events and the dictionaries naming their tags.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Entries of the events, stats and security buffers are not text but a tag
+ * number followed by a typed value: an int, a long, a float, a string or a list
+ * of further values. They are decoded into the text logcat shows for them, with
+ * the tag number replaced by its name from the device's event-log-tags file.
+ *
+ * Dictionaries are loaded once per build of the system, which fixes the tags a
+ * device knows, and shared by every device running that build. Each is a table
+ * of open addressing indexed by tag number, so that naming an event costs a
+ * multiplication and a probe or two.
+ */
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+
+#include "logcat.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/**
+ * Maximum number of bytes of the text an event is decoded into; text beyond
+ * is cut short.
+ */
+#define EVENTS_TEXT_NBYTES_MAX (4 * LOGCAT_ENTRY_NBYTES_MAX)
+
+/*******************************************************************************
+ * Types
+ */
+
+struct events_tags;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void events_clear(void);
+size_t events_decode(const struct events_tags *tags,
+                     struct logcat_entry *entry, char *out, size_t n);
+const struct events_tags *events_tags_get(const char *serial);
+
+#endif
@@ -0,0 +1,577 @@
+/** @file
+ * Filters deciding which log lines are shown.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Filter specs behave as they do for logcat: a line is shown when its priority
+ * is at least the one given for its tag by the last spec naming the tag, or by
+ * the last "*" spec when none does. Without a "*" spec every priority is shown.
+ * A spec whose tag ends in "*", such as "com.ourapp.*:I", names every tag
+ * starting with the rest; a tag named by no spec of its own takes the longest
+ * such prefix it starts with.
+ *
+ * Prefixes are held by a critbit tree and looked up by each leading part of a
+ * tag. That only happens once per tag, when it is interned, see tag.h; the
+ * lowest priority shown is kept on the tag, so specs cost a comparison per
+ * line however many there are.
+ *
+ * The specs are pushed down to logcat as a whole or not at all, since logcat
+ * applies its own default to every tag the specs do not name. Specs whose tag
+ * would need quoting on the device's shell command line, and prefixes, which
+ * logcat knows nothing of, are kept local.
+ *
+ * glibc serializes regexec() calls sharing a compiled expression, so every
+ * thread compiles the message expression for itself the first time it is used.
+ *
+ * The specs and the expression make up a set of filters published through an
+ * atomic pointer. Filters are set up before any device is read, and may be
+ * replaced while devices are read by building a new set and swapping it in.
+ * Each set carries a generation; a tag remembers the generation of the set its
+ * level was found by, and a thread the generation of the expression it
+ * compiled, so both are brought up to date by the first line that sees a new
+ * set. Sets replaced are kept until filter_clear(), as the tag map keeps its
+ * tables, since a device may still be reading them; they are only replaced by
+ * hand.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "filter.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <regex.h>
+
+#include <ccan/strmap/strmap.h>
+
+#include "grep.h"
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of filter specs. */
+#define RULES_NMAX (256)
+
+/** Maximum number of characters of the tag of a filter spec. */
+#define RULE_TAG_NCHARS (64)
+
+/** Maximum number of characters of the filter specs pushed down to logcat. */
+#define PUSHDOWN_NCHARS (512)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Single TAG:PRIORITY filter spec.
+ */
+struct rule {
+    char   tag[RULE_TAG_NCHARS]; //!< Tag or prefix the spec applies to.
+    size_t len;                  //!< Length of the tag.
+    int    level;                //!< Lowest priority level shown.
+    bool   prefix;               //!< Whether it applies to every tag
+                                 //!< starting with the tag.
+};
+
+/**
+ * Specs applying to tags by prefix, keyed by the prefix.
+ */
+struct rule_map {
+    STRMAP_MEMBERS(struct rule *);
+};
+
+/**
+ * Set of filters lines are checked against.
+ */
+struct filters {
+    unsigned         generation;               //!< Number of sets before it.
+    struct rule      rules[RULES_NMAX];        //!< Specs in the order given.
+    size_t           rules_n;                  //!< Number of specs.
+    int              default_level;            //!< Lowest priority level shown
+                                               //!< for tags no spec names.
+    struct rule_map  prefixes;                 //!< Specs applying by prefix,
+                                               //!< last given wins.
+    size_t           prefix_max_len;           //!< Length of the longest
+                                               //!< prefix among the specs.
+    char            *match_pattern;            //!< Expression messages must
+                                               //!< match, NULL for any.
+    bool             pushed;                   //!< Whether the specs have
+                                               //!< been pushed down to logcat.
+    char             pushdown[PUSHDOWN_NCHARS]; //!< Specs in the form handed
+                                                //!< to logcat.
+    struct filters  *retired;                  //!< Set replaced before it.
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Set of filters given on the command line. */
+static struct filters initial;
+
+/** Set of filters lines are currently checked against. */
+static _Atomic(struct filters *) current = &initial;
+
+/** Message expression compiled by the calling thread. */
+static __thread regex_t local_match;
+
+/** Generation of the set local_match was compiled for. */
+static __thread unsigned local_match_generation;
+
+/** Whether the calling thread has compiled local_match. */
+static __thread bool local_match_ready;
+
+/** Lock used to serialize the replacement of the set of filters. */
+static pthread_mutex_t replace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Sets replaced, most recently replaced first. */
+static struct filters *retired;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static int add_rule(struct filters *f, const char *tag, size_t len,
+                    int level);
+static int add_specs(struct filters *f, const char *specs);
+static void build_pushdown(struct filters *f);
+static void clear_filters(struct filters *f);
+static int find_level(const struct filters *f, const char *name, size_t len);
+static int level_of(char tagtype);
+static struct filters *new_filters(void);
+static bool pushable(const char *tag, size_t len);
+static void publish(struct filters *f);
+
+/******************************************************************************/
+
+/**
+ * Return whether a line with the given tag, tag type letter and message is to
+ * be shown.
+ */
+bool filter_accept(const struct tag *tag, char tagtype, const char *msg,
+                   size_t msg_len)
+{
+    const struct filters *f = atomic_load_explicit(&current,
+                                                   memory_order_acquire);
+    unsigned level = atomic_load_explicit(&tag->level, memory_order_relaxed);
+    if (level >> FILTER_LEVEL_BITS != f->generation) {
+        // What the specs say of a tag is a cache the filters keep on it.
+        level = (f->generation << FILTER_LEVEL_BITS)
+                | find_level(f, tag->name, tag->len);
+        atomic_store_explicit(&((struct tag *)tag)->level, level,
+                              memory_order_relaxed);
+    }
+    if (level_of(tagtype) < (int)(level & FILTER_LEVEL_MASK)) {
+        return false;
+    }
+
+    if (grep_count() > 0 && !grep_match(msg, msg_len)) {
+        return false;
+    }
+
+    if (f->match_pattern != NULL) {
+        if (!local_match_ready || local_match_generation != f->generation) {
+            filter_thread_free();
+            int err = regcomp(&local_match, f->match_pattern,
+                              REG_EXTENDED | REG_NOSUB);
+            assert(!err);
+            local_match_generation = f->generation;
+            local_match_ready = true;
+        }
+        regmatch_t span = { 0, msg_len };
+        if (regexec(&local_match, msg, 1, &span, REG_STARTEND) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Add the given whitespace separated TAG:PRIORITY filter specs. Returns 0 on
+ * success or -1 if a spec is invalid. Must only be called before any device is
+ * read.
+ */
+int filter_add(const char *specs)
+{
+    struct filters *f = atomic_load_explicit(&current, memory_order_relaxed);
+    int err = add_specs(f, specs);
+    build_pushdown(f);
+    return err;
+}
+
+/**
+ * Remove every filter, along with every set of filters replaced.
+ */
+void filter_clear(void)
+{
+    filter_thread_free();
+    struct filters *f = atomic_exchange(&current, &initial);
+    if (f != &initial) {
+        f->retired = retired;
+        retired = f;
+    }
+    while (retired != NULL) {
+        f = retired;
+        retired = f->retired;
+        if (f != &initial) {
+            clear_filters(f);
+            free(f);
+        }
+    }
+    clear_filters(&initial);
+}
+
+/**
+ * Apply every filter spec locally rather than pushing any down to logcat.
+ */
+void filter_keep_local(void)
+{
+    struct filters *f = atomic_load_explicit(&current, memory_order_relaxed);
+    f->pushed = false;
+    f->pushdown[0] = '\0';
+}
+
+/**
+ * Return what the filter specs say of the tag of the given name, as kept by
+ * the tag: the lowest priority level shown, or 0 when lines of every priority
+ * are, within the low FILTER_LEVEL_BITS and the generation of the specs above
+ * them. The name does not need to be NUL terminated.
+ */
+unsigned filter_level(const char *name, size_t len)
+{
+    const struct filters *f = atomic_load_explicit(&current,
+                                                   memory_order_acquire);
+    return (f->generation << FILTER_LEVEL_BITS) | find_level(f, name, len);
+}
+
+/**
+ * Return the arguments that have logcat filter lines itself, which may be
+ * empty. They start with a space when they are not.
+ */
+const char *filter_pushdown(void)
+{
+    return atomic_load_explicit(&current, memory_order_acquire)->pushdown;
+}
+
+/**
+ * Replace the expression messages must match while devices are read, NULL or
+ * empty to show any message. The specs stay as they are. Returns 0 on success
+ * or the error code of regcomp() if the expression is invalid.
+ */
+int filter_replace_match(const char *pattern)
+{
+    if (pattern != NULL && *pattern != '\0') {
+        regex_t preg;
+        int err = regcomp(&preg, pattern, REG_EXTENDED | REG_NOSUB);
+        if (err) {
+            return err;
+        }
+        regfree(&preg);
+    }
+
+    pthread_mutex_lock(&replace_lock);
+    const struct filters *old = atomic_load_explicit(&current,
+                                                     memory_order_relaxed);
+    struct filters *f = new_filters();
+    memcpy(f->rules, old->rules, sizeof(old->rules[0]) * old->rules_n);
+    f->rules_n = old->rules_n;
+    f->default_level = old->default_level;
+    f->prefix_max_len = old->prefix_max_len;
+    for (size_t i = 0; i < f->rules_n; ++i) {
+        struct rule *rule = &f->rules[i];
+        if (rule->prefix) {
+            strmap_del(&f->prefixes, rule->tag, NULL);
+            strmap_add(&f->prefixes, rule->tag, rule);
+        }
+    }
+    if (pattern != NULL && *pattern != '\0') {
+        f->match_pattern = strdup(pattern);
+        assert(f->match_pattern != NULL);
+    }
+    publish(f);
+    pthread_mutex_unlock(&replace_lock);
+    return 0;
+}
+
+/**
+ * Replace every filter spec with the given whitespace separated TAG:PRIORITY
+ * filter specs, which may be empty, while devices are read. The expression
+ * messages must match stays as it is. Returns 0 on success or -1 if a spec is
+ * invalid, leaving the specs as they were.
+ */
+int filter_replace_specs(const char *specs)
+{
+    struct filters *f = new_filters();
+    if (add_specs(f, specs) != 0) {
+        clear_filters(f);
+        free(f);
+        return -1;
+    }
+
+    pthread_mutex_lock(&replace_lock);
+    const struct filters *old = atomic_load_explicit(&current,
+                                                     memory_order_relaxed);
+    if (old->match_pattern != NULL) {
+        f->match_pattern = strdup(old->match_pattern);
+        assert(f->match_pattern != NULL);
+    }
+    publish(f);
+    pthread_mutex_unlock(&replace_lock);
+    return 0;
+}
+
+/**
+ * Only show lines whose message matches the given extended regular expression.
+ * Returns 0 on success or the error code of regcomp() if the expression is
+ * invalid. Must only be called before any device is read.
+ */
+int filter_set_match(const char *pattern)
+{
+    regex_t preg;
+    int err = regcomp(&preg, pattern, REG_EXTENDED | REG_NOSUB);
+    if (err) {
+        return err;
+    }
+    regfree(&preg);
+    struct filters *f = atomic_load_explicit(&current, memory_order_relaxed);
+    free(f->match_pattern);
+    f->match_pattern = strdup(pattern);
+    assert(f->match_pattern != NULL);
+    return 0;
+}
+
+/**
+ * Release what the calling thread compiled for filtering.
+ */
+void filter_thread_free(void)
+{
+    if (local_match_ready) {
+        regfree(&local_match);
+        local_match_ready = false;
+    }
+}
+
+/**
+ * Add a spec for the given tag, which names every tag starting with the rest
+ * when it ends in "*", to the given set of filters. Returns 0 on success or -1
+ * if the spec is invalid or the set holds too many.
+ */
+static int add_rule(struct filters *f, const char *tag, size_t len, int level)
+{
+    if (len == 0 || len >= RULE_TAG_NCHARS || level == 0
+        || f->rules_n == RULES_NMAX) {
+        return -1;
+    }
+
+    if (len == 1 && *tag == '*') {
+        f->default_level = level;
+    }
+    struct rule *rule = &f->rules[f->rules_n++];
+    rule->prefix = len > 1 && tag[len - 1] == '*';
+    rule->len = rule->prefix ? len - 1 : len;
+    memcpy(rule->tag, tag, rule->len);
+    rule->tag[rule->len] = '\0';
+    rule->level = level;
+    if (rule->prefix) {
+        strmap_del(&f->prefixes, rule->tag, NULL);
+        strmap_add(&f->prefixes, rule->tag, rule);
+        if (rule->len > f->prefix_max_len) {
+            f->prefix_max_len = rule->len;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Add the given whitespace separated TAG:PRIORITY filter specs to the given
+ * set of filters. Returns 0 on success or -1 if a spec is invalid.
+ */
+static int add_specs(struct filters *f, const char *specs)
+{
+    const char *p = specs;
+    for (;;) {
+        p += strspn(p, " \t");
+        if (*p == '\0') {
+            break;
+        }
+        size_t len = strcspn(p, " \t");
+        const char *colon = memchr(p, ':', len);
+        size_t tag_len = colon != NULL ? (size_t)(colon - p) : len;
+        int level = 0;
+        if (colon == NULL) {
+            level = level_of('V');
+        } else if (colon + 2 == p + len) {
+            level = level_of(toupper((unsigned char)colon[1]));
+        }
+        if (add_rule(f, p, tag_len, level) != 0) {
+            return -1;
+        }
+        p += len;
+    }
+    return 0;
+}
+
+/**
+ * (Re)build the specs of the given set of filters handed to logcat; every spec
+ * must survive the device's shell unquoted but for the wildcard.
+ */
+static void build_pushdown(struct filters *f)
+{
+    f->pushed = true;
+    size_t used = 0;
+    for (size_t i = 0; i < f->rules_n && f->pushed; ++i) {
+        const struct rule *rule = &f->rules[i];
+        f->pushed = !rule->prefix && pushable(rule->tag, rule->len);
+        int n = snprintf(f->pushdown + used, sizeof(f->pushdown) - used,
+                         rule->len == 1 && rule->tag[0] == '*'
+                         ? " '%.*s:%c'" : " %.*s:%c", (int)rule->len,
+                         rule->tag, "??VDIWEFS"[rule->level]);
+        if (n < 0 || (size_t)n >= sizeof(f->pushdown) - used) {
+            f->pushed = false;
+            break;
+        }
+        used += n;
+    }
+    if (!f->pushed) {
+        f->pushdown[0] = '\0';
+    }
+}
+
+/**
+ * Remove every filter of the given set and reset its generation.
+ */
+static void clear_filters(struct filters *f)
+{
+    free(f->match_pattern);
+    f->match_pattern = NULL;
+    strmap_clear(&f->prefixes);
+    f->prefix_max_len = 0;
+    f->rules_n = 0;
+    f->default_level = 0;
+    f->pushed = false;
+    f->pushdown[0] = '\0';
+    f->generation = 0;
+    f->retired = NULL;
+}
+
+/**
+ * Return the lowest priority level the given set of filters shows for the tag
+ * of the given name, or 0 when lines of every priority are shown.
+ */
+static int find_level(const struct filters *f, const char *name, size_t len)
+{
+    if (f->rules_n == 0 || f->pushed) {
+        return 0;
+    }
+    for (size_t i = f->rules_n; i-- > 0;) {
+        const struct rule *rule = &f->rules[i];
+        if (!rule->prefix && rule->len == len
+            && memcmp(rule->tag, name, len) == 0) {
+            return rule->level;
+        }
+    }
+
+    // Look up the longest leading part of the name first.
+    char part[RULE_TAG_NCHARS];
+    size_t n = len < f->prefix_max_len ? len : f->prefix_max_len;
+    memcpy(part, name, n);
+    for (; n > 0; --n) {
+        part[n] = '\0';
+        const struct rule *rule = strmap_get(&f->prefixes, part);
+        if (rule != NULL) {
+            return rule->level;
+        }
+    }
+    return f->default_level;
+}
+
+/**
+ * Return the priority level of the given tag type letter, or 0 for letters
+ * that are not priorities.
+ */
+static int level_of(char tagtype)
+{
+    const char *levels = "VDIWEFS";
+    const char *p = tagtype != '\0' ? strchr(levels, tagtype) : NULL;
+    return p != NULL ? (int)(p - levels) + 2 : 0;
+}
+
+/**
+ * Return a new empty set of filters.
+ */
+static struct filters *new_filters(void)
+{
+    struct filters *f = calloc(1, sizeof(*f));
+    if (f == NULL) {
+        fprintf(stderr, "Failure to allocate filters.\n");
+        abort();
+    }
+    strmap_init(&f->prefixes);
+    return f;
+}
+
+/**
+ * Return whether the given tag can be handed to logcat on the device's shell
+ * command line.
+ */
+static bool pushable(const char *tag, size_t len)
+{
+    if (len == 1 && *tag == '*') {
+        return true;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        char c = tag[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+              || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Have lines checked against the given set of filters from now on, retiring
+ * the set it replaces. Sets replacing another are never pushed down to logcat,
+ * which has been started with the specs of the first. Must be called with
+ * replace_lock held.
+ */
+static void publish(struct filters *f)
+{
+    struct filters *old = atomic_load_explicit(&current,
+                                               memory_order_relaxed);
+    f->generation = (old->generation + 1) & (UINT_MAX >> FILTER_LEVEL_BITS);
+    f->pushed = false;
+    f->pushdown[0] = '\0';
+    atomic_store_explicit(&current, f, memory_order_release);
+    old->retired = retired;
+    retired = old;
+}
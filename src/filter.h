@@ -0,0 +1,75 @@
+/** @file
+ * Filters deciding which log lines are shown.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Filters follow logcat's TAG:PRIORITY filter specs and may add literals of
+ * which the message must contain one, see grep.h, and a regular expression the
+ * message must match. Filter specs are handed to logcat on the device whenever
+ * they can be, so that filtered lines never cross the wire; whatever is left is
+ * checked as soon as a line's tag and priority are known, before any
+ * formatting. What the specs say of a tag is settled when the tag is interned,
+ * and again only once the filters are replaced, so filters must be set up
+ * before the tag map is.
+ */
+#ifndef FILTER_H_
+#define FILTER_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of low bits holding the level within filter_level() values. */
+#define FILTER_LEVEL_BITS (4)
+
+/** Mask of the level within filter_level() values. */
+#define FILTER_LEVEL_MASK ((1U << FILTER_LEVEL_BITS) - 1)
+
+/*******************************************************************************
+ * Types
+ */
+
+struct tag;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+bool filter_accept(const struct tag *tag, char tagtype, const char *msg,
+                   size_t msg_len);
+int filter_add(const char *specs);
+void filter_clear(void);
+void filter_keep_local(void);
+unsigned filter_level(const char *name, size_t len);
+const char *filter_pushdown(void);
+int filter_replace_match(const char *pattern);
+int filter_replace_specs(const char *specs);
+int filter_set_match(const char *pattern);
+void filter_thread_free(void);
+
+#endif
@@ -0,0 +1,600 @@
+/** @file
+ * Search of messages for any of a set of literal strings.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Two searches are built from the literals. The portable one is an Aho-Corasick
+ * automaton flattened into a transition table over classes of bytes, with every
+ * transition into a state at which some literal ends replaced by a single match
+ * marker, so a message is searched with one table load per byte.
+ *
+ * Where the processor offers byte shuffles the literals are instead spread over
+ * eight buckets, Teddy style, and up to the first three bytes of every position
+ * are tested against nibble masks of each bucket a whole vector at a time. Only
+ * positions that survive are compared against the literals of the buckets that
+ * flagged them. The masks grow fuzzier as buckets fill, so large sets of
+ * literals are left to the automaton, whose cost does not depend on their
+ * number.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "grep.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GREP_X86 (1)
+#include <immintrin.h>
+#endif
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of literals. */
+#define LITERALS_NMAX (1024)
+
+/** Maximum number of bytes of all literals together. */
+#define LITERALS_NBYTES_MAX (64 * 1024)
+
+/** Number of buckets the literals are spread over by the vector search. */
+#define BUCKETS_N (8)
+
+/** Largest number of literals handed to the vector search. */
+#define BUCKETS_LITERALS_NMAX (40)
+
+/** Maximum number of leading bytes of each literal the vector search tests. */
+#define FINGERPRINT_NBYTES_MAX (3)
+
+/** Maximum number of characters of a line of a file of literals. */
+#define LINE_NCHARS (1024)
+
+/** Transition into a state at which some literal has been found. */
+#define STATE_MATCH (UINT32_MAX)
+
+/** Bytes beyond the longest literal each part of a split message must hold. */
+#define WALKS_SLACK_NBYTES (2)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Literal searched for.
+ */
+struct literal {
+    char   *text; //!< Bytes of the literal.
+    size_t  len;  //!< Number of bytes of the literal.
+};
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static int build_automaton(void);
+static void build_buckets(void);
+static int compare_fingerprints(const void *a, const void *b);
+static bool match_automaton(const char *s, size_t n);
+static bool verify(const char *s, size_t n, size_t pos, unsigned buckets);
+#if GREP_X86
+static bool match_avx2(const char *s, size_t n);
+static bool match_ssse3(const char *s, size_t n);
+#endif
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+bool (*grep_match_impl)(const char *s, size_t n) = match_automaton;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** First index within sorted of the literals within each bucket. */
+static uint16_t bucket_first[BUCKETS_N + 1];
+
+/** Class of each byte value; bytes within no literal are all of class 0. */
+static uint16_t classes[256];
+
+/** Number of classes of bytes. */
+static size_t classes_n;
+
+/** Transitions of the automaton indexed by state plus class of byte. */
+static uint32_t *dfa;
+
+/** Number of leading bytes of each literal tested by the vector search. */
+static size_t fingerprint_n;
+
+/** Name of the search currently in use. */
+static const char *impl_name = "aho-corasick";
+
+/** Literals in the order given. */
+static struct literal literals[LITERALS_NMAX];
+
+/** Number of literals. */
+static size_t literals_n;
+
+/** Number of bytes of all literals together. */
+static size_t literals_nbytes;
+
+/** Number of bytes of the longest literal. */
+static size_t literals_longest;
+
+/** Buckets holding each high nibble of each fingerprint byte. */
+static uint8_t masks_hi[FINGERPRINT_NBYTES_MAX][16];
+
+/** Buckets holding each low nibble of each fingerprint byte. */
+static uint8_t masks_lo[FINGERPRINT_NBYTES_MAX][16];
+
+/** Indices of the literals ordered by fingerprint then grouped by bucket. */
+static uint16_t sorted[LITERALS_NMAX];
+
+/******************************************************************************/
+
+/**
+ * Add the given literal to those searched for. Returns 0 on success or -1 if
+ * the literal is empty or there are too many literals.
+ */
+int grep_add(const char *literal, size_t len)
+{
+    if (len == 0 || literals_n == LITERALS_NMAX
+        || literals_nbytes + len > LITERALS_NBYTES_MAX) {
+        return -1;
+    }
+    struct literal *lit = &literals[literals_n];
+    lit->text = malloc(len);
+    if (lit->text == NULL) {
+        return -1;
+    }
+    memcpy(lit->text, literal, len);
+    lit->len = len;
+    ++literals_n;
+    literals_nbytes += len;
+    if (len > literals_longest) {
+        literals_longest = len;
+    }
+    return 0;
+}
+
+/**
+ * Add every line of the file at the given path as a literal; empty lines are
+ * skipped. Returns 0 on success or an error number on failure.
+ */
+int grep_add_file(const char *path)
+{
+    FILE *fh = fopen(path, "r");
+    if (fh == NULL) {
+        return errno;
+    }
+    int err = 0;
+    char line[LINE_NCHARS];
+    while (fgets(line, sizeof(line), fh) != NULL) {
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+            err = E2BIG;
+            break;
+        }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            --len;
+        }
+        if (len > 0 && grep_add(line, len) != 0) {
+            err = E2BIG;
+            break;
+        }
+    }
+    if (err == 0 && ferror(fh)) {
+        err = EIO;
+    }
+    fclose(fh);
+    return err;
+}
+
+/**
+ * Compile the literals added so far and select the fastest search for them.
+ * Must be called before messages are searched and before any other threads of
+ * execution are started. Returns 0 on success or an error number on failure.
+ */
+int grep_build(void)
+{
+    if (literals_n == 0) {
+        return 0;
+    }
+    int err = build_automaton();
+    if (err) {
+        return err;
+    }
+    grep_match_impl = match_automaton;
+    impl_name = "aho-corasick";
+
+#if GREP_X86
+    if (literals_n <= BUCKETS_LITERALS_NMAX) {
+        build_buckets();
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            grep_match_impl = match_avx2;
+            impl_name = "teddy-avx2";
+        } else if (__builtin_cpu_supports("ssse3")) {
+            grep_match_impl = match_ssse3;
+            impl_name = "teddy-ssse3";
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Remove every literal.
+ */
+void grep_clear(void)
+{
+    for (size_t i = 0; i < literals_n; ++i) {
+        free(literals[i].text);
+    }
+    literals_n = 0;
+    literals_nbytes = 0;
+    literals_longest = 0;
+    free(dfa);
+    dfa = NULL;
+    grep_match_impl = match_automaton;
+    impl_name = "aho-corasick";
+}
+
+/**
+ * Return the number of literals searched for.
+ */
+size_t grep_count(void)
+{
+    return literals_n;
+}
+
+/**
+ * Return the name of the search selected by grep_build().
+ */
+const char *grep_name(void)
+{
+    return impl_name;
+}
+
+/**
+ * Build the automaton that finds every literal. Returns 0 on success or an
+ * error number on failure.
+ */
+static int build_automaton(void)
+{
+    memset(classes, 0, sizeof(classes));
+    classes_n = 1;
+    for (size_t i = 0; i < literals_n; ++i) {
+        for (size_t j = 0; j < literals[i].len; ++j) {
+            uint8_t c = literals[i].text[j];
+            if (classes[c] == 0) {
+                classes[c] = classes_n++;
+            }
+        }
+    }
+
+    // The trie can hold no more states than there are bytes of literals plus
+    // the root, state 0. Since no edge of the trie leads back to the root, 0
+    // also marks transitions the trie lacks until they are filled in.
+    size_t states_max = literals_nbytes + 1;
+    uint32_t *table = calloc(states_max * classes_n, sizeof(*table));
+    uint32_t *fail = malloc(states_max * sizeof(*fail));
+    uint32_t *queue = malloc(states_max * sizeof(*queue));
+    bool *accepting = calloc(states_max, sizeof(*accepting));
+    if (table == NULL || fail == NULL || queue == NULL || accepting == NULL) {
+        free(table);
+        free(fail);
+        free(queue);
+        free(accepting);
+        return ENOMEM;
+    }
+
+    size_t states_n = 1;
+    for (size_t i = 0; i < literals_n; ++i) {
+        uint32_t state = 0;
+        for (size_t j = 0; j < literals[i].len; ++j) {
+            uint32_t *next = &table[state * classes_n
+                                    + classes[(uint8_t)literals[i].text[j]]];
+            if (*next == 0) {
+                *next = states_n++;
+            }
+            state = *next;
+        }
+        accepting[state] = true;
+    }
+
+    // Visit states breadth first, so that the state every failure transition
+    // leads to has all of its transitions filled in before they are copied.
+    size_t head = 0;
+    size_t tail = 0;
+    for (size_t k = 0; k < classes_n; ++k) {
+        if (table[k] != 0) {
+            fail[table[k]] = 0;
+            queue[tail++] = table[k];
+        }
+    }
+    while (head < tail) {
+        uint32_t state = queue[head++];
+        accepting[state] |= accepting[fail[state]];
+        uint32_t *row = &table[state * classes_n];
+        const uint32_t *fallback = &table[fail[state] * classes_n];
+        for (size_t k = 0; k < classes_n; ++k) {
+            if (row[k] != 0) {
+                fail[row[k]] = fallback[k];
+                queue[tail++] = row[k];
+            } else {
+                row[k] = fallback[k];
+            }
+        }
+    }
+
+    // Searching stops at the first literal found, so every transition into an
+    // accepting state becomes the match marker; the rest are premultiplied.
+    for (size_t i = 0; i < states_n * classes_n; ++i) {
+        table[i] = accepting[table[i]] ? STATE_MATCH : table[i] * classes_n;
+    }
+    free(fail);
+    free(queue);
+    free(accepting);
+
+    free(dfa);
+    dfa = realloc(table, states_n * classes_n * sizeof(*table));
+    if (dfa == NULL) {
+        dfa = table;
+    }
+    return 0;
+}
+
+/**
+ * Spread the literals over the buckets of the vector search and fill in the
+ * nibble masks of the buckets.
+ */
+static void build_buckets(void)
+{
+    fingerprint_n = FINGERPRINT_NBYTES_MAX;
+    for (size_t i = 0; i < literals_n; ++i) {
+        if (literals[i].len < fingerprint_n) {
+            fingerprint_n = literals[i].len;
+        }
+        sorted[i] = i;
+    }
+
+    // Literals sharing leading bytes share buckets which keeps the masks of
+    // the other buckets sharp.
+    qsort(sorted, literals_n, sizeof(sorted[0]), compare_fingerprints);
+    memset(masks_lo, 0, sizeof(masks_lo));
+    memset(masks_hi, 0, sizeof(masks_hi));
+    for (size_t b = 0; b <= BUCKETS_N; ++b) {
+        bucket_first[b] = b * literals_n / BUCKETS_N;
+    }
+    for (size_t b = 0; b < BUCKETS_N; ++b) {
+        for (size_t i = bucket_first[b]; i < bucket_first[b + 1]; ++i) {
+            const struct literal *lit = &literals[sorted[i]];
+            for (size_t j = 0; j < fingerprint_n; ++j) {
+                uint8_t c = lit->text[j];
+                masks_lo[j][c & 0x0f] |= 1 << b;
+                masks_hi[j][c >> 4] |= 1 << b;
+            }
+        }
+    }
+}
+
+/**
+ * Order indices of literals by the literals' fingerprints.
+ */
+static int compare_fingerprints(const void *a, const void *b)
+{
+    const struct literal *la = &literals[*(const uint16_t *)a];
+    const struct literal *lb = &literals[*(const uint16_t *)b];
+    return memcmp(la->text, lb->text, fingerprint_n);
+}
+
+/**
+ * Search by walking the automaton over every byte. Each step waits on the
+ * table load of the step before, so longer messages are split into two or four
+ * overlapping spans that are walked together to keep that many loads in
+ * flight. Every span reaches far enough past the start of the next that a
+ * literal starting within one span ends within it.
+ */
+static bool match_automaton(const char *s, size_t n)
+{
+    const uint8_t *p = (const uint8_t *)s;
+    if (n >= 4 * (literals_longest + WALKS_SLACK_NBYTES)) {
+        size_t quarter = (n + 3) / 4;
+        size_t len = quarter + literals_longest - 1;
+        const uint8_t *p1 = p + quarter;
+        const uint8_t *p2 = p + 2 * quarter;
+        const uint8_t *p3 = p + n - len;
+        uint32_t s0 = 0;
+        uint32_t s1 = 0;
+        uint32_t s2 = 0;
+        uint32_t s3 = 0;
+        for (size_t i = 0; i < len; ++i) {
+            s0 = dfa[s0 + classes[p[i]]];
+            s1 = dfa[s1 + classes[p1[i]]];
+            s2 = dfa[s2 + classes[p2[i]]];
+            s3 = dfa[s3 + classes[p3[i]]];
+            if ((s0 == STATE_MATCH) | (s1 == STATE_MATCH)
+                | (s2 == STATE_MATCH) | (s3 == STATE_MATCH)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (n >= 2 * (literals_longest + WALKS_SLACK_NBYTES)) {
+        size_t len = (n + 1) / 2 + literals_longest - 1;
+        const uint8_t *p1 = p + n - len;
+        uint32_t s0 = 0;
+        uint32_t s1 = 0;
+        for (size_t i = 0; i < len; ++i) {
+            s0 = dfa[s0 + classes[p[i]]];
+            s1 = dfa[s1 + classes[p1[i]]];
+            if ((s0 == STATE_MATCH) | (s1 == STATE_MATCH)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t state = 0;
+    for (size_t i = 0; i < n; ++i) {
+        state = dfa[state + classes[p[i]]];
+        if (state == STATE_MATCH) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Return whether a literal of any of the given buckets starts at pos within
+ * the n bytes at s.
+ */
+static bool verify(const char *s, size_t n, size_t pos, unsigned buckets)
+{
+    while (buckets != 0) {
+        int b = __builtin_ctz(buckets);
+        buckets &= buckets - 1;
+        for (size_t i = bucket_first[b]; i < bucket_first[b + 1]; ++i) {
+            const struct literal *lit = &literals[sorted[i]];
+            if (lit->len <= n - pos
+                && memcmp(s + pos, lit->text, lit->len) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+#if GREP_X86
+/**
+ * Search 32 positions at a time with AVX2 shuffles.
+ */
+__attribute__((target("avx2")))
+static bool match_avx2(const char *s, size_t n)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i lo[FINGERPRINT_NBYTES_MAX];
+    __m256i hi[FINGERPRINT_NBYTES_MAX];
+    for (size_t j = 0; j < fingerprint_n; ++j) {
+        lo[j] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)masks_lo[j]));
+        hi[j] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)masks_hi[j]));
+    }
+
+    // Every fingerprint byte of every position of the block must lie within
+    // the message.
+    size_t i = 0;
+    for (; i + sizeof(__m256i) + fingerprint_n - 1 <= n;
+         i += sizeof(__m256i)) {
+        __m256i found = _mm256_set1_epi8(-1);
+        for (size_t j = 0; j < fingerprint_n; ++j) {
+            __m256i block = _mm256_loadu_si256((const __m256i *)(s + i + j));
+            __m256i l = _mm256_shuffle_epi8(lo[j],
+                                            _mm256_and_si256(block, nibble));
+            __m256i h = _mm256_shuffle_epi8(
+                hi[j], _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+            found = _mm256_and_si256(found, _mm256_and_si256(l, h));
+        }
+        uint32_t candidates = ~(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(found, _mm256_setzero_si256()));
+        if (candidates != 0) {
+            uint8_t buckets[sizeof(__m256i)];
+            _mm256_storeu_si256((__m256i *)buckets, found);
+            do {
+                int k = __builtin_ctz(candidates);
+                candidates &= candidates - 1;
+                if (verify(s, n, i + k, buckets[k])) {
+                    return true;
+                }
+            } while (candidates != 0);
+        }
+    }
+
+    // Literals starting within what is left also end within it.
+    return match_ssse3(s + i, n - i);
+}
+
+/**
+ * Search 16 positions at a time with SSSE3 shuffles.
+ */
+__attribute__((target("ssse3")))
+static bool match_ssse3(const char *s, size_t n)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i lo[FINGERPRINT_NBYTES_MAX];
+    __m128i hi[FINGERPRINT_NBYTES_MAX];
+    for (size_t j = 0; j < fingerprint_n; ++j) {
+        lo[j] = _mm_loadu_si128((const __m128i *)masks_lo[j]);
+        hi[j] = _mm_loadu_si128((const __m128i *)masks_hi[j]);
+    }
+
+    bool final = false;
+    for (size_t i = 0; i < n && !final; i += sizeof(__m128i)) {
+        // The final block is copied out so that its fingerprint bytes may be
+        // loaded; no literal fits past its first sizeof(__m128i) positions.
+        char last[sizeof(__m128i) + FINGERPRINT_NBYTES_MAX - 1];
+        const char *p = s + i;
+        uint32_t limit = 0xffff;
+        final = i + sizeof(__m128i) + fingerprint_n - 1 > n;
+        if (final) {
+            memset(last, 0, sizeof(last));
+            memcpy(last, p, n - i);
+            p = last;
+            if (n - i < sizeof(__m128i)) {
+                limit = (1u << (n - i)) - 1;
+            }
+        }
+
+        __m128i found = _mm_set1_epi8(-1);
+        for (size_t j = 0; j < fingerprint_n; ++j) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(p + j));
+            __m128i l = _mm_shuffle_epi8(lo[j], _mm_and_si128(block, nibble));
+            __m128i h = _mm_shuffle_epi8(
+                hi[j], _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+            found = _mm_and_si128(found, _mm_and_si128(l, h));
+        }
+        uint32_t candidates = ~(uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(found, _mm_setzero_si128())) & limit;
+        if (candidates != 0) {
+            uint8_t buckets[sizeof(__m128i)];
+            _mm_storeu_si128((__m128i *)buckets, found);
+            do {
+                int k = __builtin_ctz(candidates);
+                candidates &= candidates - 1;
+                if (verify(s, n, i + k, buckets[k])) {
+                    return true;
+                }
+            } while (candidates != 0);
+        }
+    }
+    return false;
+}
+#endif
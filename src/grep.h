@@ -0,0 +1,64 @@
+/** @file
+ * Search of messages for any of a set of literal strings.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Literals are given on the command line and compiled once at start up, before
+ * any device is read, into structures that are only ever read afterwards. The
+ * search routine is chosen for the host processor at the same time.
+ */
+#ifndef GREP_H_
+#define GREP_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stddef.h>
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Implementation of grep_match() selected by grep_build(). */
+extern bool (*grep_match_impl)(const char *s, size_t n);
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int grep_add(const char *literal, size_t len);
+int grep_add_file(const char *path);
+int grep_build(void);
+void grep_clear(void);
+size_t grep_count(void);
+const char *grep_name(void);
+
+/**
+ * Return whether any of the literals occurs within the n bytes at s.
+ */
+static inline bool grep_match(const char *s, size_t n)
+{
+    return grep_match_impl(s, n);
+}
+
+#endif
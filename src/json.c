@@ -0,0 +1,144 @@
+/** @file
+ * Escaping of text within JSON Lines output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Bytes of 0x80 and above are passed through untouched, so text that is UTF-8
+ * stays UTF-8.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "json.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#define JSON_SSE2 (1)
+#include <emmintrin.h>
+#endif
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Hexadecimal digits of the escapes of control characters. */
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * Letters of the short escapes of bytes indexed by byte, 'u' for bytes with
+ * only a numeric escape and 0 for bytes that need no escaping.
+ */
+static const char escape_table[256] = {
+    ['\0'] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u',
+    [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+    ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', [0x0b] = 'u',
+    ['\f'] = 'f', ['\r'] = 'r', [0x0e] = 'u', [0x0f] = 'u',
+    [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+    [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+    [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u',
+    [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+    ['"'] = '"', ['\\'] = '\\',
+};
+
+/******************************************************************************/
+
+/**
+ * Write the given text escaped for a JSON string to out, which must have room
+ * for JSON_ESCAPE_NCHARS_MAX characters for every byte. Returns the number of
+ * characters written.
+ */
+size_t json_escape(char *out, const char *in, size_t len)
+{
+    char *start = out;
+    const char *end = in + len;
+    while (in < end) {
+        const char *special = json_special(in, end - in);
+        size_t run = (special != NULL ? special : end) - in;
+        memcpy(out, in, run);
+        out += run;
+        in += run;
+        if (special == NULL) {
+            break;
+        }
+
+        uint8_t c = *in++;
+        char letter = escape_table[c];
+        *out++ = '\\';
+        *out++ = letter;
+        if (letter == 'u') {
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex_digits[c >> 4];
+            *out++ = hex_digits[c & 0xf];
+        }
+    }
+    return out - start;
+}
+
+/**
+ * Return the number of characters the n bytes at s are escaped to.
+ */
+size_t json_escaped_len(const char *s, size_t n)
+{
+    size_t len = n;
+    for (const char *special = json_special(s, n); special != NULL;) {
+        len += escape_table[(uint8_t)*special] == 'u' ? 5 : 1;
+        ++special;
+        special = json_special(special, s + n - special);
+    }
+    return len;
+}
+
+/**
+ * Return a pointer to the first byte within the n bytes at s that has to be
+ * escaped within a JSON string, or NULL if none does.
+ */
+const char *json_special(const char *s, size_t n)
+{
+    size_t i = 0;
+#if JSON_SSE2
+    // Control characters are those below 0x20 when compared as unsigned.
+    const __m128i controls = _mm_set1_epi8(0x1f);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, controls), v);
+        __m128i hit = _mm_or_si128(low,
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                _mm_cmpeq_epi8(v, backslash)));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return s + i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (escape_table[(uint8_t)s[i]] != 0) {
+            return s + i;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,53 @@
+/** @file
+ * Escaping of text within JSON Lines output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Lines may be written as JSON Lines, one object per line. Most tags and
+ * messages need no escaping at all, so text is first searched for bytes that
+ * do, sixteen at a time where the processor allows, and is only copied when
+ * some turn up. Bytes are escaped by table lookup rather than through printf.
+ */
+#ifndef JSON_H_
+#define JSON_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Most characters a single byte is escaped to, as in "\u001f". */
+#define JSON_ESCAPE_NCHARS_MAX (6)
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+size_t json_escape(char *out, const char *in, size_t len);
+size_t json_escaped_len(const char *s, size_t n);
+const char *json_special(const char *s, size_t n);
+
+#endif
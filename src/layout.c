@@ -0,0 +1,126 @@
+/** @file
+ * Layout of lines of text shown on a terminal.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The layout is kept packed within a single word, so that devices read it with
+ * a single load whichever thread formats their lines, while the thread handling
+ * signals replaces it.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "layout.h"
+
+#include <stdatomic.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "color.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Terminal columns for each character of width of the device column. */
+#define DEVICE_COLUMNS_PER_NCHAR (10)
+
+/** Least width of the device and tag columns on a terminal. */
+#define NCOLUMNS_MIN (8)
+
+/** Terminal columns for each character of width of the tag column. */
+#define TAG_COLUMNS_PER_NCHAR (8)
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Layout packed, the device width, the tag width and the line width. */
+static atomic_uint_fast64_t packed = LAYOUT_DEVICE_NCOLUMNS
+                                     | (uint_fast64_t)LAYOUT_TAG_NCOLUMNS << 16;
+
+/** Terminal the lines are shown on, -1 if none. */
+static int terminal_fd = -1;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static uint16_t width_of(unsigned columns, unsigned per_nchar);
+
+/******************************************************************************/
+
+/**
+ * Return the layout lines are formatted in at this moment.
+ */
+struct layout layout_get(void)
+{
+    uint_fast64_t word = atomic_load_explicit(&packed, memory_order_relaxed);
+    return (struct layout){
+        .device = word & 0xffff,
+        .tag = word >> 16 & 0xffff,
+        .line = word >> 32 & 0xffff,
+    };
+}
+
+/**
+ * Lay lines out to the width of the terminal with the given descriptor, if it
+ * is a terminal at all.
+ */
+void layout_init(int fd)
+{
+    if (isatty(fd)) {
+        terminal_fd = fd;
+        layout_update();
+    }
+}
+
+/**
+ * Lay lines out again to the width the terminal has now.
+ */
+void layout_update(void)
+{
+    struct winsize ws;
+    if (terminal_fd < 0 || ioctl(terminal_fd, TIOCGWINSZ, &ws) != 0
+        || ws.ws_col == 0) {
+        return;
+    }
+    uint_fast64_t word = width_of(ws.ws_col, DEVICE_COLUMNS_PER_NCHAR)
+                         | (uint_fast64_t)width_of(ws.ws_col,
+                                                   TAG_COLUMNS_PER_NCHAR) << 16
+                         | (uint_fast64_t)ws.ws_col << 32;
+    atomic_store_explicit(&packed, word, memory_order_relaxed);
+}
+
+/**
+ * Return the width of a column taking a character for every given number of
+ * columns of the terminal, the given number of columns wide.
+ */
+static uint16_t width_of(unsigned columns, unsigned per_nchar)
+{
+    unsigned width = columns / per_nchar;
+    if (width < NCOLUMNS_MIN) {
+        return NCOLUMNS_MIN;
+    }
+    return width > COLUMN_WIDTH_MAX ? COLUMN_WIDTH_MAX : width;
+}
@@ -0,0 +1,77 @@
+/** @file
+ * Layout of lines of text shown on a terminal.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Lines shown on a terminal are laid out to its width: the device and tag
+ * columns widen on wide terminals and narrow on narrow ones, and messages are
+ * clipped so that no line wraps. A wrapping line costs the terminal far more
+ * than the characters it holds, which at high rates makes the terminal itself
+ * the bottleneck.
+ *
+ * The layout is worked out once from the size of the terminal and again
+ * whenever it is resized, on SIGWINCH. Columns are rendered once at the widest
+ * they may be shown and cut to the width of the layout as they are copied
+ * alongside each line, so that a resize never touches what is rendered, see
+ * color.h. Output that is not a terminal keeps the fixed widths, those of a
+ * terminal 160 columns wide, and whole messages.
+ */
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdint.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Width of the column that displays the device name off a terminal. */
+#define LAYOUT_DEVICE_NCOLUMNS (16)
+
+/** Width of the column that displays the tag off a terminal. */
+#define LAYOUT_TAG_NCOLUMNS (20)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Widths lines of text are laid out in, in characters.
+ */
+struct layout {
+    uint16_t device; //!< Width of the column of the device name.
+    uint16_t tag;    //!< Width of the column of the tag.
+    uint16_t line;   //!< Width lines are clipped to, 0 for none.
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+struct layout layout_get(void);
+void layout_init(int fd);
+void layout_update(void);
+
+#endif
@@ -0,0 +1,226 @@
+/** @file
+ * Suppression of repeated lines and of tags logging too fast.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Buckets are indexed by tag identifier and tell the tags that held an
+ * identifier apart by serial number, so an evicted tag's budget is never
+ * inherited by the tag that replaces it. They are only ever touched by the
+ * thread reading their device.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "limit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Initial number of buckets of a device; must be a power of two. */
+#define BUCKETS_NMIN (1024)
+
+/** Microseconds a line's time may go back without resetting its budget. */
+#define BACKWARDS_NUSECS (1000000)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Budget of lines of a single tag.
+ */
+struct bucket {
+    uint64_t serial;  //!< Serial number of the tag, 0 if unused.
+    uint64_t due;     //!< Microsecond the tag's next line is due at.
+    uint64_t limited; //!< Lines suppressed since one was let through.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Whether consecutive repeats of a line are collapsed. */
+bool limit_collapse = false;
+
+/** Lines per second each tag may log, or zero for no limit. */
+uint32_t limit_rate;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Lines a tag may log at once beyond its rate. */
+static uint32_t limit_burst;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static uint64_t hash_line(const struct tag *tag, char tagtype,
+                          const char *msg, size_t len);
+
+/******************************************************************************/
+
+/**
+ * Release the resources held by the given suppression state.
+ */
+void limit_free(struct limit *l)
+{
+    free(l->buckets);
+    l->buckets = NULL;
+    l->nbuckets = 0;
+}
+
+/**
+ * Prepare the given suppression state for use.
+ */
+void limit_init(struct limit *l)
+{
+    memset(l, 0, sizeof(*l));
+}
+
+/**
+ * Return whether the given line repeats the one before it and is to be
+ * suppressed. Otherwise the number of repeats of the line before, which are
+ * to be reported, is stored to repeats.
+ */
+bool limit_repeated(struct limit *l, const struct tag *tag, char tagtype,
+                    const char *msg, size_t len, uint64_t *repeats)
+{
+    uint64_t hash = hash_line(tag, tagtype, msg, len);
+    if (hash == l->hash) {
+        ++l->repeats;
+        return true;
+    }
+    l->hash = hash;
+    *repeats = l->repeats;
+    l->repeats = 0;
+    return false;
+}
+
+/**
+ * Return the number of repeats of the last line suppressed and not reported
+ * yet, forgetting the line.
+ */
+uint64_t limit_repeats_take(struct limit *l)
+{
+    uint64_t repeats = l->repeats;
+    l->hash = 0;
+    l->repeats = 0;
+    return repeats;
+}
+
+/**
+ * Limit every tag to the lines per second given by spec, "RATE" or
+ * "RATE:BURST"; the burst defaults to the rate. Returns 0 on success or -1 if
+ * the spec is invalid.
+ */
+int limit_set(const char *spec)
+{
+    char *end;
+    unsigned long rate = strtoul(spec, &end, 10);
+    unsigned long burst = rate;
+    if (*end == ':') {
+        burst = strtoul(end + 1, &end, 10);
+    }
+    if (*end != '\0' || rate == 0 || rate > 1000000 || burst == 0
+        || burst > 1000000) {
+        return -1;
+    }
+    limit_rate = rate;
+    limit_burst = burst;
+    return 0;
+}
+
+/**
+ * Return whether the given tag's line logged at the given millisecond is over
+ * the tag's budget and is to be suppressed. Otherwise the number of lines of
+ * the tag suppressed before it, which are to be reported, is stored to
+ * limited.
+ */
+bool limit_throttled(struct limit *l, const struct tag *tag, uint64_t ms,
+                     uint64_t *limited)
+{
+    if (tag->id >= l->nbuckets) {
+        size_t n = l->nbuckets > 0 ? l->nbuckets : BUCKETS_NMIN;
+        while (n <= tag->id) {
+            n *= 2;
+        }
+        struct bucket *buckets = realloc(l->buckets, n * sizeof(*buckets));
+        if (buckets == NULL) {
+            fprintf(stderr, "Failure to allocate tag budgets.\n");
+            abort();
+        }
+        memset(buckets + l->nbuckets, 0,
+               (n - l->nbuckets) * sizeof(*buckets));
+        l->buckets = buckets;
+        l->nbuckets = n;
+    }
+    struct bucket *b = &l->buckets[tag->id];
+    if (b->serial != tag->serial) {
+        b->serial = tag->serial;
+        b->due = 0;
+        b->limited = 0;
+    }
+
+    // A line is let through unless it would be due later than the burst
+    // allows; a clock set back far starts the budget over.
+    uint64_t now = ms * 1000;
+    uint64_t interval = 1000000 / limit_rate;
+    uint64_t tolerance = (limit_burst - 1) * interval;
+    uint64_t due = b->due > now ? b->due : now;
+    if (due - now > tolerance + BACKWARDS_NUSECS) {
+        due = now;
+    }
+    if (due - now > tolerance) {
+        ++b->limited;
+        return true;
+    }
+    b->due = due + interval;
+    *limited = b->limited;
+    b->limited = 0;
+    return false;
+}
+
+/**
+ * Return the 64-bit FNV-1a hash of the given line's tag, priority and
+ * message, never 0.
+ */
+static uint64_t hash_line(const struct tag *tag, char tagtype,
+                          const char *msg, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ tag->serial) * 1099511628211ULL;
+    hash = (hash ^ (uint8_t)tagtype) * 1099511628211ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (uint8_t)msg[i]) * 1099511628211ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
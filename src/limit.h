@@ -0,0 +1,86 @@
+/** @file
+ * Suppression of repeated lines and of tags logging too fast.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Lines are suppressed right after they are tokenized and filtered, before any
+ * formatting, so a device spamming the same message costs little more than
+ * reading it. Two stages may be turned on, each with state of its own device:
+ *
+ * Collapsing compares every line with the one before it by a hash of its tag,
+ * priority and message. Consecutive repeats are counted instead of shown, and
+ * the count is reported once a different line arrives or the device goes away.
+ *
+ * Limiting gives every tag a budget of lines per second with a burst allowance,
+ * kept by the generic cell rate algorithm: the single time a tag's next line is
+ * due stands in for a token bucket. Time is that the lines were logged at, so
+ * replayed captures are limited as they were logged. Lines over budget are
+ * counted and the count reported with the next line of the tag let through.
+ */
+#ifndef LIMIT_H_
+#define LIMIT_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Types
+ */
+
+struct bucket;
+struct tag;
+
+/**
+ * Suppression state of a single device.
+ */
+struct limit {
+    uint64_t       hash;     //!< Hash of the last line, 0 when none.
+    uint64_t       repeats;  //!< Repeats of that line suppressed.
+    struct bucket *buckets;  //!< Budget of each tag by identifier.
+    size_t         nbuckets; //!< Number of buckets allocated.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern bool limit_collapse;
+extern uint32_t limit_rate;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void limit_free(struct limit *l);
+void limit_init(struct limit *l);
+bool limit_repeated(struct limit *l, const struct tag *tag, char tagtype,
+                    const char *msg, size_t len, uint64_t *repeats);
+uint64_t limit_repeats_take(struct limit *l);
+int limit_set(const char *spec);
+bool limit_throttled(struct limit *l, const struct tag *tag, uint64_t ms,
+                     uint64_t *limited);
+
+#endif
@@ -0,0 +1,738 @@
+/** @file
+ * Tokenizer for lines of logcat output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The `-v time` format is:
+ *
+ *     MM-DD HH:MM:SS.mmm P/TAG(OWNER): MESSAGE
+ *
+ * The tokenizer mirrors the regular expression: the tag runs up to the first
+ * '(' and the owner up to the first ')', which must be followed by ": ".
+ * The message is everything remaining in the line including its newline.
+ *
+ * The `-v threadtime` format, or with `-v epoch` the seconds since the epoch
+ * in place of the date, is:
+ *
+ *     MM-DD HH:MM:SS.mmm  PID  TID P TAG     : MESSAGE
+ *     SSSSSSSSSS.mmm  PID  TID P TAG     : MESSAGE
+ *
+ * The process and thread are padded with spaces ahead to five characters and
+ * the tag with spaces behind to eight. The tag runs up to the first ": ", so
+ * that it may hold colons of its own.
+ *
+ * Binary entries start with the header of liblog's struct logger_entry. The
+ * first version of the header has no size field and is 20 bytes long; later
+ * versions record their size and only append fields we do not need. The
+ * payload is a priority byte followed by the NUL terminated tag and message.
+ * Headers are little endian, as on every device and host we log from. Headers
+ * of logd, 24 bytes and more, follow these fields with the buffer of the
+ * entry; the 24 byte header of the older kernel logger holds the euid there
+ * instead, which is taken for the main buffer unless it happens to be small.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "logcat.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "scan.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Offset of the tag type character following the time stamp. */
+#define TAGTYPE_OFFSET (LOGCAT_TIME_NCHARS + 1)
+
+/** Offset of the first character of the tag. */
+#define TAG_OFFSET (TAGTYPE_OFFSET + 2)
+
+/** Number of bytes of the first version of the binary entry header. */
+#define ENTRY_HEADER_V1_NBYTES (20)
+
+/** Number of bytes of the header up to and including the buffer of logd. */
+#define ENTRY_HEADER_LID_NBYTES (24)
+
+/** Number of characters of the milliseconds ending a time, ".mmm". */
+#define MSEC_NCHARS (4)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Fields common to every version of the binary entry header.
+ */
+struct entry_header {
+    uint16_t len;      //!< Number of bytes of the payload.
+    uint16_t hdr_size; //!< Number of bytes of the header, or 0 for version 1.
+    int32_t  pid;      //!< Process that logged the entry.
+    uint32_t tid;      //!< Thread that logged the entry.
+    uint32_t sec;      //!< Seconds of the time the entry was logged.
+    uint32_t nsec;     //!< Nanoseconds of the time the entry was logged.
+};
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static unsigned decode_digits(const char *s, size_t n);
+static bool is_digit(char c);
+static bool match_time(const char *line);
+static bool parse_epoch(struct logcat_parser *parser, const char *line,
+                        size_t len, regmatch_t matches[MESSAGE_NPARTS]);
+static bool parse_none(struct logcat_parser *parser, const char *line,
+                       size_t len, regmatch_t matches[MESSAGE_NPARTS]);
+static bool parse_threadtime(struct logcat_parser *parser, const char *line,
+                             size_t len, regmatch_t matches[MESSAGE_NPARTS]);
+static const char *scan_id(const char *p, const char *end);
+static void set_match(regmatch_t *match, size_t start, size_t end);
+static bool tokenize_threads(const char *line, size_t len, size_t time_start,
+                             size_t time_end,
+                             regmatch_t matches[MESSAGE_NPARTS]);
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Whatever format devices write by default, detected from their lines. */
+const struct logcat_format logcat_format_auto = {
+    "auto", "", parse_none, logcat_decode_time,
+};
+
+/** The threadtime format with the seconds since the epoch as the time. */
+const struct logcat_format logcat_format_epoch = {
+    "epoch", "-v threadtime -v epoch", parse_epoch, logcat_decode_epoch,
+};
+
+/** The format holding the thread, the default of newer devices. */
+const struct logcat_format logcat_format_threadtime = {
+    "threadtime", "-v threadtime", parse_threadtime, logcat_decode_time,
+};
+
+/** The format holding the time and only the process. */
+const struct logcat_format logcat_format_time = {
+    "time", "-v time", logcat_parse, logcat_decode_time,
+};
+
+/** Names of the log buffers indexed by their number. */
+const char *const logcat_buffer_names[LOGCAT_BUFFER_NMAX] = {
+    [LOGCAT_MAIN] = "main",         [LOGCAT_RADIO] = "radio",
+    [LOGCAT_EVENTS] = "events",     [LOGCAT_SYSTEM] = "system",
+    [LOGCAT_CRASH] = "crash",       [LOGCAT_STATS] = "stats",
+    [LOGCAT_SECURITY] = "security", [LOGCAT_KERNEL] = "kernel",
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Formats lines are detected in, in the order they are tried. */
+static const struct logcat_format *const formats[] = {
+    &logcat_format_time,
+    &logcat_format_threadtime,
+    &logcat_format_epoch,
+    NULL,
+};
+
+/** Letters of the priorities of binary entries indexed by priority. */
+static const char priority_letters[] = "SSVDIWEFS";
+
+/******************************************************************************/
+
+/**
+ * Find the number of the log buffer with the given name. Returns -1 if there
+ * is no such buffer.
+ */
+int logcat_buffer_find(const char *name, size_t len)
+{
+    for (int i = 0; i < LOGCAT_BUFFER_NMAX; ++i) {
+        if (strlen(logcat_buffer_names[i]) == len
+            && memcmp(logcat_buffer_names[i], name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Decode the binary entry at the start of the given data. Returns the number
+ * of bytes of the entry, 0 if the data holds only part of an entry or -1 if
+ * the data does not start with a valid entry.
+ */
+ssize_t logcat_decode_entry(const char *data, size_t len,
+                            struct logcat_entry *entry)
+{
+    struct entry_header hdr;
+    if (len < sizeof(hdr)) {
+        return 0;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+    size_t hdr_size = hdr.hdr_size != 0 ? hdr.hdr_size
+                                         : ENTRY_HEADER_V1_NBYTES;
+    size_t total = hdr_size + hdr.len;
+    if (hdr_size < sizeof(hdr) || total > LOGCAT_ENTRY_NBYTES_MAX) {
+        return -1;
+    }
+    if (len < total) {
+        return 0;
+    }
+
+    entry->pid = hdr.pid;
+    entry->tid = hdr.tid;
+    entry->sec = hdr.sec;
+    entry->nsec = hdr.nsec;
+    entry->buffer = LOGCAT_MAIN;
+    if (hdr_size >= ENTRY_HEADER_LID_NBYTES) {
+        uint32_t lid;
+        memcpy(&lid, data + sizeof(hdr), sizeof(lid));
+        entry->buffer = lid < LOGCAT_BUFFER_NMAX ? (enum logcat_buffer)lid
+                                                 : LOGCAT_MAIN;
+    }
+
+    // Binary events are decoded by whoever knows their tags.
+    const char *payload = data + hdr_size;
+    if ((LOGCAT_BINARY_BUFFERS >> entry->buffer & 1) != 0) {
+        entry->tagtype = 'I';
+        entry->tag = payload;
+        entry->tag_len = 0;
+        entry->msg = payload;
+        entry->msg_len = hdr.len;
+        return total;
+    }
+
+    // Payload of priority, tag and message; either string may be missing its
+    // NUL when the logger truncated the entry.
+    const char *end = payload + hdr.len;
+    if (hdr.len == 0) {
+        entry->tagtype = priority_letters[0];
+        entry->tag = end;
+        entry->tag_len = 0;
+        entry->msg = end;
+        entry->msg_len = 0;
+        return total;
+    }
+    uint8_t priority = payload[0];
+    entry->tagtype = priority < sizeof(priority_letters) - 1
+                     ? priority_letters[priority] : priority_letters[0];
+    entry->tag = payload + 1;
+    const char *nul = memchr(entry->tag, '\0', end - entry->tag);
+    entry->tag_len = (nul != NULL ? nul : end) - entry->tag;
+    entry->msg = nul != NULL ? nul + 1 : end;
+    nul = memchr(entry->msg, '\0', end - entry->msg);
+    entry->msg_len = (nul != NULL ? nul : end) - entry->msg;
+    return total;
+}
+
+/**
+ * Decode the given time, seconds since the epoch and their milliseconds,
+ * "SSSSSSSSSS.mmm", into milliseconds that order times just as those decoded
+ * by logcat_decode_time() do. Only the first time of every minute is placed
+ * in local time, and the minute is kept for logcat_epoch_ms(). Returns 0 if
+ * the time is not in that form.
+ */
+uint64_t logcat_decode_epoch(struct logcat_clock *clock, const char *time,
+                             size_t len)
+{
+    if (len <= MSEC_NCHARS || time[len - MSEC_NCHARS] != '.') {
+        return 0;
+    }
+    uint64_t sec = 0;
+    for (size_t i = 0; i < len - MSEC_NCHARS; ++i) {
+        if (!is_digit(time[i])) {
+            return 0;
+        }
+        sec = sec * 10 + (time[i] - '0');
+    }
+    const char *msec = time + len - MSEC_NCHARS + 1;
+    if (!is_digit(msec[0]) || !is_digit(msec[1]) || !is_digit(msec[2])) {
+        return 0;
+    }
+
+    // Zones are offset by whole minutes, so minutes start at the same seconds
+    // wherever they are shown.
+    uint64_t minute = (sec - sec % 60) * 1000;
+    if (clock->epoch == 0 || minute != clock->epoch) {
+        time_t t = sec - sec % 60;
+        struct tm tm;
+        if (localtime_r(&t, &tm) == NULL) {
+            return 0;
+        }
+        uint64_t month = tm.tm_mon + 1;
+        clock->epoch_base = (((month * 31 + tm.tm_mday) * 24 + tm.tm_hour) * 60
+                             + tm.tm_min) * 60000;
+        clock->epoch = minute;
+    }
+    return clock->epoch_base + sec % 60 * 1000 + decode_digits(msec, 3);
+}
+
+/**
+ * Decode the given time, "MM-DD HH:MM:SS.mmm", into milliseconds that order
+ * times the way they read; months are taken to have 31 days and the year is
+ * not known. Returns 0 if the time is not in that form.
+ */
+uint64_t logcat_decode_time(struct logcat_clock *clock, const char *time,
+                            size_t len)
+{
+    if (len != LOGCAT_TIME_NCHARS || time[LOGCAT_MINUTE_NCHARS] != ':'
+        || time[LOGCAT_MINUTE_NCHARS + 3] != '.') {
+        return 0;
+    }
+    const char *sec = time + LOGCAT_MINUTE_NCHARS + 1;
+    if (!is_digit(sec[0]) || !is_digit(sec[1]) || !is_digit(sec[3])
+        || !is_digit(sec[4]) || !is_digit(sec[5])) {
+        return 0;
+    }
+
+    if (clock->base == 0
+        || memcmp(time, clock->minute, LOGCAT_MINUTE_NCHARS) != 0) {
+        static const char layout[] = "00-00 00:00";
+        for (size_t i = 0; i < LOGCAT_MINUTE_NCHARS; ++i) {
+            if (layout[i] == '0' ? !is_digit(time[i]) : time[i] != layout[i]) {
+                return 0;
+            }
+        }
+        uint64_t month = decode_digits(time, 2);
+        uint64_t day = decode_digits(time + 3, 2);
+        uint64_t hour = decode_digits(time + 6, 2);
+        uint64_t min = decode_digits(time + 9, 2);
+        clock->base = (((month * 31 + day) * 24 + hour) * 60 + min) * 60000;
+        memcpy(clock->minute, time, LOGCAT_MINUTE_NCHARS);
+    }
+    return clock->base + decode_digits(sec, 2) * 1000
+           + decode_digits(sec + 3, 3);
+}
+
+/**
+ * Encode the given entry, apart from its buffer, as logcat writes binary
+ * entries into out, which holds size bytes. The message is cut short when the
+ * entry would otherwise not fit within LOGCAT_ENTRY_NBYTES_MAX or size.
+ * Returns the number of bytes of the entry.
+ */
+size_t logcat_encode_entry(char *out, size_t size,
+                           const struct logcat_entry *entry)
+{
+    size_t room = size < LOGCAT_ENTRY_NBYTES_MAX ? size
+                                                 : LOGCAT_ENTRY_NBYTES_MAX;
+    struct entry_header hdr = {
+        .hdr_size = sizeof(hdr),
+        .pid = entry->pid,
+        .tid = entry->tid,
+        .sec = entry->sec,
+        .nsec = entry->nsec,
+    };
+    // Priority and the NULs ending the tag and message.
+    size_t tag_len = entry->tag_len;
+    if (sizeof(hdr) + 3 + tag_len > room) {
+        tag_len = room - sizeof(hdr) - 3;
+    }
+    size_t msg_len = entry->msg_len;
+    if (sizeof(hdr) + 3 + tag_len + msg_len > room) {
+        msg_len = room - sizeof(hdr) - 3 - tag_len;
+    }
+    const char *letter = memchr(&priority_letters[2], entry->tagtype,
+                                sizeof(priority_letters) - 3);
+    char *p = out + sizeof(hdr);
+    *p++ = letter != NULL ? letter - priority_letters : 0;
+    memcpy(p, entry->tag, tag_len);
+    p += tag_len;
+    *p++ = '\0';
+    memcpy(p, entry->msg, msg_len);
+    p += msg_len;
+    *p++ = '\0';
+    hdr.len = p - out - sizeof(hdr);
+    memcpy(out, &hdr, sizeof(hdr));
+    return p - out;
+}
+
+/**
+ * Return the milliseconds since the epoch of the given time decoded by the
+ * clock. The year is the latest that does not place the time over a day in
+ * the future. Only the first time of every minute is handed to mktime().
+ */
+uint64_t logcat_epoch_ms(struct logcat_clock *clock, uint64_t key)
+{
+    uint64_t minute = key - key % 60000;
+    if (clock->epoch == 0 || minute != clock->epoch_base) {
+        // Day 31 of a month decodes just as day 0 of the next would.
+        uint64_t days = minute / (24 * 60 * 60000);
+        int month = days / 31;
+        int day = days % 31;
+        if (day == 0) {
+            --month;
+            day = 31;
+        }
+        time_t now = time(NULL);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        time_t t = 0;
+        for (int year = tm.tm_year; year >= tm.tm_year - 1; --year) {
+            struct tm when = {
+                .tm_year = year,
+                .tm_mon = month - 1,
+                .tm_mday = day,
+                .tm_hour = minute / (60 * 60000) % 24,
+                .tm_min = minute / 60000 % 60,
+                .tm_isdst = -1,
+            };
+            t = mktime(&when);
+            if (t <= now + 24 * 60 * 60) {
+                break;
+            }
+        }
+        clock->epoch_base = minute;
+        clock->epoch = t > 0 ? (uint64_t)t * 1000 : 0;
+    }
+    return clock->epoch + (key - minute);
+}
+
+/**
+ * Return the format of the given name, or NULL if no format is named so.
+ */
+const struct logcat_format *logcat_format_find(const char *name)
+{
+    if (strcmp(name, logcat_format_auto.name) == 0) {
+        return &logcat_format_auto;
+    }
+    for (const struct logcat_format *const *f = formats; *f != NULL; ++f) {
+        if (strcmp(name, (*f)->name) == 0) {
+            return *f;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Release the resources held by the given parser.
+ */
+void logcat_parser_free(struct logcat_parser *parser)
+{
+    regfree(&parser->preg);
+}
+
+/**
+ * Prepare the given parser for use. Returns 0 on success or the error code of
+ * regcomp() on failure.
+ */
+int logcat_parser_init(struct logcat_parser *parser)
+{
+    return regcomp(&parser->preg, "^([0-9]{2}-[0-9]{2} "
+                                  "[0-9]{2}:[0-9]{2}:[0-9]{2}\\.[0-9]{3}) "
+                                  "([A-Z])/([^\\(]+)\\(([^\\)]+)\\): (.*)$",
+                   REG_EXTENDED);
+}
+
+/**
+ * Split the given line of logcat output into its parts. The line does not need
+ * to be NUL terminated. Returns true when the line was recognized and the
+ * matches array filled out.
+ */
+bool logcat_parse(struct logcat_parser *parser, const char *line, size_t len,
+                  regmatch_t matches[MESSAGE_NPARTS])
+{
+    if (logcat_tokenize_time(line, len, matches)) {
+        return true;
+    }
+
+    // Fast path rejected the line; let the regular expression have a look.
+    set_match(&matches[WHOLE], 0, len);
+    return regexec(&parser->preg, line, MESSAGE_NPARTS, matches,
+                   REG_STARTEND) == 0;
+}
+
+/**
+ * Split the given line into its parts by the given format, or when it is not
+ * in that format by the first other format it is in, which becomes the given
+ * format. Returns true when the line was recognized and the matches array
+ * filled out.
+ */
+bool logcat_parse_any(struct logcat_parser *parser,
+                      const struct logcat_format **format, const char *line,
+                      size_t len, regmatch_t matches[MESSAGE_NPARTS])
+{
+    if ((*format)->parse(parser, line, len, matches)) {
+        return true;
+    }
+    for (const struct logcat_format *const *f = formats; *f != NULL; ++f) {
+        if (*f != *format && (*f)->parse(parser, line, len, matches)) {
+            *format = *f;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Tokenize a line in the `-v threadtime -v epoch` format with a single forward
+ * scan. Returns false if the line is not in that format.
+ */
+bool logcat_tokenize_epoch(const char *line, size_t len,
+                           regmatch_t matches[MESSAGE_NPARTS])
+{
+    // Seconds, padded with spaces ahead, and their milliseconds.
+    const char *end = line + len;
+    const char *p = line;
+    while (p < end && *p == ' ') {
+        ++p;
+    }
+    const char *time = p;
+    while (p < end && is_digit(*p)) {
+        ++p;
+    }
+    if (p == time || end - p < MSEC_NCHARS || p[0] != '.' || !is_digit(p[1])
+        || !is_digit(p[2]) || !is_digit(p[3])) {
+        return false;
+    }
+    p += MSEC_NCHARS;
+    return tokenize_threads(line, len, time - line, p - line, matches);
+}
+
+/**
+ * Tokenize a line in the `-v threadtime` format with a single forward scan.
+ * Returns false if the line is not in that format.
+ */
+bool logcat_tokenize_threadtime(const char *line, size_t len,
+                                regmatch_t matches[MESSAGE_NPARTS])
+{
+    if (len <= LOGCAT_TIME_NCHARS || !match_time(line)) {
+        return false;
+    }
+    return tokenize_threads(line, len, 0, LOGCAT_TIME_NCHARS, matches);
+}
+
+/**
+ * Tokenize a line in the `-v time` format with a single forward scan. Returns
+ * false if the line is not in that format.
+ */
+bool logcat_tokenize_time(const char *line, size_t len,
+                          regmatch_t matches[MESSAGE_NPARTS])
+{
+    // Time stamp "MM-DD HH:MM:SS.mmm" followed by a space.
+    if (len <= TAG_OFFSET || !match_time(line)
+        || line[LOGCAT_TIME_NCHARS] != ' ') {
+        return false;
+    }
+
+    // Tag type is a single upper case letter followed by '/'.
+    char tagtype = line[TAGTYPE_OFFSET];
+    if (tagtype < 'A' || tagtype > 'Z' || line[TAGTYPE_OFFSET + 1] != '/') {
+        return false;
+    }
+
+    // Tag runs up to the first '(' and must not be empty. A backslash in a
+    // bracket expression is literal, so the regular expression keeps it out
+    // of the tag and the owner alike; each scan stops at one too.
+    const char *end = line + len;
+    const char *open = scan_chr2(line + TAG_OFFSET, len - TAG_OFFSET, '(',
+                                 '\\');
+    if (open == NULL || *open != '(' || open == line + TAG_OFFSET) {
+        return false;
+    }
+
+    // Owner runs up to the first ')' and must not be empty.
+    const char *owner = open + 1;
+    const char *close = scan_chr2(owner, end - owner, ')', '\\');
+    if (close == NULL || *close != ')' || close == owner) {
+        return false;
+    }
+
+    // The owner is terminated by "): " with the message following.
+    if (end - close < 3 || close[1] != ':' || close[2] != ' ') {
+        return false;
+    }
+    const char *message = close + 3;
+
+    set_match(&matches[WHOLE], 0, len);
+    set_match(&matches[TIME], 0, LOGCAT_TIME_NCHARS);
+    set_match(&matches[TAGTYPE], TAGTYPE_OFFSET, TAGTYPE_OFFSET + 1);
+    set_match(&matches[TAG], TAG_OFFSET, open - line);
+    set_match(&matches[OWNER], owner - line, close - line);
+    set_match(&matches[MESSAGE], message - line, len);
+    matches[THREAD].rm_so = matches[THREAD].rm_eo = -1;
+    return true;
+}
+
+/**
+ * Return the value of the n decimal digits at s.
+ */
+static unsigned decode_digits(const char *s, size_t n)
+{
+    unsigned value = 0;
+    for (size_t i = 0; i < n; ++i) {
+        value = value * 10 + (s[i] - '0');
+    }
+    return value;
+}
+
+/**
+ * Return whether the given character is a decimal digit.
+ */
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Return whether the given line starts with a time stamp, "MM-DD
+ * HH:MM:SS.mmm". The line must hold at least LOGCAT_TIME_NCHARS characters.
+ */
+static bool match_time(const char *line)
+{
+    static const char layout[] = "00-00 00:00:00.000";
+    for (size_t i = 0; i < sizeof(layout) - 1; ++i) {
+        if (layout[i] == '0') {
+            if (!is_digit(line[i])) {
+                return false;
+            }
+        } else if (line[i] != layout[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Split the given line in the epoch format into its parts.
+ */
+static bool parse_epoch(struct logcat_parser *parser, const char *line,
+                        size_t len, regmatch_t matches[MESSAGE_NPARTS])
+{
+    (void)parser;
+    return logcat_tokenize_epoch(line, len, matches);
+}
+
+/**
+ * Recognize no line at all, so that the format of a line is always detected.
+ */
+static bool parse_none(struct logcat_parser *parser, const char *line,
+                       size_t len, regmatch_t matches[MESSAGE_NPARTS])
+{
+    (void)parser;
+    (void)line;
+    (void)len;
+    (void)matches;
+    return false;
+}
+
+/**
+ * Split the given line in the threadtime format into its parts.
+ */
+static bool parse_threadtime(struct logcat_parser *parser, const char *line,
+                             size_t len, regmatch_t matches[MESSAGE_NPARTS])
+{
+    (void)parser;
+    return logcat_tokenize_threadtime(line, len, matches);
+}
+
+/**
+ * Skip the space separating a process or thread identifier from what comes
+ * before it, and the identifier padded with spaces ahead. Returns the end of
+ * the identifier or NULL if there is none.
+ */
+static const char *scan_id(const char *p, const char *end)
+{
+    if (p == end || *p != ' ') {
+        return NULL;
+    }
+    ++p;
+    while (p < end && *p == ' ') {
+        ++p;
+    }
+    const char *digits = p;
+    while (p < end && is_digit(*p)) {
+        ++p;
+    }
+    return p != digits ? p : NULL;
+}
+
+/**
+ * Record the start and end offsets of a match.
+ */
+static void set_match(regmatch_t *match, size_t start, size_t end)
+{
+    match->rm_so = start;
+    match->rm_eo = end;
+}
+
+/**
+ * Tokenize the process, thread, priority, tag and message of a line in the
+ * threadtime layout, which follow its time at the given offsets. Returns
+ * false if the line is not in that layout.
+ */
+static bool tokenize_threads(const char *line, size_t len, size_t time_start,
+                             size_t time_end,
+                             regmatch_t matches[MESSAGE_NPARTS])
+{
+    // Process and thread, each shown padded as the owner is in `-v time`.
+    const char *end = line + len;
+    const char *pid = line + time_end + 1;
+    const char *pid_end = scan_id(line + time_end, end);
+    if (pid_end == NULL) {
+        return false;
+    }
+    const char *tid = pid_end + 1;
+    const char *tid_end = scan_id(pid_end, end);
+    if (tid_end == NULL) {
+        return false;
+    }
+
+    // Priority is a single upper case letter between spaces.
+    if (end - tid_end < 3 || tid_end[0] != ' ' || tid_end[1] < 'A'
+        || tid_end[1] > 'Z' || tid_end[2] != ' ') {
+        return false;
+    }
+    const char *tagtype = tid_end + 1;
+
+    // Tag runs up to the first ": ", less its padding, and must not be empty.
+    const char *tag = tid_end + 3;
+    const char *colon = tag;
+    for (;;) {
+        colon = scan_chr(colon, end - colon, ':');
+        if (colon == NULL || colon + 1 == end) {
+            return false;
+        }
+        if (colon[1] == ' ') {
+            break;
+        }
+        ++colon;
+    }
+    const char *tag_end = colon;
+    while (tag_end > tag && tag_end[-1] == ' ') {
+        --tag_end;
+    }
+    if (tag_end == tag) {
+        return false;
+    }
+
+    set_match(&matches[WHOLE], 0, len);
+    set_match(&matches[TIME], time_start, time_end);
+    set_match(&matches[TAGTYPE], tagtype - line, tagtype - line + 1);
+    set_match(&matches[TAG], tag - line, tag_end - line);
+    set_match(&matches[OWNER], pid - line, pid_end - line);
+    set_match(&matches[MESSAGE], colon + 2 - line, len);
+    set_match(&matches[THREAD], tid - line, tid_end - line);
+    return true;
+}
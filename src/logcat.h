@@ -0,0 +1,210 @@
+/** @file
+ * Tokenizer for lines of logcat output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Lines produced by `logcat -v time` are split into the spans named by enum
+ * regex_match. A hand written tokenizer finds every span in one forward scan of
+ * the line; lines that it rejects are handed to the original POSIX regular
+ * expression so that behavior never differs from the regex based parser.
+ *
+ * The `-v threadtime` format, the default of newer devices, and its `-v epoch`
+ * variant carry the thread as well. Each format has a tokenizer of its own,
+ * selected once per device through struct logcat_format, so that no line
+ * branches on the format it is in. Lines not in the format expected are tried
+ * against the others, which detects the format of devices left to their own
+ * default.
+ *
+ * Output of `logcat -B` is a stream of binary entries instead, each a fixed
+ * header followed by the priority, tag and message. Entries are decoded with
+ * fixed offset reads and no parsing at all. Every entry carries the buffer it
+ * was logged to; entries of the buffers holding binary events keep their
+ * payload for events.h to decode.
+ */
+#ifndef LOGCAT_H_
+#define LOGCAT_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <sys/types.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of bytes of a binary entry, header included. */
+#define LOGCAT_ENTRY_NBYTES_MAX (5 * 1024)
+
+/** Buffers whose entries are binary events rather than text. */
+#define LOGCAT_BINARY_BUFFERS \
+    (1u << LOGCAT_EVENTS | 1u << LOGCAT_STATS | 1u << LOGCAT_SECURITY)
+
+/** Number of characters of the minute leading a time, "MM-DD HH:MM". */
+#define LOGCAT_MINUTE_NCHARS (11)
+
+/** Number of characters in the "MM-DD HH:MM:SS.mmm" time stamp. */
+#define LOGCAT_TIME_NCHARS (18)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Log buffers of a device, numbered as logd numbers them.
+ */
+enum logcat_buffer {
+    LOGCAT_MAIN = 0,
+    LOGCAT_RADIO,
+    LOGCAT_EVENTS,
+    LOGCAT_SYSTEM,
+    LOGCAT_CRASH,
+    LOGCAT_STATS,
+    LOGCAT_SECURITY,
+    LOGCAT_KERNEL,
+    LOGCAT_BUFFER_NMAX
+};
+
+/**
+ * Decoded binary log entry. The tag and message point into the entry; the
+ * message of an entry of a binary buffer is its whole undecoded payload.
+ */
+struct logcat_entry {
+    enum logcat_buffer buffer;  //!< Buffer the entry was logged to.
+    int32_t            pid;     //!< Process that logged the entry.
+    uint32_t           tid;     //!< Thread that logged the entry.
+    uint32_t           sec;     //!< Seconds of the time the entry was logged.
+    uint32_t           nsec;    //!< Nanoseconds of the time the entry was
+                                //!< logged.
+    char               tagtype; //!< Letter of the entry's priority.
+    const char        *tag;     //!< Tag of the entry.
+    size_t             tag_len; //!< Length of the tag.
+    const char        *msg;     //!< Message of the entry.
+    size_t             msg_len; //!< Length of the message.
+};
+
+/**
+ * Decoder of the times lines are logged at, "MM-DD HH:MM:SS.mmm", that keeps
+ * the minute it last decoded. Lines logged one after the other nearly always
+ * share their minute, so only the seconds need decoding again.
+ */
+struct logcat_clock {
+    char     minute[LOGCAT_MINUTE_NCHARS]; //!< Minute last decoded.
+    uint64_t base;                         //!< Milliseconds of that minute, 0
+                                           //!< when nothing was decoded.
+    uint64_t epoch_base;                   //!< Minute last placed in time.
+    uint64_t epoch;                        //!< Milliseconds since the epoch of
+                                           //!< that minute.
+};
+
+/**
+ * The index numbers for different portions of matched regular expression in
+ * line of log.
+ */
+enum regex_match {
+    WHOLE = 0,
+    TIME,
+    TAGTYPE,
+    TAG,
+    OWNER,
+    MESSAGE,
+    THREAD,
+    MESSAGE_NPARTS
+};
+
+/**
+ * State required to parse lines of logcat output.
+ */
+struct logcat_parser {
+    regex_t preg; //!< Fallback regular expression for the time format.
+};
+
+/**
+ * Function that splits a line of one format into its parts. Returns true when
+ * the line was recognized and the matches array filled out; the thread is
+ * left unmatched in formats without one.
+ */
+typedef bool logcat_parse_fn(struct logcat_parser *parser, const char *line,
+                             size_t len, regmatch_t matches[MESSAGE_NPARTS]);
+
+/**
+ * Function that decodes the time of a line into milliseconds ordering times
+ * the way they read. Returns 0 if the time is not in the expected form.
+ */
+typedef uint64_t logcat_decode_fn(struct logcat_clock *clock, const char *time,
+                                  size_t len);
+
+/**
+ * Format of the lines of logcat output.
+ */
+struct logcat_format {
+    const char       *name;        //!< Name of the format.
+    const char       *args;        //!< Arguments logcat is run with to write
+                                   //!< the format.
+    logcat_parse_fn  *parse;       //!< Splits a line into its parts.
+    logcat_decode_fn *decode_time; //!< Decodes the time of a line.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *const logcat_buffer_names[LOGCAT_BUFFER_NMAX];
+extern const struct logcat_format logcat_format_auto;
+extern const struct logcat_format logcat_format_epoch;
+extern const struct logcat_format logcat_format_threadtime;
+extern const struct logcat_format logcat_format_time;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int logcat_buffer_find(const char *name, size_t len);
+ssize_t logcat_decode_entry(const char *data, size_t len,
+                            struct logcat_entry *entry);
+uint64_t logcat_decode_epoch(struct logcat_clock *clock, const char *time,
+                             size_t len);
+uint64_t logcat_decode_time(struct logcat_clock *clock, const char *time,
+                            size_t len);
+size_t logcat_encode_entry(char *out, size_t size,
+                           const struct logcat_entry *entry);
+uint64_t logcat_epoch_ms(struct logcat_clock *clock, uint64_t key);
+const struct logcat_format *logcat_format_find(const char *name);
+void logcat_parser_free(struct logcat_parser *parser);
+int logcat_parser_init(struct logcat_parser *parser);
+bool logcat_parse(struct logcat_parser *parser, const char *line, size_t len,
+                  regmatch_t matches[MESSAGE_NPARTS]);
+bool logcat_parse_any(struct logcat_parser *parser,
+                      const struct logcat_format **format, const char *line,
+                      size_t len, regmatch_t matches[MESSAGE_NPARTS]);
+bool logcat_tokenize_epoch(const char *line, size_t len,
+                           regmatch_t matches[MESSAGE_NPARTS]);
+bool logcat_tokenize_threadtime(const char *line, size_t len,
+                                regmatch_t matches[MESSAGE_NPARTS]);
+bool logcat_tokenize_time(const char *line, size_t len,
+                          regmatch_t matches[MESSAGE_NPARTS]);
+
+#endif
@@ -0,0 +1,300 @@
+/** @file
+ * Event loops that read the logs of many devices each.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Descriptors are registered level triggered and each readiness event is served
+ * by a single read, so a busy device cannot starve the others sharing its loop.
+ * Each loop owns a parser, which is all the per device state a thread used to
+ * carry beyond its buffers.
+ *
+ * Starting logcat takes a round trip to the device and perhaps a few retries,
+ * so every device is started by a short lived thread of its own; devices
+ * found together start streaming at once.
+ *
+ * Every loop waits on the descriptor that tells of shutdown along with its
+ * devices, so loops stop as soon as it is requested. The devices they read are
+ * left to be closed once the loops and the threads starting devices are gone.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "loop.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "filter.h"
+#include "logcat.h"
+#include "stats.h"
+#include "uring.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of events handled per wait. */
+#define EVENTS_NMAX (64)
+
+/** Milliseconds a loop waits before checking for shutdown. */
+#define WAIT_MSECS (1000)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Event loop serving a share of the devices.
+ */
+struct loop {
+    pthread_t thread; //!< Thread of execution of the loop.
+    int       epfd;   //!< Descriptor of the loop's epoll instance.
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Mechanism the loops wait with. */
+static enum loop_backend loops_backend;
+
+/** Loops that devices are spread over. */
+static struct loop *loops;
+
+/** Number of loops. */
+static int loops_n;
+
+/** Index of the loop to receive the next device. */
+static int next_loop;
+
+/** Lock used to prevent concurrent modification of next_loop and starting. */
+static pthread_mutex_t next_loop_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Number of threads starting devices. Protected by next_loop_lock. */
+static int starting;
+
+/** Condition signalled when the last thread starting a device is done. */
+static pthread_cond_t started = PTHREAD_COND_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void *run_loop(void *loop);
+static void *start_device(void *device);
+static void stop_starting(void);
+static int watch_device(struct device *d);
+
+/******************************************************************************/
+
+/**
+ * Start logcat for the given device and hand the device to the next loop once
+ * it runs, without waiting for either. Returns 0 on success or an error number
+ * on failure, in which case the device has been closed.
+ */
+int loop_add(struct device *d)
+{
+    pthread_mutex_lock(&next_loop_lock);
+    ++starting;
+    pthread_mutex_unlock(&next_loop_lock);
+    int err = device_spawn(d, start_device);
+    if (err) {
+        device_close(d);
+        stop_starting();
+        return err;
+    }
+    pthread_detach(d->thread);
+    return 0;
+}
+
+/**
+ * Stop the event loops once shutdown has been requested, waiting for the
+ * threads starting devices as well. The devices the loops read are left open.
+ */
+void loop_close(void)
+{
+    // Devices are handed to loops until the last of them has started.
+    pthread_mutex_lock(&next_loop_lock);
+    while (starting > 0) {
+        pthread_cond_wait(&started, &next_loop_lock);
+    }
+    pthread_mutex_unlock(&next_loop_lock);
+
+    if (loops_backend == LOOP_URING) {
+        uring_close();
+    }
+    for (int i = 0; i < loops_n; ++i) {
+        pthread_join(loops[i].thread, NULL);
+        close(loops[i].epfd);
+    }
+    free(loops);
+    loops = NULL;
+    loops_n = 0;
+}
+
+/**
+ * Start the given number of event loops waiting with the given backend. When
+ * io_uring is not usable the loops fall back to epoll. Returns 0 on success or
+ * an error number on failure.
+ */
+int loop_init(int nloops, enum loop_backend backend)
+{
+    if (backend == LOOP_URING) {
+        int err = uring_init(nloops);
+        if (!err) {
+            loops_backend = LOOP_URING;
+            return 0;
+        }
+        fprintf(stderr, "Failure to set up io_uring (%s); using epoll.\n",
+                strerror(err));
+    }
+
+    loops_backend = LOOP_EPOLL;
+    loops = calloc(nloops, sizeof(*loops));
+    if (loops == NULL) {
+        return ENOMEM;
+    }
+    loops_n = nloops;
+    for (int i = 0; i < nloops; ++i) {
+        loops[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (loops[i].epfd < 0) {
+            return errno;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+        if (epoll_ctl(loops[i].epfd, EPOLL_CTL_ADD, device_shutdown_fd(), &ev)
+            != 0) {
+            return errno;
+        }
+        int err = pthread_create(&loops[i].thread, NULL, run_loop, &loops[i]);
+        if (err) {
+            return err;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Run thread of execution that reads the devices registered with the given
+ * loop.
+ */
+static void *run_loop(void *loop)
+{
+    int err;
+
+    struct loop *l = (struct loop *)loop;
+    affinity_pin(AFFINITY_READERS);
+    struct logcat_parser parser;
+    err = logcat_parser_init(&parser);
+    assert(!err);
+
+    struct epoll_event events[EVENTS_NMAX];
+    while (!atomic_load(&shutdown_requested)) {
+        int n = epoll_wait(l->epfd, events, EVENTS_NMAX, WAIT_MSECS);
+        for (int i = 0; i < n && !atomic_load(&shutdown_requested); ++i) {
+            struct device *d = (struct device *)events[i].data.ptr;
+            if (d == NULL) {
+                // Shutdown was requested.
+                continue;
+            }
+            if (!device_read(d, &parser)) {
+                // Device disconnected; cleanup the device resources.
+                epoll_ctl(l->epfd, EPOLL_CTL_DEL, d->fd, NULL);
+                device_close(d);
+            }
+        }
+    }
+    stats_thread_unregister();
+    filter_thread_free();
+    logcat_parser_free(&parser);
+    return NULL;
+}
+
+/**
+ * Run thread of execution that starts logcat for the given device and hands
+ * the device to a loop.
+ */
+static void *start_device(void *device)
+{
+    struct device *d = (struct device *)device;
+    affinity_pin(AFFINITY_READERS);
+    if (device_open(d) != 0) {
+        device_close(d);
+    } else {
+        watch_device(d);
+    }
+    stop_starting();
+    return NULL;
+}
+
+/**
+ * Count a thread starting a device as done.
+ */
+static void stop_starting(void)
+{
+    pthread_mutex_lock(&next_loop_lock);
+    if (--starting == 0) {
+        pthread_cond_broadcast(&started);
+    }
+    pthread_mutex_unlock(&next_loop_lock);
+}
+
+/**
+ * Hand the given device, whose logcat is running, to the next loop. Returns 0
+ * on success or an error number on failure, in which case the device has been
+ * closed.
+ */
+static int watch_device(struct device *d)
+{
+    int flags = fcntl(d->fd, F_GETFL);
+    fcntl(d->fd, F_SETFL, flags | O_NONBLOCK);
+
+    pthread_mutex_lock(&next_loop_lock);
+    if (loops_backend == LOOP_URING) {
+        int err = uring_add(d);
+        pthread_mutex_unlock(&next_loop_lock);
+        if (err) {
+            fprintf(stderr, "Failure to watch device: %s\n", d->name);
+            device_close(d);
+        }
+        return err;
+    }
+    struct loop *loop = &loops[next_loop];
+    next_loop = (next_loop + 1) % loops_n;
+    pthread_mutex_unlock(&next_loop_lock);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = d };
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, d->fd, &ev) != 0) {
+        int err = errno;
+        fprintf(stderr, "Failure to watch device: %s\n", d->name);
+        device_close(d);
+        return err;
+    }
+    return 0;
+}
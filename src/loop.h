@@ -0,0 +1,59 @@
+/** @file
+ * Event loops that read the logs of many devices each.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Rather than a thread per device, event loop mode runs a small fixed number of
+ * threads that each wait on an epoll instance of their own. Devices are spread
+ * over the loops as they are discovered and stay with their loop until their
+ * logcat stream ends. Loops wait with epoll or, where the kernel allows it,
+ * with io_uring.
+ */
+#ifndef LOOP_H_
+#define LOOP_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "device.h"
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Mechanisms the event loops may wait on device output with.
+ */
+enum loop_backend {
+    LOOP_EPOLL = 0,
+    LOOP_URING,
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int loop_add(struct device *d);
+void loop_close(void);
+int loop_init(int nloops, enum loop_backend backend);
+
+#endif
@@ -34,17 +34,48 @@
  * Include Files
  */
 #include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <regex.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
-#include <ccan/strmap/strmap.h>
+#include "adb.h"
+#include "affinity.h"
+#include "archive.h"
+#include "buffer.h"
+#include "control.h"
+#include "device.h"
+#include "events.h"
+#include "filter.h"
+#include "grep.h"
+#include "layout.h"
+#include "limit.h"
+#include "loop.h"
+#include "metrics.h"
+#include "output.h"
+#include "pool.h"
+#include "raw.h"
+#include "relay.h"
+#include "replay.h"
+#include "scan.h"
+#include "serve.h"
+#include "sink.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "tag.h"
+#include "tail.h"
+#include "uevent.h"
 
 /*******************************************************************************
  * Constants
@@ -56,200 +87,624 @@
 /** Number of seconds to delay between attempts to find devices. */
 #define DELAY_BETWEEN_DEVICE_CHECK (3)
 
+/** Maximum number of characters of the list of devices. */
+#define DEVICE_LIST_NCHARS (16 * 1024)
+
 /** Maximum number of characters for device name. */
 #define DEVICE_NAME_NCHARS (64)
 
-/** Maxmium number of characters in a read line. */
-#define LINE_NCHARS (1024)
+/** Milliseconds within which continuation lines are coalesced by default. */
+#define COALESCE_MS_DEFAULT (5)
 
-/**
- * When matching line of device text we expect whole string to match and the
- * substring that is the device's name/serial.
- */
-#define MAX_MATCHES (2)
+/** Most milliseconds lines may be coalesced or held back for merging. */
+#define INTERVAL_MS_MAX (60 * 1000)
 
-/** Maximum number of retries on starting logcat execution. */
-#define RETRIES_NMAX (10)
+/** Most seconds between summaries of the counters. */
+#define INTERVAL_SECS_MAX (24 * 60 * 60)
 
-/** Maximum number of characters allowed in Android device serial number. */
-#define SERIAL_NCHARS (128)
+/** Number of event loops used when not given on the command line. */
+#define LOOPS_NDEFAULT (1)
 
-/** Shell command max number of characters. */
-#define SHELL_NCHARS (128)
+/** Milliseconds lines wait on those of other devices when merging. */
+#define MERGE_MS_DEFAULT (50)
 
-/*******************************************************************************
- * Local Types
- */
+/** Seconds shutdown may take before the process exits all the same. */
+#define SHUTDOWN_SECS (5)
 
-/**
- * Listing of colors we have available in our console. Note that the ordering
- * of values here coincide with the ordering of values in the color_ansi_table[]
- * variable below. Also know that the ordering and contents of this enum effect
- * how we select which color next to use when choosing colors for a newly
- * discovered tag or device name / serial number.
- */
-enum color {
-    COLOR_RED = 0,
-    COLOR_GREEN,
-    COLOR_YELLOW,
-    COLOR_BLUE,
-    COLOR_MAGENTA,
-    COLOR_CYAN,
-    COLOR_BRIGHT_RED,
-    COLOR_BRIGHT_GREEN,
-    COLOR_BRIGHT_YELLOW,
-    COLOR_BRIGHT_BLUE,
-    COLOR_BRIGHT_MAGENTA,
-    COLOR_BRIGHT_CYAN,
-    COLOR_NMAX
-};
+/** Most megabytes the tail rings may hold. */
+#define TAIL_MB_MAX (1024 * 1024)
+
+/** Maximum number of characters of the name of a dump of the tail rings. */
+#define TAIL_PATH_NCHARS (64)
+
+/** Most event loops or workers that may be started. */
+#define THREADS_NMAX (1024)
 
 /**
- * The index numbers for different portions of matched regular expression in
- * line of log.
+ * Milliseconds after an adb interface comes or goes before devices are listed
+ * again, doubled each time up to the longest, while adb catches up with it.
  */
-enum regex_match {
-    WHOLE = 0,
-    TIME,
-    TAGTYPE,
-    TAG,
-    OWNER,
-    MESSAGE,
-    MESSAGE_NPARTS
-};
+#define UEVENT_SETTLE_MS_MIN (250)
+#define UEVENT_SETTLE_MS_MAX (4000)
 
 /**
- * Representation of an Android device connected to the host.
+ * When matching line of device text we expect whole string to match and the
+ * substring that is the device's name/serial.
  */
-struct device {
-    pthread_t  thread;              //!< Thread of execution for device.
-    char       name[SERIAL_NCHARS]; //!< Serial number of device.
-    FILE      *fh;                  //!< Handle to running process.
-    enum color color;               //!< Color of the device's name.
-};
+#define MAX_MATCHES (2)
 
 /*******************************************************************************
  * Local Variables
  */
 
+/** Mechanism the event loops wait on devices with. */
+static enum loop_backend loops_backend = LOOP_EPOLL;
+
+/** Number of event loops reading devices, or zero for a thread per device. */
+static int loops_n;
+
+/** Milliseconds lines wait to be merged in time order, or zero to not merge. */
+static int merge_ms;
+
+/** Seconds between summaries of the counters, or zero for none. */
+static int stats_secs;
+
+/** Most tags held by the tag map at once. */
+static int tags_max = TAG_NDEFAULT;
+
+/** Whether devices are only listed again as kernel uevents tell of them. */
+static bool uevents;
+
 /**
- * Table that converts a color code to its respective ANSI. Note that the
- * values here are ordered according to the enum color type. This means that
- * enum color and color_ansi_table must be kept synchronized.
+ * Number of workers devices hand batches of lines to, or zero for devices to
+ * handle their own lines.
  */
-static uint8_t color_ansi_table[] = {
-    31, // RED
-    32, // GREEN
-    33, // YELLOW
-    34, // BLUE
-    35, // MAGENTA
-    36, // CYAN
-    91, // BRIGHT_RED
-    92, // BRIGHT_GREEN
-    93, // BRIGHT_YELLOW
-    94, // BRIGHT_BLUE
-    95, // BRIGHT_MAGENTA
-    96  // BRIGHT_CYAN
-};
-
-
-/** Map of device names to device struct. */
-static struct { STRMAP_MEMBERS(struct device *); } device_map;
-
-/** Lock used to prevent concurrent read and write. */
-static pthread_mutex_t device_map_lock = PTHREAD_MUTEX_INITIALIZER;
-
-/** Lock used to prevent concurrent writing of line of text to display. */
-static pthread_mutex_t line_lock = PTHREAD_MUTEX_INITIALIZER;
-
-/** Flag that indicates whether or not we are to shutdown software. */
-static bool shutdown = false;
+static int workers_n;
 
-/** Map of tag names to colors used in color output. */
-static struct { STRMAP_MEMBERS(enum color *); } tag_map;
+/*******************************************************************************
+ * Global Variables
+ */
 
-/** Lock used to prevent concurrent modification / access of tag map. */
-static pthread_mutex_t tag_map_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Flag that indicates whether or not we are to shutdown software. */
+atomic_bool shutdown_requested = false;
 
 /*******************************************************************************
  * Local Functions
  */
 
-static void find_android_devices(void);
-static bool handle_count_member(const char *member, struct device *device,
-                                void *count);
-static bool handle_delete_color(const char *member, enum color *color,
-                                void *unused);
-static char *parse_match(regmatch_t *match, char *in,
-                         char *out, size_t out_len);
+static void add_devices(const regex_t *preg, char *list);
+static void dump_tail(void);
+static void find_android_devices(const regex_t *preg);
+static void follow_uevents(const regex_t *preg, int fd);
+static unsigned parse_buffers(const char *list);
+static bool parse_number(const char *text, unsigned long min,
+                         unsigned long max, unsigned long *number);
+static uint64_t parse_time(const char *text, const char *msec);
+static void report_first_pass(bool *first);
 static void *run_find_devices(void *unused);
-static void *run_logcat(void *device);
+static void *run_signals(void *unused);
+static void usage(FILE *fh, const char *name);
 
 /******************************************************************************/
 
 int main(int argc, char *argv[])
 {
+    static const struct option options[] = {
+        { "aggregate",   required_argument, NULL, 'A' },
+        { "archive",     required_argument, NULL, 'a' },
+        { "backend",     required_argument, NULL, 'b' },
+        { "binary",      no_argument,       NULL, 'B' },
+        { "buffers",     required_argument, NULL, 'y' },
+        { "coalesce",    optional_argument, NULL, 'j' },
+        { "collapse",    no_argument,       NULL, 'c' },
+        { "control",     required_argument, NULL, 'C' },
+        { "cpus",        required_argument, NULL, 'K' },
+        { "drop",        required_argument, NULL, 'd' },
+        { "event-loop",  optional_argument, NULL, 'e' },
+        { "extract",     required_argument, NULL, 'x' },
+        { "filter",      required_argument, NULL, 'f' },
+        { "format",      required_argument, NULL, 'O' },
+        { "from",        required_argument, NULL, 'F' },
+        { "grep",        required_argument, NULL, 'g' },
+        { "grep-file",   required_argument, NULL, 'G' },
+        { "help",        no_argument,       NULL, 'h' },
+        { "limit",       required_argument, NULL, 'L' },
+        { "log-format",  required_argument, NULL, 'v' },
+        { "match",       required_argument, NULL, 'm' },
+        { "merge",       optional_argument, NULL, 'M' },
+        { "metrics",     required_argument, NULL, 'P' },
+        { "out-dir",     required_argument, NULL, 'o' },
+        { "raw",         required_argument, NULL, 'r' },
+        { "raw-only",    no_argument,       NULL, 'R' },
+        { "relay",       required_argument, NULL, 'n' },
+        { "replay",      no_argument,       NULL, 'p' },
+        { "rotate-secs", required_argument, NULL, 'S' },
+        { "rotate-size", required_argument, NULL, 's' },
+        { "serve",       required_argument, NULL, 'l' },
+        { "snapshot",    required_argument, NULL, 'z' },
+        { "snapshot-on", required_argument, NULL, 'q' },
+        { "stats",       required_argument, NULL, 'i' },
+        { "tag",         required_argument, NULL, 'T' },
+        { "tags",        required_argument, NULL, 't' },
+        { "tail",        required_argument, NULL, 'k' },
+        { "uevents",     no_argument,       NULL, 'u' },
+        { "until",       required_argument, NULL, 'U' },
+        { "workers",     optional_argument, NULL, 'w' },
+        { "writer-cpus", required_argument, NULL, 'W' },
+        { NULL,          0,                 NULL, 0   },
+    };
+    const char *extract = NULL;
+    const char *extract_tag = NULL;
+    bool format_given = false;
+    bool replay = false;
+    bool snapshot_on = false;
+    int coalesce_ms;
+    uint64_t from = 0;
+    uint64_t until = UINT64_MAX;
+    int err;
+    unsigned long number;
+    int opt;
+    while ((opt = getopt_long(argc, argv,
+                              "A:a:b:BcC:d:e::f:F:g:G:hi:j::k:K:l:L:m:M::"
+                              "n:o:O:pP:q:r:Rs:S:t:T:uU:v:w::W:x:y:z:",
+                              options, NULL)) != -1) {
+        switch (opt) {
+        case 'A':
+            relay_accept_addr = optarg;
+            break;
+        case 'a':
+            archive_dir = optarg;
+            break;
+        case 'B':
+            device_binary = true;
+            break;
+        case 'b':
+            if (strcmp(optarg, "epoll") == 0) {
+                loops_backend = LOOP_EPOLL;
+            } else if (strcmp(optarg, "io_uring") == 0) {
+                loops_backend = LOOP_URING;
+            } else {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            if (loops_n == 0) {
+                loops_n = LOOPS_NDEFAULT;
+            }
+            break;
+        case 'c':
+            limit_collapse = true;
+            break;
+        case 'C':
+            control_path = optarg;
+            break;
+        case 'd':
+            if (strcmp(optarg, "block") == 0) {
+                output_policy = OUTPUT_BLOCK;
+            } else if (strcmp(optarg, "oldest") == 0) {
+                output_policy = OUTPUT_DROP_OLDEST;
+            } else if (strcmp(optarg, "verbose") == 0) {
+                output_policy = OUTPUT_DROP_VERBOSE;
+            } else {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'e':
+            if (optarg != NULL
+                && !parse_number(optarg, 1, THREADS_NMAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            loops_n = optarg != NULL ? (int)number : LOOPS_NDEFAULT;
+            break;
+        case 'f':
+            if (filter_add(optarg) != 0) {
+                fprintf(stderr, "Invalid filter spec: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'F':
+            from = parse_time(optarg, ".000");
+            if (from == 0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'G':
+            err = grep_add_file(optarg);
+            if (err) {
+                fprintf(stderr, "Failure to read literals from %s: %s\n",
+                        optarg, strerror(err));
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'g':
+            if (grep_add(optarg, strlen(optarg)) != 0) {
+                fprintf(stderr, "Invalid literal: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            usage(stdout, argv[0]);
+            return EXIT_SUCCESS;
+        case 'i':
+            if (!parse_number(optarg, 1, INTERVAL_SECS_MAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            stats_secs = number;
+            break;
+        case 'j':
+            if (optarg != NULL
+                && !parse_number(optarg, 1, INTERVAL_MS_MAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            coalesce_ms = optarg != NULL ? (int)number : COALESCE_MS_DEFAULT;
+            device_coalesce_ms = coalesce_ms;
+            break;
+        case 'k':
+            if (!parse_number(optarg, 1, TAIL_MB_MAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            tail_nbytes = (uint64_t)number * 1024 * 1024;
+            break;
+        case 'K':
+            if (affinity_parse(AFFINITY_READERS, optarg) != 0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'l':
+            serve_addr = optarg;
+            break;
+        case 'L':
+            if (limit_set(optarg) != 0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'M':
+            if (optarg != NULL
+                && !parse_number(optarg, 1, INTERVAL_MS_MAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            merge_ms = optarg != NULL ? (int)number : MERGE_MS_DEFAULT;
+            break;
+        case 'm':
+            if (filter_set_match(optarg) != 0) {
+                fprintf(stderr, "Invalid regular expression: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            relay_addr = optarg;
+            break;
+        case 'O':
+            if (strcmp(optarg, "color") == 0) {
+                output_format = OUTPUT_COLOR;
+            } else if (strcmp(optarg, "binary") == 0) {
+                output_format = OUTPUT_BINARY;
+            } else if (strcmp(optarg, "jsonl") == 0) {
+                output_format = OUTPUT_JSONL;
+            } else if (strcmp(optarg, "plain") == 0) {
+                output_format = OUTPUT_PLAIN;
+            } else {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            format_given = true;
+            break;
+        case 'o':
+            sink_dir = optarg;
+            break;
+        case 'P':
+            metrics_addr = optarg;
+            break;
+        case 'p':
+            replay = true;
+            break;
+        case 'q':
+            err = snapshot_add(optarg);
+            if (err) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            snapshot_on = true;
+            break;
+        case 'R':
+            raw_only = true;
+            break;
+        case 'r':
+            raw_dir = optarg;
+            break;
+        case 'S':
+            if (!parse_number(optarg, 0, SINK_ROTATE_SECS_MAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            sink_rotate_secs = number;
+            break;
+        case 's':
+            if (!parse_number(optarg, 1, SINK_ROTATE_MB_MAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            sink_rotate_nbytes = (uint64_t)number * 1024 * 1024;
+            break;
+        case 'T':
+            extract_tag = optarg;
+            break;
+        case 't':
+            if (!parse_number(optarg, 1, TAG_NMAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            tags_max = number;
+            break;
+        case 'u':
+            uevents = true;
+            break;
+        case 'U':
+            until = parse_time(optarg, ".999");
+            if (until == 0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'v':
+            device_format = logcat_format_find(optarg);
+            if (device_format == NULL) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            if (optarg != NULL
+                && !parse_number(optarg, 1, THREADS_NMAX, &number)) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            workers_n = optarg != NULL ? (int)number
+                                       : sysconf(_SC_NPROCESSORS_ONLN);
+            break;
+        case 'W':
+            if (affinity_parse(AFFINITY_WRITERS, optarg) != 0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'x':
+            extract = optarg;
+            break;
+        case 'y':
+            // Only binary entries tell the buffer they were logged to.
+            device_buffers = parse_buffers(optarg);
+            if (device_buffers == 0) {
+                usage(stderr, argv[0]);
+                return EXIT_FAILURE;
+            }
+            device_binary = true;
+            break;
+        case 'z':
+            snapshot_dir = optarg;
+            break;
+        default:
+            usage(stderr, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((raw_only && raw_dir == NULL) || (sink_dir != NULL && merge_ms > 0)
+        || (replay && (optind == argc || control_path != NULL
+                       || metrics_addr != NULL || snapshot_dir != NULL
+                       || relay_accept_addr != NULL))
+        || (relay_addr != NULL
+            && (sink_dir != NULL || serve_addr != NULL || replay
+                || relay_accept_addr != NULL
+                || (format_given && output_format != OUTPUT_BINARY)))
+        || (snapshot_on && snapshot_dir == NULL)
+        || (output_format == OUTPUT_BINARY && (sink_dir != NULL || replay))
+        || (serve_addr != NULL
+            && (sink_dir != NULL || replay
+                || output_format == OUTPUT_BINARY))) {
+        usage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Lines are relayed as binary records.
+    if (relay_addr != NULL) {
+        output_format = OUTPUT_BINARY;
+        format_given = true;
+    }
+
+    // Colors are only worth their escape sequences on a terminal.
+    if (!format_given && sink_dir == NULL && serve_addr == NULL
+        && !isatty(STDOUT_FILENO)) {
+        output_format = OUTPUT_PLAIN;
+    }
+    color_plain = output_format == OUTPUT_PLAIN;
+
+    // Querying an archive needs no devices.
+    if (extract != NULL) {
+        err = archive_extract(extract, from, until, extract_tag, stdout);
+        if (err) {
+            fprintf(stderr, "Failure to extract from %s: %s\n", extract,
+                    strerror(err));
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     // Setup software.
     pthread_t device_mon;
-    strmap_init(&device_map);
-    strmap_init(&tag_map);
-
-    // Fill out the colors used for tag names.
-    enum color *c = malloc(sizeof(*c));
-    *c = COLOR_BLUE;
-    strmap_add(&tag_map, "dalvikvm", c);
-    strmap_add(&tag_map, "Process", c);
-    c = malloc(sizeof(*c));
-    *c = COLOR_CYAN;
-    strmap_add(&tag_map, "ActivityManager", c);
-    strmap_add(&tag_map, "ActivityThread", c);
+    pthread_t signal_mon;
+    scan_init();
+    if (replay || control_path != NULL) {
+        // Captures were made without the specs logcat would have applied,
+        // and logcat would go on applying specs after they were replaced.
+        filter_keep_local();
+    }
+    tag_map_init(tags_max);
+    err = grep_build();
+    if (err) {
+        fprintf(stderr, "Failure to compile literals: %s\n", strerror(err));
+        return EXIT_FAILURE;
+    }
 
-    // Start thread of execution that will periodically check on available
-    // android devices.
-    pthread_create(&device_mon, NULL, run_find_devices, NULL);
+    // Replaying captures needs no devices either.
+    if (replay) {
+        err = replay_files(&argv[optind], argc - optind, STDOUT_FILENO);
+        buffer_pool_clear();
+        tag_map_clear();
+        filter_clear();
+        grep_clear();
+        return err ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 
-    // Slight delay while we wait for first pass of devices to load.
-    sleep(1);
+    // Signals are handled by a dedicated thread; every thread created from
+    // here on inherits the mask that blocks them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    pthread_create(&signal_mon, NULL, run_signals, NULL);
+
+    // Start serving subscribers ahead of the writer that feeds them.
+    if (serve_addr != NULL) {
+        err = serve_start();
+        if (err) {
+            fprintf(stderr, "Failure to serve on %s: %s\n", serve_addr,
+                    strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
 
-    // Count the number of devices we discovered.
-    int count = 0;
-    pthread_mutex_lock(&device_map_lock);
-    strmap_iterate(&device_map, handle_count_member, &count);
-    pthread_mutex_unlock(&device_map_lock);
-    if (count == 0) {
-        fprintf(stderr, "Waiting on device to connect.\n");
+    // Start the thread of execution that writes colorized lines, to the
+    // central instance when relaying them.
+    int out_fd = STDOUT_FILENO;
+    if (relay_addr != NULL) {
+        out_fd = relay_connect();
+        if (out_fd < 0) {
+            fprintf(stderr, "Failure to relay to %s: %s\n", relay_addr,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    err = output_init(out_fd, merge_ms);
+    assert(!err);
+    if ((output_format == OUTPUT_COLOR || output_format == OUTPUT_PLAIN)
+        && sink_dir == NULL && serve_addr == NULL) {
+        layout_init(out_fd);
+    }
+    if (archive_dir != NULL) {
+        err = archive_start();
+        assert(!err);
+    }
+
+    // Snapshots are taken of the latest lines, kept unless told otherwise.
+    if (snapshot_dir != NULL) {
+        if (tail_nbytes == 0) {
+            tail_nbytes = (uint64_t)SNAPSHOT_TAIL_MB_DEFAULT * 1024 * 1024;
+        }
+        err = snapshot_start();
+        assert(!err);
     }
+
+    // Start the workers that devices hand their lines to.
+    if (workers_n > 0) {
+        err = pool_open(workers_n, device_worker_leave);
+        assert(!err);
+    }
+
+    // Start the event loops that devices will be read by.
+    if (loops_n > 0) {
+        err = loop_init(loops_n, loops_backend);
+        assert(!err);
+    }
+
+    // Take requests replacing the filters while devices are read.
+    if (control_path != NULL) {
+        err = control_start();
+        if (err) {
+            fprintf(stderr, "Failure to take requests on %s: %s\n",
+                    control_path, strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Take the lines of the devices of other hosts relaying them.
+    if (relay_accept_addr != NULL) {
+        err = relay_start();
+        if (err) {
+            fprintf(stderr, "Failure to accept relays on %s: %s\n",
+                    relay_accept_addr, strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Serve the counters to whoever monitors the host.
+    if (metrics_addr != NULL) {
+        err = metrics_start();
+        if (err) {
+            fprintf(stderr, "Failure to serve metrics on %s: %s\n",
+                    metrics_addr, strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Start thread of execution that will periodically check on available
+    // android devices.
+    pthread_create(&device_mon, NULL, run_find_devices, NULL);
     pthread_join(device_mon, NULL);
 
-    // Delete all colors out of the color map.
-    strmap_iterate(&tag_map, handle_delete_color, NULL);
-    strmap_clear(&tag_map);
+    // Shutdown was requested; the devices' last lines are written out before
+    // the writer and whatever it writes to are closed.
+    control_stop();
+    metrics_stop();
+    relay_stop();
+    if (loops_n > 0) {
+        // Only devices the loops read are left once they have stopped.
+        loop_close();
+        device_close_all();
+    }
+    device_wait_closed();
+    pool_close();
+    output_close();
+    serve_stop();
+    archive_stop();
+    snapshot_stop();
+    buffer_pool_clear();
+
+    // Delete all tags out of the tag map.
+    tag_map_clear();
+    device_map_clear();
+    tail_free();
+    events_clear();
+    filter_clear();
+    grep_clear();
     return 0;
 }
 
 /**
- * Recover list of android devices. This function queries adb devices to
- * determine what Android devices are connected to the host. Devices found are
- * added to the global devices set of strings.
+ * Start logging the devices named within the given listing of devices, as
+ * reported by adb devices or the adb server, that are not known yet.
  */
-static void find_android_devices(void)
+static void add_devices(const regex_t *preg, char *list)
 {
     int err;
-    static enum color next_color;
-    static pthread_mutex_t next_color_lock = PTHREAD_MUTEX_INITIALIZER;
-
-    char cmd[COMMAND_NCHARS];
-    snprintf(cmd, sizeof(cmd), "adb devices");
-    FILE *file = popen(cmd, "r");
 
-    regex_t preg;
-    err = regcomp(&preg, "^([0-9A-Fa-f]+)[ \t]+device.*$", REG_EXTENDED);
-    assert(!err);
-
-    char line[LINE_NCHARS];
-    while (fgets(line, sizeof(line), file) != NULL) {
+    char *save;
+    for (char *line = strtok_r(list, "\n", &save); line != NULL;
+         line = strtok_r(NULL, "\n", &save)) {
         regmatch_t matches[MAX_MATCHES];
-        err = regexec(&preg, line, MAX_MATCHES, matches, 0);
+        err = regexec(preg, line, MAX_MATCHES, matches, 0);
         if (err == REG_NOMATCH) {
             // Failure to find matching line. Continue.
             continue;
@@ -265,229 +720,447 @@ static void find_android_devices(void)
         // Check if we already know of this device.
         char name[DEVICE_NAME_NCHARS];
         memset(name, 0, sizeof(name));
-        strncpy(name, &line[start], len);
+        strncpy(name, &line[start], len < sizeof(name) ? len
+                                                      : sizeof(name) - 1);
 
-        pthread_mutex_lock(&device_map_lock);
-        if (strmap_get(&device_map, name) != NULL) {
-            pthread_mutex_unlock(&device_map_lock);
+        if (device_known(name)) {
             // Name already in the map.
             continue;
         }
-        pthread_mutex_unlock(&device_map_lock);
-
-        // Lets create the device and add it to the map.
-        struct device *device = (struct device *)malloc(sizeof(struct device));
-        memset(device->name, 0, sizeof(device->name));
-        strcpy(device->name, name);
-        // Set up the device's color.
-        pthread_mutex_lock(&next_color_lock);
-        device->color = next_color;
-        ++next_color;
-        if (next_color == COLOR_NMAX) {
-            next_color = COLOR_RED;
-        }
-        pthread_mutex_unlock(&next_color_lock);
-        // Add device to the device map.
-        pthread_mutex_lock(&device_map_lock);
-        strmap_add(&device_map, device->name, device);
-        pthread_mutex_unlock(&device_map_lock);
 
         // Begin running logcat.
-        err = pthread_create(&device->thread, NULL, run_logcat, device);
-        assert(!err);
+        struct device *device = device_new(name);
+        if (loops_n > 0) {
+            loop_add(device);
+        } else {
+            err = device_spawn(device, device_run);
+            assert(!err);
+        }
     }
-    regfree(&preg);
 }
 
 /**
- * Handler that counts the numer of members by iterating the count each time its
- * called recursively.
+ * Dump the rings of the latest lines of every device to a file within the
+ * working directory named after the current time.
  */
-static bool handle_count_member(const char *member, struct device *device,
-                                void *count)
+static void dump_tail(void)
 {
-    int *c = (int *)count;
-    if (member != NULL) {
-        ++(*c);
+    char path[TAIL_PATH_NCHARS];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(path, sizeof(path), "android-log-tail-%Y%m%d-%H%M%S.log", &tm);
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Failure to open %s: %s\n", path, strerror(errno));
+        return;
     }
-    return true;
+    int err = tail_dump(out);
+    if (fclose(out) != 0 && !err) {
+        err = errno;
+    }
+    if (err) {
+        fprintf(stderr, "Failure to dump the latest lines to %s: %s\n", path,
+                strerror(err));
+        return;
+    }
+    fprintf(stderr, "Dumped the latest lines to %s.\n", path);
+}
+
+/**
+ * Recover list of android devices. This function queries adb devices to
+ * determine what Android devices are connected to the host. Devices found are
+ * added to the global devices set of strings.
+ */
+static void find_android_devices(const regex_t *preg)
+{
+    // Ask the adb server itself, falling back to the adb client when no
+    // server is listening.
+    char list[DEVICE_LIST_NCHARS];
+    if (adb_query("host:devices", list, sizeof(list)) < 0) {
+        char cmd[COMMAND_NCHARS];
+        snprintf(cmd, sizeof(cmd), "adb devices");
+        FILE *file = popen(cmd, "r");
+        if (file == NULL) {
+            return;
+        }
+        size_t len = fread(list, 1, sizeof(list) - 1, file);
+        list[len] = '\0';
+        pclose(file);
+    }
+    add_devices(preg, list);
 }
 
 /**
- * Handler that deletes the given color that corresponds to member.
+ * Keep our set of known devices up to date by the uevents read from the given
+ * socket. Devices are listed at the start, as soon as an adb interface comes
+ * or goes and again after each of a few growing delays while adb catches up;
+ * while nothing changes this thread never wakes.
  */
-static bool handle_delete_color(const char *member, enum color *color,
-                                void *unused)
+static void follow_uevents(const regex_t *preg, int fd)
 {
-    free(color);
+    bool first = true;
+    find_android_devices(preg);
+    report_first_pass(&first);
+    int delay_ms = -1;
+    while (!atomic_load(&shutdown_requested)) {
+        struct pollfd pfds[2] = {
+            { .fd = fd, .events = POLLIN },
+            { .fd = device_shutdown_fd(), .events = POLLIN },
+        };
+        int ready = poll(pfds, 2, delay_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfds[1].revents & POLLIN) {
+            break;
+        }
+        if (ready > 0) {
+            if (!uevent_read(fd)) {
+                continue;
+            }
+            delay_ms = UEVENT_SETTLE_MS_MIN;
+        } else {
+            delay_ms = delay_ms * 2 <= UEVENT_SETTLE_MS_MAX ? delay_ms * 2 : -1;
+        }
+        find_android_devices(preg);
+    }
+}
+
+/**
+ * Return the log buffers named in the given comma separated list as a set of
+ * bits, one for each enum logcat_buffer. Returns 0 if any name is unknown.
+ */
+static unsigned parse_buffers(const char *list)
+{
+    unsigned buffers = 0;
+    for (const char *p = list;; ++p) {
+        size_t len = strcspn(p, ",");
+        int buffer = logcat_buffer_find(p, len);
+        if (buffer < 0) {
+            return 0;
+        }
+        buffers |= 1u << buffer;
+        p += len;
+        if (*p == '\0') {
+            return buffers;
+        }
+    }
+}
+
+/**
+ * Read the given text as a decimal number from min to max into number. Returns
+ * false, leaving number alone, if the text is anything else.
+ */
+static bool parse_number(const char *text, unsigned long min,
+                         unsigned long max, unsigned long *number)
+{
+    // strtoul() would take leading spaces and signs, negating the number.
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    unsigned long value = strtoul(text, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value < min || value > max) {
+        return false;
+    }
+    *number = value;
     return true;
 }
 
 /**
- * Extracts the text for a match in the regular expression from the given input
- * text and store the extracted text into the out variable.
+ * Return the time given as "MM-DD HH:MM:SS[.mmm]" as a merge key, taking the
+ * given milliseconds when they are left out. Returns 0 if the time is invalid.
  */
-static char *parse_match(regmatch_t *match, char *in,
-                         char *out, size_t out_len)
+static uint64_t parse_time(const char *text, const char *msec)
 {
-    memset(out, 0, out_len);
-    size_t len = match->rm_eo - match->rm_so;
-    strncpy(out, &in[match->rm_so], len);
-    return out;
+    char time[LOGCAT_TIME_NCHARS + 1];
+    int n = snprintf(time, sizeof(time), "%s%s", text,
+                     strchr(text, '.') == NULL ? msec : "");
+    if (n != LOGCAT_TIME_NCHARS) {
+        return 0;
+    }
+    struct logcat_clock clock = { .base = 0 };
+    return logcat_decode_time(&clock, time, n);
 }
 
 /**
- * Run thread of execution that continuously polls adb for listing of connected
- * devices updating our set of known devices.
+ * Tell that no device is connected after the first pass over the devices,
+ * which the given flag tells this is; the devices found start on their own.
  */
-static void *run_find_devices(void *unused)
+static void report_first_pass(bool *first)
 {
-    while (!shutdown) {
-        find_android_devices();
-        sleep(DELAY_BETWEEN_DEVICE_CHECK);
+    if (*first && device_count() == 0) {
+        fprintf(stderr, "Waiting on device to connect.\n");
     }
-    return NULL;
+    *first = false;
 }
 
 /**
- * Run logcat for the given device.
+ * Run thread of execution that keeps our set of known devices up to date. The
+ * adb server pushes a fresh listing of devices whenever one comes or goes;
+ * when no server is listening adb is polled for the listing instead, unless
+ * kernel uevents are to tell when to list the devices.
  */
-static void *run_logcat(void *device)
+static void *run_find_devices(void *unused)
 {
     int err;
 
-    struct device *d = (struct device *)device;
-    char cmd[SHELL_NCHARS];
-    snprintf(cmd, sizeof(cmd), "adb -s %s logcat -v time", d->name);
-    d->fh = popen(cmd, "r");
-    int retries = 0;
-    do {
-        d->fh = popen(cmd, "r");
-        if (d->fh == NULL) {
-            fprintf(stderr, "Failure to open device\n");
-            ++retries;
-            if (retries > RETRIES_NMAX) {
-                fprintf(stderr, "Failure to start logcat for device: %s\n",
-                        d->name);
-                return NULL;
-            }
-            sleep(1);
-        }
-    } while (d->fh == NULL);
-
     regex_t preg;
-    err = regcomp(&preg, "^([0-9]{2}-[0-9]{2} "
-                         "[0-9]{2}:[0-9]{2}:[0-9]{2}\\.[0-9]{3}) "
-                         "([A-Z])/([^\\(]+)\\(([^\\)]+)\\): (.*)$",
-                  REG_EXTENDED);
+    err = regcomp(&preg, "^([0-9A-Fa-f]+)[ \t]+device.*$", REG_EXTENDED);
     assert(!err);
 
-    char line[LINE_NCHARS];
-    while (!shutdown && fgets(line, sizeof(line), d->fh) != NULL) {
-        // Continuously read log lines and print them.
-        regmatch_t matches[MESSAGE_NPARTS];
-        err = regexec(&preg, line, MESSAGE_NPARTS, matches, 0);
-        if (err == REG_NOMATCH) {
-            fprintf(stderr, "Received line that did not match pattern: %s.\n",
-                    line);
-            continue;
+    // Kernel uevents tell when to look for devices, sparing the polling.
+    if (uevents) {
+        int fd = uevent_open();
+        if (fd >= 0) {
+            follow_uevents(&preg, fd);
+            close(fd);
+            regfree(&preg);
+            return NULL;
         }
+        fprintf(stderr, "Failure to listen for uevents: %s\n",
+                strerror(errno));
+    }
 
-        // Line that accumulates the color log messages.
-        char log[LINE_NCHARS];
-        memset(log, 0, sizeof(log));
-
-        // Text that houses portion of regular expression match.
-        char match[LINE_NCHARS];
-
-        // Print device name.
-        size_t len = sprintf(log, "\e[%dm%-16.16s\e[0m",
-                             color_ansi_table[d->color],
-                             d->name);
-
-        // Print the time of the logged message.
-        len += sprintf(log + len, " \e[34m%s\e[0m",
-                       parse_match(&matches[TIME], line,
-                                   match, sizeof(match)));
-
-        // Print the owner of the message.
-        len += sprintf(log + len, " \e[30;100m%s\e[0m",
-                       parse_match(&matches[OWNER], line,
-                                   match, sizeof(match)));
-
-        // Print the tag.
-        // The color we're currently using for a message.
-        static enum color next_color;
-        static pthread_mutex_t color_lock = PTHREAD_MUTEX_INITIALIZER;
-
-        parse_match(&matches[TAG], line, match, sizeof(match));
-        pthread_mutex_lock(&tag_map_lock);
-        enum color *color = strmap_get(&tag_map, match);
-        pthread_mutex_unlock(&tag_map_lock);
-
-        if (color == NULL) {
-            color = (enum color *)malloc(sizeof(*color));
-
-            pthread_mutex_lock(&color_lock);
-            *color = next_color;
-            // Update our color after we've assigned its value.
-            ++next_color;
-            if (next_color == COLOR_NMAX) {
-                next_color = COLOR_RED;
+    bool first = true;
+    while (!atomic_load(&shutdown_requested)) {
+        int fd = adb_connect();
+        if (fd >= 0 && adb_request(fd, "host:track-devices") == 0) {
+            // Follow the listings until the server goes away. The latest
+            // listing is gone over again now and then to reconnect devices
+            // whose logcat ended while they stayed connected.
+            char latest[DEVICE_LIST_NCHARS] = "";
+            while (!atomic_load(&shutdown_requested)) {
+                struct pollfd pfds[2] = {
+                    { .fd = fd, .events = POLLIN },
+                    { .fd = device_shutdown_fd(), .events = POLLIN },
+                };
+                int ready = poll(pfds, 2, DELAY_BETWEEN_DEVICE_CHECK * 1000);
+                if (pfds[1].revents & POLLIN) {
+                    break;
+                }
+                if (ready > 0 && (pfds[0].revents & (POLLIN | POLLHUP))
+                    && adb_read_reply(fd, latest, sizeof(latest)) < 0) {
+                    break;
+                }
+                char list[DEVICE_LIST_NCHARS];
+                strcpy(list, latest);
+                add_devices(&preg, list);
+                report_first_pass(&first);
             }
-            pthread_mutex_unlock(&color_lock);
-
-            // Tag does not already exists therefore we add it.
-            pthread_mutex_lock(&tag_map_lock);
-            strmap_add(&tag_map, match, color);
-            pthread_mutex_unlock(&tag_map_lock);
-
-        } else {
-            pthread_mutex_unlock(&tag_map_lock);
+            close(fd);
+            continue;
         }
-        len += sprintf(log + len, " \e[%dm%-20.20s\e[0m",
-                       color_ansi_table[*color], match);
-
-        // print tagtype
-        len += sprintf(log + len, " ");
-        parse_match(&matches[TAGTYPE], line, match, sizeof(match));
-        switch (*match) {
-        case 'D':
-            len += sprintf(log + len, "\e[30;44m D \e[0m");
-            break;
-        case 'E':
-            len += sprintf(log + len, "\e[30;41m E \e[0m");
-            break;
-        case 'F':
-            len += sprintf(log + len, "\e[5;30;41m F \e[0m");
-            break;
-        case 'I':
-            len += sprintf(log + len, "\e[30;42m I \e[0m");
-            break;
-        case 'V':
-            len += sprintf(log + len, "\e[37m V ");
-            break;
-        case 'W':
-            len += sprintf(log + len, "\e[30;43m W \e[0m");
-            break;
+        if (fd >= 0) {
+            close(fd);
         }
-
-        // print message
-        len += sprintf(log + len, " \e[1;30m%s\e[0m",
-                       parse_match(&matches[MESSAGE], line,
-                                   match, sizeof(match)));
-
-        pthread_mutex_lock(&line_lock);
-        fputs(log, stdout);
-        pthread_mutex_unlock(&line_lock);
+        find_android_devices(&preg);
+        report_first_pass(&first);
+        struct pollfd pfd = { .fd = device_shutdown_fd(), .events = POLLIN };
+        poll(&pfd, 1, DELAY_BETWEEN_DEVICE_CHECK * 1000);
     }
+    regfree(&preg);
+    return NULL;
+}
 
-    // Device disconnected; cleanup the device resources.
-    pthread_mutex_lock(&device_map_lock);
-    strmap_del(&device_map, d->name, NULL);
-    pthread_mutex_unlock(&device_map_lock);
-    free(d);
-
+/**
+ * Run thread of execution that handles the signals delivered to the process,
+ * printing the counters every stats_secs seconds in between when asked to.
+ * Interrupting or terminating the process asks for shutdown; should it not be
+ * done within SHUTDOWN_SECS, or be interrupted again, the process exits anyway.
+ * Terminating it again does not, since timeout(1) and the like signal both the
+ * process and its group.
+ */
+static void *run_signals(void *unused)
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGWINCH);
+    struct timespec interval = { stats_secs, 0 };
+    struct timespec deadline;
+    for (;;) {
+        int sig;
+        if (atomic_load(&shutdown_requested)) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            struct timespec left = {
+                deadline.tv_sec - now.tv_sec, deadline.tv_nsec - now.tv_nsec,
+            };
+            if (left.tv_nsec < 0) {
+                --left.tv_sec;
+                left.tv_nsec += 1000000000;
+            }
+            sig = left.tv_sec >= 0 ? sigtimedwait(&signals, NULL, &left) : -1;
+            if (sig < 0 && (left.tv_sec < 0 || errno == EAGAIN)) {
+                fprintf(stderr, "Failure to shut down in time.\n");
+                _exit(EXIT_FAILURE);
+            }
+        } else if (stats_secs > 0) {
+            sig = sigtimedwait(&signals, NULL, &interval);
+            if (sig < 0 && errno == EAGAIN) {
+                stats_print(stderr);
+                continue;
+            }
+        } else if (sigwait(&signals, &sig) != 0) {
+            continue;
+        }
+        if (sig == SIGUSR1) {
+            stats_print(stderr);
+        } else if (sig == SIGUSR2) {
+            dump_tail();
+        } else if (sig == SIGWINCH) {
+            layout_update();
+        } else if (sig == SIGINT || sig == SIGTERM) {
+            if (atomic_load(&shutdown_requested)) {
+                if (sig == SIGINT) {
+                    _exit(EXIT_FAILURE);
+                }
+                continue;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += SHUTDOWN_SECS;
+            device_shutdown();
+        }
+    }
     return NULL;
 }
 
+/**
+ * Print the command line usage of the software to the given stream.
+ */
+static void usage(FILE *fh, const char *name)
+{
+    fprintf(fh,
+            "Usage: %s [OPTION]... [--replay FILE...]\n"
+            "Colorize the logs of every Android device attached to the host,\n"
+            "or those captured in each FILE.\n"
+            "\n"
+            "  -a, --archive=DIR     archive the lines of each device\n"
+            "                        compressed and indexed by time and tag\n"
+            "                        to files of its own within DIR\n"
+            "  -A, --aggregate=[HOST:]PORT\n"
+            "                        also show the lines of the devices of\n"
+            "                        every host relaying them to PORT\n"
+            "  -b, --backend=NAME    wait on devices with NAME, epoll or\n"
+            "                        io_uring; implies --event-loop\n"
+            "  -B, --binary          read the binary log format from devices\n"
+            "                        running Android 5.0 or later\n"
+            "  -c, --collapse        collapse consecutive repeats of a line\n"
+            "                        into a count of them\n"
+            "  -C, --control=PATH    take requests replacing the filters, or\n"
+            "                        searching the lines kept by --tail,\n"
+            "                        while running on the Unix domain socket\n"
+            "                        PATH\n"
+            "  -d, --drop=POLICY     when output falls behind, block (the\n"
+            "                        default), drop the oldest lines or drop\n"
+            "                        verbose and debug lines first; dropped\n"
+            "                        lines are marked\n"
+            "  -e, --event-loop[=N]  read devices from N event loops\n"
+            "                        (default %d) instead of a thread per\n"
+            "                        device\n"
+            "  -f, --filter=SPECS    only show lines passing logcat\n"
+            "                        TAG:PRIORITY filter SPECS, e.g.\n"
+            "                        'ActivityManager:I *:S'; a TAG ending\n"
+            "                        in * names every tag starting with the\n"
+            "                        rest, e.g. 'com.ourapp.*:D'\n"
+            "  -F, --from=TIME       only extract lines logged from TIME on,\n"
+            "                        given as 'MM-DD HH:MM:SS[.mmm]'\n"
+            "  -g, --grep=LITERAL    only show lines whose message contains\n"
+            "                        LITERAL or any other literal given\n"
+            "  -G, --grep-file=FILE  add every line of FILE as a literal\n"
+            "  -h, --help            display this help and exit\n"
+            "  -i, --stats=N         print the counters to stderr every N\n"
+            "                        seconds, as SIGUSR1 does\n"
+            "  -j, --coalesce[=MS]   show the lines a process logs under one\n"
+            "                        tag within MS (default %d)\n"
+            "                        milliseconds, such as those of a stack\n"
+            "                        trace, as a single record\n"
+            "  -k, --tail=MB         keep the latest MB megabytes of lines\n"
+            "                        of all devices in memory, dumped to a\n"
+            "                        file on SIGUSR2\n"
+            "  -K, --cpus=LIST       run the threads reading devices, the\n"
+            "                        event loops and workers on the\n"
+            "                        processors of the comma separated LIST,\n"
+            "                        such as 0-3,8\n"
+            "  -l, --serve=[HOST:]PORT\n"
+            "                        stream lines to every subscriber\n"
+            "                        connecting to PORT instead of standard\n"
+            "                        output\n"
+            "  -L, --limit=RATE[:BURST]\n"
+            "                        show at most RATE lines per second of\n"
+            "                        each tag, and BURST at once (default\n"
+            "                        RATE), of each device; lines over are\n"
+            "                        counted\n"
+            "  -m, --match=REGEX     only show lines whose message matches\n"
+            "                        the extended regular expression REGEX\n"
+            "  -M, --merge[=MS]      show the lines of every device in the\n"
+            "                        order they were logged, waiting up to\n"
+            "                        MS (default %d) milliseconds on late\n"
+            "                        lines\n"
+            "  -n, --relay=HOST:PORT relay the lines of every device as\n"
+            "                        binary records to the instance\n"
+            "                        aggregating them on HOST:PORT instead\n"
+            "                        of standard output\n"
+            "  -o, --out-dir=DIR     write the lines of each device to files\n"
+            "                        of its own within DIR instead of\n"
+            "                        standard output\n"
+            "  -O, --format=NAME     write lines as NAME; color (the default\n"
+            "                        on a terminal), binary records, jsonl\n"
+            "                        or plain text (the default otherwise)\n"
+            "  -p, --replay          colorize the captures FILE... instead\n"
+            "                        of devices\n"
+            "  -P, --metrics=[HOST:]PORT\n"
+            "                        serve the counters as Prometheus or\n"
+            "                        OpenMetrics metrics at /metrics on PORT\n"
+            "  -q, --snapshot-on=LITERAL\n"
+            "                        also take a snapshot on lines whose\n"
+            "                        message contains LITERAL, e.g.\n"
+            "                        'FATAL EXCEPTION'\n"
+            "  -r, --raw=DIR         archive the output of each device\n"
+            "                        untouched to DIR/SERIAL.log\n"
+            "  -R, --raw-only        only archive, without colorizing\n"
+            "  -s, --rotate-size=MB  start a new file once one reaches MB\n"
+            "                        megabytes (default %d)\n"
+            "  -S, --rotate-secs=N   start a new file after N seconds\n"
+            "  -t, --tags=N          hold at most N tags (default %d),\n"
+            "                        evicting the least recently used\n"
+            "  -T, --tag=TAG         only extract lines with the tag TAG\n"
+            "  -u, --uevents         list devices again only as kernel\n"
+            "                        uevents tell of an adb interface coming\n"
+            "                        or going, instead of following the adb\n"
+            "                        server\n"
+            "  -U, --until=TIME      only extract lines logged until TIME\n"
+            "  -v, --log-format=NAME ask devices for lines in the logcat\n"
+            "                        format NAME; time (the default),\n"
+            "                        threadtime, epoch or auto for their\n"
+            "                        own; lines in any of them are\n"
+            "                        recognized whichever is asked for\n"
+            "  -w, --workers[=N]     parse and format lines read in bulk on\n"
+            "                        N workers (default one per processor)\n"
+            "  -W, --writer-cpus=LIST\n"
+            "                        run the writer of lines, archives and\n"
+            "                        snapshots on the processors of LIST\n"
+            "  -x, --extract=FILE    write the lines of the archive FILE and\n"
+            "                        exit\n"
+            "  -y, --buffers=LIST    read the comma separated log buffers\n"
+            "                        LIST, e.g. main,system,crash,events,\n"
+            "                        naming the buffer of each line in\n"
+            "                        jsonl; implies --binary, events are\n"
+            "                        decoded\n"
+            "  -z, --snapshot=DIR    on a fatal line write the latest lines\n"
+            "                        of its device, and the seconds before\n"
+            "                        of the others, compressed to DIR;\n"
+            "                        implies --tail=%d unless given\n",
+            name, LOOPS_NDEFAULT, COALESCE_MS_DEFAULT, MERGE_MS_DEFAULT,
+            SINK_ROTATE_NBYTES_DEFAULT / (1024 * 1024), TAG_NDEFAULT,
+            SNAPSHOT_TAIL_MB_DEFAULT);
+}
@@ -0,0 +1,369 @@
+/** @file
+ * Reorder buffer merging the lines of every device in time order.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Held lines live in nodes taken from a block allocated up front, which also
+ * bounds how many lines may be held; once it runs out the first line of the
+ * heap is due whether or not its time has come. Ties between sources are broken
+ * by the order lines were taken off the ring so that merging is stable.
+ *
+ * Sources are opened by device threads under sources_lock. Only the writer
+ * learns that a source has closed, from the record marking its end, and it
+ * hands the source back once every line of the source has been written.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "merge.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of lines held at once. */
+#define HELD_NMAX (16 * 1024)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Line held until it is its turn to be written.
+ */
+struct held {
+    struct held          *next;    //!< Next line of the source or spare node.
+    uint64_t              arrival; //!< Time the line was taken off the ring.
+    uint64_t              seq;     //!< Order the line was taken off the ring.
+    struct output_record  rec;     //!< Line itself.
+};
+
+/**
+ * Queue of the lines held for a source.
+ */
+struct source {
+    struct held *head;   //!< First line held, NULL when none are.
+    struct held *tail;   //!< Last line held.
+    size_t       pos;    //!< Position within the heap while lines are held.
+    bool         ended;  //!< Whether the end of the source has been seen.
+    bool         used;   //!< Whether the source is open, sources_lock held.
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Sources with held lines ordered by the time of their first line. */
+static uint32_t heap[MERGE_SOURCES_NMAX];
+
+/** Number of sources within the heap. */
+static size_t heap_n;
+
+/** Storage for every node of a held line. */
+static struct held *held_block;
+
+/** Number of lines held. */
+static size_t held_n;
+
+/** Milliseconds a line is held waiting on older lines of other sources. */
+static unsigned latency_ms;
+
+/** Order of the next line taken off the ring. */
+static uint64_t next_seq;
+
+/** Number of sources whose end has not been seen and which hold lines. */
+static size_t open_held_n;
+
+/** Sources indexed by identifier. */
+static struct source sources[MERGE_SOURCES_NMAX];
+
+/** Lock used to serialize the opening and handing back of sources. */
+static pthread_mutex_t sources_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Number of sources whose end has not been seen by the writer. */
+static atomic_size_t sources_open;
+
+/** Nodes not holding a line. */
+static struct held *spare;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static bool before(uint32_t a, uint32_t b);
+static void end_source(uint32_t id);
+static void sift_down(size_t pos);
+static void sift_up(size_t pos);
+static void swap(size_t a, size_t b);
+
+/******************************************************************************/
+
+/**
+ * Return the time at which the next line to be written falls due, which may
+ * have passed, or MERGE_NEVER when no line is held.
+ */
+uint64_t merge_due(void)
+{
+    if (heap_n == 0) {
+        return MERGE_NEVER;
+    }
+    if (held_n == HELD_NMAX || open_held_n == atomic_load(&sources_open)) {
+        return 0;
+    }
+    return sources[heap[0]].head->arrival + latency_ms;
+}
+
+/**
+ * Drop every held line and release the storage of the reorder buffer.
+ */
+void merge_free(void)
+{
+    struct output_record rec;
+    while (merge_next(&rec, 0, true)) {
+        output_release(&rec);
+    }
+    free(held_block);
+    held_block = NULL;
+    spare = NULL;
+}
+
+/**
+ * Return whether no more lines can be held until some are written.
+ */
+bool merge_full(void)
+{
+    return held_n == HELD_NMAX;
+}
+
+/**
+ * Hold the given line, taken off the ring at the given time in milliseconds,
+ * until it is its turn to be written. Ownership of the references on the
+ * line's buffers passes to the reorder buffer. A record without fragments
+ * marks the end of its source. Must not be called while merge_full().
+ */
+void merge_hold(const struct output_record *rec, uint64_t now)
+{
+    struct source *src = &sources[rec->source];
+    if (rec->niov == 0) {
+        end_source(rec->source);
+        return;
+    }
+
+    assert(spare != NULL);
+    struct held *h = spare;
+    spare = h->next;
+    h->next = NULL;
+    h->arrival = now;
+    h->seq = next_seq++;
+    h->rec = *rec;
+    ++held_n;
+
+    if (src->head == NULL) {
+        src->head = h;
+        src->tail = h;
+        if (!src->ended) {
+            ++open_held_n;
+        }
+        src->pos = heap_n;
+        heap[heap_n++] = rec->source;
+        sift_up(src->pos);
+    } else {
+        src->tail->next = h;
+        src->tail = h;
+    }
+}
+
+/**
+ * Prepare the reorder buffer to hold lines for up to the given latency in
+ * milliseconds. Returns 0 on success or an error number on failure.
+ */
+int merge_init(unsigned latency)
+{
+    held_block = malloc(sizeof(*held_block) * HELD_NMAX);
+    if (held_block == NULL) {
+        return ENOMEM;
+    }
+    spare = NULL;
+    for (size_t i = HELD_NMAX; i-- > 0;) {
+        held_block[i].next = spare;
+        spare = &held_block[i];
+    }
+    memset(sources, 0, sizeof(sources));
+    atomic_store(&sources_open, 0);
+    held_n = 0;
+    heap_n = 0;
+    open_held_n = 0;
+    next_seq = 0;
+    latency_ms = latency;
+    return 0;
+}
+
+/**
+ * Take the next line to be written at the given time in milliseconds out of
+ * the reorder buffer. Returns false if no line is due; every held line is due
+ * when flushing.
+ */
+bool merge_next(struct output_record *rec, uint64_t now, bool flush)
+{
+    if (heap_n == 0) {
+        return false;
+    }
+    if (!flush && merge_due() > now) {
+        return false;
+    }
+
+    uint32_t id = heap[0];
+    struct source *src = &sources[id];
+    struct held *h = src->head;
+    *rec = h->rec;
+    src->head = h->next;
+    h->next = spare;
+    spare = h;
+    --held_n;
+
+    if (src->head != NULL) {
+        sift_down(0);
+        return true;
+    }
+    swap(0, --heap_n);
+    sift_down(0);
+    if (src->ended) {
+        end_source(id);
+    } else {
+        --open_held_n;
+    }
+    return true;
+}
+
+/**
+ * Return the identifier of a newly opened source. The end of the source is
+ * marked by pushing a record without fragments.
+ */
+uint32_t merge_source_open(void)
+{
+    pthread_mutex_lock(&sources_lock);
+    uint32_t id = 0;
+    while (id < MERGE_SOURCES_NMAX && sources[id].used) {
+        ++id;
+    }
+    if (id == MERGE_SOURCES_NMAX) {
+        fprintf(stderr, "Too many devices to merge.\n");
+        abort();
+    }
+    sources[id].used = true;
+    atomic_fetch_add(&sources_open, 1);
+    pthread_mutex_unlock(&sources_lock);
+    return id;
+}
+
+/**
+ * Return whether the first line of the source a should be written before that
+ * of the source b.
+ */
+static bool before(uint32_t a, uint32_t b)
+{
+    const struct held *ha = sources[a].head;
+    const struct held *hb = sources[b].head;
+    if (ha->rec.key != hb->rec.key) {
+        return ha->rec.key < hb->rec.key;
+    }
+    return ha->seq < hb->seq;
+}
+
+/**
+ * Note the end of the given source, handing it back once none of its lines
+ * are held.
+ */
+static void end_source(uint32_t id)
+{
+    struct source *src = &sources[id];
+    if (!src->ended) {
+        src->ended = true;
+        atomic_fetch_sub(&sources_open, 1);
+        if (src->head != NULL) {
+            --open_held_n;
+        }
+    }
+    if (src->head != NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sources_lock);
+    src->ended = false;
+    src->used = false;
+    pthread_mutex_unlock(&sources_lock);
+}
+
+/**
+ * Move the source at the given position of the heap down until it is in
+ * order.
+ */
+static void sift_down(size_t pos)
+{
+    for (;;) {
+        size_t least = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < heap_n && before(heap[left], heap[least])) {
+            least = left;
+        }
+        if (right < heap_n && before(heap[right], heap[least])) {
+            least = right;
+        }
+        if (least == pos) {
+            return;
+        }
+        swap(pos, least);
+        pos = least;
+    }
+}
+
+/**
+ * Move the source at the given position of the heap up until it is in order.
+ */
+static void sift_up(size_t pos)
+{
+    while (pos > 0 && before(heap[pos], heap[(pos - 1) / 2])) {
+        swap(pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+}
+
+/**
+ * Exchange the sources at the given positions of the heap.
+ */
+static void swap(size_t a, size_t b)
+{
+    uint32_t id = heap[a];
+    heap[a] = heap[b];
+    heap[b] = id;
+    sources[heap[a]].pos = a;
+    sources[heap[b]].pos = b;
+}
@@ -0,0 +1,68 @@
+/** @file
+ * Reorder buffer merging the lines of every device in time order.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * When merging, the writer holds every line it takes off the ring in a queue
+ * of the device, or source, the line came from and writes them out through a
+ * k-way merge of those queues. A min-heap keeps the queues with held lines by
+ * the time of their first line. The first line of the heap is written once a
+ * line is held for every open source, since nothing older can still arrive,
+ * or once it has been held for the latency bound, since whatever is older is
+ * taken to be too late.
+ *
+ * Everything but the opening of sources is only used by the writer thread.
+ */
+#ifndef MERGE_H_
+#define MERGE_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "output.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of sources open at once. */
+#define MERGE_SOURCES_NMAX (1024)
+
+/** Returned by merge_due() when no line is held. */
+#define MERGE_NEVER (UINT64_MAX)
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+uint64_t merge_due(void);
+void merge_free(void);
+bool merge_full(void);
+void merge_hold(const struct output_record *rec, uint64_t now);
+int merge_init(unsigned latency);
+bool merge_next(struct output_record *rec, uint64_t now, bool flush);
+uint32_t merge_source_open(void);
+
+#endif
@@ -0,0 +1,275 @@
+/** @file
+ * HTTP endpoint the counters are scraped from as metrics.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Scrapes are served one at a time by a thread of their own, each on a
+ * connection closed once answered. A scraper that stalls is given up on after a
+ * second, so it holds up nothing but the scrapes behind it.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "metrics.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "serve.h"
+#include "stats.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Content type of metrics in the text format of OpenMetrics. */
+#define OPENMETRICS_TYPE \
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/** Content type of metrics in the text format of Prometheus. */
+#define PROMETHEUS_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+/** Maximum number of characters of a request, headers included. */
+#define REQUEST_NCHARS (8192)
+
+/** Seconds a scraper is given to send its request and take the answer. */
+#define TIMEOUT_SECS (1)
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Address metrics are served on as [HOST:]PORT, NULL for none. */
+const char *metrics_addr;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Socket connections are accepted on, -1 when not listening. */
+static int listen_fd = -1;
+
+/** Thread of execution serving scrapes. */
+static pthread_t server;
+
+/** Flag that indicates the server should exit. */
+static atomic_bool stopping;
+
+/** Event the server is woken by when it should exit. */
+static int wake_fd = -1;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void answer(int fd, const char *status, const char *type,
+                   const char *body, size_t len);
+static void handle_scrape(int fd);
+static bool read_request(int fd, char *request, size_t size);
+static void *run_server(void *unused);
+
+/******************************************************************************/
+
+/**
+ * Start serving metrics on metrics_addr. Returns 0 on success or an error
+ * number on failure.
+ */
+int metrics_start(void)
+{
+    int err = serve_listen(metrics_addr, &listen_fd);
+    if (err) {
+        return err;
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        err = errno;
+    } else {
+        atomic_init(&stopping, false);
+        err = pthread_create(&server, NULL, run_server, NULL);
+    }
+    if (err) {
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    return err;
+}
+
+/**
+ * Stop serving metrics.
+ */
+void metrics_stop(void)
+{
+    if (listen_fd < 0) {
+        return;
+    }
+    atomic_store(&stopping, true);
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+    pthread_join(server, NULL);
+    close(listen_fd);
+    close(wake_fd);
+    listen_fd = -1;
+    wake_fd = -1;
+}
+
+/**
+ * Answer the scraper on the given socket with the given status and body.
+ */
+static void answer(int fd, const char *status, const char *type,
+                   const char *body, size_t len)
+{
+    char head[256];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\n"
+                                         "Content-Type: %s\r\n"
+                                         "Content-Length: %zu\r\n"
+                                         "Connection: close\r\n\r\n",
+                     status, type, len);
+    if (send(fd, head, n, MSG_NOSIGNAL | (len > 0 ? MSG_MORE : 0)) != n) {
+        return;
+    }
+    while (len > 0) {
+        ssize_t sent = send(fd, body, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return;
+        }
+        body += sent;
+        len -= sent;
+    }
+}
+
+/**
+ * Receive the request of the scraper on the given socket and answer it.
+ */
+static void handle_scrape(int fd)
+{
+    char request[REQUEST_NCHARS];
+    if (!read_request(fd, request, sizeof(request))) {
+        return;
+    }
+    static const char get[] = "GET ";
+    if (strncmp(request, get, sizeof(get) - 1) != 0) {
+        static const char text[] = "Only GET is supported.\n";
+        answer(fd, "405 Method Not Allowed", PROMETHEUS_TYPE, text,
+               sizeof(text) - 1);
+        return;
+    }
+    const char *path = &request[sizeof(get) - 1];
+    size_t path_len = strcspn(path, " \r\n");
+    if (path_len != sizeof("/metrics") - 1
+        || strncmp(path, "/metrics", path_len) != 0) {
+        static const char text[] = "Metrics are served at /metrics.\n";
+        answer(fd, "404 Not Found", PROMETHEUS_TYPE, text, sizeof(text) - 1);
+        return;
+    }
+
+    // OpenMetrics is only served to scrapers that accept it.
+    const char *headers = &path[path_len];
+    bool openmetrics = strcasestr(headers, "application/openmetrics-text")
+                       != NULL;
+    char *body = NULL;
+    size_t len = 0;
+    FILE *fh = open_memstream(&body, &len);
+    if (fh == NULL) {
+        fprintf(stderr, "Failure to allocate metrics.\n");
+        abort();
+    }
+    stats_write_metrics(fh, openmetrics);
+    fclose(fh);
+    answer(fd, "200 OK", openmetrics ? OPENMETRICS_TYPE : PROMETHEUS_TYPE,
+           body, len);
+    free(body);
+}
+
+/**
+ * Receive the request of the scraper on the given socket, up to the blank line
+ * ending its headers, into request as a string. Returns false if the scraper
+ * went away, stalled or sent too much.
+ */
+static bool read_request(int fd, char *request, size_t size)
+{
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = recv(fd, &request[len], size - 1 - len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        len += n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL
+            || strstr(request, "\n\n") != NULL) {
+            return true;
+        }
+        if (len == size - 1) {
+            return false;
+        }
+    }
+}
+
+/**
+ * Run thread of execution that accepts scrapers and answers them.
+ */
+static void *run_server(void *unused)
+{
+    while (!atomic_load(&stopping)) {
+        struct pollfd fds[2] = {
+            { .fd = listen_fd, .events = POLLIN },
+            { .fd = wake_fd, .events = POLLIN },
+        };
+        if (poll(fds, 2, -1) < 0 || !(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        struct timeval timeout = { .tv_sec = TIMEOUT_SECS };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handle_scrape(fd);
+        close(fd);
+    }
+    return NULL;
+}
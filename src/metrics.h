@@ -0,0 +1,52 @@
+/** @file
+ * HTTP endpoint the counters are scraped from as metrics.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Fleets of hosts running the software are monitored by scraping the counters
+ * of each, see stats.h, over HTTP:
+ *
+ *     GET /metrics    every counter in the text format of Prometheus, or of
+ *                     OpenMetrics when the Accept header asks for it
+ *
+ * Rates of lines and bytes follow from the counters, while the time since each
+ * device was last read tells of a device gone quiet and the lines queued for
+ * the writer of a host falling behind. Scrapes only read the counters, so they
+ * never pause the devices or the writer.
+ */
+#ifndef METRICS_H_
+#define METRICS_H_
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *metrics_addr;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int metrics_start(void);
+void metrics_stop(void);
+
+#endif
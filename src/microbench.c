@@ -0,0 +1,422 @@
+/** @file
+ * Microbenchmarks of the hot paths of line handling.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Each benchmark repeats one operation, doubling the number of repetitions
+ * until a run lasts long enough to time, and reports the time each operation
+ * took as a JSON Lines object on stdout:
+ *
+ *     {"benchmark":"tokenize_time","keys":0,"iterations":4194304,
+ *      "ns_per_op":21.4}
+ *
+ * Covered are tokenizing lines in the `-v time` format by the single scan and
+ * by the regular expression it falls back to, tokenizing lines in the
+ * `-v threadtime` format, parsing lines as devices do, rendering colorized
+ * columns and adding keys to and looking them up in a strmap of 1k, 100k and
+ * 1M keys. Naming benchmarks on the command line runs only those whose names
+ * start with one of them.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <regex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ccan/strmap/strmap.h>
+
+#include "color.h"
+#include "logcat.h"
+#include "scan.h"
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Shortest run, in nanoseconds, whose time is reported. */
+#define RUN_MIN_NS (200000000ULL)
+
+/** Maximum number of characters of a key of a strmap. */
+#define KEY_NCHARS (16)
+
+/** Most tags held by the tag map, enough for the largest set of keys. */
+#define TAGS_NMAX (2000000)
+
+/** Number of lines of sample_lines. */
+#define SAMPLE_NLINES (sizeof(sample_lines) / sizeof(sample_lines[0]))
+
+/** Number of lines of threadtime_lines. */
+#define THREADTIME_NLINES \
+    (sizeof(threadtime_lines) / sizeof(threadtime_lines[0]))
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * A strmap of keys to their index.
+ */
+struct key_map {
+    STRMAP_MEMBERS(uintptr_t *);
+};
+
+/**
+ * A benchmark repeating a single operation.
+ */
+struct benchmark {
+    const char *name;                      //!< Name reported.
+    unsigned    keys;                      //!< Number of keys, 0 if unkeyed.
+    uint64_t  (*run)(unsigned keys, uint64_t iterations); //!< Operation,
+                                           //!< returning the ns it took.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Flag that indicates whether or not we are to shutdown software. */
+atomic_bool shutdown_requested = false;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Lines of logcat output, in the `-v time` format, that are parsed. */
+static const char *const sample_lines[] = {
+    "10-14 12:00:00.001 I/ActivityManager(  612): Start proc 3141:com.example"
+    ".app/u0a123 for activity {com.example.app/.MainActivity}",
+    "10-14 12:00:00.002 D/WifiStateMachine(  612): processMsg: ConnectedState",
+    "10-14 12:00:00.017 V/AudioFlinger(  240): mixer(0xb4000070) throttle end",
+    "10-14 12:00:00.018 W/InputDispatcher(  612): channel '4a1c0 (server)' ~ "
+    "Consumer closed input channel or an error occurred.  events=0x9",
+    "10-14 12:00:00.512 E/BluetoothHal( 1021): hci_timeout: 0x0c03",
+    "10-14 12:00:01.000 I/chatty  ( 2201): uid=10123(com.example.app) "
+    "RenderThread identical 4 lines",
+    "10-14 12:00:01.250 D/PowerManagerService(  612): acquireWakeLock flags="
+    "0x1 tag=*job*/com.example.app/.SyncService uid=10123 pid=3141",
+    "10-14 12:00:01.251 F/libc    ( 3141): Fatal signal 11 (SIGSEGV), code 1",
+};
+
+/** The same lines in the `-v threadtime` format. */
+static const char *const threadtime_lines[] = {
+    "10-14 12:00:00.001   612   640 I ActivityManager: Start proc 3141:com."
+    "example.app/u0a123 for activity {com.example.app/.MainActivity}",
+    "10-14 12:00:00.002   612   701 D WifiStateMachine: processMsg: "
+    "ConnectedState",
+    "10-14 12:00:00.017   240   255 V AudioFlinger: mixer(0xb4000070) "
+    "throttle end",
+    "10-14 12:00:00.018   612   633 W InputDispatcher: channel '4a1c0 "
+    "(server)' ~ Consumer closed input channel or an error occurred.  "
+    "events=0x9",
+    "10-14 12:00:00.512  1021  1090 E BluetoothHal: hci_timeout: 0x0c03",
+    "10-14 12:00:01.000  2201  2201 I chatty  : uid=10123(com.example.app) "
+    "RenderThread identical 4 lines",
+    "10-14 12:00:01.250   612  1544 D PowerManagerService: acquireWakeLock "
+    "flags=0x1 tag=*job*/com.example.app/.SyncService uid=10123 pid=3141",
+    "10-14 12:00:01.251  3141  3170 F libc    : Fatal signal 11 (SIGSEGV), "
+    "code 1",
+};
+
+/** Sink results are stored to so that the work producing them is kept. */
+static volatile uintptr_t sink;
+
+/** Keys of the strmap, KEY_NCHARS characters each. */
+static char *keys_text;
+
+/** Number of keys in keys_text. */
+static unsigned keys_n;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static uint64_t bench_color_column(unsigned keys, uint64_t iterations);
+static uint64_t bench_logcat_parse(unsigned keys, uint64_t iterations);
+static uint64_t bench_strmap_add(unsigned keys, uint64_t iterations);
+static uint64_t bench_strmap_get(unsigned keys, uint64_t iterations);
+static uint64_t bench_tag_intern(unsigned keys, uint64_t iterations);
+static uint64_t bench_tokenize_regex(unsigned keys, uint64_t iterations);
+static uint64_t bench_tokenize_threadtime(unsigned keys, uint64_t iterations);
+static uint64_t bench_tokenize_time(unsigned keys, uint64_t iterations);
+static void init_keys(unsigned n);
+static uint64_t now_ns(void);
+static bool selected(const char *name, int argc, char *argv[]);
+
+/** Every benchmark, in the order run. */
+static const struct benchmark benchmarks[] = {
+    { "tokenize_time",       0,       bench_tokenize_time       },
+    { "tokenize_threadtime", 0,       bench_tokenize_threadtime },
+    { "tokenize_regex",      0,       bench_tokenize_regex      },
+    { "logcat_parse",        0,       bench_logcat_parse        },
+    { "color_column",        0,       bench_color_column        },
+    { "strmap_add",          1000,    bench_strmap_add          },
+    { "strmap_add",          100000,  bench_strmap_add          },
+    { "strmap_add",          1000000, bench_strmap_add          },
+    { "strmap_get",          1000,    bench_strmap_get          },
+    { "strmap_get",          100000,  bench_strmap_get          },
+    { "strmap_get",          1000000, bench_strmap_get          },
+    { "tag_intern",          1000,    bench_tag_intern          },
+    { "tag_intern",          100000,  bench_tag_intern          },
+    { "tag_intern",          1000000, bench_tag_intern          },
+};
+
+/******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    scan_init();
+    tag_map_init(TAGS_NMAX);
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+        const struct benchmark *b = &benchmarks[i];
+        if (!selected(b->name, argc, argv)) {
+            continue;
+        }
+        init_keys(b->keys);
+
+        uint64_t iterations = b->keys > 0 ? b->keys : 1;
+        uint64_t elapsed;
+        for (;;) {
+            elapsed = b->run(b->keys, iterations);
+            if (elapsed >= RUN_MIN_NS) {
+                break;
+            }
+            iterations *= 2;
+        }
+        printf("{\"benchmark\":\"%s\",\"keys\":%u,\"iterations\":%llu,"
+               "\"ns_per_op\":%.1f,\"scan\":\"%s\"}\n", b->name, b->keys,
+               (unsigned long long)iterations, (double)elapsed / iterations,
+               scan_name());
+        fflush(stdout);
+    }
+    tag_map_clear();
+    free(keys_text);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Render a colorized tag column.
+ */
+static uint64_t bench_color_column(unsigned keys, uint64_t iterations)
+{
+    struct column col;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        color_render_column(&col, i % COLOR_NMAX, "ActivityManager",
+                            COLUMN_WIDTH_MAX);
+        sink += col.len;
+    }
+    return now_ns() - start;
+}
+
+/**
+ * Parse a line as devices do, by the scan with the regular expression to
+ * fall back to.
+ */
+static uint64_t bench_logcat_parse(unsigned keys, uint64_t iterations)
+{
+    struct logcat_parser parser;
+    logcat_parser_init(&parser);
+    regmatch_t matches[MESSAGE_NPARTS];
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const char *line = sample_lines[i % SAMPLE_NLINES];
+        sink += logcat_parse(&parser, line, strlen(line), matches);
+    }
+    uint64_t elapsed = now_ns() - start;
+    logcat_parser_free(&parser);
+    return elapsed;
+}
+
+/**
+ * Add keys to a strmap, a map of the given number of keys at a time; each
+ * iteration is one key added.
+ */
+static uint64_t bench_strmap_add(unsigned keys, uint64_t iterations)
+{
+    struct key_map map;
+    strmap_init(&map);
+    uint64_t elapsed = 0;
+    for (uint64_t i = 0; i < iterations;) {
+        uint64_t start = now_ns();
+        for (unsigned j = 0; j < keys && i < iterations; ++j, ++i) {
+            char *key = &keys_text[j * KEY_NCHARS];
+            sink += strmap_add(&map, key, (uintptr_t *)key);
+        }
+        elapsed += now_ns() - start;
+        strmap_clear(&map);
+    }
+    return elapsed;
+}
+
+/**
+ * Look up keys, in no particular order, in a strmap of the given number of
+ * keys.
+ */
+static uint64_t bench_strmap_get(unsigned keys, uint64_t iterations)
+{
+    struct key_map map;
+    strmap_init(&map);
+    for (unsigned i = 0; i < keys; ++i) {
+        char *key = &keys_text[i * KEY_NCHARS];
+        strmap_add(&map, key, (uintptr_t *)key);
+    }
+    uint64_t index = 0;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        // Stride through the keys by a prime so lookups miss the caches.
+        index = (index + 7919) % keys;
+        sink += (uintptr_t)strmap_get(&map, &keys_text[index * KEY_NCHARS]);
+    }
+    uint64_t elapsed = now_ns() - start;
+    strmap_clear(&map);
+    return elapsed;
+}
+
+/**
+ * Intern keys, in no particular order, held by a tag map of at least the
+ * given number of tags. Most lookups miss the cache of each thread and
+ * search the shared table.
+ */
+static uint64_t bench_tag_intern(unsigned keys, uint64_t iterations)
+{
+    tag_read_begin();
+    for (unsigned i = 0; i < keys; ++i) {
+        const char *key = &keys_text[i * KEY_NCHARS];
+        tag_intern(key, strlen(key));
+    }
+    uint64_t index = 0;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        index = (index + 7919) % keys;
+        const char *key = &keys_text[index * KEY_NCHARS];
+        sink += (uintptr_t)tag_intern(key, strlen(key));
+    }
+    uint64_t elapsed = now_ns() - start;
+    tag_read_end();
+    return elapsed;
+}
+
+/**
+ * Tokenize a line by the regular expression alone, as every line once was.
+ */
+static uint64_t bench_tokenize_regex(unsigned keys, uint64_t iterations)
+{
+    struct logcat_parser parser;
+    logcat_parser_init(&parser);
+    regmatch_t matches[MESSAGE_NPARTS];
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const char *line = sample_lines[i % SAMPLE_NLINES];
+        matches[WHOLE].rm_so = 0;
+        matches[WHOLE].rm_eo = strlen(line);
+        sink += regexec(&parser.preg, line, MESSAGE_NPARTS, matches,
+                        REG_STARTEND);
+    }
+    uint64_t elapsed = now_ns() - start;
+    logcat_parser_free(&parser);
+    return elapsed;
+}
+
+/**
+ * Tokenize a line by the single scan of the `-v threadtime` format.
+ */
+static uint64_t bench_tokenize_threadtime(unsigned keys, uint64_t iterations)
+{
+    regmatch_t matches[MESSAGE_NPARTS];
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const char *line = threadtime_lines[i % THREADTIME_NLINES];
+        sink += logcat_tokenize_threadtime(line, strlen(line), matches);
+    }
+    return now_ns() - start;
+}
+
+/**
+ * Tokenize a line by the single scan of the `-v time` format.
+ */
+static uint64_t bench_tokenize_time(unsigned keys, uint64_t iterations)
+{
+    regmatch_t matches[MESSAGE_NPARTS];
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        const char *line = sample_lines[i % SAMPLE_NLINES];
+        sink += logcat_tokenize_time(line, strlen(line), matches);
+    }
+    return now_ns() - start;
+}
+
+/**
+ * Make the given number of distinct keys, alike in the way serial numbers
+ * and tags are, unless as many were made already.
+ */
+static void init_keys(unsigned n)
+{
+    if (n <= keys_n) {
+        return;
+    }
+    free(keys_text);
+    keys_text = malloc((size_t)n * KEY_NCHARS);
+    if (keys_text == NULL) {
+        fprintf(stderr, "Failure to allocate keys.\n");
+        abort();
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        snprintf(&keys_text[(size_t)i * KEY_NCHARS], KEY_NCHARS, "Tag%08X",
+                 i * 2654435761U);
+    }
+    keys_n = n;
+}
+
+/**
+ * Return the time on the monotonic clock in nanoseconds.
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Return whether the benchmark of the given name is to be run: every one is
+ * when none are named on the command line.
+ */
+static bool selected(const char *name, int argc, char *argv[])
+{
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(name, argv[i], strlen(argv[i])) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,772 @@
+/** @file
+ * Output writer fed by a lock-free queue of finished lines.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The ring is the bounded queue of Dmitry Vyukov: every slot carries a
+ * sequence number that tells producers whether the slot is free for the lap
+ * they are on and tells the consumer whether the slot has been published.
+ * Producers claim slots by advancing the head with compare and swap. The tail
+ * is advanced the same way, since producers dropping the oldest line consume it
+ * as well as the writer. What a slot holds is told apart through a separate
+ * field published along with it, so that producers only ever consume lines
+ * they may drop.
+ *
+ * Errors and fatal lines are queued within a lane of their own, a second such
+ * ring the writer always drains first, so that they never wait behind the
+ * verbose lines of a flood. Lines of a device still go out in the order it
+ * pushed them: the lines queued in each lane are counted by device, and a
+ * device only moves to the other lane once none of its lines are left in
+ * the lane it is in. While its error waits in the urgent lane, the device's
+ * next lines follow it there.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "output.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "merge.h"
+#include "record.h"
+#include "serve.h"
+#include "sink.h"
+#include "stats.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of slots in the ring; must be a power of two. */
+#define RING_NSLOTS (4096)
+
+/** Number of slots in the ring of the urgent lane; must be a power of two. */
+#define URGENT_NSLOTS (1024)
+
+/** Number of counters of lines queued in each lane; a power of two. */
+#define QUEUED_NSLOTS (1024)
+
+/** Maximum number of fragments handed to a writev(), IOV_MAX on Linux. */
+#define WRITE_IOV_NMAX (1024)
+
+/** Maximum number of lines written by a single writev(). */
+#define WRITE_BATCH_NMAX (WRITE_IOV_NMAX / OUTPUT_NIOV)
+
+/** Number of times a producer yields on a full ring before sleeping. */
+#define FULL_YIELDS_NMAX (64)
+
+/** Nanoseconds a producer sleeps while waiting on a full ring. */
+#define FULL_SLEEP_NSECS (100 * 1000)
+
+/** Number of counters of lines dropped; a power of two. */
+#define DROPS_NSLOTS (1024)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * What a slot holds as far as dropping it goes.
+ */
+enum kind {
+    KIND_KEEP = 0, //!< Never dropped.
+    KIND_LINE,     //!< Line that may be dropped.
+    KIND_VERBOSE,  //!< Verbose or debug line, dropped first.
+};
+
+/**
+ * Lanes of lines queued for the writer, drained in this order.
+ */
+enum lane_id {
+    LANE_URGENT = 0, //!< Errors and fatal lines, and any line following them.
+    LANE_NORMAL,     //!< Every other line.
+    LANES_N
+};
+
+/**
+ * Slot within the ring.
+ */
+struct slot {
+    atomic_size_t        seq;  //!< Sequence number of the slot.
+    atomic_int           kind; //!< What the record is, see enum kind.
+    struct output_record rec;  //!< Record stored in the slot.
+};
+
+/**
+ * Ring of a lane of lines.
+ */
+struct lane {
+    struct slot   *slots;  //!< Storage for the ring.
+    size_t         nslots; //!< Number of slots; a power of two.
+    atomic_size_t  head;   //!< Position of the next slot to be claimed by a
+                           //!< producer.
+    atomic_size_t  tail;   //!< Position of the next slot to be consumed.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Format lines are written in. */
+enum output_format output_format = OUTPUT_COLOR;
+
+/** What becomes of lines pushed while the ring is full. */
+enum output_policy output_policy = OUTPUT_BLOCK;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Lines dropped, counted by device identifier. */
+static atomic_uint_fast64_t drops[DROPS_NSLOTS];
+
+/** File descriptor that lines are written to. */
+static int out_fd = -1;
+
+/** Rings of the lanes, by lane identifier; NULL storage when closed. */
+static struct lane lanes[LANES_N];
+
+/** Lines queued within each lane, counted by device identifier. */
+static atomic_uint_fast32_t queued[LANES_N][QUEUED_NSLOTS];
+
+/** Flag that indicates the writer should exit once the ring is empty. */
+static atomic_bool closing;
+
+/** Whether lines are merged across sources in the order they were logged. */
+static bool merging;
+
+/** Whether lines are served to subscribers instead, see serve.h. */
+static bool serving;
+
+/** Whether lines are written to the files of their sources, see sink.h. */
+static bool sinking;
+
+/** Thread of execution that drains the ring. */
+static pthread_t writer;
+
+/** Flag that indicates the writer is, or is about to be, asleep. */
+static atomic_bool writer_sleeping;
+
+/** Lock used with writer_wake to put the writer to sleep. */
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Condition signalled when lines are published to a sleeping writer. */
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void count_drop(const struct output_record *rec);
+static void free_lanes(void);
+static enum kind kind_of(const struct output_record *rec);
+static int lane_of(const struct output_record *rec);
+static void note_written(const struct output_record *recs, int n,
+                         uint64_t now);
+static uint64_t now_ms(void);
+static bool ring_drop(enum lane_id id, enum kind kind);
+static bool ring_peek(void);
+static bool ring_pop(struct output_record *rec);
+static bool ring_push(enum lane_id id, const struct output_record *rec);
+static void *run_writer(void *unused);
+static void wait_writer(uint64_t due);
+static void wake_writer(void);
+static void write_all(struct iovec *iov, int iovcnt);
+
+/******************************************************************************/
+
+/**
+ * Write out every line still queued and stop the writer thread. Producers must
+ * have stopped pushing before this is called.
+ */
+void output_close(void)
+{
+    if (lanes[LANE_NORMAL].slots == NULL) {
+        return;
+    }
+    atomic_store(&closing, true);
+    wake_writer();
+    pthread_join(writer, NULL);
+    free_lanes();
+    if (merging) {
+        merge_free();
+        merging = false;
+    }
+    if (sinking) {
+        sink_free();
+        sinking = false;
+    }
+    record_free();
+}
+
+/**
+ * Return the number of lines of the device with the given identifier dropped
+ * since last asked, forgetting them.
+ */
+uint64_t output_drops_take(uint32_t device)
+{
+    atomic_uint_fast64_t *count = &drops[device & (DROPS_NSLOTS - 1)];
+    if (atomic_load_explicit(count, memory_order_relaxed) == 0) {
+        return 0;
+    }
+    return atomic_exchange_explicit(count, 0, memory_order_relaxed);
+}
+
+/**
+ * Start the writer thread that writes queued lines to the given file
+ * descriptor, to the files of their sources when sink_dir is set or to
+ * subscribers when serve_addr is set. Unless
+ * merge_ms is 0, lines are merged in the order they were logged waiting up to
+ * merge_ms milliseconds on those of other sources. Returns 0 on success or an
+ * error number on failure.
+ */
+int output_init(int fd, unsigned merge_ms)
+{
+    static const size_t nslots[LANES_N] = {
+        [LANE_URGENT] = URGENT_NSLOTS,
+        [LANE_NORMAL] = RING_NSLOTS,
+    };
+    for (int i = 0; i < LANES_N; ++i) {
+        struct lane *l = &lanes[i];
+        l->slots = malloc(sizeof(*l->slots) * nslots[i]);
+        if (l->slots == NULL) {
+            free_lanes();
+            return ENOMEM;
+        }
+        l->nslots = nslots[i];
+        for (size_t j = 0; j < l->nslots; ++j) {
+            atomic_init(&l->slots[j].seq, j);
+            atomic_init(&l->slots[j].kind, KIND_KEEP);
+        }
+        atomic_init(&l->head, 0);
+        atomic_init(&l->tail, 0);
+    }
+    if (merge_ms > 0) {
+        int err = merge_init(merge_ms);
+        if (err) {
+            free_lanes();
+            return err;
+        }
+        merging = true;
+    }
+    atomic_init(&closing, false);
+    atomic_init(&writer_sleeping, false);
+    out_fd = fd;
+    serving = serve_addr != NULL;
+    sinking = sink_dir != NULL;
+
+    int err = pthread_create(&writer, NULL, run_writer, NULL);
+    if (err) {
+        free_lanes();
+        if (merging) {
+            merge_free();
+            merging = false;
+        }
+    }
+    return err;
+}
+
+/**
+ * Queue the given record for output. Ownership of the references on the
+ * record's buffers passes to the writer. While the ring is full, lines are
+ * dropped as the output policy has it or else waited on.
+ */
+void output_push(const struct output_record *rec)
+{
+    int yields = 0;
+    enum kind kind = kind_of(rec);
+    int id;
+    while ((id = lane_of(rec)) < 0 || !ring_push(id, rec)) {
+        if (id >= 0 && output_policy == OUTPUT_DROP_VERBOSE
+            && kind == KIND_VERBOSE) {
+            struct output_record dropped = *rec;
+            count_drop(&dropped);
+            output_release(&dropped);
+            return;
+        }
+        if (id >= 0 && output_policy == OUTPUT_DROP_OLDEST
+            && ring_drop(id, KIND_LINE)) {
+            continue;
+        }
+        if (id >= 0 && output_policy == OUTPUT_DROP_VERBOSE
+            && ring_drop(id, KIND_VERBOSE)) {
+            continue;
+        }
+        if (yields < FULL_YIELDS_NMAX) {
+            ++yields;
+            sched_yield();
+        } else {
+            struct timespec ts = { 0, FULL_SLEEP_NSECS };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    // Pairs with the fence in run_writer() so that either the writer sees the
+    // record or we see that the writer is going to sleep.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&writer_sleeping, memory_order_relaxed)) {
+        wake_writer();
+    }
+}
+
+/**
+ * Return the number of lines queued for the writer at this moment.
+ */
+size_t output_queued(void)
+{
+    size_t n = 0;
+    for (int i = 0; i < LANES_N; ++i) {
+        size_t tail = atomic_load_explicit(&lanes[i].tail,
+                                           memory_order_relaxed);
+        size_t head = atomic_load_explicit(&lanes[i].head,
+                                           memory_order_relaxed);
+        n += head > tail ? head - tail : 0;
+    }
+    return n;
+}
+
+/**
+ * Drop the references the given record holds on its buffers.
+ */
+void output_release(struct output_record *rec)
+{
+    for (int i = 0; i < OUTPUT_NBUFS; ++i) {
+        if (rec->bufs[i] != NULL) {
+            buffer_unref(rec->bufs[i]);
+            rec->bufs[i] = NULL;
+        }
+    }
+}
+
+/**
+ * Mark the end of the lines of the given source, those of the device with the
+ * given identifier. The source must not be used afterwards.
+ */
+void output_source_close(uint32_t source, uint32_t device)
+{
+    if (merging || sinking) {
+        struct output_record rec = { .source = source, .device = device };
+        output_push(&rec);
+    }
+}
+
+/**
+ * Return the identifier lines of a new source, the device with the given
+ * serial number, are to be pushed with.
+ */
+uint32_t output_source_open(const char *name)
+{
+    if (sinking) {
+        return sink_open(name);
+    }
+    return merging ? merge_source_open() : 0;
+}
+
+/**
+ * Count the given record as dropped for its device.
+ */
+static void count_drop(const struct output_record *rec)
+{
+    atomic_fetch_add_explicit(&drops[rec->device & (DROPS_NSLOTS - 1)], 1,
+                              memory_order_relaxed);
+}
+
+/**
+ * Free the storage of the rings of the lanes.
+ */
+static void free_lanes(void)
+{
+    for (int i = 0; i < LANES_N; ++i) {
+        free(lanes[i].slots);
+        lanes[i].slots = NULL;
+    }
+}
+
+/**
+ * Return what the given record is as far as dropping it goes.
+ */
+static enum kind kind_of(const struct output_record *rec)
+{
+    if (rec->niov == 0 || rec->priority == 0) {
+        return KIND_KEEP;
+    }
+    return rec->priority == 'V' || rec->priority == 'D' ? KIND_VERBOSE
+                                                        : KIND_LINE;
+}
+
+/**
+ * Return the identifier of the lane the given record is to be queued in, or -1
+ * when it must wait for the lines its device has queued in the urgent lane to
+ * be written first.
+ */
+static int lane_of(const struct output_record *rec)
+{
+    size_t i = rec->device & (QUEUED_NSLOTS - 1);
+    uint_fast32_t normal = atomic_load_explicit(&queued[LANE_NORMAL][i],
+                                                memory_order_acquire);
+    uint_fast32_t urgent = atomic_load_explicit(&queued[LANE_URGENT][i],
+                                                memory_order_acquire);
+    bool error = rec->niov > 0
+                 && (rec->priority == 'E' || rec->priority == 'F');
+    if (normal == 0 && (urgent > 0 || error)) {
+        return LANE_URGENT;
+    }
+    // Devices sharing a counter may find lines queued in both lanes.
+    return urgent == 0 ? LANE_NORMAL : -1;
+}
+
+/**
+ * Count the given records as written at the given time in nanoseconds.
+ */
+static void note_written(const struct output_record *recs, int n,
+                         uint64_t now)
+{
+    uint64_t lines = 0;
+    uint64_t bytes = 0;
+    for (int i = 0; i < n; ++i) {
+        if (recs[i].niov == 0) {
+            continue;
+        }
+        ++lines;
+        for (int j = 0; j < recs[i].niov; ++j) {
+            bytes += recs[i].iov[j].iov_len;
+        }
+        if (recs[i].read_ns != 0 && recs[i].read_ns <= now) {
+            stats_latency(now - recs[i].read_ns);
+        }
+    }
+    stats_written(lines, bytes);
+}
+
+/**
+ * Return the current time of the monotonic clock in milliseconds.
+ */
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Drop the record at the tail of the ring of the lane with the given
+ * identifier should it be a line of at least the given kind, KIND_LINE and
+ * KIND_VERBOSE alike or KIND_VERBOSE alone. Returns whether a line was dropped.
+ */
+static bool ring_drop(enum lane_id id, enum kind kind)
+{
+    struct lane *l = &lanes[id];
+    size_t pos = atomic_load_explicit(&l->tail, memory_order_relaxed);
+    struct slot *slot = &l->slots[pos & (l->nslots - 1)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != pos + 1) {
+        return false;
+    }
+    // Should the slot be consumed meanwhile, claiming it below fails.
+    enum kind held = atomic_load_explicit(&slot->kind, memory_order_relaxed);
+    if (held == KIND_KEEP || (kind == KIND_VERBOSE && held != KIND_VERBOSE)) {
+        return false;
+    }
+    if (!atomic_compare_exchange_strong_explicit(&l->tail, &pos, pos + 1,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed)) {
+        return false;
+    }
+    struct output_record rec = slot->rec;
+    atomic_store_explicit(&slot->seq, pos + l->nslots, memory_order_release);
+    atomic_fetch_sub_explicit(&queued[id][rec.device & (QUEUED_NSLOTS - 1)], 1,
+                              memory_order_release);
+    count_drop(&rec);
+    output_release(&rec);
+    return true;
+}
+
+/**
+ * Return whether a published record is waiting at the tail of the ring of
+ * either lane.
+ */
+static bool ring_peek(void)
+{
+    for (int i = 0; i < LANES_N; ++i) {
+        struct lane *l = &lanes[i];
+        size_t pos = atomic_load_explicit(&l->tail, memory_order_relaxed);
+        struct slot *slot = &l->slots[pos & (l->nslots - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq == pos + 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Remove the record at the tail of the ring of the urgent lane or, when it is
+ * empty, of the normal lane. Returns false if both rings are empty.
+ */
+static bool ring_pop(struct output_record *rec)
+{
+    for (int i = 0; i < LANES_N; ++i) {
+        struct lane *l = &lanes[i];
+        size_t pos = atomic_load_explicit(&l->tail, memory_order_relaxed);
+        struct slot *slot;
+        for (;;) {
+            slot = &l->slots[pos & (l->nslots - 1)];
+            size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (atomic_compare_exchange_weak_explicit(
+                        &l->tail, &pos, pos + 1, memory_order_relaxed,
+                        memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                slot = NULL;
+                break;
+            } else {
+                pos = atomic_load_explicit(&l->tail, memory_order_relaxed);
+            }
+        }
+        if (slot == NULL) {
+            continue;
+        }
+        *rec = slot->rec;
+        atomic_store_explicit(&slot->seq, pos + l->nslots,
+                              memory_order_release);
+        atomic_fetch_sub_explicit(&queued[i][rec->device & (QUEUED_NSLOTS - 1)],
+                                  1, memory_order_release);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Place the given record at the head of the ring of the lane with the given
+ * identifier. Returns false if the ring is full.
+ */
+static bool ring_push(enum lane_id id, const struct output_record *rec)
+{
+    struct lane *l = &lanes[id];
+    size_t pos = atomic_load_explicit(&l->head, memory_order_relaxed);
+    struct slot *slot;
+    for (;;) {
+        slot = &l->slots[pos & (l->nslots - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&l->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&l->head, memory_order_relaxed);
+        }
+    }
+    // Counted before being published, so that the writer never finds it
+    // uncounted.
+    atomic_fetch_add_explicit(&queued[id][rec->device & (QUEUED_NSLOTS - 1)], 1,
+                              memory_order_relaxed);
+    slot->rec = *rec;
+    atomic_store_explicit(&slot->kind, kind_of(rec), memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Run thread of execution that drains the ring writing batches of lines. When
+ * merging, lines go through the reorder buffer on their way from the ring.
+ * When sinking, lines are gathered into the batches of their sources. When
+ * serving, lines are handed to the subscribers' ring instead of written.
+ */
+static void *run_writer(void *unused)
+{
+    struct output_record recs[WRITE_BATCH_NMAX];
+    struct iovec iov[WRITE_IOV_NMAX];
+    uint8_t names[WRITE_BATCH_NMAX][RECORD_NAME_NBYTES];
+
+    affinity_pin(AFFINITY_WRITERS);
+    if (output_format == OUTPUT_BINARY) {
+        struct iovec start = { (void *)record_start, sizeof(record_start) };
+        write_all(&start, 1);
+    }
+
+    for (;;) {
+        int n = 0;
+        int iovcnt = 0;
+        if (sinking) {
+            struct output_record rec;
+            uint64_t now = stats_now_ns();
+            while (n < WRITE_BATCH_NMAX && ring_pop(&rec)) {
+                if (rec.niov == 0) {
+                    sink_close(rec.source);
+                } else {
+                    sink_append(rec.source, rec.iov, rec.niov);
+                    note_written(&rec, 1, now);
+                }
+                output_release(&rec);
+                ++n;
+            }
+            if (n > 0) {
+                continue;
+            }
+            // Whatever is gathered goes out before the writer idles.
+            sink_flush();
+        } else if (merging) {
+            uint64_t now = now_ms();
+            struct output_record rec;
+            while (!merge_full() && ring_pop(&rec)) {
+                merge_hold(&rec, now);
+            }
+            // Once closing, every line that will ever be held is.
+            bool flush = atomic_load(&closing) && !ring_peek();
+            while (n < WRITE_BATCH_NMAX && merge_next(&recs[n], now, flush)) {
+                ++n;
+            }
+        } else {
+            while (n < WRITE_BATCH_NMAX && ring_pop(&recs[n])) {
+                ++n;
+            }
+        }
+
+        if (n > 0 && serving) {
+            serve_write(recs, n);
+            note_written(recs, n, stats_now_ns());
+            for (int i = 0; i < n; ++i) {
+                output_release(&recs[i]);
+            }
+            continue;
+        }
+        if (n > 0) {
+            for (int i = 0; i < n; ++i) {
+                if (output_format == OUTPUT_BINARY) {
+                    iovcnt += record_describe(&recs[i], &iov[iovcnt],
+                                              names[i]);
+                    continue;
+                }
+                for (int j = 0; j < recs[i].niov; ++j) {
+                    iov[iovcnt++] = recs[i].iov[j];
+                }
+            }
+            write_all(iov, iovcnt);
+            note_written(recs, n, stats_now_ns());
+            for (int i = 0; i < n; ++i) {
+                output_release(&recs[i]);
+            }
+            continue;
+        }
+
+        uint64_t due = merging ? merge_due() : MERGE_NEVER;
+        if (due != MERGE_NEVER && due <= now_ms()) {
+            continue;
+        }
+        if (atomic_load(&closing) && !ring_peek()) {
+            if (due == MERGE_NEVER) {
+                break;
+            }
+            continue;
+        }
+        wait_writer(due);
+    }
+    return NULL;
+}
+
+/**
+ * Put the writer to sleep until a producer publishes a line, the writer is
+ * closing or the given time in milliseconds passes.
+ */
+static void wait_writer(uint64_t due)
+{
+    stats_lock(&writer_lock, STATS_LOCK_WRITER);
+    atomic_store_explicit(&writer_sleeping, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!ring_peek() && !atomic_load(&closing)) {
+        if (due == MERGE_NEVER) {
+            pthread_cond_wait(&writer_wake, &writer_lock);
+            continue;
+        }
+        uint64_t now = now_ms();
+        if (due <= now) {
+            break;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t nsec = ts.tv_nsec + (due - now) * 1000000;
+        ts.tv_sec += nsec / 1000000000;
+        ts.tv_nsec = nsec % 1000000000;
+        pthread_cond_timedwait(&writer_wake, &writer_lock, &ts);
+    }
+    atomic_store_explicit(&writer_sleeping, false, memory_order_relaxed);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+/**
+ * Wake the writer should it be asleep.
+ */
+static void wake_writer(void)
+{
+    stats_lock(&writer_lock, STATS_LOCK_WRITER);
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+/**
+ * Write every byte described by the given vector, resuming after partial
+ * writes.
+ */
+static void write_all(struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(out_fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failure to write output: %d\n", errno);
+            return;
+        }
+
+        // Skip past the vectors that were completely written.
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/** @file
+ * Output writer fed by a lock-free queue of finished lines.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Device threads push finished lines into a bounded multi-producer single
+ * consumer ring. A line is a list of fragments that point either at constant
+ * decoration strings or at the bytes read from the device, so text is never
+ * copied on its way to the kernel. A single writer thread drains the ring and
+ * hands whole batches of lines to the kernel with writev(). Pushing a line
+ * never takes a lock; the writer is only signalled through a mutex when it has
+ * gone to sleep on an empty ring.
+ *
+ * While the ring is full, lines either wait for room or, so that devices are
+ * always read as fast as they log, are dropped according to the output policy.
+ * Lines dropped are counted for their device, which marks the gap within its
+ * lines once there is room again. Errors and fatal lines are queued apart and
+ * written ahead of the lines of other devices waiting before them, but never
+ * ahead of earlier lines of their own device.
+ *
+ * Lines may instead be merged across their sources in the order they were
+ * logged, see merge.h, written to files of their sources, see sink.h, or
+ * served to subscribers, see serve.h; every producer opens a source for its
+ * lines. Lines that are binary records
+ * are completed by the writer on their way out, see record.h.
+ */
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "buffer.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of buffers the fragments of one line may point into. */
+#define OUTPUT_NBUFS (2)
+
+/** Maximum number of fragments making up one line of output. */
+#define OUTPUT_NIOV (16)
+
+/** Append the string literal s as a fragment of the given record. */
+#define output_add_literal(rec, s) output_add((rec), (s), sizeof(s) - 1)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Formats lines are written in.
+ */
+enum output_format {
+    OUTPUT_COLOR = 0, //!< Colorized text for the console.
+    OUTPUT_BINARY,    //!< Structured binary records, see record.h.
+    OUTPUT_JSONL,     //!< JSON Lines, one object per line, see json.h.
+    OUTPUT_PLAIN,     //!< Text aligned as colorized text is, without any
+                      //!< escape sequences.
+};
+
+/**
+ * What becomes of lines pushed while the ring is full.
+ */
+enum output_policy {
+    OUTPUT_BLOCK = 0,    //!< Wait for room, the default.
+    OUTPUT_DROP_OLDEST,  //!< Drop the oldest line queued.
+    OUTPUT_DROP_VERBOSE, //!< Drop verbose and debug lines, the new one or the
+                         //!< oldest queued, before waiting for room.
+};
+
+/**
+ * A finished line of output waiting to be written.
+ */
+struct output_record {
+    struct buffer *bufs[OUTPUT_NBUFS]; //!< Buffers the fragments point into.
+    uint64_t       key;                //!< Time the line was logged, merge key.
+    uint32_t       source;             //!< Source the line came from.
+    uint64_t       serial;             //!< Serial number of the line's tag
+                                       //!< within binary records.
+    uint64_t       read_ns;            //!< Time the line was read on the
+                                       //!< monotonic clock, 0 if unknown.
+    uint32_t       device;             //!< Identifier of the device.
+    char           priority;           //!< Priority of the line, 0 for
+                                       //!< lines never dropped.
+    int            niov;               //!< Number of fragments in use.
+    struct iovec   iov[OUTPUT_NIOV];   //!< Fragments of the line.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern enum output_format output_format;
+extern enum output_policy output_policy;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void output_close(void);
+uint64_t output_drops_take(uint32_t device);
+int output_init(int fd, unsigned merge_ms);
+void output_push(const struct output_record *rec);
+size_t output_queued(void);
+void output_release(struct output_record *rec);
+void output_source_close(uint32_t source, uint32_t device);
+uint32_t output_source_open(const char *name);
+
+/**
+ * Append a fragment of text to the given record. Empty fragments are skipped.
+ */
+static inline void output_add(struct output_record *rec, const void *data,
+                              size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    rec->iov[rec->niov].iov_base = (void *)data;
+    rec->iov[rec->niov].iov_len = len;
+    ++rec->niov;
+}
+
+#endif
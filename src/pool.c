@@ -0,0 +1,308 @@
+/** @file
+ * Pool of worker threads that steal jobs from one another.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Workers only sleep once every deque was found empty, and a job is counted as
+ * queued before anyone is told of it, so a job is never left waiting while a
+ * worker sleeps.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "pool.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "affinity.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of jobs a deque first has room for. */
+#define DEQUE_NJOBS_MIN (16)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Jobs waiting on a worker, in the order they were handed to it.
+ */
+struct deque {
+    struct pool_job **jobs;  //!< Ring of the jobs.
+    size_t            head;  //!< Index of the oldest job.
+    size_t            count; //!< Number of jobs.
+    size_t            size;  //!< Number of jobs there is room for.
+    pthread_mutex_t   lock;  //!< Lock used to protect the above.
+};
+
+/**
+ * Thread of the pool and the jobs handed to it.
+ */
+struct worker {
+    pthread_t    thread; //!< Thread of execution.
+    unsigned     index;  //!< Index of the worker within the pool.
+    struct deque deque;  //!< Jobs handed to the worker.
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Whether the pool is closing, once every job queued has run. */
+static bool closing;
+
+/** Function every worker calls before it exits, NULL for none. */
+static void (*leave_fn)(void);
+
+/** Index of the worker to be handed the next job. */
+static atomic_uint next_worker;
+
+/** Number of jobs within the deques. */
+static atomic_size_t queued;
+
+/** Number of workers asleep or about to be. */
+static atomic_uint sleepers;
+
+/** Lock used to protect closing and to put workers to sleep. */
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Condition signalled when a job is queued or the pool is closing. */
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+
+/** Workers of the pool. */
+static struct worker *workers;
+
+/** Number of workers, 0 while the pool is not open. */
+static unsigned workers_n;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void push_job(struct deque *q, struct pool_job *job);
+static void *run_worker(void *worker);
+static struct pool_job *take_job(struct worker *w);
+static struct pool_job *take_newest(struct deque *q);
+static struct pool_job *take_oldest(struct deque *q);
+
+/******************************************************************************/
+
+/**
+ * Run every job still queued and stop the workers of the pool.
+ */
+void pool_close(void)
+{
+    if (workers_n == 0) {
+        return;
+    }
+    pthread_mutex_lock(&sleep_lock);
+    closing = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&sleep_lock);
+    for (unsigned i = 0; i < workers_n; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    for (unsigned i = 0; i < workers_n; ++i) {
+        pthread_mutex_destroy(&workers[i].deque.lock);
+        free(workers[i].deque.jobs);
+    }
+    free(workers);
+    workers = NULL;
+    workers_n = 0;
+    closing = false;
+}
+
+/**
+ * Start a pool of the given number of workers, each of which calls the given
+ * function, unless NULL, just before it exits. Returns 0 on success or an
+ * error number on failure.
+ */
+int pool_open(unsigned nworkers, void (*leave)(void))
+{
+    workers = calloc(nworkers, sizeof(*workers));
+    if (workers == NULL) {
+        return ENOMEM;
+    }
+    leave_fn = leave;
+    for (unsigned i = 0; i < nworkers; ++i) {
+        struct worker *w = &workers[i];
+        w->index = i;
+        w->deque.size = DEQUE_NJOBS_MIN;
+        w->deque.jobs = malloc(w->deque.size * sizeof(*w->deque.jobs));
+        if (w->deque.jobs == NULL) {
+            fprintf(stderr, "Failure to allocate pool deque.\n");
+            abort();
+        }
+        pthread_mutex_init(&w->deque.lock, NULL);
+    }
+    // Workers look at one another's deques, so all of them are set up first.
+    workers_n = nworkers;
+    for (unsigned i = 0; i < nworkers; ++i) {
+        int err = pthread_create(&workers[i].thread, NULL, run_worker,
+                                 &workers[i]);
+        if (err) {
+            workers_n = i;
+            pool_close();
+            return err;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Hand the given job to the pool. The job is run once by some worker; it must
+ * stay valid until then. The pool must be open.
+ */
+void pool_submit(struct pool_job *job)
+{
+    unsigned i = atomic_fetch_add_explicit(&next_worker, 1,
+                                           memory_order_relaxed);
+    push_job(&workers[i % workers_n].deque, job);
+    atomic_fetch_add(&queued, 1);
+    if (atomic_load(&sleepers) > 0) {
+        pthread_mutex_lock(&sleep_lock);
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&sleep_lock);
+    }
+}
+
+/**
+ * Return the number of workers of the pool, 0 when it is not open.
+ */
+unsigned pool_workers(void)
+{
+    return workers_n;
+}
+
+/**
+ * Append the given job to the given deque, growing its ring when full.
+ */
+static void push_job(struct deque *q, struct pool_job *job)
+{
+    pthread_mutex_lock(&q->lock);
+    if (q->count == q->size) {
+        struct pool_job **jobs = malloc(2 * q->size * sizeof(*jobs));
+        if (jobs == NULL) {
+            fprintf(stderr, "Failure to allocate pool deque.\n");
+            abort();
+        }
+        for (size_t i = 0; i < q->count; ++i) {
+            jobs[i] = q->jobs[(q->head + i) % q->size];
+        }
+        free(q->jobs);
+        q->jobs = jobs;
+        q->head = 0;
+        q->size *= 2;
+    }
+    q->jobs[(q->head + q->count) % q->size] = job;
+    ++q->count;
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * Run thread of execution of a worker, running jobs until the pool closes and
+ * none is left.
+ */
+static void *run_worker(void *worker)
+{
+    struct worker *w = (struct worker *)worker;
+    affinity_pin(AFFINITY_READERS);
+    for (;;) {
+        struct pool_job *job = take_job(w);
+        if (job != NULL) {
+            job->run(job);
+            continue;
+        }
+        pthread_mutex_lock(&sleep_lock);
+        atomic_fetch_add(&sleepers, 1);
+        while (atomic_load(&queued) == 0 && !closing) {
+            pthread_cond_wait(&wake, &sleep_lock);
+        }
+        atomic_fetch_sub(&sleepers, 1);
+        bool done = closing && atomic_load(&queued) == 0;
+        pthread_mutex_unlock(&sleep_lock);
+        if (done) {
+            break;
+        }
+    }
+    if (leave_fn != NULL) {
+        leave_fn();
+    }
+    return NULL;
+}
+
+/**
+ * Take the oldest job of the worker's own deque or, failing that, the newest
+ * job of the first other deque holding any. Returns NULL if every deque was
+ * found empty.
+ */
+static struct pool_job *take_job(struct worker *w)
+{
+    struct pool_job *job = take_oldest(&w->deque);
+    for (unsigned i = 1; job == NULL && i < workers_n; ++i) {
+        job = take_newest(&workers[(w->index + i) % workers_n].deque);
+    }
+    if (job != NULL) {
+        atomic_fetch_sub(&queued, 1);
+    }
+    return job;
+}
+
+/**
+ * Take the job last appended to the given deque. Returns NULL if it is empty.
+ */
+static struct pool_job *take_newest(struct deque *q)
+{
+    struct pool_job *job = NULL;
+    pthread_mutex_lock(&q->lock);
+    if (q->count > 0) {
+        --q->count;
+        job = q->jobs[(q->head + q->count) % q->size];
+    }
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+/**
+ * Take the job first appended to the given deque. Returns NULL if it is empty.
+ */
+static struct pool_job *take_oldest(struct deque *q)
+{
+    struct pool_job *job = NULL;
+    pthread_mutex_lock(&q->lock);
+    if (q->count > 0) {
+        job = q->jobs[q->head];
+        q->head = (q->head + 1) % q->size;
+        --q->count;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
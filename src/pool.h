@@ -0,0 +1,55 @@
+/** @file
+ * Pool of worker threads that steal jobs from one another.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every worker owns a deque of jobs. Jobs handed to the pool are spread over
+ * the deques in turn; a worker runs the oldest job of its own deque and, once
+ * that is empty, steals the newest job of another's, so a burst handed to one
+ * worker is soon shared by all of them. Deques are guarded by a lock each,
+ * which costs nothing measurable for jobs the size of a read of logcat output.
+ * Idle workers sleep until a job is handed to the pool.
+ */
+#ifndef POOL_H_
+#define POOL_H_
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * A job for the pool, embedded within whatever the job works on.
+ */
+struct pool_job {
+    void (*run)(struct pool_job *job); //!< Function that runs the job.
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void pool_close(void);
+int pool_open(unsigned nworkers, void (*leave)(void));
+void pool_submit(struct pool_job *job);
+unsigned pool_workers(void);
+
+#endif
@@ -0,0 +1,237 @@
+/** @file
+ * Raw archives of the output of devices.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Archives are named after the serial number of their device and appended to
+ * across reconnections. splice() refuses files opened for appending, so the
+ * archive is positioned at its end once on opening instead.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "raw.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Directory the output of devices is archived to, NULL to not archive. */
+const char *raw_dir;
+
+/** Flag that indicates whether output is only archived and not colorized. */
+bool raw_only = false;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void fail(struct raw *raw);
+static int new_pipe(int fds[2], size_t nbytes);
+static int splice_all(int from, int to, size_t len);
+
+/******************************************************************************/
+
+/**
+ * Stop archiving and release everything held by the given archive.
+ */
+void raw_close(struct raw *raw)
+{
+    int *fds[] = { &raw->file, &raw->pipe[0], &raw->pipe[1], &raw->copy[0],
+                   &raw->copy[1] };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+}
+
+/**
+ * Initialize the given archive as not archiving.
+ */
+void raw_init(struct raw *raw)
+{
+    raw->file = -1;
+    raw->pipe[0] = raw->pipe[1] = -1;
+    raw->copy[0] = raw->copy[1] = -1;
+    raw->nbytes = 0;
+}
+
+/**
+ * Start archiving the output of the device with the given serial number into
+ * the archive directory. Returns 0 on success or an error number on failure,
+ * in which case nothing is archived.
+ */
+int raw_open(struct raw *raw, const char *name)
+{
+    // Serial numbers of devices attached over the network hold colons, which
+    // are fine, but nothing may step outside the directory.
+    char path[PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/%s.log", raw_dir, name);
+    if (n < 0 || (size_t)n >= sizeof(path)) {
+        return ENAMETOOLONG;
+    }
+    for (char *c = path + strlen(raw_dir) + 1; *c != '\0'; ++c) {
+        if (*c == '/') {
+            *c = '_';
+        }
+    }
+
+    raw->file = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (raw->file < 0 || lseek(raw->file, 0, SEEK_END) < 0) {
+        int err = errno;
+        raw_close(raw);
+        return err;
+    }
+    int err = new_pipe(raw->pipe, RAW_PIPE_NBYTES);
+    if (!err && !raw_only) {
+        err = new_pipe(raw->copy, RAW_PIPE_NBYTES);
+    }
+    if (err) {
+        raw_close(raw);
+        return err;
+    }
+    // The duplicate is taken of everything within the first pipe, so the
+    // second must hold at least as much.
+    raw->nbytes = fcntl(raw->pipe[1], F_GETPIPE_SZ);
+    if (!raw_only) {
+        int copy_nbytes = fcntl(raw->copy[1], F_GETPIPE_SZ);
+        if ((size_t)copy_nbytes < raw->nbytes) {
+            raw->nbytes = copy_nbytes;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Move whatever output of a device is waiting on fd into the archive. Unless
+ * only archiving, the output is also left within raw->pipe[0], which must be
+ * drained before the next call. Returns the number of bytes moved, 0 once the
+ * output has ended or -1 with errno set on failure.
+ */
+ssize_t raw_pump(struct raw *raw, int fd)
+{
+    ssize_t n = splice(fd, NULL, raw->pipe[1], NULL, raw->nbytes,
+                       SPLICE_F_MOVE);
+    if (n <= 0) {
+        return n;
+    }
+    if (raw_only) {
+        if (splice_all(raw->pipe[0], raw->file, n) != 0) {
+            fail(raw);
+            return -1;
+        }
+        return n;
+    }
+
+    // The pipes are equally large and the second one is empty, so the
+    // duplicate takes everything at once.
+    ssize_t copied = tee(raw->pipe[0], raw->copy[1], n, SPLICE_F_NONBLOCK);
+    if (copied != n || splice_all(raw->copy[0], raw->file, n) != 0) {
+        fail(raw);
+    }
+    return n;
+}
+
+/**
+ * Append the given output of a device to the archive. For output that has
+ * already been read into memory.
+ */
+void raw_write(struct raw *raw, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(raw->file, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fail(raw);
+            return;
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+/**
+ * Stop archiving after a failure to write the archive. The pipe the output
+ * passes through is kept since it may still hold output.
+ */
+static void fail(struct raw *raw)
+{
+    int err = errno;
+    fprintf(stderr, "Failure to archive device output: %s\n", strerror(err));
+    int *fds[] = { &raw->file, &raw->copy[0], &raw->copy[1] };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+    errno = err;
+}
+
+/**
+ * Create a pipe and try to grow it to hold the given number of bytes; a pipe
+ * that cannot grow still works. Returns 0 on success or an error number.
+ */
+static int new_pipe(int fds[2], size_t nbytes)
+{
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return errno;
+    }
+    fcntl(fds[1], F_SETPIPE_SZ, (int)nbytes);
+    return 0;
+}
+
+/**
+ * Move len bytes out of the pipe from into the file to. Returns 0 on success
+ * or -1 with errno set on failure.
+ */
+static int splice_all(int from, int to, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = splice(from, NULL, to, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO;
+            }
+            return -1;
+        }
+        len -= n;
+    }
+    return 0;
+}
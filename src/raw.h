@@ -0,0 +1,81 @@
+/** @file
+ * Raw archives of the output of devices.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The output of a device may be archived untouched to a file of its own in
+ * the archive directory, alongside or instead of being colorized. Output moves
+ * from the device's descriptor into a pipe with splice() and from there into
+ * the archive without ever being copied through user space. When it is also to
+ * be colorized, tee() duplicates it into a second pipe feeding the archive and
+ * the original is then read out of the first pipe. Both pipes are grown to
+ * absorb bursts such as boot logs and crash dumps.
+ */
+#ifndef RAW_H_
+#define RAW_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes pipes carrying the output of a device are grown to. */
+#define RAW_PIPE_NBYTES (1024 * 1024)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Archive of the output of a device.
+ */
+struct raw {
+    int    file;    //!< Descriptor of the archive, -1 when not archiving.
+    int    pipe[2]; //!< Pipe the output of the device passes through.
+    int    copy[2]; //!< Pipe the duplicate being archived passes through.
+    size_t nbytes;  //!< Capacity of the pipes.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *raw_dir;
+extern bool raw_only;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void raw_close(struct raw *raw);
+void raw_init(struct raw *raw);
+int raw_open(struct raw *raw, const char *name);
+ssize_t raw_pump(struct raw *raw, int fd);
+void raw_write(struct raw *raw, const void *data, size_t len);
+
+#endif
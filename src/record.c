@@ -0,0 +1,244 @@
+/** @file
+ * Structured binary records of lines for downstream consumers.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Device threads encode the header of each line and hand the writer the name
+ * of its tag alongside the message, straight from the bytes read. Only the
+ * writer knows the order records reach the stream in, so it alone decides
+ * when a tag has to be named, keeping the serial number of the tag last named
+ * under every identifier. The name is dropped from every other line.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Version of the records written. */
+#define RECORD_VERSION (1)
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Bytes starting the stream, "ALOG" and the version. */
+const uint8_t record_start[RECORD_START_NBYTES] = {
+    'A', 'L', 'O', 'G', RECORD_VERSION, 0, 0, 0
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Serial numbers of the tags named under each identifier, 0 for none. */
+static uint64_t *named;
+
+/** Number of identifiers within the named tags. */
+static size_t named_n;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static uint32_t get_le32(const uint8_t *p);
+static uint64_t get_le64(const uint8_t *p);
+static void put_le(uint8_t *p, uint64_t value, int nbytes);
+
+/******************************************************************************/
+
+/**
+ * Decode the record at the start of the given bytes into rec, whose text
+ * points into them. Returns the number of bytes of the record, 0 if the bytes
+ * hold only part of it or -1 if they do not start with a valid record.
+ */
+ssize_t record_decode(const uint8_t *data, size_t len,
+                      struct record_decoded *rec)
+{
+    if (len < 5) {
+        return 0;
+    }
+    size_t total = 4 + (size_t)get_le32(data);
+    if (total > RECORD_NBYTES_MAX) {
+        return -1;
+    }
+    if (len < total) {
+        return 0;
+    }
+    rec->type = data[4];
+    switch (rec->type) {
+    case RECORD_DEVICE:
+    case RECORD_TAG:
+        if (total < RECORD_NAME_NBYTES) {
+            return -1;
+        }
+        rec->id = get_le32(data + 5);
+        rec->text = (const char *)data + RECORD_NAME_NBYTES;
+        rec->len = total - RECORD_NAME_NBYTES;
+        break;
+    case RECORD_LINE:
+        if (total < RECORD_LINE_NBYTES) {
+            return -1;
+        }
+        rec->id = get_le32(data + 5);
+        rec->tag = get_le32(data + 9);
+        rec->nsec = get_le64(data + 13);
+        rec->pid = (int32_t)get_le32(data + 21);
+        rec->tid = get_le32(data + 25);
+        rec->priority = data[29];
+        rec->text = (const char *)data + RECORD_LINE_NBYTES;
+        rec->len = total - RECORD_LINE_NBYTES;
+        break;
+    default:
+        return -1;
+    }
+    return total;
+}
+
+/**
+ * Describe the given record within the given vector as it goes on the wire,
+ * preceded by the record of its tag's name when the tag was not named yet; the
+ * header of that record is kept in the given scratch space. Returns the number
+ * of fragments, at most RECORD_NIOV. Must only be called by the writer.
+ */
+int record_describe(const struct output_record *rec, struct iovec *iov,
+                    uint8_t scratch[RECORD_NAME_NBYTES])
+{
+    const uint8_t *header = rec->iov[0].iov_base;
+    if (header[4] != RECORD_LINE) {
+        memcpy(iov, rec->iov, rec->niov * sizeof(*iov));
+        return rec->niov;
+    }
+
+    // The name of the tag is whatever the fragments hold beyond the message.
+    size_t msg_len = get_le32(header) - (RECORD_LINE_NBYTES - 4);
+    size_t rest = 0;
+    for (int i = 1; i < rec->niov; ++i) {
+        rest += rec->iov[i].iov_len;
+    }
+    size_t name_len = rest - msg_len;
+
+    int n = 0;
+    uint32_t tag = get_le32(header + 9);
+    if (tag >= named_n) {
+        size_t grown = named_n > 0 ? named_n : 1024;
+        while (grown <= tag) {
+            grown *= 2;
+        }
+        named = realloc(named, grown * sizeof(*named));
+        if (named == NULL) {
+            fprintf(stderr, "Failure to allocate named tags.\n");
+            abort();
+        }
+        memset(named + named_n, 0, (grown - named_n) * sizeof(*named));
+        named_n = grown;
+    }
+    if (named[tag] != rec->serial) {
+        named[tag] = rec->serial;
+        record_encode_name(scratch, RECORD_TAG, tag, name_len);
+        iov[n].iov_base = scratch;
+        iov[n].iov_len = RECORD_NAME_NBYTES;
+        ++n;
+        if (name_len > 0) {
+            iov[n++] = rec->iov[1];
+        }
+    }
+    iov[n++] = rec->iov[0];
+    for (int i = name_len > 0 ? 2 : 1; i < rec->niov; ++i) {
+        iov[n++] = rec->iov[i];
+    }
+    return n;
+}
+
+/**
+ * Encode the header of a line record with a message of the given length.
+ */
+void record_encode_line(uint8_t header[RECORD_LINE_NBYTES], uint32_t device,
+                        uint32_t tag, uint64_t nsec, int32_t pid, uint32_t tid,
+                        char priority, size_t msg_len)
+{
+    put_le(header, RECORD_LINE_NBYTES - 4 + msg_len, 4);
+    header[4] = RECORD_LINE;
+    put_le(header + 5, device, 4);
+    put_le(header + 9, tag, 4);
+    put_le(header + 13, nsec, 8);
+    put_le(header + 21, (uint32_t)pid, 4);
+    put_le(header + 25, tid, 4);
+    header[29] = priority;
+}
+
+/**
+ * Encode the header of a record naming the device or tag of the given
+ * identifier with a name of the given length.
+ */
+void record_encode_name(uint8_t header[RECORD_NAME_NBYTES],
+                        enum record_type type, uint32_t id, size_t len)
+{
+    put_le(header, RECORD_NAME_NBYTES - 4 + len, 4);
+    header[4] = type;
+    put_le(header + 5, id, 4);
+}
+
+/**
+ * Forget every tag named.
+ */
+void record_free(void)
+{
+    free(named);
+    named = NULL;
+    named_n = 0;
+}
+
+/**
+ * Return the little endian 32-bit number at the given bytes.
+ */
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Return the little endian 64-bit number at the given bytes.
+ */
+static uint64_t get_le64(const uint8_t *p)
+{
+    return get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+/**
+ * Store the given number as a little endian number of the given number of
+ * bytes.
+ */
+static void put_le(uint8_t *p, uint64_t value, int nbytes)
+{
+    for (int i = 0; i < nbytes; ++i) {
+        p[i] = value >> (8 * i);
+    }
+}
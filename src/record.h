@@ -0,0 +1,122 @@
+/** @file
+ * Structured binary records of lines for downstream consumers.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Instead of colorized text, lines may be written as length prefixed binary
+ * records that consumers read at fixed offsets. The stream starts with the
+ * eight bytes "ALOG" followed by the version as a little endian 32-bit number.
+ * Every record then starts with its length, not counting the length itself, as
+ * a little endian 32-bit number and a byte giving its type:
+ *
+ *   'D' device  u32 id, name
+ *   'T' tag     u32 id, name
+ *   'L' line    u32 device id, u32 tag id, u64 nanoseconds since the epoch,
+ *               i32 pid, u32 tid (0 when not known), u8 priority letter,
+ *               message
+ *
+ * All numbers are little endian. Names of devices and tags are sent once, in a
+ * record ahead of the first line that refers to them, and again whenever an
+ * identifier comes to stand for another name.
+ */
+#ifndef RECORD_H_
+#define RECORD_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "output.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes of the header of a line record, up to its message. */
+#define RECORD_LINE_NBYTES (4 + 1 + 4 + 4 + 8 + 4 + 4 + 1)
+
+/** Most bytes of a single record, its length included. */
+#define RECORD_NBYTES_MAX (RECORD_LINE_NBYTES + 16 * 1024 * 1024)
+
+/** Number of bytes of the header of the record of a name, up to the name. */
+#define RECORD_NAME_NBYTES (4 + 1 + 4)
+
+/** Number of bytes starting the stream. */
+#define RECORD_START_NBYTES (8)
+
+/** Most fragments record_describe() describes a single line with. */
+#define RECORD_NIOV (4)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Types of records.
+ */
+enum record_type {
+    RECORD_DEVICE = 'D',
+    RECORD_TAG = 'T',
+    RECORD_LINE = 'L',
+};
+
+/**
+ * Record as read back from a stream.
+ */
+struct record_decoded {
+    enum record_type type;     //!< Type of the record.
+    uint32_t         id;       //!< Identifier named, or of the line's device.
+    uint32_t         tag;      //!< Identifier of the line's tag.
+    uint64_t         nsec;     //!< Nanoseconds since the epoch of the line.
+    int32_t          pid;      //!< Process that logged the line.
+    uint32_t         tid;      //!< Thread that logged the line, 0 if unknown.
+    char             priority; //!< Letter of the line's priority.
+    const char      *text;     //!< Name, or message of the line.
+    size_t           len;      //!< Length of the text.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const uint8_t record_start[RECORD_START_NBYTES];
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+ssize_t record_decode(const uint8_t *data, size_t len,
+                      struct record_decoded *rec);
+int record_describe(const struct output_record *rec, struct iovec *iov,
+                    uint8_t scratch[RECORD_NAME_NBYTES]);
+void record_encode_line(uint8_t header[RECORD_LINE_NBYTES], uint32_t device,
+                        uint32_t tag, uint64_t nsec, int32_t pid, uint32_t tid,
+                        char priority, size_t msg_len);
+void record_encode_name(uint8_t header[RECORD_NAME_NBYTES],
+                        enum record_type type, uint32_t id, size_t len);
+void record_free(void);
+
+#endif
@@ -0,0 +1,554 @@
+/** @file
+ * Relay of lines between hosts as binary records.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * A single thread of the central instance serves every relay, receiving their
+ * records into a buffer each and turning the lines of a device as they come in
+ * one after the other into entries handed to the device in one go. Names of
+ * tags are kept by relay, by the identifier the relay gave them.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "relay.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "device.h"
+#include "filter.h"
+#include "logcat.h"
+#include "record.h"
+#include "serve.h"
+#include "stats.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of characters of an address given as HOST:PORT. */
+#define ADDR_NCHARS (256)
+
+/** Bytes of entries of a device handed to it at once. */
+#define BATCH_NBYTES (64 * 1024)
+
+/** Maximum number of characters of the numeric address of a relay. */
+#define PEER_NCHARS (64)
+
+/** Least number of bytes of room records are received into. */
+#define READ_NBYTES_MIN (64 * 1024)
+
+/** Maximum number of relays served at once. */
+#define RELAYS_NMAX (64)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Relay connected to the central instance.
+ */
+struct relay {
+    int             fd;                //!< Socket of the relay, -1 if none.
+    char            peer[PEER_NCHARS]; //!< Numeric address of the relay.
+    bool            started;           //!< Whether the start of the stream
+                                       //!< was received.
+    uint8_t        *data;              //!< Bytes received, not yet decoded.
+    size_t          used;              //!< Number of those bytes.
+    size_t          size;              //!< Room for bytes received.
+    struct device **devices;           //!< Devices by identifier.
+    size_t          ndevices;          //!< Identifiers within the devices.
+    char          **tags;              //!< Names of tags by identifier.
+    size_t          ntags;             //!< Identifiers within the tags.
+    struct device  *batched;           //!< Device of the entries batched.
+    char           *batch;             //!< Entries not yet handed to it.
+    size_t          batch_len;         //!< Number of bytes of those entries.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Address relays are accepted on as [HOST:]PORT, NULL for none. */
+const char *relay_accept_addr;
+
+/** Address of the central instance lines are relayed to, NULL for none. */
+const char *relay_addr;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Socket relays are accepted on, -1 when not listening. */
+static int listen_fd = -1;
+
+/** Relays being served. */
+static struct relay relays[RELAYS_NMAX];
+
+/** Thread of execution serving relays. */
+static pthread_t server;
+
+/** Flag that indicates the server should exit. */
+static atomic_bool stopping;
+
+/** Event the server is woken by when it should exit. */
+static int wake_fd = -1;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void accept_relay(void);
+static void add_device(struct relay *r, const struct record_decoded *rec);
+static void add_line(struct relay *r, struct logcat_parser *parser,
+                     const struct record_decoded *rec);
+static void add_tag(struct relay *r, const struct record_decoded *rec);
+static void close_relay(struct relay *r, struct logcat_parser *parser);
+static bool decode_records(struct relay *r, struct logcat_parser *parser);
+static void flush_batch(struct relay *r, struct logcat_parser *parser);
+static void grow(void *array, size_t *n, size_t id, size_t size);
+static void read_records(struct relay *r, struct logcat_parser *parser);
+static void *run_server(void *unused);
+
+/******************************************************************************/
+
+/**
+ * Connect to the central instance at relay_addr, given as HOST:PORT. Returns
+ * the connected socket or -1 with errno set on failure.
+ */
+int relay_connect(void)
+{
+    char host[ADDR_NCHARS];
+    if (snprintf(host, sizeof(host), "%s", relay_addr) >= (int)sizeof(host)) {
+        errno = EINVAL;
+        return -1;
+    }
+    char *port = strrchr(host, ':');
+    if (port == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    *port++ = '\0';
+    // Numeric IPv6 addresses are given within brackets.
+    char *node = host;
+    size_t len = strlen(host);
+    if (len >= 2 && host[0] == '[' && host[len - 1] == ']') {
+        host[len - 1] = '\0';
+        ++node;
+    }
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *found;
+    if (getaddrinfo(node, port, &hints, &found) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int err = EADDRNOTAVAIL;
+    int fd = -1;
+    for (struct addrinfo *ai = found; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                    ai->ai_protocol);
+        if (fd < 0) {
+            err = errno;
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        err = errno;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(found);
+    if (fd < 0) {
+        errno = err;
+    }
+    return fd;
+}
+
+/**
+ * Start accepting relays on relay_accept_addr. Returns 0 on success or an
+ * error number on failure.
+ */
+int relay_start(void)
+{
+    for (int i = 0; i < RELAYS_NMAX; ++i) {
+        relays[i].fd = -1;
+    }
+    int err = serve_listen(relay_accept_addr, &listen_fd);
+    if (err) {
+        return err;
+    }
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        err = errno;
+    } else {
+        atomic_init(&stopping, false);
+        err = pthread_create(&server, NULL, run_server, NULL);
+    }
+    if (err) {
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    return err;
+}
+
+/**
+ * Stop accepting relays, disconnecting every relay and closing its devices.
+ */
+void relay_stop(void)
+{
+    if (listen_fd < 0) {
+        return;
+    }
+    atomic_store(&stopping, true);
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+    pthread_join(server, NULL);
+    close(listen_fd);
+    close(wake_fd);
+    listen_fd = -1;
+    wake_fd = -1;
+}
+
+/**
+ * Accept a relay waiting to connect, unless as many are served as can be.
+ */
+static void accept_relay(void)
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = accept4(listen_fd, (struct sockaddr *)&addr, &addr_len,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct relay *r = NULL;
+    for (int i = 0; i < RELAYS_NMAX && r == NULL; ++i) {
+        if (relays[i].fd < 0) {
+            r = &relays[i];
+        }
+    }
+    if (r == NULL) {
+        fprintf(stderr, "Refused a relay; %d are served already.\n",
+                RELAYS_NMAX);
+        close(fd);
+        return;
+    }
+    *r = (struct relay){ .fd = fd };
+    if (getnameinfo((struct sockaddr *)&addr, addr_len, r->peer,
+                    sizeof(r->peer), NULL, 0, NI_NUMERICHOST) != 0) {
+        strcpy(r->peer, "relay");
+    }
+    r->batch = malloc(BATCH_NBYTES);
+    if (r->batch == NULL) {
+        fprintf(stderr, "Failure to allocate relay batch.\n");
+        abort();
+    }
+}
+
+/**
+ * Open a device for the record naming a device of the given relay, in place
+ * of whichever device its identifier stood for.
+ */
+static void add_device(struct relay *r, const struct record_decoded *rec)
+{
+    grow(&r->devices, &r->ndevices, rec->id, sizeof(*r->devices));
+    struct device *old = r->devices[rec->id];
+    if (old != NULL) {
+        device_close(old);
+        r->devices[rec->id] = NULL;
+    }
+    int len = rec->len < SERIAL_NCHARS ? (int)rec->len : SERIAL_NCHARS - 1;
+    char name[SERIAL_NCHARS];
+    snprintf(name, sizeof(name), "%.*s", len, rec->text);
+    if (device_known(name)) {
+        snprintf(name, sizeof(name), "%.*s@%s", len, rec->text, r->peer);
+        if (device_known(name)) {
+            return;
+        }
+    }
+    struct device *d = device_new(name);
+    d->binary = true;
+    d->format = &logcat_format_time;
+    r->devices[rec->id] = d;
+}
+
+/**
+ * Batch the given line record of the given relay as an entry of its device,
+ * handing the entries batched before to their device when it is another.
+ */
+static void add_line(struct relay *r, struct logcat_parser *parser,
+                     const struct record_decoded *rec)
+{
+    struct device *d = rec->id < r->ndevices ? r->devices[rec->id] : NULL;
+    if (d == NULL) {
+        return;
+    }
+    const char *tag = rec->tag < r->ntags ? r->tags[rec->tag] : NULL;
+    struct logcat_entry entry = {
+        .pid = rec->pid,
+        .tid = rec->tid,
+        .sec = rec->nsec / 1000000000,
+        .nsec = rec->nsec % 1000000000,
+        .tagtype = rec->priority,
+        .tag = tag != NULL ? tag : "",
+        .tag_len = tag != NULL ? strlen(tag) : 0,
+        .msg = rec->text,
+        .msg_len = rec->len,
+    };
+    if (d != r->batched
+        || BATCH_NBYTES - r->batch_len < LOGCAT_ENTRY_NBYTES_MAX) {
+        flush_batch(r, parser);
+        r->batched = d;
+    }
+    r->batch_len += logcat_encode_entry(&r->batch[r->batch_len],
+                                        BATCH_NBYTES - r->batch_len, &entry);
+}
+
+/**
+ * Keep the name of the tag of the record naming a tag of the given relay.
+ */
+static void add_tag(struct relay *r, const struct record_decoded *rec)
+{
+    grow(&r->tags, &r->ntags, rec->id, sizeof(*r->tags));
+    free(r->tags[rec->id]);
+    r->tags[rec->id] = strndup(rec->text, rec->len);
+    if (r->tags[rec->id] == NULL) {
+        fprintf(stderr, "Failure to allocate tag name.\n");
+        abort();
+    }
+}
+
+/**
+ * Disconnect the given relay, closing its devices.
+ */
+static void close_relay(struct relay *r, struct logcat_parser *parser)
+{
+    flush_batch(r, parser);
+    for (size_t i = 0; i < r->ndevices; ++i) {
+        if (r->devices[i] != NULL) {
+            device_close(r->devices[i]);
+        }
+    }
+    for (size_t i = 0; i < r->ntags; ++i) {
+        free(r->tags[i]);
+    }
+    free(r->devices);
+    free(r->tags);
+    free(r->data);
+    free(r->batch);
+    close(r->fd);
+    *r = (struct relay){ .fd = -1 };
+}
+
+/**
+ * Handle every complete record the given relay has sent, keeping a partial
+ * one for later. Returns false if the relay sent something other than
+ * records.
+ */
+static bool decode_records(struct relay *r, struct logcat_parser *parser)
+{
+    size_t offset = 0;
+    if (!r->started) {
+        if (r->used < RECORD_START_NBYTES) {
+            return true;
+        }
+        if (memcmp(r->data, record_start, RECORD_START_NBYTES) != 0) {
+            return false;
+        }
+        r->started = true;
+        offset = RECORD_START_NBYTES;
+    }
+    bool ok = true;
+    while (offset < r->used) {
+        struct record_decoded rec;
+        ssize_t n = record_decode(&r->data[offset], r->used - offset, &rec);
+        if (n <= 0) {
+            ok = n == 0;
+            break;
+        }
+        offset += n;
+        if (rec.type == RECORD_LINE) {
+            add_line(r, parser, &rec);
+        } else if (rec.type == RECORD_DEVICE) {
+            flush_batch(r, parser);
+            add_device(r, &rec);
+        } else {
+            add_tag(r, &rec);
+        }
+    }
+    flush_batch(r, parser);
+    r->used -= offset;
+    memmove(r->data, &r->data[offset], r->used);
+    return ok;
+}
+
+/**
+ * Hand the entries batched of the given relay to their device.
+ */
+static void flush_batch(struct relay *r, struct logcat_parser *parser)
+{
+    if (r->batch_len > 0) {
+        device_feed(r->batched, parser, r->batch, r->batch_len);
+        r->batch_len = 0;
+    }
+    r->batched = NULL;
+}
+
+/**
+ * Grow the given array of pointers, of n identifiers each of the given size,
+ * to hold the given identifier, the new ones NULL.
+ */
+static void grow(void *array, size_t *n, size_t id, size_t size)
+{
+    if (id < *n) {
+        return;
+    }
+    size_t grown = *n > 0 ? *n : 16;
+    while (grown <= id) {
+        grown *= 2;
+    }
+    void **p = (void **)array;
+    char *resized = realloc(*p, grown * size);
+    if (resized == NULL) {
+        fprintf(stderr, "Failure to allocate relay identifiers.\n");
+        abort();
+    }
+    memset(resized + *n * size, 0, (grown - *n) * size);
+    *p = resized;
+    *n = grown;
+}
+
+/**
+ * Receive and handle whatever records the given relay has sent, disconnecting
+ * it when it has gone away or sent something other than records.
+ */
+static void read_records(struct relay *r, struct logcat_parser *parser)
+{
+    for (;;) {
+        // What is left over is part of a record shorter than the longest.
+        if (r->size - r->used < READ_NBYTES_MIN) {
+            size_t size = r->size > 0 ? 2 * r->size : 2 * READ_NBYTES_MIN;
+            if (size > RECORD_NBYTES_MAX + READ_NBYTES_MIN) {
+                size = RECORD_NBYTES_MAX + READ_NBYTES_MIN;
+            }
+            uint8_t *data = realloc(r->data, size);
+            if (data == NULL) {
+                fprintf(stderr, "Failure to allocate relay records.\n");
+                abort();
+            }
+            r->data = data;
+            r->size = size;
+        }
+        ssize_t n = recv(r->fd, &r->data[r->used], r->size - r->used, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            close_relay(r, parser);
+            return;
+        }
+        r->used += n;
+        if (!decode_records(r, parser)) {
+            fprintf(stderr, "Relay %s sent something other than records.\n",
+                    r->peer);
+            close_relay(r, parser);
+            return;
+        }
+    }
+}
+
+/**
+ * Run thread of execution that accepts relays and hands the lines of their
+ * devices on.
+ */
+static void *run_server(void *unused)
+{
+    struct logcat_parser parser;
+    int err = logcat_parser_init(&parser);
+    assert(!err);
+
+    while (!atomic_load(&stopping)) {
+        struct pollfd fds[2 + RELAYS_NMAX];
+        struct relay *polled[RELAYS_NMAX];
+        fds[0] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = wake_fd, .events = POLLIN };
+        int nfds = 2;
+        for (int i = 0; i < RELAYS_NMAX; ++i) {
+            if (relays[i].fd >= 0) {
+                polled[nfds - 2] = &relays[i];
+                fds[nfds++] = (struct pollfd){
+                    .fd = relays[i].fd,
+                    .events = POLLIN,
+                };
+            }
+        }
+        if (poll(fds, nfds, -1) < 0) {
+            continue;
+        }
+        for (int i = 2; i < nfds; ++i) {
+            if (fds[i].revents != 0) {
+                read_records(polled[i - 2], &parser);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_relay();
+        }
+    }
+
+    for (int i = 0; i < RELAYS_NMAX; ++i) {
+        if (relays[i].fd >= 0) {
+            close_relay(&relays[i], &parser);
+        }
+    }
+    logcat_parser_free(&parser);
+    stats_thread_unregister();
+    filter_thread_free();
+    return NULL;
+}
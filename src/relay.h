@@ -0,0 +1,60 @@
+/** @file
+ * Relay of lines between hosts as binary records.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Devices spread over several hosts, each with an adb server of its own, are
+ * shown by a single central instance. Every other host runs as a relay: it
+ * reads its devices as usual but writes its lines as binary records, see
+ * record.h, to the central instance over TCP instead of standard output.
+ * Records name every device and tag once and carry lines without any
+ * decoration, so a relay spends far less on its lines, and sends far fewer
+ * bytes, than it would colorizing them.
+ *
+ * The central instance accepts up to 64 relays at once and turns the lines of
+ * every device of theirs back into entries of a device of its own, named as the
+ * relay named it, or SERIAL@ADDRESS of the relay when a device of that name is
+ * known already. From there on the lines are handled like those of any local
+ * device, so they are merged in the order they were logged across hosts, see
+ * merge.h, and filtered, written, archived or served as asked for. A relay's
+ * devices go away along with it, while a relay ends once the central instance
+ * it writes to has gone away.
+ */
+#ifndef RELAY_H_
+#define RELAY_H_
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *relay_accept_addr;
+extern const char *relay_addr;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int relay_connect(void);
+int relay_start(void);
+void relay_stop(void);
+
+#endif
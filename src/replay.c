@@ -0,0 +1,339 @@
+/** @file
+ * Replay of captured logcat output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * A chunk is only colorized once fewer than a few chunks per thread are waiting
+ * to be written, which bounds the memory held by colorized lines however large
+ * the capture. Lines and entries are cut by the same tokenizer that reads live
+ * devices, so a capture replays exactly as it was shown.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "replay.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "color.h"
+#include "device.h"
+#include "filter.h"
+#include "logcat.h"
+#include "scan.h"
+#include "stats.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Most chunks colorized ahead of the chunk being written, per thread. */
+#define AHEAD_NCHUNKS (2)
+
+/**
+ * Number of bytes of a file colorized together, before rounding up to the end
+ * of a line or entry.
+ */
+#define CHUNK_NBYTES (4 * 1024 * 1024)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Stretch of a file colorized by a single thread.
+ */
+struct chunk {
+    const char    *data;  //!< Start of the chunk within the file.
+    size_t         len;   //!< Number of bytes of the chunk.
+    struct buffer *lines; //!< Colorized lines, oldest first.
+    bool           done;  //!< Whether the chunk was colorized.
+};
+
+/**
+ * Replay of a single file.
+ */
+struct replay {
+    char            name[SERIAL_NCHARS]; //!< Name the lines are shown with.
+    enum color      color;               //!< Color of the name.
+    struct chunk   *chunks;              //!< Chunks of the file, in order.
+    size_t          nchunks;             //!< Number of chunks.
+    size_t          next;                //!< Next chunk to colorize.
+    size_t          written;             //!< Number of chunks written.
+    size_t          ahead;               //!< Most chunks colorized ahead of
+                                         //!< those written.
+    bool            failed;              //!< Whether writing failed.
+    pthread_mutex_t lock;                //!< Lock used to protect the above.
+    pthread_cond_t  cond;                //!< Condition signalled when a
+                                         //!< chunk is colorized or written.
+};
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static size_t chunk_end(const char *data, size_t len, size_t start);
+static void free_lines(struct buffer *lines);
+static int replay_file(const char *path, enum color color, int nthreads,
+                       int fd);
+static void *run_worker(void *replay);
+static int write_lines(int fd, const struct buffer *lines);
+
+/******************************************************************************/
+
+/**
+ * Colorize the captures at the given paths and write their lines to the given
+ * descriptor, one capture after the other. A capture that cannot be replayed
+ * is reported and skipped. Returns 0 on success or the error number of the
+ * last failure otherwise.
+ */
+int replay_files(char *const paths[], int npaths, int fd)
+{
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    int err = 0;
+    for (int i = 0; i < npaths; ++i) {
+        int e = replay_file(paths[i], (enum color)(i % COLOR_NMAX), nthreads,
+                            fd);
+        if (e) {
+            fprintf(stderr, "Failure to replay %s: %s\n", paths[i],
+                    strerror(e));
+            err = e;
+        }
+    }
+    return err;
+}
+
+/**
+ * Return the offset at which the chunk of the given file starting at the given
+ * offset ends, just past the line or entry that crosses CHUNK_NBYTES.
+ */
+static size_t chunk_end(const char *data, size_t len, size_t start)
+{
+    if (len - start <= CHUNK_NBYTES) {
+        return len;
+    }
+    if (!device_binary) {
+        const char *newline = scan_chr(data + start + CHUNK_NBYTES,
+                                       len - start - CHUNK_NBYTES, '\n');
+        return newline != NULL ? (size_t)(newline - data) + 1 : len;
+    }
+    size_t end = start;
+    while (end - start < CHUNK_NBYTES) {
+        struct logcat_entry entry;
+        ssize_t n = logcat_decode_entry(data + end, len - end, &entry);
+        if (n <= 0) {
+            // Whatever follows is for the colorizing thread to report.
+            return len;
+        }
+        end += n;
+    }
+    return end;
+}
+
+/**
+ * Release the given chain of colorized lines.
+ */
+static void free_lines(struct buffer *lines)
+{
+    while (lines != NULL) {
+        struct buffer *next = lines->next;
+        buffer_unref(lines);
+        lines = next;
+    }
+}
+
+/**
+ * Colorize the capture at the given path on the given number of threads and
+ * write its lines to the given descriptor. The capture is shown named after
+ * its file, without any extension. Returns 0 on success or an error number
+ * otherwise.
+ */
+static int replay_file(const char *path, enum color color, int nthreads,
+                       int fd)
+{
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return errno;
+    }
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        int err = errno;
+        close(in);
+        return err;
+    }
+    size_t len = st.st_size;
+    if (len == 0) {
+        close(in);
+        return 0;
+    }
+    char *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, in, 0);
+    int err = data == MAP_FAILED ? errno : 0;
+    close(in);
+    if (err) {
+        return err;
+    }
+    madvise(data, len, MADV_SEQUENTIAL);
+
+    struct replay r = {
+        .color = color,
+        .ahead = (size_t)nthreads * AHEAD_NCHUNKS,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+    };
+    const char *base = strrchr(path, '/');
+    snprintf(r.name, sizeof(r.name), "%s", base != NULL ? base + 1 : path);
+    char *dot = strchr(r.name, '.');
+    if (dot != NULL && dot != r.name) {
+        *dot = '\0';
+    }
+    size_t nslots = 0;
+    for (size_t start = 0; start < len;) {
+        if (r.nchunks == nslots) {
+            nslots = nslots > 0 ? 2 * nslots : 64;
+            r.chunks = realloc(r.chunks, nslots * sizeof(*r.chunks));
+            assert(r.chunks != NULL);
+        }
+        size_t end = chunk_end(data, len, start);
+        r.chunks[r.nchunks++] = (struct chunk){
+            .data = data + start,
+            .len = end - start,
+        };
+        start = end;
+    }
+
+    if ((size_t)nthreads > r.nchunks) {
+        nthreads = r.nchunks;
+    }
+    pthread_t threads[nthreads];
+    for (int i = 0; i < nthreads; ++i) {
+        err = pthread_create(&threads[i], NULL, run_worker, &r);
+        assert(!err);
+    }
+
+    // Chunks are written in order, each as soon as it has been colorized.
+    for (size_t i = 0; i < r.nchunks && !err; ++i) {
+        pthread_mutex_lock(&r.lock);
+        while (!r.chunks[i].done) {
+            pthread_cond_wait(&r.cond, &r.lock);
+        }
+        struct buffer *lines = r.chunks[i].lines;
+        r.chunks[i].lines = NULL;
+        pthread_mutex_unlock(&r.lock);
+
+        err = write_lines(fd, lines);
+        free_lines(lines);
+
+        pthread_mutex_lock(&r.lock);
+        r.written = i + 1;
+        r.failed = err != 0;
+        pthread_cond_broadcast(&r.cond);
+        pthread_mutex_unlock(&r.lock);
+    }
+    for (int i = 0; i < nthreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < r.nchunks; ++i) {
+        free_lines(r.chunks[i].lines);
+    }
+    free(r.chunks);
+    munmap(data, len);
+    return err;
+}
+
+/**
+ * Run thread of execution that colorizes the chunks of a replay, taking the
+ * next chunk whenever not too far ahead of those written.
+ */
+static void *run_worker(void *replay)
+{
+    struct replay *r = (struct replay *)replay;
+    struct logcat_parser parser;
+    int err = logcat_parser_init(&parser);
+    assert(!err);
+    struct device *d = device_replay_new(r->name, r->color);
+
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        while (!r->failed && r->next < r->nchunks
+               && r->next >= r->written + r->ahead) {
+            pthread_cond_wait(&r->cond, &r->lock);
+        }
+        if (r->failed || r->next == r->nchunks) {
+            break;
+        }
+        struct chunk *c = &r->chunks[r->next++];
+        pthread_mutex_unlock(&r->lock);
+
+        struct buffer *lines = device_replay(d, &parser, c->data, c->len);
+
+        pthread_mutex_lock(&r->lock);
+        c->lines = lines;
+        c->done = true;
+        pthread_cond_broadcast(&r->cond);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    device_replay_free(d);
+    logcat_parser_free(&parser);
+    stats_thread_unregister();
+    filter_thread_free();
+    return NULL;
+}
+
+/**
+ * Write the given chain of colorized lines to the given descriptor. Returns 0
+ * on success or an error number otherwise.
+ */
+static int write_lines(int fd, const struct buffer *lines)
+{
+    for (; lines != NULL; lines = lines->next) {
+        const char *p = lines->data;
+        size_t left = lines->used;
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return errno;
+            }
+            p += n;
+            left -= n;
+        }
+    }
+    return 0;
+}
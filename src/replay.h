@@ -0,0 +1,40 @@
+/** @file
+ * Replay of captured logcat output.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Captures, such as the raw archives of devices, are colorized offline just as
+ * live output would be. Every file is mapped into memory and cut into chunks
+ * that end on a line or entry boundary. A pool of threads colorizes the chunks
+ * in parallel, each with a replay device of its own, and the lines of every
+ * chunk are written in the order the chunks came in.
+ */
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int replay_files(char *const paths[], int npaths, int fd);
+
+#endif
@@ -0,0 +1,304 @@
+/** @file
+ * Vectorized delimiter scanning.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every implementation only ever loads whole vectors that lie inside the
+ * buffer; the final partial vector is handled by the scalar routine.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 (1)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SCAN_NEON (1)
+#include <arm_neon.h>
+#endif
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static const char *scan_chr_scalar(const char *s, size_t n, char c);
+static const char *scan_chr2_scalar(const char *s, size_t n, char c, char d);
+#if SCAN_X86
+static const char *scan_chr_avx2(const char *s, size_t n, char c);
+static const char *scan_chr_sse2(const char *s, size_t n, char c);
+static const char *scan_chr2_avx2(const char *s, size_t n, char c, char d);
+static const char *scan_chr2_sse2(const char *s, size_t n, char c, char d);
+#endif
+#if SCAN_NEON
+static const char *scan_chr_neon(const char *s, size_t n, char c);
+static const char *scan_chr2_neon(const char *s, size_t n, char c, char d);
+#endif
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+const char *(*scan_chr_impl)(const char *s, size_t n, char c) = scan_chr_scalar;
+const char *(*scan_chr2_impl)(const char *s, size_t n, char c, char d) =
+    scan_chr2_scalar;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Name of the implementation currently in use. */
+static const char *impl_name = "scalar";
+
+/******************************************************************************/
+
+/**
+ * Select the fastest scanning implementation supported by the processor. Must
+ * be called before any other threads of execution are started.
+ */
+void scan_init(void)
+{
+#if SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_chr_impl = scan_chr_avx2;
+        scan_chr2_impl = scan_chr2_avx2;
+        impl_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_chr_impl = scan_chr_sse2;
+        scan_chr2_impl = scan_chr2_sse2;
+        impl_name = "sse2";
+    }
+#elif SCAN_NEON
+    scan_chr_impl = scan_chr_neon;
+    scan_chr2_impl = scan_chr2_neon;
+    impl_name = "neon";
+#endif
+}
+
+/**
+ * Return the name of the implementation selected by scan_init().
+ */
+const char *scan_name(void)
+{
+    return impl_name;
+}
+
+/**
+ * Portable implementation that tests eight bytes at a time within a machine
+ * word.
+ */
+static const char *scan_chr_scalar(const char *s, size_t n, char c)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t pattern = ones * (uint8_t)c;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, s + i, sizeof(word));
+        word ^= pattern;
+        if ((word - ones) & ~word & highs) {
+            break;
+        }
+    }
+    for (; i < n; ++i) {
+        if (s[i] == c) {
+            return s + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Portable implementation of scan_chr2() that tests eight bytes at a time
+ * within a machine word.
+ */
+static const char *scan_chr2_scalar(const char *s, size_t n, char c, char d)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t pattern_c = ones * (uint8_t)c;
+    const uint64_t pattern_d = ones * (uint8_t)d;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, s + i, sizeof(word));
+        uint64_t word_c = word ^ pattern_c;
+        uint64_t word_d = word ^ pattern_d;
+        if (((word_c - ones) & ~word_c & highs)
+            | ((word_d - ones) & ~word_d & highs)) {
+            break;
+        }
+    }
+    for (; i < n; ++i) {
+        if (s[i] == c || s[i] == d) {
+            return s + i;
+        }
+    }
+    return NULL;
+}
+
+#if SCAN_X86
+/**
+ * Implementation using 32 byte AVX2 compares.
+ */
+__attribute__((target("avx2")))
+static const char *scan_chr_avx2(const char *s, size_t n, char c)
+{
+    const __m256i pattern = _mm256_set1_epi8(c);
+
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(s + i));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block,
+                                                               pattern));
+        if (mask != 0) {
+            return s + i + __builtin_ctz(mask);
+        }
+    }
+
+    // Clear the upper halves of the registers before running legacy SSE
+    // code, which otherwise pays for the transition on every short scan.
+    _mm256_zeroupper();
+    return scan_chr_sse2(s + i, n - i, c);
+}
+
+/**
+ * Implementation of scan_chr2() using 32 byte AVX2 compares.
+ */
+__attribute__((target("avx2")))
+static const char *scan_chr2_avx2(const char *s, size_t n, char c, char d)
+{
+    const __m256i pattern_c = _mm256_set1_epi8(c);
+    const __m256i pattern_d = _mm256_set1_epi8(d);
+
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(block, pattern_c),
+                                     _mm256_cmpeq_epi8(block, pattern_d));
+        uint32_t mask = _mm256_movemask_epi8(eq);
+        if (mask != 0) {
+            return s + i + __builtin_ctz(mask);
+        }
+    }
+
+    // As in scan_chr_avx2(), leave no dirty upper halves to the SSE2 tail.
+    _mm256_zeroupper();
+    return scan_chr2_sse2(s + i, n - i, c, d);
+}
+
+/**
+ * Implementation using 16 byte SSE2 compares.
+ */
+__attribute__((target("sse2")))
+static const char *scan_chr_sse2(const char *s, size_t n, char c)
+{
+    const __m128i pattern = _mm_set1_epi8(c);
+
+    size_t i = 0;
+    for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+        if (mask != 0) {
+            return s + i + __builtin_ctz(mask);
+        }
+    }
+    return scan_chr_scalar(s + i, n - i, c);
+}
+
+/**
+ * Implementation of scan_chr2() using 16 byte SSE2 compares.
+ */
+__attribute__((target("sse2")))
+static const char *scan_chr2_sse2(const char *s, size_t n, char c, char d)
+{
+    const __m128i pattern_c = _mm_set1_epi8(c);
+    const __m128i pattern_d = _mm_set1_epi8(d);
+
+    size_t i = 0;
+    for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(block, pattern_c),
+                                  _mm_cmpeq_epi8(block, pattern_d));
+        uint32_t mask = _mm_movemask_epi8(eq);
+        if (mask != 0) {
+            return s + i + __builtin_ctz(mask);
+        }
+    }
+    return scan_chr2_scalar(s + i, n - i, c, d);
+}
+#endif
+
+#if SCAN_NEON
+/**
+ * Implementation using 16 byte NEON compares. The comparison result is
+ * narrowed to four bits per byte so that it fits a general purpose register.
+ */
+static const char *scan_chr_neon(const char *s, size_t n, char c)
+{
+    const uint8x16_t pattern = vdupq_n_u8((uint8_t)c);
+
+    size_t i = 0;
+    for (; i + sizeof(uint8x16_t) <= n; i += sizeof(uint8x16_t)) {
+        uint8x16_t block = vld1q_u8((const uint8_t *)(s + i));
+        uint8x16_t eq = vceqq_u8(block, pattern);
+        uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+        if (mask != 0) {
+            return s + i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+    return scan_chr_scalar(s + i, n - i, c);
+}
+
+/**
+ * Implementation of scan_chr2() using 16 byte NEON compares, narrowed as in
+ * scan_chr_neon().
+ */
+static const char *scan_chr2_neon(const char *s, size_t n, char c, char d)
+{
+    const uint8x16_t pattern_c = vdupq_n_u8((uint8_t)c);
+    const uint8x16_t pattern_d = vdupq_n_u8((uint8_t)d);
+
+    size_t i = 0;
+    for (; i + sizeof(uint8x16_t) <= n; i += sizeof(uint8x16_t)) {
+        uint8x16_t block = vld1q_u8((const uint8_t *)(s + i));
+        uint8x16_t eq = vorrq_u8(vceqq_u8(block, pattern_c),
+                                 vceqq_u8(block, pattern_d));
+        uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+        if (mask != 0) {
+            return s + i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+    return scan_chr2_scalar(s + i, n - i, c, d);
+}
+#endif
@@ -0,0 +1,73 @@
+/** @file
+ * Vectorized delimiter scanning.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The tokenizer and line splitter spend most of their time looking for single
+ * delimiter bytes. The routines here search with the widest vector unit the
+ * host processor offers; the implementation is chosen once at start up by
+ * scan_init().
+ */
+#ifndef SCAN_H_
+#define SCAN_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Implementation of scan_chr() selected for the host processor. */
+extern const char *(*scan_chr_impl)(const char *s, size_t n, char c);
+
+/** Implementation of scan_chr2() selected for the host processor. */
+extern const char *(*scan_chr2_impl)(const char *s, size_t n, char c, char d);
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void scan_init(void);
+const char *scan_name(void);
+
+/**
+ * Return a pointer to the first occurrence of c within the n bytes at s or NULL
+ * if c does not appear.
+ */
+static inline const char *scan_chr(const char *s, size_t n, char c)
+{
+    return scan_chr_impl(s, n, c);
+}
+
+/**
+ * Return a pointer to the first occurrence of either c or d within the n bytes
+ * at s or NULL if neither appears.
+ */
+static inline const char *scan_chr2(const char *s, size_t n, char c, char d)
+{
+    return scan_chr2_impl(s, n, c, d);
+}
+
+#endif
@@ -0,0 +1,665 @@
+/** @file
+ * Server streaming lines to subscribers over TCP.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The ring holds the bytes of the latest lines along with where each starts,
+ * both indexed by ever growing positions so that a subscriber's place stays
+ * meaningful however often the ring wraps. The ring's lock is only ever held to
+ * copy bytes in or out, never while anything is sent to a subscriber, so the
+ * writer is not held up by a subscriber beyond the copying of one stage.
+ *
+ * A single thread serves every subscriber. It copies lines into a stage of the
+ * subscriber's own, filters them there and sends the stage without blocking,
+ * waiting on the subscriber only while the stage has not been sent.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "serve.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of characters of the address served on. */
+#define ADDR_NCHARS (256)
+
+/** Number of connections waiting to be accepted the kernel holds. */
+#define BACKLOG_NMAX (16)
+
+/** Maximum number of characters of a notice of lines lost. */
+#define NOTICE_NCHARS (64)
+
+/** Maximum number of characters of a request of a subscriber. */
+#define REQUEST_NCHARS (1024)
+
+/** Number of bytes of the ring; must be a power of two. */
+#define RING_NBYTES (16 * 1024 * 1024)
+
+/** Most lines held by the ring; must be a power of two. */
+#define RING_NLINES (128 * 1024)
+
+/** Number of bytes staged for a subscriber at once. */
+#define STAGE_NBYTES (128 * 1024)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Subscriber following the lines.
+ */
+struct client {
+    int      fd;                      //!< Socket of the subscriber, -1 if none.
+    uint64_t next;                    //!< Position of the next line to stage.
+    uint64_t lost;                    //!< Lines lost since the last notice.
+    bool     matching;                //!< Whether lines must match.
+    regex_t  match;                   //!< Expression lines must match.
+    bool     plain;                   //!< Whether colors are left out.
+    char    *stage;                   //!< Lines waiting to be sent.
+    size_t   staged;                  //!< Bytes of the stage filled.
+    size_t   sent;                    //!< Bytes of the stage sent.
+    char     request[REQUEST_NCHARS]; //!< Request being received.
+    size_t   request_len;             //!< Characters of the request received.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Address subscribers are served on as [HOST:]PORT, NULL to not serve. */
+const char *serve_addr;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Subscribers, of which those without a socket are free. */
+static struct client clients[SERVE_CLIENTS_NMAX];
+
+/** Number of subscribers connected. */
+static atomic_int clients_n;
+
+/** Socket connections are accepted on, -1 when not serving. */
+static int listen_fd = -1;
+
+/** Bytes of the latest lines. */
+static char *ring;
+
+/** Position in bytes the next line is copied to. */
+static uint64_t ring_end;
+
+/** Position of the next line added to the ring. */
+static uint64_t ring_head;
+
+/** Lock used to prevent concurrent access to the ring. */
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Positions in bytes of the lines held by the ring. */
+static uint64_t *ring_starts;
+
+/** Position of the oldest line held by the ring. */
+static uint64_t ring_tail;
+
+/** Thread of execution serving the subscribers. */
+static pthread_t server;
+
+/** Flag that indicates the server should exit. */
+static atomic_bool stopping;
+
+/** Event the server is woken by when lines are added or it should exit. */
+static int wake_fd = -1;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void accept_clients(void);
+static void close_client(struct client *c);
+static void filter_lines(struct client *c, size_t from);
+static void handle_request(struct client *c, char *request);
+static void read_requests(struct client *c);
+static void ring_append(const struct output_record *rec);
+static void ring_copy(char *out, uint64_t pos, size_t len);
+static void *run_server(void *unused);
+static void send_lines(struct client *c);
+static bool stage_lines(struct client *c);
+static size_t strip_colors(char *line, size_t len);
+static void wake_server(void);
+
+/******************************************************************************/
+
+/**
+ * Open a socket that connections are accepted on at the given address, given
+ * as [HOST:]PORT, into fd. Returns 0 on success or an error number on failure.
+ */
+int serve_listen(const char *addr, int *fd)
+{
+    char host[ADDR_NCHARS];
+    if (snprintf(host, sizeof(host), "%s", addr) >= (int)sizeof(host)) {
+        return EINVAL;
+    }
+    char *port = strrchr(host, ':');
+    const char *node = NULL;
+    if (port == NULL) {
+        port = host;
+    } else {
+        *port++ = '\0';
+        // Numeric IPv6 addresses are given within brackets.
+        node = host;
+        size_t len = strlen(host);
+        if (len >= 2 && host[0] == '[' && host[len - 1] == ']') {
+            host[len - 1] = '\0';
+            ++node;
+        }
+        if (*node == '\0') {
+            node = NULL;
+        }
+    }
+
+    struct addrinfo hints = {
+        .ai_flags = AI_PASSIVE,
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *found;
+    if (getaddrinfo(node, port, &hints, &found) != 0) {
+        return EINVAL;
+    }
+    int err = EADDRNOTAVAIL;
+    for (struct addrinfo *ai = found; ai != NULL; ai = ai->ai_next) {
+        int sock = socket(ai->ai_family,
+                          ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          ai->ai_protocol);
+        if (sock < 0) {
+            err = errno;
+            continue;
+        }
+        int on = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(sock, ai->ai_addr, ai->ai_addrlen) == 0
+            && listen(sock, BACKLOG_NMAX) == 0) {
+            *fd = sock;
+            err = 0;
+            break;
+        }
+        err = errno;
+        close(sock);
+    }
+    freeaddrinfo(found);
+    return err;
+}
+
+/**
+ * Start serving subscribers on serve_addr. Returns 0 on success or an error
+ * number on failure.
+ */
+int serve_start(void)
+{
+    for (int i = 0; i < SERVE_CLIENTS_NMAX; ++i) {
+        clients[i].fd = -1;
+    }
+    int err = serve_listen(serve_addr, &listen_fd);
+    if (err) {
+        return err;
+    }
+    ring = malloc(RING_NBYTES);
+    ring_starts = malloc(sizeof(*ring_starts) * RING_NLINES);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring == NULL || ring_starts == NULL || wake_fd < 0) {
+        err = ring == NULL || ring_starts == NULL ? ENOMEM : errno;
+    } else {
+        atomic_init(&stopping, false);
+        err = pthread_create(&server, NULL, run_server, NULL);
+    }
+    if (err) {
+        free(ring);
+        free(ring_starts);
+        ring = NULL;
+        ring_starts = NULL;
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    return err;
+}
+
+/**
+ * Stop serving, disconnecting every subscriber.
+ */
+void serve_stop(void)
+{
+    if (listen_fd < 0) {
+        return;
+    }
+    atomic_store(&stopping, true);
+    wake_server();
+    pthread_join(server, NULL);
+    for (int i = 0; i < SERVE_CLIENTS_NMAX; ++i) {
+        if (clients[i].fd >= 0) {
+            close_client(&clients[i]);
+        }
+    }
+    close(listen_fd);
+    close(wake_fd);
+    listen_fd = -1;
+    wake_fd = -1;
+    free(ring);
+    free(ring_starts);
+    ring = NULL;
+    ring_starts = NULL;
+}
+
+/**
+ * Add the given lines to the ring. Must only be called by the writer.
+ */
+void serve_write(const struct output_record *recs, int n)
+{
+    pthread_mutex_lock(&ring_lock);
+    for (int i = 0; i < n; ++i) {
+        ring_append(&recs[i]);
+    }
+    pthread_mutex_unlock(&ring_lock);
+    if (atomic_load_explicit(&clients_n, memory_order_relaxed) > 0) {
+        wake_server();
+    }
+}
+
+/**
+ * Accept every subscriber waiting to connect, turning away those beyond the
+ * most served at once.
+ */
+static void accept_clients(void)
+{
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct client *c = NULL;
+        for (int i = 0; i < SERVE_CLIENTS_NMAX && c == NULL; ++i) {
+            if (clients[i].fd < 0) {
+                c = &clients[i];
+            }
+        }
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        c->stage = malloc(STAGE_NBYTES);
+        if (c->stage == NULL) {
+            fprintf(stderr, "Failure to allocate subscriber stage.\n");
+            abort();
+        }
+        c->fd = fd;
+        c->lost = 0;
+        c->matching = false;
+        c->plain = false;
+        c->staged = 0;
+        c->sent = 0;
+        c->request_len = 0;
+
+        // Subscribers follow the lines from the time they connect on.
+        pthread_mutex_lock(&ring_lock);
+        c->next = ring_head;
+        pthread_mutex_unlock(&ring_lock);
+        atomic_fetch_add(&clients_n, 1);
+    }
+}
+
+/**
+ * Disconnect the given subscriber.
+ */
+static void close_client(struct client *c)
+{
+    close(c->fd);
+    c->fd = -1;
+    if (c->matching) {
+        regfree(&c->match);
+        c->matching = false;
+    }
+    free(c->stage);
+    c->stage = NULL;
+    atomic_fetch_sub(&clients_n, 1);
+}
+
+/**
+ * Remove the colors and the lines the subscriber does not want from what was
+ * staged for it from the given offset on.
+ */
+static void filter_lines(struct client *c, size_t from)
+{
+    if (!c->plain && !c->matching) {
+        return;
+    }
+    size_t kept = from;
+    size_t pos = from;
+    while (pos < c->staged) {
+        char *line = &c->stage[pos];
+        char *nl = memchr(line, '\n', c->staged - pos);
+        size_t len = nl != NULL ? (size_t)(nl - line) + 1 : c->staged - pos;
+        pos += len;
+        if (c->plain) {
+            len = strip_colors(line, len);
+        }
+        regmatch_t span = { .rm_so = 0, .rm_eo = len };
+        if (c->matching
+            && regexec(&c->match, line, 1, &span, REG_STARTEND) != 0) {
+            continue;
+        }
+        memmove(&c->stage[kept], line, len);
+        kept += len;
+    }
+    c->staged = kept;
+}
+
+/**
+ * Act on the given request of the subscriber. Requests that are not understood
+ * are ignored.
+ */
+static void handle_request(struct client *c, char *request)
+{
+    if (strncmp(request, "match", 5) == 0
+        && (request[5] == '\0' || request[5] == ' ')) {
+        if (c->matching) {
+            regfree(&c->match);
+            c->matching = false;
+        }
+        if (request[5] == ' ' && request[6] != '\0') {
+            c->matching = regcomp(&c->match, &request[6],
+                                  REG_EXTENDED | REG_NOSUB) == 0;
+        }
+    } else if (strcmp(request, "format plain") == 0) {
+        c->plain = true;
+    } else if (strcmp(request, "format color") == 0) {
+        c->plain = false;
+    }
+}
+
+/**
+ * Receive and act on whatever requests the subscriber has sent, disconnecting
+ * it when it has gone away.
+ */
+static void read_requests(struct client *c)
+{
+    for (;;) {
+        size_t room = sizeof(c->request) - c->request_len;
+        ssize_t n = recv(c->fd, &c->request[c->request_len], room, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            close_client(c);
+            return;
+        }
+        c->request_len += n;
+
+        char *start = c->request;
+        char *nl;
+        while ((nl = memchr(start, '\n', &c->request[c->request_len] - start))
+               != NULL) {
+            *nl = '\0';
+            if (nl > start && nl[-1] == '\r') {
+                nl[-1] = '\0';
+            }
+            handle_request(c, start);
+            start = nl + 1;
+        }
+        c->request_len -= start - c->request;
+        memmove(c->request, start, c->request_len);
+
+        // Requests too long to hold are dropped.
+        if (c->request_len == sizeof(c->request)) {
+            c->request_len = 0;
+        }
+    }
+}
+
+/**
+ * Copy the given line to the ring, making room by dropping the oldest lines.
+ * Must be called with ring_lock held.
+ */
+static void ring_append(const struct output_record *rec)
+{
+    size_t len = 0;
+    for (int i = 0; i < rec->niov; ++i) {
+        len += rec->iov[i].iov_len;
+    }
+    // Lines too long to be staged along with a notice are never served.
+    if (len == 0 || len > STAGE_NBYTES - NOTICE_NCHARS) {
+        return;
+    }
+    while (ring_tail < ring_head
+           && (ring_head - ring_tail == RING_NLINES
+               || ring_end + len - ring_starts[ring_tail & (RING_NLINES - 1)]
+                  > RING_NBYTES)) {
+        ++ring_tail;
+    }
+    ring_starts[ring_head & (RING_NLINES - 1)] = ring_end;
+    for (int i = 0; i < rec->niov; ++i) {
+        const char *data = rec->iov[i].iov_base;
+        size_t left = rec->iov[i].iov_len;
+        while (left > 0) {
+            size_t at = ring_end & (RING_NBYTES - 1);
+            size_t n = RING_NBYTES - at < left ? RING_NBYTES - at : left;
+            memcpy(&ring[at], data, n);
+            data += n;
+            left -= n;
+            ring_end += n;
+        }
+    }
+    ++ring_head;
+}
+
+/**
+ * Copy len bytes of the ring from the given position to out. Must be called
+ * with ring_lock held.
+ */
+static void ring_copy(char *out, uint64_t pos, size_t len)
+{
+    while (len > 0) {
+        size_t at = pos & (RING_NBYTES - 1);
+        size_t n = RING_NBYTES - at < len ? RING_NBYTES - at : len;
+        memcpy(out, &ring[at], n);
+        out += n;
+        pos += n;
+        len -= n;
+    }
+}
+
+/**
+ * Run thread of execution that accepts subscribers, receives their requests
+ * and sends them lines as fast as each of them takes them.
+ */
+static void *run_server(void *unused)
+{
+    struct pollfd fds[2 + SERVE_CLIENTS_NMAX];
+    struct client *polled[2 + SERVE_CLIENTS_NMAX];
+    while (!atomic_load(&stopping)) {
+        fds[0] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = wake_fd, .events = POLLIN };
+        int nfds = 2;
+        for (int i = 0; i < SERVE_CLIENTS_NMAX; ++i) {
+            struct client *c = &clients[i];
+            if (c->fd < 0) {
+                continue;
+            }
+            // Only a subscriber that has not taken its stage is waited on.
+            fds[nfds].fd = c->fd;
+            fds[nfds].events = POLLIN | (c->sent < c->staged ? POLLOUT : 0);
+            polled[nfds++] = c;
+        }
+        if (poll(fds, nfds, -1) < 0) {
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            ssize_t n = read(wake_fd, &count, sizeof(count));
+            (void)n;
+        }
+        for (int i = 2; i < nfds; ++i) {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_requests(polled[i]);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_clients();
+        }
+        for (int i = 0; i < SERVE_CLIENTS_NMAX; ++i) {
+            if (clients[i].fd >= 0) {
+                send_lines(&clients[i]);
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Send the subscriber lines until it is caught up or takes no more for now.
+ */
+static void send_lines(struct client *c)
+{
+    for (;;) {
+        if (c->sent == c->staged) {
+            c->sent = 0;
+            c->staged = 0;
+            if (!stage_lines(c)) {
+                return;
+            }
+        }
+        ssize_t n = send(c->fd, &c->stage[c->sent], c->staged - c->sent,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n < 0) {
+            close_client(c);
+            return;
+        }
+        c->sent += n;
+    }
+}
+
+/**
+ * Fill the subscriber's empty stage with the lines it has yet to be sent,
+ * preceded by a notice of any it lost by falling behind. Returns whether
+ * anything was staged.
+ */
+static bool stage_lines(struct client *c)
+{
+    size_t notice = 0;
+    uint64_t head;
+    do {
+        pthread_mutex_lock(&ring_lock);
+        if (c->next < ring_tail) {
+            c->lost += ring_tail - c->next;
+            c->next = ring_tail;
+        }
+        if (c->lost > 0 && notice == 0) {
+            const char *fmt = output_format == OUTPUT_JSONL
+                              ? "{\"lost\":%llu}\n"
+                              : "--------- lost %llu lines\n";
+            notice = snprintf(c->stage, NOTICE_NCHARS, fmt,
+                              (unsigned long long)c->lost);
+            c->staged = notice;
+            c->lost = 0;
+        }
+        for (head = ring_head; c->next < head; ++c->next) {
+            uint64_t start = ring_starts[c->next & (RING_NLINES - 1)];
+            uint64_t end = c->next + 1 < head
+                           ? ring_starts[(c->next + 1) & (RING_NLINES - 1)]
+                           : ring_end;
+            if (end - start > STAGE_NBYTES - c->staged) {
+                break;
+            }
+            ring_copy(&c->stage[c->staged], start, end - start);
+            c->staged += end - start;
+        }
+        pthread_mutex_unlock(&ring_lock);
+
+        // Lines are filtered with the ring free for the writer.
+        filter_lines(c, notice);
+    } while (c->staged == notice && c->next < head);
+    return c->staged > 0;
+}
+
+/**
+ * Remove the escape sequences coloring the given line in place. Returns the
+ * length of what is left.
+ */
+static size_t strip_colors(char *line, size_t len)
+{
+    char *esc = memchr(line, '\033', len);
+    if (esc == NULL) {
+        return len;
+    }
+    size_t kept = esc - line;
+    for (size_t i = kept; i < len; ++i) {
+        if (line[i] == '\033' && i + 1 < len && line[i + 1] == '[') {
+            i += 2;
+            while (i < len && (line[i] < 0x40 || line[i] > 0x7e)) {
+                ++i;
+            }
+            continue;
+        }
+        line[kept++] = line[i];
+    }
+    return kept;
+}
+
+/**
+ * Wake the server from waiting on its subscribers.
+ */
+static void wake_server(void)
+{
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+}
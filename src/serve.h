@@ -0,0 +1,68 @@
+/** @file
+ * Server streaming lines to subscribers over TCP.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * One instance reads every device once while any number of subscribers follow
+ * its lines over TCP. The writer copies each finished line into a shared ring
+ * of formatted lines and never waits on a subscriber; every subscriber keeps
+ * its own place within the ring, so one that falls too far behind loses its
+ * oldest lines while the others, and the devices, carry on.
+ *
+ * Subscribers may send requests, one per line, at any time:
+ *
+ *     match REGEX     only send lines matching the extended regular expression
+ *     match           send every line again
+ *     format plain    send lines without their colors
+ *     format color    send lines as they are written, the default
+ */
+#ifndef SERVE_H_
+#define SERVE_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "output.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of subscribers served at once. */
+#define SERVE_CLIENTS_NMAX (64)
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *serve_addr;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int serve_listen(const char *addr, int *fd);
+int serve_start(void);
+void serve_stop(void);
+void serve_write(const struct output_record *recs, int n);
+
+#endif
@@ -0,0 +1,323 @@
+/** @file
+ * Rotating files the lines of each device are written to.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Files are opened by the writer when the first batch of a sink is written, so
+ * the thread that opens a sink only ever claims a slot for it. Batches are only
+ * written early when the writer is about to go idle, so quiet devices still
+ * reach the disk promptly.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "sink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes of each batch; a multiple of the page size. */
+#define BATCH_NBYTES (256 * 1024)
+
+/** Maximum number of characters of the name of a sink. */
+#define NAME_NCHARS (128)
+
+/** Size of a page, which batches are aligned to. */
+#define PAGE_NBYTES (4096)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Sink of the lines of a single device.
+ */
+struct sink {
+    char     name[NAME_NCHARS]; //!< Serial number of the device.
+    int      fd;                //!< Descriptor of the file, -1 when none.
+    bool     failed;            //!< Whether failing to write was reported.
+    bool     seen;              //!< Whether the writer was handed lines of it.
+    bool     used;              //!< Whether the sink is open, sinks_lock held.
+    time_t   opened;            //!< Time the file was started.
+    uint64_t written;           //!< Bytes written to the file.
+    char    *batch;             //!< Lines waiting to be written.
+    size_t   batch_used;        //!< Bytes of the batch filled.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Directory lines are written to, NULL to write them to standard output. */
+const char *sink_dir;
+
+/** Number of bytes a file grows to before rotating. */
+uint64_t sink_rotate_nbytes = SINK_ROTATE_NBYTES_DEFAULT;
+
+/** Seconds a file is written for before rotating, or zero for no limit. */
+unsigned sink_rotate_secs;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Sinks indexed by identifier. */
+static struct sink sinks[SINK_NMAX];
+
+/** Lock used to serialize the opening and handing back of sinks. */
+static pthread_mutex_t sinks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void close_file(struct sink *s);
+static void fail(struct sink *s, const char *what);
+static void start_file(struct sink *s, time_t now);
+static void write_batch(struct sink *s);
+
+/******************************************************************************/
+
+/**
+ * Append the line described by the given vector to the sink with the given
+ * identifier.
+ */
+void sink_append(uint32_t id, const struct iovec *iov, int iovcnt)
+{
+    struct sink *s = &sinks[id];
+    s->seen = true;
+    for (int i = 0; i < iovcnt; ++i) {
+        const char *p = iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+        while (left > 0) {
+            if (s->batch_used == BATCH_NBYTES) {
+                write_batch(s);
+            }
+            size_t n = BATCH_NBYTES - s->batch_used;
+            if (n > left) {
+                n = left;
+            }
+            memcpy(s->batch + s->batch_used, p, n);
+            s->batch_used += n;
+            p += n;
+            left -= n;
+        }
+    }
+}
+
+/**
+ * Write out whatever the sink with the given identifier holds and hand the
+ * sink back.
+ */
+void sink_close(uint32_t id)
+{
+    struct sink *s = &sinks[id];
+    write_batch(s);
+    close_file(s);
+    free(s->batch);
+    s->batch = NULL;
+    s->seen = false;
+
+    pthread_mutex_lock(&sinks_lock);
+    s->used = false;
+    pthread_mutex_unlock(&sinks_lock);
+}
+
+/**
+ * Write out the partial batches of every sink.
+ */
+void sink_flush(void)
+{
+    for (uint32_t id = 0; id < SINK_NMAX; ++id) {
+        // Sinks are only touched by the writer once it has seen lines of them.
+        if (sinks[id].seen && sinks[id].batch_used > 0) {
+            write_batch(&sinks[id]);
+        }
+    }
+}
+
+/**
+ * Write out and hand back every sink still open. Whatever opened them must be
+ * done with them.
+ */
+void sink_free(void)
+{
+    for (uint32_t id = 0; id < SINK_NMAX; ++id) {
+        if (sinks[id].batch != NULL) {
+            sink_close(id);
+        }
+    }
+}
+
+/**
+ * Return the identifier of a new sink for the device with the given serial
+ * number. Safe to call from any thread.
+ */
+uint32_t sink_open(const char *name)
+{
+    char *batch = aligned_alloc(PAGE_NBYTES, BATCH_NBYTES);
+    if (batch == NULL) {
+        fprintf(stderr, "Failure to allocate output batch.\n");
+        abort();
+    }
+
+    pthread_mutex_lock(&sinks_lock);
+    uint32_t id = 0;
+    while (id < SINK_NMAX && sinks[id].used) {
+        ++id;
+    }
+    if (id == SINK_NMAX) {
+        fprintf(stderr, "Too many devices to write files of.\n");
+        abort();
+    }
+    struct sink *s = &sinks[id];
+    s->used = true;
+    pthread_mutex_unlock(&sinks_lock);
+
+    // The writer only touches the sink once handed lines of it.
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->fd = -1;
+    s->failed = false;
+    s->batch = batch;
+    s->batch_used = 0;
+    return id;
+}
+
+/**
+ * Close the file of the given sink, if it has one, giving back the space
+ * preallocated past what was written to it.
+ */
+static void close_file(struct sink *s)
+{
+    if (s->fd < 0) {
+        return;
+    }
+    if (ftruncate(s->fd, (off_t)s->written) != 0) {
+        fail(s, "truncate");
+    }
+    close(s->fd);
+    s->fd = -1;
+}
+
+/**
+ * Report a failure to write the files of the given sink, once per file.
+ */
+static void fail(struct sink *s, const char *what)
+{
+    if (!s->failed) {
+        fprintf(stderr, "Failure to %s file of device %s: %s\n", what,
+                s->name, strerror(errno));
+        s->failed = true;
+    }
+}
+
+/**
+ * Start a new file for the given sink, closing the one before. The file is
+ * named after the device and the time it was started, with a count appended
+ * when several start within the same second.
+ */
+static void start_file(struct sink *s, time_t now)
+{
+    close_file(s);
+
+    // Nothing may step outside the directory.
+    char name[NAME_NCHARS];
+    snprintf(name, sizeof(name), "%s", s->name);
+    for (char *c = name; *c != '\0'; ++c) {
+        if (*c == '/') {
+            *c = '_';
+        }
+    }
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+    char path[PATH_MAX];
+    for (unsigned count = 0; s->fd < 0; ++count) {
+        if (count == 0) {
+            snprintf(path, sizeof(path), "%s/%s-%s.log", sink_dir, name, stamp);
+        } else {
+            snprintf(path, sizeof(path), "%s/%s-%s.%u.log", sink_dir, name,
+                     stamp, count);
+        }
+        s->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (s->fd < 0 && errno != EEXIST) {
+            fail(s, "create");
+            return;
+        }
+    }
+    // Preallocating is only an optimization; not every file system can.
+    fallocate(s->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)sink_rotate_nbytes);
+    s->opened = now;
+    s->written = 0;
+    s->failed = false;
+}
+
+/**
+ * Write the given sink's batch to its file, starting a new file first when
+ * the current one is due to rotate. The batch is emptied even should writing
+ * fail.
+ */
+static void write_batch(struct sink *s)
+{
+    if (s->batch_used == 0) {
+        return;
+    }
+    time_t now = time(NULL);
+    if (s->fd < 0 || s->written >= sink_rotate_nbytes
+        || (sink_rotate_secs > 0
+            && now - s->opened >= (time_t)sink_rotate_secs)) {
+        start_file(s, now);
+    }
+
+    const char *p = s->batch;
+    size_t left = s->batch_used;
+    while (s->fd >= 0 && left > 0) {
+        ssize_t n = write(s->fd, p, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            fail(s, "write");
+            break;
+        }
+        p += n;
+        left -= n;
+        s->written += n;
+    }
+    s->batch_used = 0;
+}
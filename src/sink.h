@@ -0,0 +1,78 @@
+/** @file
+ * Rotating files the lines of each device are written to.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Instead of standard output, the lines of every device may be written within
+ * a directory to files of their own named after the device's serial number and
+ * the time each file was started. A file is started anew once it has grown to
+ * the rotation size or has been written for the rotation period. Files are
+ * preallocated to the rotation size, which keeps them contiguous on disk, and
+ * lines are gathered into large batches before being written.
+ *
+ * Everything but the opening of sinks is only used by the writer thread, so
+ * neither writing nor rotating files ever stalls the threads reading devices.
+ */
+#ifndef SINK_H_
+#define SINK_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Maximum number of sinks open at once. */
+#define SINK_NMAX (1024)
+
+/** Number of bytes a file grows to before rotating unless told otherwise. */
+#define SINK_ROTATE_NBYTES_DEFAULT (64 * 1024 * 1024)
+
+/** Most megabytes a file may be told to grow to before rotating. */
+#define SINK_ROTATE_MB_MAX (1024 * 1024)
+
+/** Most seconds a file may be told to be written to before rotating. */
+#define SINK_ROTATE_SECS_MAX (7 * 24 * 60 * 60)
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *sink_dir;
+extern uint64_t sink_rotate_nbytes;
+extern unsigned sink_rotate_secs;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void sink_append(uint32_t id, const struct iovec *iov, int iovcnt);
+void sink_close(uint32_t id);
+void sink_flush(void);
+void sink_free(void);
+uint32_t sink_open(const char *name);
+
+#endif
@@ -0,0 +1,359 @@
+/** @file
+ * Snapshots of the latest lines taken when a device crashes.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Requests are kept in a small table by device, which also remembers when each
+ * device last triggered, under a lock only taken for lines that trigger. The
+ * writer thread sleeps until the earliest request is due, takes the snapshot
+ * and writes it through a stream that compresses as it goes. Requests still
+ * waiting when the writer stops are written at once.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "snapshot.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include "affinity.h"
+#include "tail.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Milliseconds after the triggering line a snapshot is taken. */
+#define DELAY_MS (2000)
+
+/** Milliseconds after a snapshot its device is ignored. */
+#define HOLDOFF_MS (30000)
+
+/** Maximum number of literals that trigger a snapshot. */
+#define LITERALS_NMAX (64)
+
+/** Maximum number of characters of the name of a device. */
+#define NAME_NCHARS (128)
+
+/** Maximum number of characters of the path of a snapshot. */
+#define PATH_NCHARS (4096)
+
+/** Number of devices whose requests are remembered. */
+#define REQUESTS_NMAX (16)
+
+/** Milliseconds of lines of the other devices before the triggering line. */
+#define WINDOW_MS (5000)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Snapshot asked for by a device.
+ */
+struct request {
+    char     name[NAME_NCHARS]; //!< Serial number of the device, empty for an
+                                //!< unused request.
+    uint64_t ms;                //!< Milliseconds since the epoch the line
+                                //!< triggering it was logged at.
+    uint64_t at;                //!< Time it was asked for on the monotonic
+                                //!< clock in milliseconds.
+    bool     pending;           //!< Whether it is still to be taken.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Directory snapshots are written to, NULL to take none. */
+const char *snapshot_dir;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Literals whose lines trigger a snapshot. */
+static char *literals[LITERALS_NMAX];
+
+/** Number of literals. */
+static size_t literals_n;
+
+/** Requests of the devices that last asked for snapshots. */
+static struct request requests[REQUESTS_NMAX];
+
+/** Lock used to protect the requests and the writer's state. */
+static pthread_mutex_t requests_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Condition signalled when a request is made or the writer is stopped. */
+static pthread_cond_t requested = PTHREAD_COND_INITIALIZER;
+
+/** Whether the writer was started. */
+static bool started;
+
+/** Whether the writer is to stop once every request is written. */
+static bool stopping;
+
+/** Thread that writes snapshots. */
+static pthread_t thread;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static int close_gz(void *cookie);
+static bool has_literal(const char *msg, size_t len);
+static uint64_t now_ms(void);
+static void *run_writer(void *unused);
+static ssize_t write_gz(void *cookie, const char *data, size_t len);
+static void write_snapshot(const struct request *r);
+
+/******************************************************************************/
+
+/**
+ * Have lines holding the given literal trigger a snapshot, as lines logged at
+ * the fatal priority do. Must be called before snapshot_start(). Returns 0 on
+ * success or an error number on failure.
+ */
+int snapshot_add(const char *literal)
+{
+    if (literals_n == LITERALS_NMAX || *literal == '\0') {
+        return EINVAL;
+    }
+    literals[literals_n] = strdup(literal);
+    if (literals[literals_n] == NULL) {
+        return ENOMEM;
+    }
+    ++literals_n;
+    return 0;
+}
+
+/**
+ * Ask for a snapshot should the given line, logged by the device with the
+ * given name at the given milliseconds since the epoch, trigger one.
+ */
+void snapshot_check(const char *name, uint64_t ms, char tagtype,
+                    const char *msg, size_t len)
+{
+    if (tagtype != 'F' && !has_literal(msg, len)) {
+        return;
+    }
+
+    // The device's own request is reused, else the one asked for longest ago
+    // that has been taken.
+    uint64_t now = now_ms();
+    pthread_mutex_lock(&requests_lock);
+    struct request *r = NULL;
+    for (size_t i = 0; i < REQUESTS_NMAX; ++i) {
+        struct request *o = &requests[i];
+        if (strncmp(o->name, name, sizeof(o->name) - 1) == 0) {
+            r = o;
+            break;
+        }
+        if (!o->pending && (r == NULL || o->at < r->at)) {
+            r = o;
+        }
+    }
+    if (r == NULL || (r->name[0] != '\0' && now < r->at + HOLDOFF_MS
+                      && strncmp(r->name, name, sizeof(r->name) - 1) == 0)) {
+        pthread_mutex_unlock(&requests_lock);
+        return;
+    }
+    strncpy(r->name, name, sizeof(r->name) - 1);
+    r->name[sizeof(r->name) - 1] = '\0';
+    r->ms = ms;
+    r->at = now;
+    r->pending = true;
+    pthread_cond_signal(&requested);
+    pthread_mutex_unlock(&requests_lock);
+}
+
+/**
+ * Start the thread that writes snapshots. Returns 0 on success or an error
+ * number on failure.
+ */
+int snapshot_start(void)
+{
+    int err = pthread_create(&thread, NULL, run_writer, NULL);
+    started = err == 0;
+    return err;
+}
+
+/**
+ * Write every snapshot asked for, without waiting for the rest of their lines,
+ * then stop the writer. Devices must no longer be adding lines.
+ */
+void snapshot_stop(void)
+{
+    pthread_mutex_lock(&requests_lock);
+    stopping = true;
+    pthread_cond_signal(&requested);
+    pthread_mutex_unlock(&requests_lock);
+    if (started) {
+        pthread_join(thread, NULL);
+        started = false;
+    }
+    while (literals_n > 0) {
+        free(literals[--literals_n]);
+    }
+}
+
+/**
+ * Close the compressed stream that is the cookie of a stream.
+ */
+static int close_gz(void *cookie)
+{
+    return gzclose((gzFile)cookie) == Z_OK ? 0 : EOF;
+}
+
+/**
+ * Return whether the given message holds any of the literals.
+ */
+static bool has_literal(const char *msg, size_t len)
+{
+    for (size_t i = 0; i < literals_n; ++i) {
+        if (memmem(msg, len, literals[i], strlen(literals[i])) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Return the time on the monotonic clock in milliseconds.
+ */
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Thread of execution that writes each snapshot once it is due.
+ */
+static void *run_writer(void *unused)
+{
+    affinity_pin(AFFINITY_WRITERS);
+    pthread_mutex_lock(&requests_lock);
+    for (;;) {
+        struct request *next = NULL;
+        for (size_t i = 0; i < REQUESTS_NMAX; ++i) {
+            struct request *r = &requests[i];
+            if (r->pending && (next == NULL || r->at < next->at)) {
+                next = r;
+            }
+        }
+        if (next == NULL) {
+            if (stopping) {
+                break;
+            }
+            pthread_cond_wait(&requested, &requests_lock);
+            continue;
+        }
+        uint64_t now = now_ms();
+        if (!stopping && now < next->at + DELAY_MS) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t nsec = ts.tv_nsec + (next->at + DELAY_MS - now) * 1000000;
+            ts.tv_sec += nsec / 1000000000;
+            ts.tv_nsec = nsec % 1000000000;
+            pthread_cond_timedwait(&requested, &requests_lock, &ts);
+            continue;
+        }
+        struct request taken = *next;
+        next->pending = false;
+        pthread_mutex_unlock(&requests_lock);
+        write_snapshot(&taken);
+        pthread_mutex_lock(&requests_lock);
+    }
+    pthread_mutex_unlock(&requests_lock);
+    return NULL;
+}
+
+/**
+ * Compress the given data into the compressed stream that is the cookie of a
+ * stream. Returns the number of bytes written, 0 on failure.
+ */
+static ssize_t write_gz(void *cookie, const char *data, size_t len)
+{
+    return gzwrite((gzFile)cookie, data, len);
+}
+
+/**
+ * Take the snapshot asked for by the given request and write it to a file of
+ * the snapshot directory named for the device and the time of the triggering
+ * line.
+ */
+static void write_snapshot(const struct request *r)
+{
+    struct tail_snapshot *s = tail_snapshot_take(r->name, r->ms > WINDOW_MS
+                                                          ? r->ms - WINDOW_MS
+                                                          : 0);
+    if (s == NULL) {
+        return;
+    }
+    char when[32];
+    time_t sec = r->ms / 1000;
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    strftime(when, sizeof(when), "%Y%m%d-%H%M%S", &tm);
+    char path[PATH_NCHARS];
+    snprintf(path, sizeof(path), "%s/%s-%s.log.gz", snapshot_dir, r->name,
+             when);
+
+    int err = 0;
+    gzFile gz = gzopen(path, "wb");
+    FILE *out = NULL;
+    if (gz == NULL) {
+        err = errno != 0 ? errno : ENOMEM;
+    } else {
+        cookie_io_functions_t io = { .write = write_gz, .close = close_gz };
+        out = fopencookie(gz, "w", io);
+        if (out == NULL) {
+            err = errno;
+            gzclose(gz);
+        }
+    }
+    if (out != NULL) {
+        err = tail_snapshot_dump(s, out);
+        if (fclose(out) != 0 && !err) {
+            err = EIO;
+        }
+    }
+    tail_snapshot_free(s);
+    if (err) {
+        fprintf(stderr, "Failure to write the snapshot %s: %s\n", path,
+                strerror(err));
+        return;
+    }
+    fprintf(stderr, "Wrote a snapshot of %s to %s.\n", r->name, path);
+}
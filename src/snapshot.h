@@ -0,0 +1,69 @@
+/** @file
+ * Snapshots of the latest lines taken when a device crashes.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * A line logged at the fatal priority, or holding any of the literals given,
+ * has a snapshot of the rings of latest lines taken: the whole ring of the
+ * device that logged it and the few seconds before it of every other device.
+ * Snapshots are written by a thread of their own as gzip files within a
+ * directory, so that a crash leaves its context behind without archiving
+ * everything at full rate.
+ *
+ * The snapshot is only taken a moment after the line triggering it, so that the
+ * rest of a stack trace makes it in, and a device that triggers again within a
+ * short while of its last snapshot is ignored, so that a crash loop does not
+ * fill the disk.
+ */
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Megabytes of latest lines kept for snapshots unless told otherwise. */
+#define SNAPSHOT_TAIL_MB_DEFAULT (16)
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern const char *snapshot_dir;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int snapshot_add(const char *literal);
+void snapshot_check(const char *name, uint64_t ms, char tagtype,
+                    const char *msg, size_t len);
+int snapshot_start(void);
+void snapshot_stop(void);
+
+#endif
@@ -0,0 +1,606 @@
+/** @file
+ * Counters describing how well the software keeps up.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Threads register their counters on first use. A report walks the registered
+ * counters under a lock that updates never take; whatever a thread counted is
+ * folded into the retired totals when it exits. Devices register their
+ * counters when they are created and are forgotten once they go away.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "stats.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output.h"
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bits of the linear split of each power of two of latency. */
+#define LATENCY_SUB_NBITS (3)
+
+/** Number of buckets of the histogram of latency. */
+#define LATENCY_NBUCKETS ((64 - LATENCY_SUB_NBITS + 1) << LATENCY_SUB_NBITS)
+
+/** Number of the heaviest talkers across every device reported. */
+#define TALKERS_NREPORTED (10)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Family of metrics of which every device has a counter of its own.
+ */
+struct device_family {
+    const char *name;   //!< Name of the family.
+    const char *help;   //!< Description of the family.
+    size_t      offset; //!< Offset of the counter within the device's.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+__thread struct stats_counters *stats_local;
+
+/** Names of the locks whose waits are measured, as they are reported. */
+const char *const stats_lock_names[STATS_LOCKS_N] = {
+    [STATS_LOCK_DEVICE_MAP] = "device_map",
+    [STATS_LOCK_TAG_MAP] = "tag_map",
+    [STATS_LOCK_WRITER] = "writer",
+};
+
+/** Waits on each of the locks whose waits are measured. */
+struct stats_lock stats_locks[STATS_LOCKS_N];
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Counters of every device currently registered. */
+static struct stats_device *devices;
+
+/** Families of metrics of the devices' counters, see stats_write_metrics. */
+static const struct device_family device_families[] = {
+    { "android_log_device_lines", "Lines or entries read from the device.",
+      offsetof(struct stats_device, lines) },
+    { "android_log_device_bytes", "Bytes of the lines read from the device.",
+      offsetof(struct stats_device, bytes) },
+    { "android_log_device_unparsed", "Lines of the device not parsed.",
+      offsetof(struct stats_device, unparsed) },
+    { "android_log_device_dropped", "Lines of the device dropped by the "
+      "output policy.", offsetof(struct stats_device, dropped) },
+    { "android_log_device_collapsed", "Repeats of lines of the device "
+      "collapsed.", offsetof(struct stats_device, collapsed) },
+    { "android_log_device_limited", "Lines of the device over their tag's "
+      "budget.", offsetof(struct stats_device, limited) },
+};
+
+/** Bounds of the buckets of latency in metrics, in seconds. */
+static const double latency_bounds[] = {
+    0.00001, 0.0001, 0.001, 0.01, 0.1, 1.0, 10.0,
+};
+
+/** Lines written by latency in nanoseconds, only updated by the writer. */
+static atomic_uint_fast64_t latency[LATENCY_NBUCKETS];
+
+/** Longest latency in nanoseconds, only updated by the writer. */
+static atomic_uint_fast64_t latency_max;
+
+/** Sum of the latencies in nanoseconds, only updated by the writer. */
+static atomic_uint_fast64_t latency_sum;
+
+/** Counters of every thread of execution currently registered. */
+static struct stats_counters *registered;
+
+/** Totals of the counters of threads that have since exited. */
+static struct stats_counters retired;
+
+/** Lock used to prevent concurrent modification of the registered lists. */
+static pthread_mutex_t registered_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Time of the last report in nanoseconds, 0 before the first. */
+static uint64_t reported_ns;
+
+/** Lines written at the last report. */
+static uint64_t reported_written;
+
+/** Bytes written, only updated by the writer. */
+static atomic_uint_fast64_t written_bytes;
+
+/** Lines written, only updated by the writer. */
+static atomic_uint_fast64_t written_lines;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static int compare_talkers(const void *a, const void *b);
+static unsigned latency_bucket(uint64_t nsecs);
+static uint64_t latency_floor(unsigned bucket);
+static void print_latency(FILE *fh);
+static void print_locks(FILE *fh);
+static void print_talkers(FILE *fh);
+static void sum_counters(struct stats_counters *total,
+                         struct stats_counters *counters);
+static void write_family(FILE *fh, bool openmetrics, const char *name,
+                         const char *type, const char *help);
+static void write_label(FILE *fh, const char *value);
+static void write_latency(FILE *fh, bool openmetrics);
+
+/******************************************************************************/
+
+/**
+ * Register the counters of the device with the given name for reports. The
+ * name must outlive the registration.
+ */
+void stats_device_register(struct stats_device *d, const char *name)
+{
+    d->name = name;
+    pthread_mutex_lock(&registered_lock);
+    if (reported_ns == 0) {
+        reported_ns = stats_now_ns();
+    }
+    d->next = devices;
+    devices = d;
+    pthread_mutex_unlock(&registered_lock);
+}
+
+/**
+ * Stop reporting the counters of the given device.
+ */
+void stats_device_unregister(struct stats_device *d)
+{
+    pthread_mutex_lock(&registered_lock);
+    for (struct stats_device **c = &devices; *c != NULL; c = &(*c)->next) {
+        if (*c == d) {
+            *c = d->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registered_lock);
+}
+
+/**
+ * Record that a line took the given number of nanoseconds from being read to
+ * being written. Must only be called by the writer.
+ */
+void stats_latency(uint64_t nsecs)
+{
+    stats_add(&latency[latency_bucket(nsecs)], 1);
+    stats_add(&latency_sum, nsecs);
+    if (nsecs > atomic_load_explicit(&latency_max, memory_order_relaxed)) {
+        atomic_store_explicit(&latency_max, nsecs, memory_order_relaxed);
+    }
+}
+
+/**
+ * Return the latency in nanoseconds that the given percent of the lines
+ * written so far took at most, to within an eighth, or 0 if none were.
+ */
+uint64_t stats_latency_percentile(double percent)
+{
+    uint64_t counts[LATENCY_NBUCKETS];
+    uint64_t total = 0;
+    for (unsigned i = 0; i < LATENCY_NBUCKETS; ++i) {
+        counts[i] = atomic_load_explicit(&latency[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(total * percent / 100.0 + 0.5);
+    unsigned bucket = 0;
+    uint64_t seen = counts[0];
+    while (seen < rank && bucket + 1 < LATENCY_NBUCKETS) {
+        seen += counts[++bucket];
+    }
+
+    // Percentiles are reported as the bound above their bucket.
+    uint64_t max = atomic_load(&latency_max);
+    uint64_t bound = bucket + 1 < LATENCY_NBUCKETS
+                     ? latency_floor(bucket + 1) : UINT64_MAX;
+    return bound < max ? bound : max;
+}
+
+/**
+ * Print a summary of the counters to the given file. Rates are of the time
+ * since the last summary.
+ */
+void stats_print(FILE *fh)
+{
+    struct stats_counters total = { 0 };
+    pthread_mutex_lock(&registered_lock);
+    sum_counters(&total, &retired);
+    for (struct stats_counters *c = registered; c != NULL; c = c->next) {
+        sum_counters(&total, c);
+    }
+
+    uint64_t hits = atomic_load(&total.tag_cache_hits);
+    uint64_t misses = atomic_load(&total.tag_cache_misses);
+    uint64_t lookups = hits + misses;
+    double rate = lookups ? 100.0 * hits / lookups : 0.0;
+    fprintf(fh, "tag cache: %" PRIu64 " hits, %" PRIu64 " misses "
+                "(%.1f%% hit rate)\n", hits, misses, rate);
+    fprintf(fh, "tags: %" PRIu32 " held, %" PRIu64 " evicted\n", tag_count(),
+            tag_evictions());
+
+    uint64_t now = stats_now_ns();
+    double secs = reported_ns != 0 ? (now - reported_ns) / 1e9 : 0.0;
+    reported_ns = now;
+    uint64_t lines = atomic_load(&written_lines);
+    fprintf(fh, "output: %" PRIu64 " lines, %" PRIu64 " bytes written "
+                "(%.0f lines/s)\n", lines, atomic_load(&written_bytes),
+            secs > 0 ? (lines - reported_written) / secs : 0.0);
+    reported_written = lines;
+    print_latency(fh);
+    print_locks(fh);
+    for (struct stats_device *d = devices; d != NULL; d = d->next) {
+        uint64_t read = atomic_load(&d->lines);
+        fprintf(fh, "device %s: %" PRIu64 " lines, %" PRIu64 " bytes read "
+                    "(%.0f lines/s), %" PRIu64 " unparsed, %" PRIu64
+                    " dropped, %" PRIu64 " collapsed, %" PRIu64 " limited, %"
+                    PRIu64 " tag misses\n", d->name, read,
+                atomic_load(&d->bytes),
+                secs > 0 && read >= d->reported ? (read - d->reported) / secs
+                                                : 0.0,
+                atomic_load(&d->unparsed), atomic_load(&d->dropped),
+                atomic_load(&d->collapsed), atomic_load(&d->limited),
+                atomic_load(&d->tag_misses));
+        d->reported = read;
+    }
+    print_talkers(fh);
+    pthread_mutex_unlock(&registered_lock);
+}
+
+/**
+ * Register counters for the calling thread and return them.
+ */
+struct stats_counters *stats_thread_register(void)
+{
+    struct stats_counters *counters = calloc(1, sizeof(*counters));
+    if (counters == NULL) {
+        // Count into the retired totals rather than lose the updates.
+        return &retired;
+    }
+    pthread_mutex_lock(&registered_lock);
+    counters->next = registered;
+    registered = counters;
+    pthread_mutex_unlock(&registered_lock);
+    stats_local = counters;
+    return counters;
+}
+
+/**
+ * Fold the calling thread's counters into the retired totals and release
+ * them. Must be called before a thread that updated counters exits.
+ */
+void stats_thread_unregister(void)
+{
+    struct stats_counters *counters = stats_local;
+    if (counters == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&registered_lock);
+    for (struct stats_counters **c = &registered; *c != NULL;
+         c = &(*c)->next) {
+        if (*c == counters) {
+            *c = counters->next;
+            break;
+        }
+    }
+    sum_counters(&retired, counters);
+    pthread_mutex_unlock(&registered_lock);
+    stats_local = NULL;
+    free(counters);
+}
+
+/**
+ * Write every counter to the given file as metrics in the text format of
+ * Prometheus, or of OpenMetrics when asked for. Counters are only read, so
+ * neither devices nor the writer wait on the metrics.
+ */
+void stats_write_metrics(FILE *fh, bool openmetrics)
+{
+    struct stats_counters total = { 0 };
+    pthread_mutex_lock(&registered_lock);
+    sum_counters(&total, &retired);
+    for (struct stats_counters *c = registered; c != NULL; c = c->next) {
+        sum_counters(&total, c);
+    }
+
+    write_family(fh, openmetrics, "android_log_output_lines", "counter",
+                 "Lines handed on by the writer.");
+    fprintf(fh, "android_log_output_lines_total %" PRIu64 "\n",
+            atomic_load(&written_lines));
+    write_family(fh, openmetrics, "android_log_output_bytes", "counter",
+                 "Bytes handed on by the writer.");
+    fprintf(fh, "android_log_output_bytes_total %" PRIu64 "\n",
+            atomic_load(&written_bytes));
+    write_family(fh, openmetrics, "android_log_output_queued", "gauge",
+                 "Lines queued for the writer.");
+    fprintf(fh, "android_log_output_queued %zu\n", output_queued());
+    write_latency(fh, openmetrics);
+    write_family(fh, openmetrics, "android_log_lock_waits", "counter",
+                 "Times a lock was found taken.");
+    for (int i = 0; i < STATS_LOCKS_N; ++i) {
+        fprintf(fh, "android_log_lock_waits_total{lock=\"%s\"} %" PRIu64 "\n",
+                stats_lock_names[i], atomic_load(&stats_locks[i].waits));
+    }
+    write_family(fh, openmetrics, "android_log_lock_wait_seconds", "counter",
+                 "Seconds spent waiting on a lock found taken.");
+    for (int i = 0; i < STATS_LOCKS_N; ++i) {
+        fprintf(fh, "android_log_lock_wait_seconds_total{lock=\"%s\"} %.6f\n",
+                stats_lock_names[i],
+                atomic_load(&stats_locks[i].wait_ns) / 1e9);
+    }
+    write_family(fh, openmetrics, "android_log_tag_cache_hits", "counter",
+                 "Tag lookups served by the cache.");
+    fprintf(fh, "android_log_tag_cache_hits_total %" PRIu64 "\n",
+            atomic_load(&total.tag_cache_hits));
+    write_family(fh, openmetrics, "android_log_tag_cache_misses", "counter",
+                 "Tag lookups of the tag map.");
+    fprintf(fh, "android_log_tag_cache_misses_total %" PRIu64 "\n",
+            atomic_load(&total.tag_cache_misses));
+    write_family(fh, openmetrics, "android_log_tags", "gauge",
+                 "Tags held by the tag map.");
+    fprintf(fh, "android_log_tags %" PRIu32 "\n", tag_count());
+    write_family(fh, openmetrics, "android_log_tags_evicted", "counter",
+                 "Tags evicted from the tag map.");
+    fprintf(fh, "android_log_tags_evicted_total %" PRIu64 "\n",
+            tag_evictions());
+
+    unsigned ndevices = 0;
+    for (struct stats_device *d = devices; d != NULL; d = d->next) {
+        ++ndevices;
+    }
+    write_family(fh, openmetrics, "android_log_devices", "gauge",
+                 "Devices being read.");
+    fprintf(fh, "android_log_devices %u\n", ndevices);
+    for (size_t i = 0; i < sizeof(device_families) / sizeof(device_families[0]);
+         ++i) {
+        const struct device_family *f = &device_families[i];
+        write_family(fh, openmetrics, f->name, "counter", f->help);
+        for (struct stats_device *d = devices; d != NULL; d = d->next) {
+            const atomic_uint_fast64_t *counter =
+                (const atomic_uint_fast64_t *)((const char *)d + f->offset);
+            fprintf(fh, "%s_total{device=", f->name);
+            write_label(fh, d->name);
+            fprintf(fh, "} %" PRIu64 "\n", atomic_load(counter));
+        }
+    }
+    // Devices gone quiet stand out by the time since they were last read.
+    uint64_t now = stats_now_ns();
+    write_family(fh, openmetrics, "android_log_device_idle_seconds", "gauge",
+                 "Seconds since the device was last read.");
+    for (struct stats_device *d = devices; d != NULL; d = d->next) {
+        uint64_t read_ns = atomic_load(&d->read_ns);
+        fprintf(fh, "android_log_device_idle_seconds{device=");
+        write_label(fh, d->name);
+        fprintf(fh, "} %.3f\n", read_ns != 0 && now > read_ns
+                                ? (now - read_ns) / 1e9 : 0.0);
+    }
+    pthread_mutex_unlock(&registered_lock);
+    if (openmetrics) {
+        fprintf(fh, "# EOF\n");
+    }
+}
+
+/**
+ * Record that the writer handed the given number of lines and bytes on. Must
+ * only be called by the writer.
+ */
+void stats_written(uint64_t lines, uint64_t bytes)
+{
+    stats_add(&written_lines, lines);
+    stats_add(&written_bytes, bytes);
+}
+
+/**
+ * Compare the given reports of talkers, the one of the larger estimate first.
+ */
+static int compare_talkers(const void *a, const void *b)
+{
+    const struct top_report *x = a;
+    const struct top_report *y = b;
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+/**
+ * Return the bucket of the histogram of latency the given latency falls in.
+ */
+static unsigned latency_bucket(uint64_t nsecs)
+{
+    if (nsecs < (1u << LATENCY_SUB_NBITS)) {
+        return nsecs;
+    }
+    unsigned msb = 63 - __builtin_clzll(nsecs);
+    unsigned shift = msb - LATENCY_SUB_NBITS;
+    return ((shift + 1) << LATENCY_SUB_NBITS)
+           | ((nsecs >> shift) & ((1u << LATENCY_SUB_NBITS) - 1));
+}
+
+/**
+ * Return the least latency falling in the given bucket.
+ */
+static uint64_t latency_floor(unsigned bucket)
+{
+    if (bucket < (1u << LATENCY_SUB_NBITS)) {
+        return bucket;
+    }
+    unsigned shift = (bucket >> LATENCY_SUB_NBITS) - 1;
+    uint64_t sub = bucket & ((1u << LATENCY_SUB_NBITS) - 1);
+    return ((1u << LATENCY_SUB_NBITS) | sub) << shift;
+}
+
+/**
+ * Print percentiles of the latency of the lines written so far.
+ */
+static void print_latency(FILE *fh)
+{
+    static const double percents[] = { 50.0, 90.0, 99.0, 99.9 };
+    uint64_t max = atomic_load(&latency_max);
+    if (max == 0) {
+        return;
+    }
+    fprintf(fh, "latency:");
+    for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); ++i) {
+        fprintf(fh, " p%g %.1fus", percents[i],
+                stats_latency_percentile(percents[i]) / 1000.0);
+    }
+    fprintf(fh, " max %.1fus\n", max / 1000.0);
+}
+
+/**
+ * Print the waits on each lock whose waits are measured.
+ */
+static void print_locks(FILE *fh)
+{
+    fprintf(fh, "lock waits:");
+    for (int i = 0; i < STATS_LOCKS_N; ++i) {
+        fprintf(fh, "%s %s %" PRIu64 " (%.3fms)", i > 0 ? "," : "",
+                stats_lock_names[i], atomic_load(&stats_locks[i].waits),
+                atomic_load(&stats_locks[i].wait_ns) / 1e6);
+    }
+    fprintf(fh, "\n");
+}
+
+/**
+ * Print the heaviest talkers across every device, heaviest first. Must be
+ * called with registered_lock held.
+ */
+static void print_talkers(FILE *fh)
+{
+    size_t ndevices = 0;
+    for (struct stats_device *d = devices; d != NULL; d = d->next) {
+        ++ndevices;
+    }
+    if (ndevices == 0) {
+        return;
+    }
+    struct top_report *reports = malloc(sizeof(*reports) * ndevices
+                                        * TOP_NTALKERS);
+    if (reports == NULL) {
+        fprintf(stderr, "Failure to allocate talkers.\n");
+        abort();
+    }
+    size_t n = 0;
+    for (struct stats_device *d = devices; d != NULL; d = d->next) {
+        n += top_read(&d->top, d->name, &reports[n]);
+    }
+    qsort(reports, n, sizeof(*reports), compare_talkers);
+    for (size_t i = 0; i < n && i < TALKERS_NREPORTED; ++i) {
+        fprintf(fh, "talker %s %s: %" PRIu64 " bytes\n", reports[i].device,
+                reports[i].name, reports[i].bytes);
+    }
+    free(reports);
+}
+
+/**
+ * Add the given counters into the total.
+ */
+static void sum_counters(struct stats_counters *total,
+                         struct stats_counters *counters)
+{
+    stats_add(&total->tag_cache_hits, atomic_load_explicit(
+                  &counters->tag_cache_hits, memory_order_relaxed));
+    stats_add(&total->tag_cache_misses, atomic_load_explicit(
+                  &counters->tag_cache_misses, memory_order_relaxed));
+}
+
+/**
+ * Write the description and type of the family of metrics of the given name to
+ * the given file. Prometheus names the family of a counter after its samples,
+ * OpenMetrics without their suffix.
+ */
+static void write_family(FILE *fh, bool openmetrics, const char *name,
+                         const char *type, const char *help)
+{
+    const char *suffix = !openmetrics && strcmp(type, "counter") == 0
+                         ? "_total" : "";
+    fprintf(fh, "# HELP %s%s %s\n", name, suffix, help);
+    fprintf(fh, "# TYPE %s%s %s\n", name, suffix, type);
+}
+
+/**
+ * Write the given value of a label quoted and escaped to the given file.
+ */
+static void write_label(FILE *fh, const char *value)
+{
+    fputc('"', fh);
+    for (const char *p = value; *p != '\0'; ++p) {
+        if (*p == '\\' || *p == '"') {
+            fputc('\\', fh);
+            fputc(*p, fh);
+        } else if (*p == '\n') {
+            fputs("\\n", fh);
+        } else {
+            fputc(*p, fh);
+        }
+    }
+    fputc('"', fh);
+}
+
+/**
+ * Write the histogram of the latency of the lines written so far to the given
+ * file. A bucket of the metrics counts the lines of every bucket of the
+ * histogram wholly within its bound.
+ */
+static void write_latency(FILE *fh, bool openmetrics)
+{
+    write_family(fh, openmetrics, "android_log_latency_seconds", "histogram",
+                 "Seconds lines took from being read to being written.");
+    uint64_t count = 0;
+    unsigned bucket = 0;
+    for (size_t i = 0; i < sizeof(latency_bounds) / sizeof(latency_bounds[0]);
+         ++i) {
+        uint64_t bound = (uint64_t)(latency_bounds[i] * 1e9);
+        while (bucket + 1 < LATENCY_NBUCKETS
+               && latency_floor(bucket + 1) <= bound) {
+            count += atomic_load_explicit(&latency[bucket++],
+                                          memory_order_relaxed);
+        }
+        fprintf(fh, "android_log_latency_seconds_bucket{le=\"%g\"} %" PRIu64
+                    "\n", latency_bounds[i], count);
+    }
+    while (bucket < LATENCY_NBUCKETS) {
+        count += atomic_load_explicit(&latency[bucket++], memory_order_relaxed);
+    }
+    fprintf(fh, "android_log_latency_seconds_bucket{le=\"+Inf\"} %" PRIu64
+                "\n", count);
+    fprintf(fh, "android_log_latency_seconds_count %" PRIu64 "\n", count);
+    fprintf(fh, "android_log_latency_seconds_sum %.9f\n",
+            atomic_load(&latency_sum) / 1e9);
+}
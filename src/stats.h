@@ -0,0 +1,179 @@
+/** @file
+ * Counters describing how well the software keeps up.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Counters are updated without locks and reported on request; sending SIGUSR1
+ * to the process prints them to stderr, as does a timer when asked for. Each
+ * thread updates counters of its own which are summed when a report is made,
+ * and each device counts what was read from it in counters of its own.
+ *
+ * The writer also records how long every line took from being read to being
+ * written within a histogram of logarithmic buckets split linearly eight ways,
+ * so percentiles are reported to within an eighth of their value. Lines are
+ * stamped with the time the chunk that held them was read, so measuring costs
+ * a reading of the clock per chunk and per batch written.
+ *
+ * Waits on the locks threads contend for are measured by taking each with a
+ * try first, so only a lock found taken costs readings of the clock and an
+ * update of counters shared by every thread.
+ *
+ * Reports end with the heaviest talkers, the tags of every device that logged
+ * the most bytes of messages shown, see top.h.
+ */
+#ifndef STATS_H_
+#define STATS_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "top.h"
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Locks whose waits are measured.
+ */
+enum stats_lock_id {
+    STATS_LOCK_DEVICE_MAP, //!< Lock of the map of connected devices.
+    STATS_LOCK_TAG_MAP,    //!< Lock of insertions into the tag map.
+    STATS_LOCK_WRITER,     //!< Lock the writer is woken through.
+    STATS_LOCKS_N,
+};
+
+/**
+ * Waits on a lock, updated by every thread that found it taken.
+ */
+struct stats_lock {
+    atomic_uint_fast64_t waits;   //!< Times the lock was found taken.
+    atomic_uint_fast64_t wait_ns; //!< Nanoseconds spent waiting on it.
+};
+
+/**
+ * Counters owned by a single thread of execution. Only the owning thread ever
+ * updates them so updates need no atomic read-modify-write.
+ */
+struct stats_counters {
+    atomic_uint_fast64_t   tag_cache_hits;   //!< Tag lookups served by cache.
+    atomic_uint_fast64_t   tag_cache_misses; //!< Tag lookups of the tag map.
+    struct stats_counters *next;             //!< Next registered counters.
+};
+
+/**
+ * Counters of a single device. Only the thread reading the device ever updates
+ * them.
+ */
+struct stats_device {
+    atomic_uint_fast64_t lines;      //!< Lines or entries read.
+    atomic_uint_fast64_t bytes;      //!< Bytes of those lines.
+    atomic_uint_fast64_t unparsed;   //!< Lines that could not be parsed.
+    atomic_uint_fast64_t dropped;    //!< Lines dropped by the output policy.
+    atomic_uint_fast64_t collapsed;  //!< Repeats of lines collapsed.
+    atomic_uint_fast64_t limited;    //!< Lines over their tag's budget.
+    atomic_uint_fast64_t tag_misses; //!< Tag lookups of the tag map.
+    atomic_uint_fast64_t read_ns;    //!< Time it was last read on the
+                                     //!< monotonic clock, 0 if never.
+    struct top           top;        //!< Heaviest talking tags, see top.h.
+    const char          *name;       //!< Serial number of the device.
+    uint64_t             reported;   //!< Lines read at the last report.
+    struct stats_device *next;       //!< Next registered device.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern __thread struct stats_counters *stats_local;
+extern const char *const stats_lock_names[STATS_LOCKS_N];
+extern struct stats_lock stats_locks[STATS_LOCKS_N];
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void stats_device_register(struct stats_device *d, const char *name);
+void stats_device_unregister(struct stats_device *d);
+void stats_latency(uint64_t nsecs);
+uint64_t stats_latency_percentile(double percent);
+void stats_print(FILE *fh);
+struct stats_counters *stats_thread_register(void);
+void stats_thread_unregister(void);
+void stats_write_metrics(FILE *fh, bool openmetrics);
+void stats_written(uint64_t lines, uint64_t bytes);
+
+/**
+ * Add n to the given counter owned by the calling thread.
+ */
+static inline void stats_add(atomic_uint_fast64_t *counter, uint64_t n)
+{
+    uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    atomic_store_explicit(counter, value + n, memory_order_relaxed);
+}
+
+/**
+ * Return the current time of the monotonic clock in nanoseconds.
+ */
+static inline uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Lock the given mutex, measuring the wait as one on the given lock should it
+ * be taken.
+ */
+static inline void stats_lock(pthread_mutex_t *mutex, enum stats_lock_id id)
+{
+    if (pthread_mutex_trylock(mutex) == 0) {
+        return;
+    }
+    uint64_t start = stats_now_ns();
+    pthread_mutex_lock(mutex);
+    struct stats_lock *lock = &stats_locks[id];
+    atomic_fetch_add_explicit(&lock->waits, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&lock->wait_ns, stats_now_ns() - start,
+                              memory_order_relaxed);
+}
+
+/**
+ * Return the counters of the calling thread registering them on first use.
+ */
+static inline struct stats_counters *stats_thread(void)
+{
+    if (stats_local == NULL) {
+        return stats_thread_register();
+    }
+    return stats_local;
+}
+
+#endif
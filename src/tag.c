@@ -0,0 +1,661 @@
+/** @file
+ * Map of tags to the information used to display them.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The shared map is an open addressing hash table of tag pointers. A tag is
+ * fully built before its pointer is published into a slot with release
+ * semantics, so readers probe the table with plain acquire loads. As in a
+ * SwissTable, every slot has a control byte beside it holding seven bits of
+ * the hash, ones the slot index is not taken from, or zero for an empty slot.
+ * Probes scan the densely packed control bytes and only follow the pointers of
+ * slots whose bits match, so a lookup usually touches a single tag. Inserting
+ * takes tag_map_lock and searches again before adding, which settles races
+ * between threads that see a new tag at the same moment. Removing a tag shifts
+ * later tags of its probe sequence back into the gap; a reader may miss a tag
+ * while it moves, which only sends it to search again under the lock. When the
+ * table grows a new one is published and the old one is kept until
+ * tag_map_clear() since readers may still be probing it.
+ *
+ * Identifiers index a two level array of pages of tag pointers. Pages are
+ * allocated as identifiers are handed out and are only freed by
+ * tag_map_clear(); the fixed top level array is what lets readers index it
+ * without coordination. An evicted tag's slot is overwritten by the tag that
+ * replaces it, and the serial number of a tag tells it from whichever tags
+ * held its identifier before.
+ *
+ * Evicted tags are reclaimed after a grace period. Readers count themselves
+ * into one of two counters, picked by the parity of the current phase, for the
+ * length of a read section. Tags retired during a phase may be held by readers
+ * of that phase or of the one before, so they are reclaimed once the phase
+ * after next begins, and a phase only begins once the counter it is about to
+ * reuse has drained.
+ *
+ * Storage comes out of an arena freed by tag_map_clear(). Reclaimed tags are
+ * kept by size for reuse, so a map that churns through tags while it stays
+ * full does not grow.
+ *
+ * The per thread cache is direct mapped and keyed by the same hash; it holds
+ * the identifiers and serial numbers of tags, and a hit only counts when the
+ * tag under the identifier is still the one that was cached.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "tag.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "filter.h"
+#include "stats.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of entries in each thread's cache; must be a power of two. */
+#define CACHE_NSLOTS (256)
+
+/** Longest tag that will be held within the cache. */
+#define CACHE_NAME_NCHARS (40)
+
+/** Granularity in bytes of the sizes reclaimed tags are kept by. */
+#define SIZE_CLASS_NBYTES (16)
+
+/** Number of sizes reclaimed tags are kept by; larger tags use the heap. */
+#define SIZE_CLASSES_NMAX (64)
+
+/** Control byte of an empty slot of the shared table. */
+#define CTRL_EMPTY (0)
+
+/** Initial number of slots in the shared table; must be a power of two. */
+#define TABLE_NSLOTS_MIN (1024)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Entry of the per thread tag cache.
+ */
+struct cache_entry {
+    uint64_t serial;                  //!< Serial number of the tag, 0 if none.
+    uint32_t id;                      //!< Identifier of the tag.
+    uint32_t hash;                    //!< Hash of the tag's name.
+    uint32_t len;                     //!< Length of the tag's name.
+    char     name[CACHE_NAME_NCHARS]; //!< Name of the tag.
+};
+
+/**
+ * Open addressing hash table of tags.
+ */
+struct table {
+    size_t                 mask;    //!< Number of slots less one.
+    size_t                 count;   //!< Number of tags held.
+    atomic_uchar          *ctrl;    //!< Control byte of each slot.
+    _Atomic(struct tag *)  slots[]; //!< Slots, NULL when empty.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Pages of the index from tag identifier to tag. */
+_Atomic(struct tag *) *_Atomic tag_pages[TAG_PAGES_NMAX];
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Storage of the tags, pages and tables. */
+static struct arena tag_arena;
+
+/** Cache of recently used tags private to each thread. */
+static __thread struct cache_entry cache[CACHE_NSLOTS];
+
+/** Identifier of the next tag the clock hand considers for eviction. */
+static uint32_t clock_hand;
+
+/** Tags retired during even and odd phases awaiting reclamation. */
+static struct tag *limbo[2];
+
+/** Number of tags evicted so far. */
+static atomic_uint_fast64_t nevicted;
+
+/** Number of well known tags, which are never evicted. */
+static uint32_t npinned;
+
+/** Number of tags interned and not evicted. */
+static atomic_uint_fast32_t ntags;
+
+/** Most tags the map holds at once. */
+static uint32_t ntags_max;
+
+/** Current phase of the grace periods tags are reclaimed after. */
+static atomic_uint phase;
+
+/** Number of threads within read sections begun in even and odd phases. */
+static atomic_uint readers[2];
+
+/** Phase the calling thread's read section began in. */
+static __thread unsigned reader_phase;
+
+/** Serial number of the most recently interned tag. */
+static uint64_t serial;
+
+/** Reclaimed tags awaiting reuse by size class. */
+static struct tag *spares[SIZE_CLASSES_NMAX];
+
+/** Currently published table of tags. */
+static _Atomic(struct table *) tag_table;
+
+/** Lock used to serialize the insertion of tags. */
+static pthread_mutex_t tag_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static struct tag *add_tag(const char *name, size_t len, uint32_t hash,
+                           enum color color);
+static void advance_phase(void);
+static struct tag *choose_victim(void);
+static uint8_t ctrl_of(uint32_t hash);
+static struct tag *find_tag(struct table *table, const char *name, size_t len,
+                            uint32_t hash);
+static void free_tag(struct tag *tag);
+static void grow_table(void);
+static void insert_tag(struct table *table, struct tag *tag);
+static void mark_used(struct tag *tag);
+static struct tag *new_tag(size_t len);
+static struct table *new_table(size_t nslots);
+static void remove_tag(struct table *table, struct tag *tag);
+static size_t size_class(size_t len);
+
+/******************************************************************************/
+
+/**
+ * Return the number of tags currently held by the map.
+ */
+uint32_t tag_count(void)
+{
+    return atomic_load_explicit(&ntags, memory_order_relaxed);
+}
+
+/**
+ * Return the number of tags evicted from the map so far.
+ */
+uint64_t tag_evictions(void)
+{
+    return atomic_load_explicit(&nevicted, memory_order_relaxed);
+}
+
+/**
+ * Return the 32-bit FNV-1a hash of the given name. Unlike identifiers, hashes
+ * stay the same from one run to the next.
+ */
+uint32_t tag_hash(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Return the tag with the given name, interning the tag if it is not held by
+ * the map. The name does not need to be NUL terminated. Must be called within
+ * a read section, and the tag is only valid until that section ends.
+ */
+const struct tag *tag_intern(const char *name, size_t len)
+{
+    uint32_t hash = tag_hash(name, len);
+    struct cache_entry *entry = &cache[hash & (CACHE_NSLOTS - 1)];
+    if (entry->serial != 0 && entry->hash == hash && entry->len == len
+        && memcmp(entry->name, name, len) == 0) {
+        // The tag may have been evicted and its identifier handed on since.
+        struct tag *tag = (struct tag *)tag_get(entry->id);
+        if (tag->serial == entry->serial) {
+            stats_add(&stats_thread()->tag_cache_hits, 1);
+            mark_used(tag);
+            return tag;
+        }
+    }
+    stats_add(&stats_thread()->tag_cache_misses, 1);
+
+    struct table *table = atomic_load_explicit(&tag_table,
+                                               memory_order_acquire);
+    struct tag *tag = find_tag(table, name, len, hash);
+    if (tag == NULL) {
+        stats_lock(&tag_map_lock, STATS_LOCK_TAG_MAP);
+        // Another thread may have added the tag since we looked.
+        table = atomic_load_explicit(&tag_table, memory_order_relaxed);
+        tag = find_tag(table, name, len, hash);
+        if (tag == NULL) {
+            tag = add_tag(name, len, hash, color_of_hash(hash));
+        }
+        pthread_mutex_unlock(&tag_map_lock);
+    }
+    mark_used(tag);
+
+    if (len <= sizeof(entry->name)) {
+        entry->serial = tag->serial;
+        entry->id = tag->id;
+        entry->hash = hash;
+        entry->len = len;
+        memcpy(entry->name, name, len);
+    }
+    return tag;
+}
+
+/**
+ * Delete every tag out of the tag map. No other thread may be using the map.
+ */
+void tag_map_clear(void)
+{
+    if (atomic_load(&tag_table) == NULL) {
+        return;
+    }
+    // Only tags too large to be kept for reuse live outside of the arena.
+    uint32_t count = tag_count();
+    for (uint32_t id = 0; id < count; ++id) {
+        struct tag *tag = (struct tag *)tag_get(id);
+        if (size_class(tag->len) >= SIZE_CLASSES_NMAX) {
+            free(tag);
+        }
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        while (limbo[i] != NULL) {
+            struct tag *next = limbo[i]->next;
+            if (size_class(limbo[i]->len) >= SIZE_CLASSES_NMAX) {
+                free(limbo[i]);
+            }
+            limbo[i] = next;
+        }
+    }
+    memset(spares, 0, sizeof(spares));
+    for (size_t i = 0; i < TAG_PAGES_NMAX; ++i) {
+        atomic_store(&tag_pages[i], NULL);
+    }
+    atomic_store(&tag_table, NULL);
+    arena_free(&tag_arena);
+    atomic_store(&ntags, 0);
+    atomic_store(&nevicted, 0);
+}
+
+/**
+ * Prepare the tag map to hold at most nmax tags, filling out the colors of
+ * well known tags. The map always holds at least the well known tags and one
+ * more.
+ */
+void tag_map_init(uint32_t nmax)
+{
+    atomic_store(&tag_table, new_table(TABLE_NSLOTS_MIN));
+
+    static const struct {
+        const char *name;
+        enum color  color;
+    } well_known[] = {
+        { "dalvikvm",        COLOR_BLUE },
+        { "Process",         COLOR_BLUE },
+        { "ActivityManager", COLOR_CYAN },
+        { "ActivityThread",  COLOR_CYAN },
+    };
+    npinned = sizeof(well_known) / sizeof(well_known[0]);
+    ntags_max = nmax > npinned ? nmax : npinned + 1;
+    for (size_t i = 0; i < npinned; ++i) {
+        size_t len = strlen(well_known[i].name);
+        add_tag(well_known[i].name, len, tag_hash(well_known[i].name, len),
+                well_known[i].color);
+    }
+    clock_hand = npinned;
+}
+
+/**
+ * Begin a section within which the calling thread may use tags.
+ */
+void tag_read_begin(void)
+{
+    reader_phase = tag_read_hold();
+}
+
+/**
+ * End the calling thread's read section; no tag it found within may be used
+ * any further.
+ */
+void tag_read_end(void)
+{
+    tag_read_release(reader_phase);
+}
+
+/**
+ * Begin a read section that is not tied to the calling thread, so that tags
+ * found within may be handed to other threads along with the section. Returns
+ * the token that tag_read_release() ends the section with, on any thread.
+ */
+unsigned tag_read_hold(void)
+{
+    for (;;) {
+        // Count ourselves as a reader of the phase, making sure it did not end
+        // before we were counted.
+        unsigned p = atomic_load(&phase);
+        atomic_fetch_add(&readers[p & 1], 1);
+        if (atomic_load(&phase) == p) {
+            return p;
+        }
+        atomic_fetch_sub(&readers[p & 1], 1);
+    }
+}
+
+/**
+ * End the read section begun by tag_read_hold() that returned the given token.
+ */
+void tag_read_release(unsigned token)
+{
+    atomic_fetch_sub_explicit(&readers[token & 1], 1, memory_order_release);
+}
+
+/**
+ * Create a tag displayed in the given color and publish it within the table,
+ * evicting another tag if the map is full. Must be called with tag_map_lock
+ * held or before other threads start.
+ */
+static struct tag *add_tag(const char *name, size_t len, uint32_t hash,
+                           enum color color)
+{
+    struct table *table = atomic_load_explicit(&tag_table,
+                                               memory_order_relaxed);
+    uint32_t id = atomic_load_explicit(&ntags, memory_order_relaxed);
+    struct tag *victim = NULL;
+    if (id == ntags_max) {
+        victim = choose_victim();
+        id = victim->id;
+        remove_tag(table, victim);
+    }
+
+    struct tag *tag = new_tag(len);
+    tag->id = id;
+    tag->color = color;
+    atomic_init(&tag->level, filter_level(name, len));
+    tag->serial = ++serial;
+    tag->next = NULL;
+    atomic_init(&tag->used, true);
+    tag->hash = hash;
+    tag->len = len;
+    memcpy(tag->name, name, len);
+    tag->name[len] = '\0';
+    color_render_column(&tag->column, color, tag->name, COLUMN_WIDTH_MAX);
+
+    // Publish the tag under its identifier before any reader can find it in
+    // the table and go looking for it by that identifier.
+    _Atomic(struct tag *) *page = atomic_load_explicit(
+        &tag_pages[id / TAG_PAGE_NTAGS], memory_order_relaxed);
+    if (page == NULL) {
+        page = arena_alloc(&tag_arena, TAG_PAGE_NTAGS * sizeof(*page));
+        assert(page != NULL);
+        memset(page, 0, TAG_PAGE_NTAGS * sizeof(*page));
+        atomic_store_explicit(&tag_pages[id / TAG_PAGE_NTAGS], page,
+                              memory_order_release);
+    }
+    atomic_store_explicit(&page[id % TAG_PAGE_NTAGS], tag,
+                          memory_order_release);
+
+    if (2 * (table->count + 1) > table->mask + 1) {
+        grow_table();
+        table = atomic_load_explicit(&tag_table, memory_order_relaxed);
+    }
+    insert_tag(table, tag);
+
+    if (victim == NULL) {
+        atomic_store_explicit(&ntags, id + 1, memory_order_release);
+    } else {
+        unsigned p = atomic_load_explicit(&phase, memory_order_relaxed);
+        victim->next = limbo[p & 1];
+        limbo[p & 1] = victim;
+        atomic_store_explicit(&nevicted, tag_evictions() + 1,
+                              memory_order_relaxed);
+        advance_phase();
+    }
+    return tag;
+}
+
+/**
+ * Begin the next phase if no thread remains within a read section begun in
+ * the phase before the current one, reclaiming the tags retired back then.
+ * Must be called with tag_map_lock held.
+ */
+static void advance_phase(void)
+{
+    unsigned p = atomic_load_explicit(&phase, memory_order_relaxed);
+    // Order the removal of retired tags before looking for their readers.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&readers[(p + 1) & 1]) != 0) {
+        return;
+    }
+    while (limbo[(p + 1) & 1] != NULL) {
+        struct tag *next = limbo[(p + 1) & 1]->next;
+        free_tag(limbo[(p + 1) & 1]);
+        limbo[(p + 1) & 1] = next;
+    }
+    atomic_store(&phase, p + 1);
+}
+
+/**
+ * Return the tag to evict, sweeping the clock hand past the tags used since
+ * it last passed them. Must be called with tag_map_lock held on a full map.
+ */
+static struct tag *choose_victim(void)
+{
+    for (;;) {
+        struct tag *tag = (struct tag *)tag_get(clock_hand);
+        ++clock_hand;
+        if (clock_hand == ntags_max) {
+            clock_hand = npinned;
+        }
+        if (!atomic_exchange_explicit(&tag->used, false,
+                                      memory_order_relaxed)) {
+            return tag;
+        }
+    }
+}
+
+/**
+ * Return the control byte of slots holding a tag of the given hash.
+ */
+static uint8_t ctrl_of(uint32_t hash)
+{
+    return 0x80 | (hash >> 25);
+}
+
+/**
+ * Search the given table for the tag with the given name. Safe to call without
+ * holding any lock.
+ */
+static struct tag *find_tag(struct table *table, const char *name, size_t len,
+                            uint32_t hash)
+{
+    uint8_t ctrl = ctrl_of(hash);
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        uint8_t c = atomic_load_explicit(&table->ctrl[i], memory_order_acquire);
+        if (c == CTRL_EMPTY) {
+            return NULL;
+        }
+        if (c != ctrl) {
+            continue;
+        }
+        // The slot may be changing under us; only a full match counts.
+        struct tag *tag = atomic_load_explicit(&table->slots[i],
+                                               memory_order_acquire);
+        if (tag != NULL && tag->hash == hash && tag->len == len
+            && memcmp(tag->name, name, len) == 0) {
+            return tag;
+        }
+    }
+}
+
+/**
+ * Free the storage of the given reclaimed tag, keeping it for reuse when it is
+ * small enough. Must be called with tag_map_lock held.
+ */
+static void free_tag(struct tag *tag)
+{
+    size_t class = size_class(tag->len);
+    if (class >= SIZE_CLASSES_NMAX) {
+        free(tag);
+        return;
+    }
+    tag->next = spares[class];
+    spares[class] = tag;
+}
+
+/**
+ * Publish a table twice the size of the current one holding the same tags.
+ * Must be called with tag_map_lock held.
+ */
+static void grow_table(void)
+{
+    struct table *old = atomic_load_explicit(&tag_table, memory_order_relaxed);
+    struct table *table = new_table(2 * (old->mask + 1));
+    for (size_t i = 0; i <= old->mask; ++i) {
+        struct tag *tag = atomic_load_explicit(&old->slots[i],
+                                               memory_order_relaxed);
+        if (tag != NULL) {
+            insert_tag(table, tag);
+        }
+    }
+    atomic_store_explicit(&tag_table, table, memory_order_release);
+}
+
+/**
+ * Place the given tag within the first free slot of its probe sequence.
+ */
+static void insert_tag(struct table *table, struct tag *tag)
+{
+    size_t i = tag->hash & table->mask;
+    while (atomic_load_explicit(&table->ctrl[i], memory_order_relaxed)
+           != CTRL_EMPTY) {
+        i = (i + 1) & table->mask;
+    }
+    atomic_store_explicit(&table->slots[i], tag, memory_order_release);
+    atomic_store_explicit(&table->ctrl[i], ctrl_of(tag->hash),
+                          memory_order_release);
+    ++table->count;
+}
+
+/**
+ * Note the use of the given tag for the clock hand. The flag is only written
+ * when it changes so the tags in steady use stay shared between caches.
+ */
+static void mark_used(struct tag *tag)
+{
+    if (!atomic_load_explicit(&tag->used, memory_order_relaxed)) {
+        atomic_store_explicit(&tag->used, true, memory_order_relaxed);
+    }
+}
+
+/**
+ * Return storage for a tag with a name of the given length, reusing that of a
+ * reclaimed tag when there is one of the size. Must be called with
+ * tag_map_lock held or before other threads start.
+ */
+static struct tag *new_tag(size_t len)
+{
+    size_t class = size_class(len);
+    struct tag *tag;
+    if (class >= SIZE_CLASSES_NMAX) {
+        tag = malloc(sizeof(*tag) + len + 1);
+    } else if (spares[class] != NULL) {
+        tag = spares[class];
+        spares[class] = tag->next;
+    } else {
+        tag = arena_alloc(&tag_arena, class * SIZE_CLASS_NBYTES);
+    }
+    assert(tag != NULL);
+    return tag;
+}
+
+/**
+ * Allocate an empty table with the given number of slots.
+ */
+static struct table *new_table(size_t nslots)
+{
+    size_t size = sizeof(struct table)
+                  + nslots * (sizeof(_Atomic(struct tag *)) + 1);
+    struct table *table = arena_alloc(&tag_arena, size);
+    assert(table != NULL);
+    memset(table, 0, size);
+    table->mask = nslots - 1;
+    table->ctrl = (atomic_uchar *)&table->slots[nslots];
+    return table;
+}
+
+/**
+ * Take the given tag out of the table, moving later tags of its probe sequence
+ * back so that none is left beyond an empty slot from where its probe starts.
+ * Must be called with tag_map_lock held.
+ */
+static void remove_tag(struct table *table, struct tag *tag)
+{
+    size_t i = tag->hash & table->mask;
+    while (atomic_load_explicit(&table->slots[i], memory_order_relaxed)
+           != tag) {
+        i = (i + 1) & table->mask;
+    }
+    for (size_t j = (i + 1) & table->mask;; j = (j + 1) & table->mask) {
+        struct tag *next = atomic_load_explicit(&table->slots[j],
+                                                memory_order_relaxed);
+        if (next == NULL) {
+            break;
+        }
+        // Move the tag into the gap unless its probe starts after the gap.
+        size_t home = next->hash & table->mask;
+        if (((j - home) & table->mask) >= ((j - i) & table->mask)) {
+            atomic_store_explicit(&table->slots[i], next,
+                                  memory_order_release);
+            atomic_store_explicit(&table->ctrl[i], ctrl_of(next->hash),
+                                  memory_order_release);
+            i = j;
+        }
+    }
+    atomic_store_explicit(&table->ctrl[i], CTRL_EMPTY, memory_order_release);
+    atomic_store_explicit(&table->slots[i], NULL, memory_order_release);
+    --table->count;
+}
+
+/**
+ * Return the size class of a tag with a name of the given length.
+ */
+static size_t size_class(size_t len)
+{
+    return (sizeof(struct tag) + len + 1 + SIZE_CLASS_NBYTES - 1)
+           / SIZE_CLASS_NBYTES;
+}
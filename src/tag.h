@@ -0,0 +1,123 @@
+/** @file
+ * Map of tags to the information used to display them.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every line looks up its tag. Lookups are first answered by a small cache
+ * private to each thread of execution and fall back to a shared hash table
+ * that is read without taking any lock. Only the insertion of a tag that has
+ * never been seen before is serialized.
+ *
+ * Each distinct tag is interned under a compact 32-bit identifier handed out
+ * in order of discovery. The rest of the software refers to tags by that
+ * identifier and finds a tag's information by indexing with it.
+ *
+ * The map holds a bounded number of tags. Once it is full the tag least
+ * recently used, as approximated by a clock sweep, is evicted to make room and
+ * its identifier is handed to the new tag. Tags are therefore only valid within
+ * a read section; threads bracket their use of tags between tag_read_begin()
+ * and tag_read_end(), and an evicted tag is only freed once no thread remains
+ * within a section that could have found it.
+ */
+#ifndef TAG_H_
+#define TAG_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of tags within each page of the identifier index. */
+#define TAG_PAGE_NTAGS (1024)
+
+/** Maximum number of pages of the identifier index. */
+#define TAG_PAGES_NMAX (4096)
+
+/** Maximum number of tags the map may be asked to hold. */
+#define TAG_NMAX (TAG_PAGE_NTAGS * TAG_PAGES_NMAX)
+
+/** Number of tags the map holds unless asked otherwise. */
+#define TAG_NDEFAULT (64 * 1024)
+
+/*******************************************************************************
+ * Types
+ */
+
+/**
+ * Information about a tag seen within the logs.
+ */
+struct tag {
+    uint32_t      id;     //!< Identifier the tag is interned under.
+    enum color    color;  //!< Color of the tag.
+    atomic_uint   level;  //!< Lowest priority level the filter specs show,
+                          //!< see filter_level().
+    struct column column; //!< Rendered tag column.
+    uint64_t      serial; //!< Unique among every tag ever interned.
+    struct tag   *next;   //!< Next tag awaiting reclamation or reuse.
+    atomic_bool   used;   //!< Whether used since the clock hand passed.
+    uint32_t      hash;   //!< Hash of the tag's name.
+    uint32_t      len;    //!< Length of the tag's name.
+    char          name[]; //!< NUL terminated name of the tag.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern _Atomic(struct tag *) *_Atomic tag_pages[TAG_PAGES_NMAX];
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+uint32_t tag_count(void);
+uint64_t tag_evictions(void);
+uint32_t tag_hash(const char *name, size_t len);
+const struct tag *tag_intern(const char *name, size_t len);
+void tag_map_clear(void);
+void tag_map_init(uint32_t nmax);
+void tag_read_begin(void);
+void tag_read_end(void);
+unsigned tag_read_hold(void);
+void tag_read_release(unsigned token);
+
+/**
+ * Return the tag currently interned under the given identifier, which must
+ * have been handed out by tag_intern(). Must be called within a read section.
+ */
+static inline const struct tag *tag_get(uint32_t id)
+{
+    _Atomic(struct tag *) *page = atomic_load_explicit(
+        &tag_pages[id / TAG_PAGE_NTAGS], memory_order_acquire);
+    return atomic_load_explicit(&page[id % TAG_PAGE_NTAGS],
+                                memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,778 @@
+/** @file
+ * Rings of the latest lines of every device kept in memory.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Each device's ring is a chain of blocks, oldest first. The device's thread
+ * fills the newest block without taking any lock and publishes each line by
+ * advancing the block's count; blocks only change hands, and chains only
+ * change, with tails_lock held. A dump holds the lock throughout, so it sees
+ * every block's lines up to the count it read while devices that need a fresh
+ * block wait for it.
+ *
+ * A snapshot copies the lines published so far, holding the lock only for the
+ * copy, so that it can be written out at leisure while the rings move on.
+ *
+ * Each block carries the index its lines are searched through, so that the
+ * index is built as lines arrive and goes along with the block it covers. The
+ * lines of each tag are chained within a block, newest first, from heads kept
+ * by a hash of the tag. Every group of lines within a block sets, for every
+ * three bytes in a row of their messages, a bit chosen by a hash of them; a
+ * group whose bits do not cover those of the text searched for cannot hold it,
+ * and a block whose last line was logged before the time searched from is
+ * passed over whole. A search holds the lock as a dump does.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#define _GNU_SOURCE
+#include "tail.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Most lines held by a block. */
+#define BLOCK_NLINES (2048)
+
+/** Number of bytes of the tags and messages a block holds. */
+#define BLOCK_TEXT_NBYTES (192 * 1024)
+
+/** Number of bits a group of lines sets for the bytes of their messages. */
+#define GRAM_NBITS (4096)
+
+/** Number of lines of a group sharing the bits of their messages. */
+#define GROUP_NLINES (64)
+
+/** Maximum number of characters of the name of a device. */
+#define NAME_NCHARS (128)
+
+/** Number of characters of a time as dumped, "MM-DD HH:MM:SS". */
+#define SECOND_NCHARS (14)
+
+/** Number of chains of the lines of tags within a block; a power of two. */
+#define TAG_NCHAINS (256)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Block of lines of a single device.
+ */
+struct block {
+    struct block *next;                      //!< Next newer block of the
+                                             //!< device, or next free block.
+    atomic_uint   count;                     //!< Number of lines published.
+    uint32_t      text_used;                 //!< Bytes of text filled.
+    uint64_t      ms[BLOCK_NLINES];          //!< Milliseconds since the epoch.
+    int32_t       pid[BLOCK_NLINES];         //!< Process identifiers.
+    int32_t       tid[BLOCK_NLINES];         //!< Thread identifiers, -1 when
+                                             //!< unknown.
+    uint32_t      text[BLOCK_NLINES];        //!< Offsets of tags in bytes.
+    uint32_t      msg_len[BLOCK_NLINES];     //!< Lengths of messages, which
+                                             //!< follow their tags.
+    uint8_t       tag_len[BLOCK_NLINES];     //!< Lengths of tags.
+    char          tagtype[BLOCK_NLINES];     //!< Priorities.
+    char          bytes[BLOCK_TEXT_NBYTES];  //!< Tags and messages.
+    atomic_ushort tag_heads[TAG_NCHAINS];    //!< Newest line plus one of each
+                                             //!< chain of tags, 0 if none.
+    uint16_t      tag_prev[BLOCK_NLINES];    //!< Previous line plus one of the
+                                             //!< chain of each line, 0 if
+                                             //!< none.
+    atomic_uint_fast64_t grams[BLOCK_NLINES / GROUP_NLINES][GRAM_NBITS / 64];
+                                             //!< Bits of the bytes of the
+                                             //!< messages of each group.
+};
+
+/**
+ * Ring of the latest lines of a device.
+ */
+struct tail {
+    char          name[NAME_NCHARS]; //!< Serial number of the device.
+    bool          used;              //!< Whether a device is adding lines.
+    struct block *oldest;            //!< Block holding the oldest lines.
+    struct block *newest;            //!< Block being filled.
+    struct tail  *next;              //!< Next ring of another device.
+};
+
+/**
+ * Copy of the rings taken when a device asked for it.
+ */
+struct tail_snapshot {
+    char         name[NAME_NCHARS]; //!< Serial number of the device.
+    uint64_t     since;             //!< Milliseconds since the epoch the lines
+                                    //!< of other devices are kept from.
+    struct tail *rings;             //!< Copies of the rings, their blocks
+                                    //!< frozen.
+};
+
+/**
+ * Line found by a search.
+ */
+struct hit {
+    const struct tail  *tail;  //!< Ring of the line.
+    const struct block *block; //!< Block holding the line.
+    unsigned            line;  //!< Index of the line within the block.
+    size_t              order; //!< Order in which the line was found.
+};
+
+/**
+ * Place of a dump within the ring of a device.
+ */
+struct cursor {
+    struct tail  *tail;  //!< Ring being dumped.
+    struct block *block; //!< Block being dumped, NULL once done.
+    unsigned      line;  //!< Index of the next line of the block.
+    unsigned      count; //!< Number of lines of the block to dump.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+/** Bytes all rings together may take, 0 to not keep any. */
+uint64_t tail_nbytes;
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Number of blocks allocated. */
+static size_t blocks_n;
+
+/** Blocks available for reuse. */
+static struct block *free_blocks;
+
+/** Rings of every device that was known. */
+static struct tail *tails;
+
+/** Lock used to prevent concurrent changes to the rings. */
+static pthread_mutex_t tails_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void advance(struct cursor *c);
+static int compare_hits(const void *a, const void *b);
+static struct tail *copy_ring(const struct tail *t, bool whole,
+                              uint64_t since);
+static void dump_line(FILE *out, const struct tail *t, const struct block *b,
+                      unsigned line);
+static int dump_rings(FILE *out, struct tail *rings, const char *whole,
+                      uint64_t since);
+static void free_ring(struct tail *t);
+static uint32_t gram_bit(const char *bytes);
+static bool has_grams(const struct block *b, unsigned group,
+                      const uint64_t *grams);
+static void index_line(struct block *b, unsigned line);
+static struct block *next_block(struct tail *t);
+
+/******************************************************************************/
+
+/**
+ * Keep the given line within the device's ring. Must only be called by the
+ * thread reading the device.
+ */
+void tail_add(struct tail *t, uint64_t ms, int32_t pid, int32_t tid,
+              char tagtype, const char *tag, size_t tag_len, const char *msg,
+              size_t msg_len)
+{
+    if (tag_len > UINT8_MAX) {
+        tag_len = UINT8_MAX;
+    }
+    if (msg_len > BLOCK_TEXT_NBYTES - tag_len) {
+        msg_len = BLOCK_TEXT_NBYTES - tag_len;
+    }
+    struct block *b = t->newest;
+    unsigned n = b != NULL
+                 ? atomic_load_explicit(&b->count, memory_order_relaxed) : 0;
+    if (b == NULL || n == BLOCK_NLINES
+        || b->text_used + tag_len + msg_len > BLOCK_TEXT_NBYTES) {
+        b = next_block(t);
+        if (b == NULL) {
+            return;
+        }
+        n = 0;
+    }
+    b->ms[n] = ms;
+    b->pid[n] = pid;
+    b->tid[n] = tid;
+    b->text[n] = b->text_used;
+    b->msg_len[n] = msg_len;
+    b->tag_len[n] = tag_len;
+    b->tagtype[n] = tagtype;
+    memcpy(&b->bytes[b->text_used], tag, tag_len);
+    memcpy(&b->bytes[b->text_used + tag_len], msg, msg_len);
+    b->text_used += tag_len + msg_len;
+    index_line(b, n);
+    atomic_store_explicit(&b->count, n + 1, memory_order_release);
+}
+
+/**
+ * Stop adding lines to the given ring. Its lines are kept until their blocks
+ * are needed, and the ring is taken up again by a device of the same name.
+ */
+void tail_close(struct tail *t)
+{
+    pthread_mutex_lock(&tails_lock);
+    t->used = false;
+    pthread_mutex_unlock(&tails_lock);
+}
+
+/**
+ * Write the lines of every ring to the given stream in the order they were
+ * logged. Returns 0 on success or an error number on failure.
+ */
+int tail_dump(FILE *out)
+{
+    pthread_mutex_lock(&tails_lock);
+    int err = dump_rings(out, tails, NULL, 0);
+    pthread_mutex_unlock(&tails_lock);
+    return err;
+}
+
+/**
+ * Release every ring and block. No device may be adding lines.
+ */
+void tail_free(void)
+{
+    pthread_mutex_lock(&tails_lock);
+    while (tails != NULL) {
+        struct tail *next = tails->next;
+        free_ring(tails);
+        tails = next;
+    }
+    while (free_blocks != NULL) {
+        struct block *next = free_blocks->next;
+        free(free_blocks);
+        free_blocks = next;
+    }
+    blocks_n = 0;
+    pthread_mutex_unlock(&tails_lock);
+}
+
+/**
+ * Return the ring the device with the given name is to keep its lines in, or
+ * NULL when no lines are kept.
+ */
+struct tail *tail_open(const char *name)
+{
+    if (tail_nbytes == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&tails_lock);
+    struct tail *t;
+    for (t = tails; t != NULL; t = t->next) {
+        if (!t->used && strcmp(t->name, name) == 0) {
+            break;
+        }
+    }
+    if (t == NULL) {
+        t = calloc(1, sizeof(*t));
+        if (t == NULL) {
+            fprintf(stderr, "Failure to allocate tail ring.\n");
+            abort();
+        }
+        strncpy(t->name, name, sizeof(t->name) - 1);
+        t->next = tails;
+        tails = t;
+    }
+    t->used = true;
+    pthread_mutex_unlock(&tails_lock);
+    return t;
+}
+
+/**
+ * Write the lines of every ring matching the given query to the given stream
+ * in the order they were logged. Returns 0 on success or an error number on
+ * failure.
+ */
+int tail_search(FILE *out, const struct tail_query *q)
+{
+    size_t tag_len = q->tag != NULL ? strlen(q->tag) : 0;
+    unsigned chain = q->tag != NULL
+                     ? tag_hash(q->tag, tag_len) & (TAG_NCHAINS - 1) : 0;
+    size_t text_len = q->text != NULL ? strlen(q->text) : 0;
+    uint64_t grams[GRAM_NBITS / 64] = { 0 };
+    for (size_t i = 2; i < text_len; ++i) {
+        uint32_t bit = gram_bit(&q->text[i - 2]);
+        grams[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+
+    struct hit *hits = NULL;
+    size_t n = 0;
+    size_t nmax = 0;
+    int err = 0;
+    pthread_mutex_lock(&tails_lock);
+    for (const struct tail *t = tails; t != NULL && !err; t = t->next) {
+        for (const struct block *b = t->oldest; b != NULL && !err;
+             b = b->next) {
+            unsigned count = atomic_load_explicit(&b->count,
+                                                  memory_order_acquire);
+            if (count == 0 || b->ms[count - 1] < q->since) {
+                continue;
+            }
+            unsigned line = count;
+            if (q->tag != NULL) {
+                line = atomic_load_explicit(&b->tag_heads[chain],
+                                            memory_order_acquire);
+            }
+            for (;;) {
+                // Lines are visited newest first, down the chain of the tag
+                // when there is one; lines published meanwhile are passed
+                // over.
+                if (q->tag != NULL) {
+                    while (line > count) {
+                        line = b->tag_prev[line - 1];
+                    }
+                }
+                if (line == 0) {
+                    break;
+                }
+                unsigned i = --line;
+                if (q->tag != NULL) {
+                    line = b->tag_prev[i];
+                }
+                if (b->ms[i] < q->since
+                    || (q->tag != NULL
+                        && (b->tag_len[i] != tag_len
+                            || memcmp(&b->bytes[b->text[i]], q->tag, tag_len)
+                               != 0))) {
+                    continue;
+                }
+                if (text_len > 0) {
+                    if (!has_grams(b, i / GROUP_NLINES, grams)) {
+                        // No line of the group holds the text.
+                        if (q->tag == NULL) {
+                            line = i / GROUP_NLINES * GROUP_NLINES;
+                        }
+                        continue;
+                    }
+                    const char *msg = &b->bytes[b->text[i] + b->tag_len[i]];
+                    if (memmem(msg, b->msg_len[i], q->text, text_len) == NULL) {
+                        continue;
+                    }
+                }
+                if (n == nmax) {
+                    size_t grown = nmax > 0 ? nmax * 2 : 256;
+                    struct hit *more = realloc(hits, sizeof(*hits) * grown);
+                    if (more == NULL) {
+                        err = ENOMEM;
+                        break;
+                    }
+                    hits = more;
+                    nmax = grown;
+                }
+                hits[n] = (struct hit){ t, b, i, n };
+                ++n;
+            }
+        }
+    }
+    if (!err && n > 0) {
+        qsort(hits, n, sizeof(*hits), compare_hits);
+    }
+    if (!err) {
+        for (size_t i = 0; i < n; ++i) {
+            dump_line(out, hits[i].tail, hits[i].block, hits[i].line);
+        }
+        err = ferror(out) ? EIO : 0;
+    }
+    pthread_mutex_unlock(&tails_lock);
+    free(hits);
+    return err;
+}
+
+/**
+ * Write the lines of the given snapshot to the given stream in the order they
+ * were logged. Returns 0 on success or an error number on failure.
+ */
+int tail_snapshot_dump(struct tail_snapshot *s, FILE *out)
+{
+    return dump_rings(out, s->rings, s->name, s->since);
+}
+
+/**
+ * Release the given snapshot.
+ */
+void tail_snapshot_free(struct tail_snapshot *s)
+{
+    while (s->rings != NULL) {
+        struct tail *next = s->rings->next;
+        free_ring(s->rings);
+        s->rings = next;
+    }
+    free(s);
+}
+
+/**
+ * Copy the ring of the device with the given name whole, along with the lines
+ * of every other ring logged from the given milliseconds since the epoch on.
+ * Returns the snapshot, which the caller frees, or NULL if the device keeps no
+ * lines.
+ */
+struct tail_snapshot *tail_snapshot_take(const char *name, uint64_t since)
+{
+    struct tail_snapshot *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        fprintf(stderr, "Failure to allocate tail snapshot.\n");
+        abort();
+    }
+    strncpy(s->name, name, sizeof(s->name) - 1);
+    s->since = since;
+
+    bool found = false;
+    pthread_mutex_lock(&tails_lock);
+    for (struct tail *t = tails; t != NULL; t = t->next) {
+        bool whole = strcmp(t->name, s->name) == 0;
+        struct tail *copy = copy_ring(t, whole, since);
+        if (copy != NULL) {
+            found |= whole;
+            copy->next = s->rings;
+            s->rings = copy;
+        }
+    }
+    pthread_mutex_unlock(&tails_lock);
+    if (!found) {
+        tail_snapshot_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+/**
+ * Move the given cursor to the next line to dump.
+ */
+static void advance(struct cursor *c)
+{
+    ++c->line;
+    while (c->block != NULL && c->line >= c->count) {
+        c->block = c->block->next;
+        c->line = 0;
+        c->count = c->block != NULL
+                   ? atomic_load_explicit(&c->block->count,
+                                          memory_order_acquire)
+                   : 0;
+    }
+}
+
+/**
+ * Compare the given lines found by a search by the time they were logged, and
+ * then by the order they were found in.
+ */
+static int compare_hits(const void *a, const void *b)
+{
+    const struct hit *x = a;
+    const struct hit *y = b;
+    uint64_t x_ms = x->block->ms[x->line];
+    uint64_t y_ms = y->block->ms[y->line];
+    if (x_ms != y_ms) {
+        return x_ms < y_ms ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/**
+ * Copy the lines published within the given ring, every one of them when whole
+ * is set and only those of blocks holding lines logged from the given
+ * milliseconds since the epoch on otherwise. Must be called with tails_lock
+ * held. Returns the copy or NULL if no lines were copied.
+ */
+static struct tail *copy_ring(const struct tail *t, bool whole,
+                              uint64_t since)
+{
+    struct tail *copy = NULL;
+    for (const struct block *b = t->oldest; b != NULL; b = b->next) {
+        unsigned n = atomic_load_explicit(&b->count, memory_order_acquire);
+        if (n == 0 || (!whole && b->ms[n - 1] < since)) {
+            continue;
+        }
+        if (copy == NULL) {
+            copy = calloc(1, sizeof(*copy));
+            if (copy == NULL) {
+                fprintf(stderr, "Failure to allocate tail ring.\n");
+                abort();
+            }
+            memcpy(copy->name, t->name, sizeof(copy->name));
+        }
+        struct block *to = malloc(sizeof(*to));
+        if (to == NULL) {
+            fprintf(stderr, "Failure to allocate tail block.\n");
+            abort();
+        }
+
+        // Only the lines published are copied; the rest may be being written.
+        // Snapshots are never searched, so the index is left behind.
+        size_t text = b->text[n - 1] + b->tag_len[n - 1] + b->msg_len[n - 1];
+        to->next = NULL;
+        atomic_init(&to->count, n);
+        to->text_used = text;
+        memcpy(to->ms, b->ms, n * sizeof(b->ms[0]));
+        memcpy(to->pid, b->pid, n * sizeof(b->pid[0]));
+        memcpy(to->tid, b->tid, n * sizeof(b->tid[0]));
+        memcpy(to->text, b->text, n * sizeof(b->text[0]));
+        memcpy(to->msg_len, b->msg_len, n * sizeof(b->msg_len[0]));
+        memcpy(to->tag_len, b->tag_len, n * sizeof(b->tag_len[0]));
+        memcpy(to->tagtype, b->tagtype, n * sizeof(b->tagtype[0]));
+        memcpy(to->bytes, b->bytes, text);
+        if (copy->newest != NULL) {
+            copy->newest->next = to;
+        } else {
+            copy->oldest = to;
+        }
+        copy->newest = to;
+    }
+    return copy;
+}
+
+/**
+ * Write the given line in logcat's threadtime format preceded by the serial
+ * number of its device; every line of a message is written so.
+ */
+static void dump_line(FILE *out, const struct tail *t, const struct block *b,
+                      unsigned line)
+{
+    time_t sec = b->ms[line] / 1000;
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char second[SECOND_NCHARS + 1];
+    strftime(second, sizeof(second), "%m-%d %H:%M:%S", &tm);
+
+    char tid[16] = "    -";
+    if (b->tid[line] >= 0) {
+        snprintf(tid, sizeof(tid), "%5d", b->tid[line]);
+    }
+    const char *tag = &b->bytes[b->text[line]];
+    const char *msg = tag + b->tag_len[line];
+    size_t left = b->msg_len[line];
+    do {
+        const char *newline = memchr(msg, '\n', left);
+        size_t len = newline != NULL ? (size_t)(newline - msg) : left;
+        fprintf(out, "%s %s.%03u %5d %s %c %.*s: %.*s\n", t->name, second,
+                (unsigned)(b->ms[line] % 1000), b->pid[line], tid,
+                b->tagtype[line], (int)b->tag_len[line], tag, (int)len, msg);
+        if (newline == NULL) {
+            break;
+        }
+        msg = newline + 1;
+        left -= len + 1;
+    } while (left > 0);
+}
+
+/**
+ * Write the lines of the given rings to the given stream in the order they were
+ * logged. The lines of the ring of the device with the given name are written
+ * whole, those of the others only from the given milliseconds since the epoch
+ * on. Returns 0 on success or an error number on failure.
+ */
+static int dump_rings(FILE *out, struct tail *rings, const char *whole,
+                      uint64_t since)
+{
+    size_t n = 0;
+    for (struct tail *t = rings; t != NULL; t = t->next) {
+        ++n;
+    }
+    struct cursor *cursors = malloc(sizeof(*cursors) * (n > 0 ? n : 1));
+    if (cursors == NULL) {
+        return ENOMEM;
+    }
+    n = 0;
+    for (struct tail *t = rings; t != NULL; t = t->next) {
+        struct cursor *c = &cursors[n++];
+        c->tail = t;
+        c->block = t->oldest;
+        c->line = 0;
+        c->count = c->block != NULL
+                   ? atomic_load_explicit(&c->block->count,
+                                          memory_order_acquire)
+                   : 0;
+        if (c->count == 0) {
+            advance(c);
+        }
+        if (whole != NULL && strcmp(t->name, whole) != 0) {
+            while (c->block != NULL && c->block->ms[c->line] < since) {
+                advance(c);
+            }
+        }
+    }
+
+    // Devices are few, so the oldest line is searched for among all of them.
+    for (;;) {
+        struct cursor *first = NULL;
+        for (size_t i = 0; i < n; ++i) {
+            struct cursor *c = &cursors[i];
+            if (c->block != NULL
+                && (first == NULL
+                    || c->block->ms[c->line] < first->block->ms[first->line])) {
+                first = c;
+            }
+        }
+        if (first == NULL) {
+            break;
+        }
+        dump_line(out, first->tail, first->block, first->line);
+        advance(first);
+    }
+    free(cursors);
+    return ferror(out) ? EIO : 0;
+}
+
+/**
+ * Release the given ring along with its blocks.
+ */
+static void free_ring(struct tail *t)
+{
+    while (t->oldest != NULL) {
+        struct block *b = t->oldest;
+        t->oldest = b->next;
+        free(b);
+    }
+    free(t);
+}
+
+/**
+ * Return the bit a group sets for the three bytes at the given address.
+ */
+static uint32_t gram_bit(const char *bytes)
+{
+    uint32_t gram = (uint32_t)(uint8_t)bytes[0] << 16
+                    | (uint32_t)(uint8_t)bytes[1] << 8 | (uint8_t)bytes[2];
+    return (gram * 2654435761u) % GRAM_NBITS;
+}
+
+/**
+ * Return whether the given group of the given block has set each of the given
+ * bits.
+ */
+static bool has_grams(const struct block *b, unsigned group,
+                      const uint64_t *grams)
+{
+    for (size_t i = 0; i < GRAM_NBITS / 64; ++i) {
+        uint64_t set = atomic_load_explicit(&b->grams[group][i],
+                                            memory_order_relaxed);
+        if ((set & grams[i]) != grams[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Add the given line, about to be published, to the index of its block. Must
+ * only be called by the thread reading the device.
+ */
+static void index_line(struct block *b, unsigned line)
+{
+    const char *tag = &b->bytes[b->text[line]];
+    unsigned chain = tag_hash(tag, b->tag_len[line]) & (TAG_NCHAINS - 1);
+    b->tag_prev[line] = atomic_load_explicit(&b->tag_heads[chain],
+                                             memory_order_relaxed);
+    atomic_store_explicit(&b->tag_heads[chain], line + 1,
+                          memory_order_release);
+
+    // Only this thread sets bits, so they need not be set atomically.
+    atomic_uint_fast64_t *grams = b->grams[line / GROUP_NLINES];
+    const char *msg = tag + b->tag_len[line];
+    for (size_t i = 2; i < b->msg_len[line]; ++i) {
+        uint32_t bit = gram_bit(&msg[i - 2]);
+        uint_fast64_t set = atomic_load_explicit(&grams[bit / 64],
+                                                 memory_order_relaxed);
+        atomic_store_explicit(&grams[bit / 64],
+                              set | (uint_fast64_t)1 << (bit % 64),
+                              memory_order_relaxed);
+    }
+}
+
+/**
+ * Return a fresh block for the given ring to fill, chained after its newest.
+ * Once the budget is spent, the block holding the oldest lines of any ring is
+ * taken, save those other devices are filling. Returns NULL when no block can
+ * be had.
+ */
+static struct block *next_block(struct tail *t)
+{
+    pthread_mutex_lock(&tails_lock);
+    struct block *b = free_blocks;
+    if (b != NULL) {
+        free_blocks = b->next;
+    } else if (blocks_n < tail_nbytes / sizeof(*b) || blocks_n == 0) {
+        b = malloc(sizeof(*b));
+        if (b == NULL) {
+            fprintf(stderr, "Failure to allocate tail block.\n");
+            abort();
+        }
+        ++blocks_n;
+    } else {
+        struct tail *victim = NULL;
+        for (struct tail *o = tails; o != NULL; o = o->next) {
+            if (o->oldest == NULL
+                || (o->oldest == o->newest && o->used && o != t)
+                || atomic_load_explicit(&o->oldest->count,
+                                        memory_order_relaxed) == 0) {
+                continue;
+            }
+            if (victim == NULL || o->oldest->ms[0] < victim->oldest->ms[0]) {
+                victim = o;
+            }
+        }
+        if (victim != NULL) {
+            b = victim->oldest;
+            victim->oldest = b->next;
+            if (victim->newest == b) {
+                victim->newest = NULL;
+            }
+        }
+    }
+    if (b != NULL) {
+        atomic_init(&b->count, 0);
+        b->text_used = 0;
+        b->next = NULL;
+        for (size_t i = 0; i < TAG_NCHAINS; ++i) {
+            atomic_init(&b->tag_heads[i], 0);
+        }
+        for (size_t i = 0; i < BLOCK_NLINES / GROUP_NLINES; ++i) {
+            for (size_t j = 0; j < GRAM_NBITS / 64; ++j) {
+                atomic_init(&b->grams[i][j], 0);
+            }
+        }
+        if (t->newest != NULL) {
+            t->newest->next = b;
+        } else {
+            t->oldest = b;
+        }
+        t->newest = b;
+    }
+    pthread_mutex_unlock(&tails_lock);
+    return b;
+}
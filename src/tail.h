@@ -0,0 +1,87 @@
+/** @file
+ * Rings of the latest lines of every device kept in memory.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every device may keep its latest lines parsed in memory so that they can be
+ * dumped the moment something goes wrong, merged across devices in the order
+ * they were logged. Lines are kept in blocks of a fixed size that hold each
+ * field of their lines in an array of its own. A block is only ever filled by
+ * the thread reading its device, and all blocks come out of a single budget, so
+ * memory stays bounded however many devices come and go: once the budget is
+ * spent, the block holding the oldest lines of any device is taken.
+ *
+ * Sending SIGUSR2 to the process dumps the rings to a file. A snapshot of the
+ * rings may also be taken and dumped later, see snapshot.h. The rings may be
+ * searched for the lines of a tag, containing some text or logged since some
+ * time, through an index kept along with their blocks, see control.h.
+ */
+#ifndef TAIL_H_
+#define TAIL_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*******************************************************************************
+ * Types
+ */
+
+struct tail;
+struct tail_snapshot;
+
+/**
+ * What the lines found by a search must match.
+ */
+struct tail_query {
+    const char *tag;   //!< Tag of the lines, NULL for any.
+    const char *text;  //!< Text their messages contain, NULL for any.
+    uint64_t    since; //!< Milliseconds since the epoch the lines were logged
+                       //!< from on.
+};
+
+/*******************************************************************************
+ * Global Variables
+ */
+
+extern uint64_t tail_nbytes;
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void tail_add(struct tail *t, uint64_t ms, int32_t pid, int32_t tid,
+              char tagtype, const char *tag, size_t tag_len, const char *msg,
+              size_t msg_len);
+void tail_close(struct tail *t);
+int tail_dump(FILE *out);
+void tail_free(void);
+struct tail *tail_open(const char *name);
+int tail_search(FILE *out, const struct tail_query *q);
+int tail_snapshot_dump(struct tail_snapshot *s, FILE *out);
+void tail_snapshot_free(struct tail_snapshot *s);
+struct tail_snapshot *tail_snapshot_take(const char *name, uint64_t since);
+
+#endif
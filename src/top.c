@@ -0,0 +1,248 @@
+/** @file
+ * Heaviest talking tags of each device, counted by a count-min sketch.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Counters are raised conservatively: of a tag's counters only those below the
+ * new estimate are raised to it, which keeps the estimates of tags sharing
+ * counters with a heavy one much closer to what they logged. Each row takes the
+ * top bits of the tag's hash multiplied by an odd constant of its own.
+ *
+ * The heap is only looked at as the estimate of a tag passes another multiple
+ * of HEAP_QUANTUM_NBYTES, so a line usually costs no more than its counters,
+ * and, since a tag within the heap has an estimate at least that of the root,
+ * only searched when the estimate also passes the root's. The estimates the
+ * heap orders tags by may therefore be a little behind, and tags that have not
+ * yet logged as much are never among the talkers; reports take the estimates
+ * afresh from the sketch.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "top.h"
+
+#include <stdio.h>
+
+#include "tag.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bits of the index of a counter within its row. */
+#define COUNTER_NBITS (__builtin_ctz(TOP_NCOUNTERS))
+
+/** Bytes a tag logs between looks at the heap; must be a power of two. */
+#define HEAP_QUANTUM_NBYTES (1024)
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Multiplier of the hash of a tag for each row of the sketch. */
+static const uint32_t row_seeds[TOP_NROWS] = {
+    0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f,
+};
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static uint64_t bytes_of(const struct top *t, size_t i);
+static uint64_t estimate_of(const struct top *t, uint32_t hash);
+static void sift_down(struct top *t, size_t i, size_t n);
+static void sift_up(struct top *t, size_t i);
+static void store_talker(struct top_talker *to, uint32_t id, uint64_t serial,
+                         uint64_t bytes);
+static void swap_talkers(struct top *t, size_t a, size_t b);
+
+/******************************************************************************/
+
+/**
+ * Count the given bytes a line of the given tag logged. Must only be called by
+ * the thread reading the device.
+ */
+void top_add(struct top *t, const struct tag *tag, uint64_t bytes)
+{
+    atomic_uint_fast64_t *counters[TOP_NROWS];
+    uint64_t estimate = UINT64_MAX;
+    for (int r = 0; r < TOP_NROWS; ++r) {
+        uint32_t at = (tag->hash * row_seeds[r]) >> (32 - COUNTER_NBITS);
+        counters[r] = &t->counters[r][at];
+        uint64_t count = atomic_load_explicit(counters[r],
+                                              memory_order_relaxed);
+        estimate = count < estimate ? count : estimate;
+    }
+    uint64_t before = estimate;
+    estimate += bytes;
+    for (int r = 0; r < TOP_NROWS; ++r) {
+        uint64_t count = atomic_load_explicit(counters[r],
+                                              memory_order_relaxed);
+        atomic_store_explicit(counters[r], count < estimate ? estimate : count,
+                              memory_order_relaxed);
+    }
+
+    if (before / HEAP_QUANTUM_NBYTES == estimate / HEAP_QUANTUM_NBYTES) {
+        return;
+    }
+    size_t n = atomic_load_explicit(&t->ntalkers, memory_order_relaxed);
+    if (n == TOP_NTALKERS && estimate <= bytes_of(t, 0)) {
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (atomic_load_explicit(&t->talkers[i].serial, memory_order_relaxed)
+            == tag->serial) {
+            atomic_store_explicit(&t->talkers[i].bytes, estimate,
+                                  memory_order_relaxed);
+            sift_down(t, i, n);
+            return;
+        }
+    }
+    if (n < TOP_NTALKERS) {
+        store_talker(&t->talkers[n], tag->id, tag->serial, estimate);
+        atomic_store_explicit(&t->ntalkers, n + 1, memory_order_release);
+        sift_up(t, n);
+        return;
+    }
+    store_talker(&t->talkers[0], tag->id, tag->serial, estimate);
+    sift_down(t, 0, n);
+}
+
+/**
+ * Report the heaviest talkers of the given device, which has the given serial
+ * number, into out, which must have room for TOP_NTALKERS. Returns the number
+ * of talkers reported, in no particular order.
+ */
+size_t top_read(const struct top *t, const char *device,
+                struct top_report *out)
+{
+    unsigned token = tag_read_hold();
+    size_t n = atomic_load_explicit(&t->ntalkers, memory_order_acquire);
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const struct top_talker *talker = &t->talkers[i];
+        uint32_t id = atomic_load_explicit(&talker->id, memory_order_relaxed);
+        uint64_t serial = atomic_load_explicit(&talker->serial,
+                                               memory_order_relaxed);
+        const struct tag *tag = tag_get(id);
+        if (tag == NULL || tag->serial != serial) {
+            continue;
+        }
+        struct top_report *report = &out[kept++];
+        report->device = device;
+        snprintf(report->name, sizeof(report->name), "%s", tag->name);
+        report->bytes = estimate_of(t, tag->hash);
+    }
+    tag_read_release(token);
+    return kept;
+}
+
+/**
+ * Return the estimate of the talker at the given position of the heap.
+ */
+static uint64_t bytes_of(const struct top *t, size_t i)
+{
+    return atomic_load_explicit(&t->talkers[i].bytes, memory_order_relaxed);
+}
+
+/**
+ * Return the estimate of the bytes logged by the tag of the given hash.
+ */
+static uint64_t estimate_of(const struct top *t, uint32_t hash)
+{
+    uint64_t estimate = UINT64_MAX;
+    for (int r = 0; r < TOP_NROWS; ++r) {
+        uint32_t at = (hash * row_seeds[r]) >> (32 - COUNTER_NBITS);
+        uint64_t count = atomic_load_explicit(&t->counters[r][at],
+                                              memory_order_relaxed);
+        estimate = count < estimate ? count : estimate;
+    }
+    return estimate;
+}
+
+/**
+ * Move the talker at the given position of the heap of n talkers down past
+ * the talkers of smaller estimates.
+ */
+static void sift_down(struct top *t, size_t i, size_t n)
+{
+    for (;;) {
+        size_t least = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < n && bytes_of(t, left) < bytes_of(t, least)) {
+            least = left;
+        }
+        if (right < n && bytes_of(t, right) < bytes_of(t, least)) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        swap_talkers(t, i, least);
+        i = least;
+    }
+}
+
+/**
+ * Move the talker at the given position of the heap up past the talkers of
+ * larger estimates.
+ */
+static void sift_up(struct top *t, size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (bytes_of(t, parent) <= bytes_of(t, i)) {
+            return;
+        }
+        swap_talkers(t, i, parent);
+        i = parent;
+    }
+}
+
+/**
+ * Store the given tag and estimate as the given talker.
+ */
+static void store_talker(struct top_talker *to, uint32_t id, uint64_t serial,
+                         uint64_t bytes)
+{
+    atomic_store_explicit(&to->id, id, memory_order_relaxed);
+    atomic_store_explicit(&to->serial, serial, memory_order_relaxed);
+    atomic_store_explicit(&to->bytes, bytes, memory_order_relaxed);
+}
+
+/**
+ * Swap the talkers at the given positions of the heap.
+ */
+static void swap_talkers(struct top *t, size_t a, size_t b)
+{
+    struct top_talker *x = &t->talkers[a];
+    struct top_talker *y = &t->talkers[b];
+    uint32_t id = atomic_load_explicit(&x->id, memory_order_relaxed);
+    uint64_t serial = atomic_load_explicit(&x->serial, memory_order_relaxed);
+    uint64_t bytes = atomic_load_explicit(&x->bytes, memory_order_relaxed);
+    store_talker(x, atomic_load_explicit(&y->id, memory_order_relaxed),
+                 atomic_load_explicit(&y->serial, memory_order_relaxed),
+                 atomic_load_explicit(&y->bytes, memory_order_relaxed));
+    store_talker(y, id, serial, bytes);
+}
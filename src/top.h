@@ -0,0 +1,110 @@
+/** @file
+ * Heaviest talking tags of each device, counted by a count-min sketch.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Every line a device shows adds the bytes of its message to the count of its
+ * tag within a count-min sketch, a few rows of counters each indexed by another
+ * part of the tag's hash. The smallest of a tag's counters is an estimate that
+ * never falls short of what the tag logged and only overshoots by what other
+ * tags sharing its counters logged. Alongside the sketch a small min-heap keeps
+ * the tags of the largest estimates seen, so the tags responsible for a flood
+ * are known at a constant cost per line without keeping a count for every tag.
+ *
+ * Only the thread reading a device updates its sketch and heap, while reports
+ * read them without a lock. Tags are remembered by identifier and serial
+ * number, and an entry is only reported once the tag interned under its
+ * identifier is still the one it was recorded for.
+ */
+#ifndef TOP_H_
+#define TOP_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of rows of the sketch. */
+#define TOP_NROWS (4)
+
+/**
+ * Number of counters of each row of the sketch; must be a power of two. The
+ * sketch of a device takes 8 KiB.
+ */
+#define TOP_NCOUNTERS (256)
+
+/** Number of tags kept by the heap of the heaviest talkers. */
+#define TOP_NTALKERS (16)
+
+/** Maximum number of characters of a tag's name reported. */
+#define TOP_NAME_NCHARS (64)
+
+/*******************************************************************************
+ * Types
+ */
+
+struct tag;
+
+/**
+ * Tag among the heaviest talkers of a device.
+ */
+struct top_talker {
+    _Atomic uint32_t     id;     //!< Identifier of the tag.
+    atomic_uint_fast64_t serial; //!< Serial number of the tag.
+    atomic_uint_fast64_t bytes;  //!< Estimate of the bytes it logged.
+};
+
+/**
+ * Heaviest talking tags of a device.
+ */
+struct top {
+    atomic_uint_fast64_t counters[TOP_NROWS][TOP_NCOUNTERS]; //!< Sketch.
+    struct top_talker    talkers[TOP_NTALKERS];   //!< Min-heap of the tags
+                                                  //!< of the largest
+                                                  //!< estimates, by bytes.
+    atomic_size_t        ntalkers;                //!< Tags held by the heap.
+};
+
+/**
+ * Tag among the heaviest talkers as reported.
+ */
+struct top_report {
+    const char *device;                //!< Serial number of the device.
+    char        name[TOP_NAME_NCHARS]; //!< Name of the tag.
+    uint64_t    bytes;                 //!< Estimate of the bytes it logged.
+};
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+void top_add(struct top *t, const struct tag *tag, uint64_t bytes);
+size_t top_read(const struct top *t, const char *device,
+                struct top_report *out);
+
+#endif
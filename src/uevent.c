@@ -0,0 +1,124 @@
+/** @file
+ * Discovery of Android USB interfaces through kernel uevents.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Messages are drained without blocking, so that a burst of uevents from one
+ * device plugged in, one per interface and configuration, costs a single
+ * refresh of the listing of devices.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "uevent.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Interface class, subclass and protocol of the adb interface. */
+#define ADB_INTERFACE "INTERFACE=255/66/1"
+
+/** Multicast group the kernel broadcasts uevents to. */
+#define UEVENT_GROUP (1)
+
+/** Maximum number of bytes of a single uevent. */
+#define UEVENT_NBYTES (8 * 1024)
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static bool is_adb_interface(const char *msg, size_t len);
+
+/******************************************************************************/
+
+/**
+ * Open a socket receiving the uevents of the kernel. Returns the socket, which
+ * never blocks, or -1 setting errno on failure.
+ */
+int uevent_open(void)
+{
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = UEVENT_GROUP,
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Drain the uevents waiting on the given socket. Returns whether any of them
+ * told of an adb interface coming or going.
+ */
+bool uevent_read(int fd)
+{
+    bool changed = false;
+    char msg[UEVENT_NBYTES];
+    for (;;) {
+        ssize_t n = recv(fd, msg, sizeof(msg), 0);
+        if (n < 0) {
+            // Messages lost to a full socket may have been any of ours.
+            return changed || errno == ENOBUFS;
+        }
+        if (is_adb_interface(msg, n)) {
+            changed = true;
+        }
+    }
+}
+
+/**
+ * Return whether the given uevent is about an adb interface. A uevent starts
+ * with the action and path of the device, which messages not sent by the
+ * kernel lack.
+ */
+static bool is_adb_interface(const char *msg, size_t len)
+{
+    const char *end = msg + len;
+    size_t n = strnlen(msg, len);
+    if (n == len || memchr(msg, '@', n) == NULL) {
+        return false;
+    }
+    for (const char *s = msg + n + 1; s < end; s += n + 1) {
+        n = strnlen(s, end - s);
+        if (n == sizeof(ADB_INTERFACE) - 1
+            && memcmp(s, ADB_INTERFACE, n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
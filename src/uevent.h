@@ -0,0 +1,46 @@
+/** @file
+ * Discovery of Android USB interfaces through kernel uevents.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * The kernel broadcasts a uevent over netlink whenever a device is added,
+ * removed, bound or unbound. Each message is a header followed by KEY=VALUE
+ * strings, each NUL terminated. An adb interface of a USB device identifies
+ * itself by its class, subclass and protocol, so only the messages that name
+ * such an interface tell anything about the devices adb may list.
+ */
+#ifndef UEVENT_H_
+#define UEVENT_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include <stdbool.h>
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int uevent_open(void);
+bool uevent_read(int fd);
+
+#endif
@@ -0,0 +1,507 @@
+/** @file
+ * io_uring backend of the event loops.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * There is no dependency on liburing; the rings are set up and driven through
+ * the raw system calls. Devices discovered by other threads are queued on the
+ * loop and announced through an eventfd the loop keeps a read posted on, since
+ * only the loop's own thread touches its submission queue.
+ *
+ * A chunk is copied out of the provided buffer into the device's input buffer
+ * and the provided buffer goes straight back to the ring. Lines therefore keep
+ * living in reference counted buffers for however long the writer needs them,
+ * and the ring never runs dry waiting on the writer.
+ *
+ * Kernels too old for multishot reads fail the first one with EINVAL; the loop
+ * then falls back to posting a single read per completion. Kernels without
+ * provided buffer rings fail uring_init() and the caller falls back to epoll.
+ */
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "uring.h"
+
+#include "config.h"
+
+#include <errno.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <assert.h>
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "filter.h"
+#include "logcat.h"
+#include "stats.h"
+
+/*******************************************************************************
+ * Constants
+ */
+
+/** Number of bytes in each provided buffer. */
+#define CHUNK_NBYTES (16 * 1024)
+
+/** Number of provided buffers per loop; must be a power of two. */
+#define CHUNKS_NMAX (64)
+
+/** Group identifier of the provided buffers. */
+#define CHUNKS_GROUP (0)
+
+/**
+ * Opcode of the multishot read, which headers older than Linux 6.7 do not
+ * define.
+ */
+#define OP_READ_MULTISHOT (49)
+
+/** Number of submission queue entries of each ring. */
+#define RING_NENTRIES (256)
+
+/** User data of the completions of the loop's eventfd read. */
+#define WAKE_USER_DATA (0)
+
+/** Nanoseconds a loop waits before checking for shutdown. */
+#define WAIT_NSECS (1000 * 1000 * 1000)
+
+/*******************************************************************************
+ * Local Types
+ */
+
+/**
+ * Event loop driving an io_uring instance.
+ */
+struct uring {
+    pthread_t                 thread;     //!< Thread of execution of the loop.
+    int                       fd;         //!< Descriptor of the io_uring.
+    int                       wake_fd;    //!< Eventfd announcing new devices.
+    uint64_t                  wake_count; //!< Value read from the eventfd.
+    bool                      multishot;  //!< Whether to post multishot reads.
+
+    pthread_mutex_t           lock;       //!< Lock protecting added.
+    struct device            *added;      //!< Devices waiting to be served.
+
+    void                     *ring_map;   //!< Mapping of both queues.
+    _Atomic unsigned         *sq_head;    //!< Head of the submission queue.
+    _Atomic unsigned         *sq_tail;    //!< Tail of the submission queue.
+    unsigned                 *sq_array;   //!< Indices of queued entries.
+    unsigned                  sq_mask;    //!< Entries of the queue less one.
+    unsigned                  sq_local;   //!< Tail including unpublished.
+    unsigned                  sq_pending; //!< Entries not yet submitted.
+    struct io_uring_sqe      *sqes;       //!< Submission queue entries.
+
+    _Atomic unsigned         *cq_head;    //!< Head of the completion queue.
+    _Atomic unsigned         *cq_tail;    //!< Tail of the completion queue.
+    unsigned                  cq_mask;    //!< Entries of the queue less one.
+    struct io_uring_cqe      *cqes;       //!< Completion queue entries.
+
+    struct io_uring_buf_ring *br;         //!< Ring of provided buffers.
+    uint16_t                  br_tail;    //!< Tail of the provided buffers.
+    char                     *chunks;     //!< Storage of provided buffers.
+};
+
+/*******************************************************************************
+ * Local Variables
+ */
+
+/** Loops that devices are spread over. */
+static struct uring *urings;
+
+/** Number of loops. */
+static int urings_n;
+
+/** Index of the loop to receive the next device. */
+static int next_uring;
+
+/*******************************************************************************
+ * Local Functions
+ */
+
+static void arm_read(struct uring *r, struct device *d);
+static void arm_wake(struct uring *r);
+static struct io_uring_sqe *get_sqe(struct uring *r);
+static void handle_cqe(struct uring *r, struct logcat_parser *parser,
+                       const struct io_uring_cqe *cqe);
+static void recycle_chunk(struct uring *r, uint16_t bid);
+static void *run_uring(void *uring);
+static int setup_uring(struct uring *r);
+static int submit(struct uring *r, bool wait);
+
+/******************************************************************************/
+
+/**
+ * Hand the given device, whose logcat is already running, to the next loop.
+ * Calls must not overlap. Returns 0 on success or an error number on failure.
+ */
+int uring_add(struct device *d)
+{
+    struct uring *r = &urings[next_uring];
+    next_uring = (next_uring + 1) % urings_n;
+
+    pthread_mutex_lock(&r->lock);
+    d->next = r->added;
+    r->added = d;
+    pthread_mutex_unlock(&r->lock);
+
+    uint64_t one = 1;
+    if (write(r->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        return errno;
+    }
+    return 0;
+}
+
+/**
+ * Stop the loops once shutdown has been requested. The devices they read are
+ * left open.
+ */
+void uring_close(void)
+{
+    uint64_t one = 1;
+    for (int i = 0; i < urings_n; ++i) {
+        ssize_t n = write(urings[i].wake_fd, &one, sizeof(one));
+        (void)n;
+    }
+    for (int i = 0; i < urings_n; ++i) {
+        pthread_join(urings[i].thread, NULL);
+    }
+    urings_n = 0;
+}
+
+/**
+ * Start the given number of io_uring event loops. Returns 0 on success or an
+ * error number when io_uring is not usable, in which case no loop is started.
+ */
+int uring_init(int nloops)
+{
+    urings = calloc(nloops, sizeof(*urings));
+    if (urings == NULL) {
+        return ENOMEM;
+    }
+    for (int i = 0; i < nloops; ++i) {
+        int err = setup_uring(&urings[i]);
+        if (err) {
+            // Rings already set up are left alone; they are few and small.
+            free(urings);
+            urings = NULL;
+            return err;
+        }
+    }
+    urings_n = nloops;
+    for (int i = 0; i < nloops; ++i) {
+        int err = pthread_create(&urings[i].thread, NULL, run_uring,
+                                 &urings[i]);
+        if (err) {
+            return err;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Post a read of the given device's output into a provided buffer.
+ */
+static void arm_read(struct uring *r, struct device *d)
+{
+    struct io_uring_sqe *sqe = get_sqe(r);
+    sqe->opcode = r->multishot ? OP_READ_MULTISHOT : IORING_OP_READ;
+    sqe->fd = d->fd;
+    sqe->off = -1;
+    sqe->len = r->multishot ? 0 : CHUNK_NBYTES;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = CHUNKS_GROUP;
+    sqe->user_data = (uintptr_t)d;
+}
+
+/**
+ * Post a read of the loop's eventfd.
+ */
+static void arm_wake(struct uring *r)
+{
+    struct io_uring_sqe *sqe = get_sqe(r);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->wake_fd;
+    sqe->off = -1;
+    sqe->addr = (uintptr_t)&r->wake_count;
+    sqe->len = sizeof(r->wake_count);
+    sqe->user_data = WAKE_USER_DATA;
+}
+
+/**
+ * Return a cleared submission queue entry, submitting the queued entries first
+ * should the queue be full.
+ */
+static struct io_uring_sqe *get_sqe(struct uring *r)
+{
+    unsigned head = atomic_load_explicit(r->sq_head, memory_order_acquire);
+    if (r->sq_local - head > r->sq_mask) {
+        submit(r, false);
+    }
+    unsigned idx = r->sq_local & r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    ++r->sq_local;
+    ++r->sq_pending;
+    return sqe;
+}
+
+/**
+ * Handle a single completion.
+ */
+static void handle_cqe(struct uring *r, struct logcat_parser *parser,
+                       const struct io_uring_cqe *cqe)
+{
+    if (cqe->user_data == WAKE_USER_DATA) {
+        pthread_mutex_lock(&r->lock);
+        struct device *added = r->added;
+        r->added = NULL;
+        pthread_mutex_unlock(&r->lock);
+        while (added != NULL) {
+            struct device *d = added;
+            added = d->next;
+            arm_read(r, d);
+        }
+        arm_wake(r);
+        return;
+    }
+
+    struct device *d = (struct device *)(uintptr_t)cqe->user_data;
+    if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        device_feed(d, parser, r->chunks + (size_t)bid * CHUNK_NBYTES,
+                    cqe->res);
+        recycle_chunk(r, bid);
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            arm_read(r, d);
+        }
+        return;
+    }
+
+    // Reads end on their own when the buffers run out; there are buffers
+    // again by the time this read is submitted.
+    if (cqe->res == -ENOBUFS || cqe->res == -EINTR || cqe->res == -EAGAIN) {
+        arm_read(r, d);
+        return;
+    }
+    if (cqe->res == -EINVAL && r->multishot) {
+        r->multishot = false;
+        arm_read(r, d);
+        return;
+    }
+
+    // Device disconnected; cleanup the device resources.
+    device_feed(d, parser, NULL, 0);
+    device_close(d);
+}
+
+/**
+ * Hand the provided buffer with the given identifier back to the kernel.
+ */
+static void recycle_chunk(struct uring *r, uint16_t bid)
+{
+    struct io_uring_buf *buf = &r->br->bufs[r->br_tail & (CHUNKS_NMAX - 1)];
+    buf->addr = (uintptr_t)(r->chunks + (size_t)bid * CHUNK_NBYTES);
+    buf->len = CHUNK_NBYTES;
+    buf->bid = bid;
+    ++r->br_tail;
+    atomic_store_explicit((_Atomic uint16_t *)&r->br->tail, r->br_tail,
+                          memory_order_release);
+}
+
+/**
+ * Run thread of execution that submits reads and handles their completions
+ * for the devices served by the given loop.
+ */
+static void *run_uring(void *uring)
+{
+    int err;
+
+    struct uring *r = (struct uring *)uring;
+    affinity_pin(AFFINITY_READERS);
+    struct logcat_parser parser;
+    err = logcat_parser_init(&parser);
+    assert(!err);
+
+    arm_wake(r);
+    while (!atomic_load(&shutdown_requested)) {
+        if (submit(r, true) != 0) {
+            continue;
+        }
+
+        // Reap every completion available in one pass.
+        unsigned head = atomic_load_explicit(r->cq_head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(r->cq_tail, memory_order_acquire);
+        while (head != tail) {
+            handle_cqe(r, &parser, &r->cqes[head & r->cq_mask]);
+            ++head;
+        }
+        atomic_store_explicit(r->cq_head, head, memory_order_release);
+    }
+    stats_thread_unregister();
+    filter_thread_free();
+    logcat_parser_free(&parser);
+    return NULL;
+}
+
+/**
+ * Set up the rings and provided buffers of the given loop. Returns 0 on
+ * success or an error number on failure.
+ */
+static int setup_uring(struct uring *r)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = syscall(__NR_io_uring_setup, RING_NENTRIES, &p);
+    if (r->fd < 0) {
+        return errno;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)
+        || !(p.features & IORING_FEAT_EXT_ARG)) {
+        close(r->fd);
+        return ENOSYS;
+    }
+
+    // Map the rings; the completion queue shares the submission queue's
+    // mapping.
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->ring_map = mmap(NULL, sq_len > cq_len ? sq_len : cq_len,
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                       IORING_OFF_SQ_RING);
+    if (r->ring_map == MAP_FAILED) {
+        int err = errno;
+        close(r->fd);
+        return err;
+    }
+    char *sq = r->ring_map;
+    r->sq_head = (_Atomic unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (_Atomic unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->sq_local = atomic_load(r->sq_tail);
+    char *cq = r->ring_map;
+    r->cq_head = (_Atomic unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (_Atomic unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                   IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        int err = errno;
+        close(r->fd);
+        return err;
+    }
+
+    // Register the ring of provided buffers and fill it.
+    r->br = mmap(NULL, CHUNKS_NMAX * sizeof(struct io_uring_buf),
+                 PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    r->chunks = malloc((size_t)CHUNKS_NMAX * CHUNK_NBYTES);
+    if (r->br == MAP_FAILED || r->chunks == NULL) {
+        close(r->fd);
+        return ENOMEM;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)r->br;
+    reg.ring_entries = CHUNKS_NMAX;
+    reg.bgid = CHUNKS_GROUP;
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) != 0) {
+        int err = errno;
+        close(r->fd);
+        return err;
+    }
+    for (uint16_t bid = 0; bid < CHUNKS_NMAX; ++bid) {
+        recycle_chunk(r, bid);
+    }
+
+    r->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (r->wake_fd < 0) {
+        int err = errno;
+        close(r->fd);
+        return err;
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    r->multishot = true;
+    return 0;
+}
+
+/**
+ * Submit the queued entries, waiting for at least one completion if asked to.
+ * Returns 0 on success or an error number on failure, which includes the wait
+ * timing out.
+ */
+static int submit(struct uring *r, bool wait)
+{
+    atomic_store_explicit(r->sq_tail, r->sq_local, memory_order_release);
+
+    struct __kernel_timespec ts = { 0, WAIT_NSECS };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uintptr_t)&ts;
+    unsigned flags = wait ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+    int n = syscall(__NR_io_uring_enter, r->fd, r->sq_pending, wait ? 1 : 0,
+                    flags, wait ? &arg : NULL, sizeof(arg));
+    if (n < 0) {
+        return errno;
+    }
+    r->sq_pending -= n;
+    return 0;
+}
+
+#else
+
+/**
+ * Fail to hand the device to a loop; io_uring is not available in this build.
+ */
+int uring_add(struct device *d)
+{
+    return ENOSYS;
+}
+
+/**
+ * Stop no loop; io_uring is not available in this build.
+ */
+void uring_close(void)
+{
+}
+
+/**
+ * Fail to start the loops; io_uring is not available in this build.
+ */
+int uring_init(int nloops)
+{
+    return ENOSYS;
+}
+
+#endif
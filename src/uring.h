@@ -0,0 +1,46 @@
+/** @file
+ * io_uring backend of the event loops.
+ *
+ *==============================================================================
+ * Copyright 2013 by Brandon Edens. All Rights Reserved
+ *==============================================================================
+ *
+ * android-log is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * android-log is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with android-log. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author  Brandon Edens
+ * @date    2026-10-14
+ * @details
+ *
+ * Each loop keeps a multishot read posted on every device it serves. The kernel
+ * picks the buffer for each read from a ring of buffers provided by the loop,
+ * so a single io_uring_enter() reaps the output of every busy device at once
+ * and posts whatever reads need posting again.
+ */
+#ifndef URING_H_
+#define URING_H_
+
+/*******************************************************************************
+ * Include Files
+ */
+#include "device.h"
+
+/*******************************************************************************
+ * Global Functions
+ */
+
+int uring_add(struct device *d);
+void uring_close(void);
+int uring_init(int nloops);
+
+#endif